@@ -0,0 +1,427 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* clock_gettime under -std=c17 */
+#endif
+#include "fossil/cube/framework.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* Throughput of the core primitives
+   - every case runs on an immediate-mode context (deferred for the tile
+     cases), once per available SIMD level and resolution
+   - output is one JSON object per line on stdout:
+       {"case":"fill_alpha","width":1280,"height":720,"simd":"sse2",
+        "threads":1,"iters":...,"ns_per_iter":...,"mpix_s":...,"best_mpix_s":...}
+     mpix_s is the median of the timed batches, best_mpix_s the fastest
+   - pixels per iteration are the destination pixels the case covers
+     (for lines and shapes, the drawn length or area)
+   - --iters n skips calibration and runs every case exactly n times after
+     one warm-up run, so the work done is the same on every run: the CI
+     instruction-count check runs it under cachegrind
+   - --filter keeps the cases whose name contains substr, --case only the
+     one named exactly
+
+   Usage: cube-bench [--quick] [--filter substr] [--case name] [--simd best|all] [--threads n]
+                     [--iters n]
+*/
+
+static uint64_t bench_now_ns(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER f, t;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&t);
+    return (uint64_t)((double)t.QuadPart * 1e9 / (double)f.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint32_t bench_rng = 1u;
+
+static uint32_t bench_rand(void) {
+    bench_rng = bench_rng * 1664525u + 1013904223u;
+    return bench_rng >> 8;
+}
+
+enum { BENCH_LINES = 256, BENCH_RECTS = 256, BENCH_CIRCLES = 64, BENCH_BATCHES = 5 };
+
+typedef struct bench_env {
+    fossil_cube_ctx* ctx;
+    int w, h;
+    uint8_t* opaque;      /* w x h sources */
+    uint8_t* mixed;       /* opaque, transparent and translucent quarters */
+    uint8_t* clear;
+    uint8_t* half;        /* w/2 x h/2, scaled back up */
+    fossil_cube_font* font;
+    int lines[BENCH_LINES][4];
+    int rects[BENCH_RECTS][4];
+    float* chart;         /* w points */
+    double pixels;        /* per iteration, set by setup */
+} bench_env;
+
+typedef struct bench_case {
+    const char* name;
+    bool deferred; /* runs whole frames on the tile executor */
+    void (*setup)(bench_env* e);
+    void (*run)(bench_env* e);
+} bench_case;
+
+static const char* bench_text = "The quick brown fox jumps over the lazy dog 0123456789";
+
+static void setup_screen(bench_env* e) { e->pixels = (double)e->w * e->h; }
+
+static void run_clear(bench_env* e) { fossil_cube_clear_ex(e->ctx, 20, 40, 60, 255); }
+
+static void run_fill_opaque(bench_env* e) {
+    fossil_cube_fill_rect_ex(e->ctx, 0, 0, e->w, e->h, 200, 100, 50, 255);
+}
+
+static void run_fill_alpha(bench_env* e) {
+    fossil_cube_fill_rect_ex(e->ctx, 0, 0, e->w, e->h, 200, 100, 50, 128);
+}
+
+static void run_blit_opaque(bench_env* e) {
+    fossil_cube_blit_rgba_ex(e->ctx, 0, 0, e->opaque, e->w, e->h, e->w * 4);
+}
+
+static void run_blit_mixed(bench_env* e) {
+    fossil_cube_blit_rgba_ex(e->ctx, 0, 0, e->mixed, e->w, e->h, e->w * 4);
+}
+
+static void run_blit_transparent(bench_env* e) {
+    fossil_cube_blit_rgba_ex(e->ctx, 0, 0, e->clear, e->w, e->h, e->w * 4);
+}
+
+static void run_scaled_nearest(bench_env* e) {
+    fossil_cube_blit_scaled_ex(e->ctx, 0, 0, e->w, e->h, e->half, e->w / 2, e->h / 2, (e->w / 2) * 4,
+                               FOSSIL_CUBE_FILTER_NEAREST);
+}
+
+static void run_scaled_bilinear(bench_env* e) {
+    fossil_cube_blit_scaled_ex(e->ctx, 0, 0, e->w, e->h, e->half, e->w / 2, e->h / 2, (e->w / 2) * 4,
+                               FOSSIL_CUBE_FILTER_BILINEAR);
+}
+
+static void setup_lines(bench_env* e) {
+    bench_rng = 7u;
+    e->pixels = 0;
+    for (int i = 0; i < BENCH_LINES; ++i) {
+        int* l = e->lines[i];
+        l[0] = (int)(bench_rand() % (uint32_t)e->w);
+        l[1] = (int)(bench_rand() % (uint32_t)e->h);
+        l[2] = (int)(bench_rand() % (uint32_t)e->w);
+        l[3] = (int)(bench_rand() % (uint32_t)e->h);
+        /* keep them off the axis-aligned fast path */
+        if (l[0] == l[2]) l[2] = l[0] > 0 ? l[0] - 1 : 1;
+        if (l[1] == l[3]) l[3] = l[1] > 0 ? l[1] - 1 : 1;
+        const int dx = abs(l[2] - l[0]), dy = abs(l[3] - l[1]);
+        e->pixels += (double)(dx > dy ? dx : dy) + 1.0;
+    }
+}
+
+static void run_lines_opaque(bench_env* e) {
+    for (int i = 0; i < BENCH_LINES; ++i) {
+        const int* l = e->lines[i];
+        fossil_cube_draw_line_ex(e->ctx, l[0], l[1], l[2], l[3], 255, 255, 255, 255);
+    }
+}
+
+static void run_lines_alpha(bench_env* e) {
+    for (int i = 0; i < BENCH_LINES; ++i) {
+        const int* l = e->lines[i];
+        fossil_cube_draw_line_ex(e->ctx, l[0], l[1], l[2], l[3], 255, 255, 255, 140);
+    }
+}
+
+static void setup_hlines(bench_env* e) { e->pixels = (double)e->w * (e->h / 2); }
+
+static void run_hlines(bench_env* e) {
+    for (int y = 0; y < e->h; y += 2) fossil_cube_draw_hline_ex(e->ctx, 0, y, e->w, 90, 200, 90, 200);
+}
+
+static void setup_vlines(bench_env* e) { e->pixels = (double)(e->w / 2) * e->h; }
+
+static void run_vlines(bench_env* e) {
+    for (int x = 0; x < e->w; x += 2) fossil_cube_draw_vline_ex(e->ctx, x, 0, e->h, 90, 200, 90, 200);
+}
+
+static void setup_text(bench_env* e) {
+    const int lines = e->h / 20;
+    e->pixels = (double)fossil_cube_text_width(e->font, bench_text, 20) * 20.0 * lines;
+}
+
+static void run_text(bench_env* e) {
+    for (int y = 16; y + 4 <= e->h; y += 20) {
+        fossil_cube_draw_text_ex(e->ctx, e->font, 0, y, bench_text, 20, 240, 240, 240, 255);
+    }
+}
+
+static void setup_circles(bench_env* e) {
+    const double r = e->h / 8.0;
+    e->pixels = BENCH_CIRCLES * 3.14159265358979 * r * r;
+}
+
+static void run_circles(bench_env* e) {
+    const float r = (float)e->h / 8.0f;
+    for (int i = 0; i < BENCH_CIRCLES; ++i) {
+        const float cx = r + (float)((i * 97) % (e->w - 2 * (int)r));
+        const float cy = r + (float)((i * 53) % (e->h - 2 * (int)r));
+        fossil_cube_fill_circle_ex(e->ctx, cx, cy, r, 50, 120, 220, 160);
+    }
+}
+
+static void setup_polyline(bench_env* e) {
+    e->pixels = 0;
+    for (int i = 0; i < e->w; ++i) {
+        e->chart[i * 2 + 0] = (float)i;
+        e->chart[i * 2 + 1] = (float)e->h * (0.5f + 0.4f * sinf((float)i * 0.05f));
+        if (i > 0) {
+            const double dx = e->chart[i * 2] - e->chart[i * 2 - 2];
+            const double dy = e->chart[i * 2 + 1] - e->chart[i * 2 - 1];
+            e->pixels += sqrt(dx * dx + dy * dy) * 2.0;
+        }
+    }
+}
+
+static void run_polyline(bench_env* e) {
+    fossil_cube_draw_polyline_ex(e->ctx, e->chart, e->w, 2.0f, 255, 200, 40, 255);
+}
+
+static void setup_tile_rects(bench_env* e) {
+    bench_rng = 11u;
+    e->pixels = 0;
+    for (int i = 0; i < BENCH_RECTS; ++i) {
+        int* r = e->rects[i];
+        r[2] = 16 + (int)(bench_rand() % (uint32_t)(e->w / 3));
+        r[3] = 16 + (int)(bench_rand() % (uint32_t)(e->h / 3));
+        r[0] = (int)(bench_rand() % (uint32_t)(e->w - r[2]));
+        r[1] = (int)(bench_rand() % (uint32_t)(e->h - r[3]));
+        e->pixels += (double)r[2] * r[3];
+    }
+}
+
+static void run_tile_rects(bench_env* e) {
+    fossil_cube_begin_frame_retain_ex(e->ctx);
+    for (int i = 0; i < BENCH_RECTS; ++i) {
+        const int* r = e->rects[i];
+        fossil_cube_fill_rect_ex(e->ctx, r[0], r[1], r[2], r[3], (uint8_t)(i * 40), 90, 200, 150);
+    }
+    fossil_cube_end_frame_ex(e->ctx);
+}
+
+static const bench_case bench_cases[] = {
+    { "clear",              false, setup_screen,     run_clear },
+    { "fill_opaque",        false, setup_screen,     run_fill_opaque },
+    { "fill_alpha",         false, setup_screen,     run_fill_alpha },
+    { "blit_opaque",        false, setup_screen,     run_blit_opaque },
+    { "blit_mixed",         false, setup_screen,     run_blit_mixed },
+    { "blit_transparent",   false, setup_screen,     run_blit_transparent },
+    { "draw_line_opaque",   false, setup_lines,      run_lines_opaque },
+    { "draw_line_alpha",    false, setup_lines,      run_lines_alpha },
+    { "draw_hline",         false, setup_hlines,     run_hlines },
+    { "draw_vline",         false, setup_vlines,     run_vlines },
+    { "scaled_nearest_2x",  false, setup_screen,     run_scaled_nearest },
+    { "scaled_bilinear_2x", false, setup_screen,     run_scaled_bilinear },
+    { "text_builtin_20px",  false, setup_text,       run_text },
+    { "aa_fill_circle",     false, setup_circles,    run_circles },
+    { "aa_polyline_2px",    false, setup_polyline,   run_polyline },
+    { "deferred_rects",     true,  setup_tile_rects, run_tile_rects },
+};
+
+static const char* bench_simd_name(fossil_cube_simd s) {
+    switch (s) {
+    case FOSSIL_CUBE_SIMD_SSE2: return "sse2";
+    case FOSSIL_CUBE_SIMD_AVX2: return "avx2";
+    case FOSSIL_CUBE_SIMD_NEON: return "neon";
+    default: return "scalar";
+    }
+}
+
+static void bench_fill_sources(bench_env* e) {
+    const int n = e->w * e->h;
+    for (int i = 0; i < n; ++i) {
+        const int x = i % e->w, y = i / e->w;
+        uint8_t* o = e->opaque + (size_t)i * 4u;
+        o[0] = (uint8_t)x; o[1] = (uint8_t)y; o[2] = (uint8_t)(x ^ y); o[3] = 255;
+        uint8_t* m = e->mixed + (size_t)i * 4u;
+        memcpy(m, o, 4);
+        /* 8-pixel stripes: opaque, clear, translucent, opaque */
+        switch ((x / 8) & 3) {
+        case 1: m[3] = 0; break;
+        case 2: m[3] = (uint8_t)(64 + (y & 127)); break;
+        default: break;
+        }
+    }
+    memset(e->clear, 0, (size_t)n * 4u);
+    for (int y = 0; y < e->h / 2; ++y) {
+        memcpy(e->half + (size_t)y * (size_t)(e->w / 2) * 4u, e->opaque + (size_t)y * (size_t)e->w * 4u,
+               (size_t)(e->w / 2) * 4u);
+    }
+}
+
+/* Time one case: calibrate the batch size (unless fixed is set), then
+   keep the median and the fastest of BENCH_BATCHES batches */
+static void bench_run(bench_env* e, const bench_case* bc, const char* simd, int threads, double target_s,
+                      uint64_t fixed) {
+    bc->setup(e);
+    bc->run(e); /* warm caches and lazily built state (glyphs) */
+    double per_iter[BENCH_BATCHES];
+    uint64_t iters = fixed;
+    int batches = 1;
+    if (fixed > 0) {
+        const uint64_t t0 = bench_now_ns();
+        for (uint64_t i = 0; i < iters; ++i) bc->run(e);
+        per_iter[0] = (double)(bench_now_ns() - t0) / (double)iters;
+    } else {
+        iters = 1;
+        for (;;) {
+            const uint64_t t0 = bench_now_ns();
+            for (uint64_t i = 0; i < iters; ++i) bc->run(e);
+            const double dt = (double)(bench_now_ns() - t0) * 1e-9;
+            if (dt >= target_s / BENCH_BATCHES || iters >= (1u << 30)) break;
+            iters = dt > 0 ? (uint64_t)((double)iters * (target_s / BENCH_BATCHES) / dt) + 1u : iters * 10u;
+        }
+        batches = BENCH_BATCHES;
+        for (int b = 0; b < batches; ++b) {
+            const uint64_t t0 = bench_now_ns();
+            for (uint64_t i = 0; i < iters; ++i) bc->run(e);
+            per_iter[b] = (double)(bench_now_ns() - t0) / (double)iters;
+        }
+    }
+    for (int i = 1; i < batches; ++i) {
+        for (int j = i; j > 0 && per_iter[j] < per_iter[j - 1]; --j) {
+            const double t = per_iter[j]; per_iter[j] = per_iter[j - 1]; per_iter[j - 1] = t;
+        }
+    }
+    const double median = per_iter[batches / 2], best = per_iter[0];
+    printf("{\"case\":\"%s\",\"width\":%d,\"height\":%d,\"simd\":\"%s\",\"threads\":%d,"
+           "\"iters\":%llu,\"ns_per_iter\":%.1f,\"mpix_s\":%.2f,\"best_mpix_s\":%.2f}\n",
+           bc->name, e->w, e->h, simd, threads, (unsigned long long)iters, median,
+           median > 0 ? e->pixels * 1e3 / median : 0.0, best > 0 ? e->pixels * 1e3 / best : 0.0);
+    fflush(stdout);
+}
+
+static bool bench_env_init(bench_env* e, int w, int h) {
+    memset(e, 0, sizeof(*e));
+    e->w = w;
+    e->h = h;
+    const size_t n = (size_t)w * (size_t)h * 4u;
+    e->opaque = (uint8_t*)malloc(n);
+    e->mixed = (uint8_t*)malloc(n);
+    e->clear = (uint8_t*)malloc(n);
+    e->half = (uint8_t*)malloc(n / 4u + 4u);
+    e->chart = (float*)malloc(sizeof(float) * 2u * (size_t)w);
+    if (!e->opaque || !e->mixed || !e->clear || !e->half || !e->chart) return false;
+    if (fossil_cube_font_create(&e->font, NULL, NULL) != FOSSIL_CUBE_OK) return false;
+    if (fossil_cube_ctx_create(&e->ctx, w, h, NULL, NULL) != FOSSIL_CUBE_OK) return false;
+    bench_fill_sources(e);
+    return true;
+}
+
+static void bench_env_free(bench_env* e) {
+    fossil_cube_ctx_destroy(e->ctx);
+    fossil_cube_font_destroy(e->font);
+    free(e->opaque);
+    free(e->mixed);
+    free(e->clear);
+    free(e->half);
+    free(e->chart);
+}
+
+int main(int argc, char** argv) {
+    bool quick = false, all_simd = true;
+    const char* filter = NULL;
+    const char* only = NULL;
+    int threads = 4;
+    uint64_t fixed = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--quick") == 0) quick = true;
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (strcmp(argv[i], "--case") == 0 && i + 1 < argc) only = argv[++i];
+        else if (strcmp(argv[i], "--simd") == 0 && i + 1 < argc) all_simd = strcmp(argv[++i], "best") != 0;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--iters") == 0 && i + 1 < argc) fixed = strtoull(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "usage: %s [--quick] [--filter substr] [--case name] [--simd best|all] [--threads n] "
+                    "[--iters n]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (threads < 1) threads = 1;
+
+    static const int sizes[][2] = { { 320, 240 }, { 1280, 720 }, { 1920, 1080 } };
+    const int first_size = quick ? 1 : 0, last_size = quick ? 1 : 2;
+    const double target_s = quick ? 0.05 : 0.5;
+
+    /* the level picked at init, then every other supported one */
+    const fossil_cube_simd best = fossil_cube_simd_level();
+    fossil_cube_simd levels[4];
+    int nlevels = 0;
+    levels[nlevels++] = best;
+    if (all_simd) {
+        for (int s = FOSSIL_CUBE_SIMD_SCALAR; s <= FOSSIL_CUBE_SIMD_NEON; ++s) {
+            if ((fossil_cube_simd)s == best) continue;
+            if (fossil_cube_set_simd_level((fossil_cube_simd)s) == FOSSIL_CUBE_OK) levels[nlevels++] = (fossil_cube_simd)s;
+        }
+        (void)fossil_cube_set_simd_level(best);
+    }
+
+    for (int si = first_size; si <= last_size; ++si) {
+        bench_env env;
+        if (!bench_env_init(&env, sizes[si][0], sizes[si][1])) {
+            fprintf(stderr, "cube-bench: out of memory at %dx%d\n", sizes[si][0], sizes[si][1]);
+            bench_env_free(&env);
+            return 1;
+        }
+        for (int l = 0; l < nlevels; ++l) {
+            (void)fossil_cube_set_simd_level(levels[l]);
+            for (size_t c = 0; c < sizeof(bench_cases) / sizeof(bench_cases[0]); ++c) {
+                const bench_case* bc = &bench_cases[c];
+                if (filter && !strstr(bc->name, filter)) continue;
+                if (only && strcmp(bc->name, only) != 0) continue;
+                if (!bc->deferred) {
+                    fossil_cube_set_mode_ex(env.ctx, FOSSIL_CUBE_MODE_IMMEDIATE);
+                    bench_run(&env, bc, bench_simd_name(levels[l]), 1, target_s, fixed);
+                    continue;
+                }
+                /* serial, then tiled when the build has threads */
+                fossil_cube_set_mode_ex(env.ctx, FOSSIL_CUBE_MODE_DEFERRED);
+                const int counts[2] = { 1, threads };
+                for (int k = 0; k < (threads > 1 ? 2 : 1); ++k) {
+                    if (fossil_cube_set_threads_ex(env.ctx, counts[k]) != FOSSIL_CUBE_OK) break;
+                    bench_run(&env, bc, bench_simd_name(levels[l]), counts[k], target_s, fixed);
+                }
+                (void)fossil_cube_set_threads_ex(env.ctx, 1);
+                fossil_cube_set_mode_ex(env.ctx, FOSSIL_CUBE_MODE_IMMEDIATE);
+            }
+        }
+        (void)fossil_cube_set_simd_level(best);
+        bench_env_free(&env);
+    }
+    return 0;
+}
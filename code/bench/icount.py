@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# Project: Fossil Logic
+#
+# This file is part of the Fossil Logic project, which aims to develop high-
+# performance, cross-platform applications and libraries. The code contained
+# herein is subject to the terms and conditions defined in the project license.
+#
+# Author: Michael Gene Brockus (Dreamer)
+#
+# Copyright (C) 2024 Fossil Logic. All rights reserved.
+# -----------------------------------------------------------------------------
+"""Instruction-count regression check for cube-bench.
+
+Runs every bench case of two cube-bench builds (the base and the change)
+under cachegrind with a fixed iteration count and compares the executed
+instruction counts. Unlike wall-clock numbers these are the same from run
+to run on a given binary, so a small threshold is meaningful on shared CI
+machines.
+
+Cachegrind counts the whole process: source generation, context setup and
+the warm-up run cost far more than a few iterations of a cheap case. Each
+case is therefore run twice, with --iters iters+1 and --iters 1, and only
+the difference (iters runs of the case itself) is compared. Cases are
+picked by exact name (--case), so one whose name contains another's does
+not add to it.
+
+    icount.py --base base/cube-bench --head head/cube-bench [--threshold 2.0]
+
+Exits 1 when a case present in both builds runs more than threshold
+percent more instructions in head. Requires valgrind.
+"""
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+BENCH_ARGS = ["--quick", "--simd", "best", "--threads", "1"]
+
+
+def cases(bench):
+    """Case names, or None when the build is missing or has no --iters (older bases)"""
+    if not os.path.exists(bench):
+        return None
+    res = subprocess.run([bench] + BENCH_ARGS + ["--iters", "1"], capture_output=True, text=True)
+    if res.returncode != 0:
+        return None
+    return [json.loads(line)["case"] for line in res.stdout.splitlines() if line.strip()]
+
+
+def selector(bench, case):
+    """--case when the build has it; older bases only match substrings"""
+    res = subprocess.run([bench] + BENCH_ARGS + ["--case", case, "--iters", "1"], capture_output=True, text=True)
+    return "--case" if res.returncode == 0 else "--filter"
+
+
+def refs(bench, select, case, iters):
+    cmd = ["valgrind", "--tool=cachegrind", "--cache-sim=no", "--cachegrind-out-file=/dev/null",
+           bench] + BENCH_ARGS + [select, case, "--iters", str(iters)]
+    res = subprocess.run(cmd, check=True, capture_output=True, text=True)
+    m = re.search(r"I\s+refs:\s+([\d,]+)", res.stderr)
+    if not m:
+        sys.exit("icount: no instruction count from cachegrind for %s:\n%s" % (case, res.stderr))
+    return int(m.group(1).replace(",", ""))
+
+
+def icount(bench, select, case, iters):
+    """Instructions of iters runs of case, without the process around them"""
+    return refs(bench, select, case, iters + 1) - refs(bench, select, case, 1)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--base", required=True, help="cube-bench built from the base revision")
+    ap.add_argument("--head", required=True, help="cube-bench built from the change")
+    ap.add_argument("--threshold", type=float, default=2.0, help="allowed increase, percent")
+    ap.add_argument("--iters", type=int, default=3, help="runs of each case that are compared")
+    args = ap.parse_args()
+
+    head_cases = cases(args.head)
+    if head_cases is None:
+        sys.exit("icount: %s does not run with --iters" % args.head)
+    base_cases = set(cases(args.base) or [])
+    base_select = selector(args.base, head_cases[0]) if base_cases and head_cases else "--case"
+    rows, failed = [], []
+    for case in head_cases:
+        head = icount(args.head, "--case", case, args.iters)
+        if case not in base_cases:
+            rows.append((case, None, head, None))
+            continue
+        base = icount(args.base, base_select, case, args.iters)
+        delta = (head - base) * 100.0 / base if base else 0.0
+        rows.append((case, base, head, delta))
+        if delta > args.threshold:
+            failed.append(case)
+
+    lines = ["| case | base Ir | head Ir | change |", "|---|---:|---:|---:|"]
+    for case, base, head, delta in rows:
+        if base is None:
+            lines.append("| %s | - | %d | new |" % (case, head))
+        else:
+            mark = " **regressed**" if case in failed else ""
+            lines.append("| %s | %d | %d | %+.2f%%%s |" % (case, base, head, delta, mark))
+    report = "\n".join(lines)
+    print(report)
+    summary = os.environ.get("GITHUB_STEP_SUMMARY")
+    if summary:
+        with open(summary, "a") as f:
+            f.write("### cube-bench instruction counts\n\n" + report + "\n")
+
+    if failed:
+        print("icount: %d case(s) above +%.1f%%: %s" % (len(failed), args.threshold, ", ".join(failed)))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,562 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* ftruncate, clock_gettime under -std=c17 */
+#endif
+
+#include "fossil/cube/capture.h"
+
+#if defined(FOSSIL_CUBE_NO_CAPTURE)
+
+fossil_cube_result fossil_cube_capture_create(fossil_cube_capture** out_cap, const char* path,
+                                              fossil_cube_capture_mode mode, int key_interval) {
+    (void)path; (void)mode; (void)key_interval;
+    if (out_cap) *out_cap = NULL;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+fossil_cube_result fossil_cube_capture_write(fossil_cube_capture* cap, const uint8_t* pixels,
+                                             int width, int height, int pitch,
+                                             fossil_cube_format format,
+                                             const fossil_cube_rect* rects, int rect_count) {
+    (void)cap; (void)pixels; (void)width; (void)height; (void)pitch; (void)format;
+    (void)rects; (void)rect_count;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+fossil_cube_result fossil_cube_capture_open(fossil_cube_capture** out_cap, const char* path) {
+    (void)path;
+    if (out_cap) *out_cap = NULL;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+int fossil_cube_capture_count(const fossil_cube_capture* cap) {
+    (void)cap;
+    return 0;
+}
+
+fossil_cube_result fossil_cube_capture_get(const fossil_cube_capture* cap, int index,
+                                           fossil_cube_capture_frame* out_frame) {
+    (void)cap; (void)index; (void)out_frame;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+fossil_cube_result fossil_cube_capture_read(const fossil_cube_capture* cap, int index,
+                                            uint8_t* pixels, int pitch) {
+    (void)cap; (void)index; (void)pixels; (void)pitch;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+void fossil_cube_capture_close(fossil_cube_capture* cap) { (void)cap; }
+
+#else
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
+/* =========================
+   File layout
+   =========================
+   A 64-byte header, then records back to back, each 8-byte aligned: a
+   fixed record header followed by its pixels. The header's length covers
+   complete records only and is stored after each record is written. The
+   writer maps well past the length and grows the mapping in steps; close
+   trims the file.
+*/
+
+#define FC_CAP_MAGIC   0x50414346u /* "FCAP" */
+#define FC_CAP_RECORD  0x44524346u /* "FCRD" */
+#define FC_CAP_VERSION 1u
+#define FC_CAP_KEY     1u
+#define FC_CAP_GROW    ((uint64_t)16u << 20) /* first mapping and minimum growth */
+
+typedef struct fc_cap_rect {
+    int32_t x, y, w, h;
+} fc_cap_rect;
+
+typedef struct fc_cap_header {
+    uint32_t magic, version;
+    uint64_t length;      /* bytes of complete records, this header included */
+    uint64_t frame_count;
+    uint8_t pad[40];
+} fc_cap_header;
+
+typedef struct fc_cap_record {
+    uint32_t magic;
+    uint32_t flags;       /* FC_CAP_KEY */
+    int32_t width, height, format, rect_count;
+    uint64_t time_ns;
+    uint64_t size;        /* whole record, padding included */
+    uint64_t data_size;   /* pixel bytes after the record header */
+    fc_cap_rect rects[FOSSIL_CUBE_MAX_DAMAGE];
+} fc_cap_record;
+
+struct fossil_cube_capture {
+    uint8_t* base;
+    size_t size; /* mapped bytes */
+    bool writer;
+#if defined(_WIN32)
+    HANDLE file, map;
+#else
+    int fd;
+#endif
+    /* writer */
+    fossil_cube_capture_mode mode;
+    int key_interval, since_key;
+    int w, h, format; /* of the last record; w == 0 before the first */
+    uint64_t t0;
+    uint64_t length;  /* bytes of complete records, kept even if the mapping is lost */
+    /* reader */
+    const fc_cap_record** frames;
+    int count;
+};
+
+static inline uint64_t fc_cap_round(uint64_t v, uint64_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+static inline fc_cap_header* fc_cap_hdr(const fossil_cube_capture* s) {
+    return (fc_cap_header*)s->base;
+}
+
+/* =========================
+   Platform
+   ========================= */
+
+#if defined(_WIN32)
+
+static uint64_t fc_cap_now_ns(void) {
+    LARGE_INTEGER f, t;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&t);
+    return (uint64_t)((double)t.QuadPart * 1e9 / (double)f.QuadPart);
+}
+
+static bool fc_cap_map(fossil_cube_capture* s, size_t size) {
+    const unsigned long long sz = size;
+    const bool w = s->writer;
+    s->map = CreateFileMappingA(s->file, NULL, w ? PAGE_READWRITE : PAGE_READONLY,
+                                (DWORD)(sz >> 32), (DWORD)sz, NULL);
+    if (!s->map) return false;
+    s->base = (uint8_t*)MapViewOfFile(s->map, w ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+    if (!s->base) {
+        CloseHandle(s->map);
+        s->map = NULL;
+        return false;
+    }
+    s->size = size;
+    return true;
+}
+
+static void fc_cap_unmap(fossil_cube_capture* s) {
+    if (s->base) UnmapViewOfFile(s->base);
+    if (s->map) CloseHandle(s->map);
+    s->base = NULL;
+    s->map = NULL;
+}
+
+static bool fc_cap_file_open(fossil_cube_capture* s, const char* path, uint64_t* out_size) {
+    s->file = s->writer
+        ? CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                      FILE_ATTRIBUTE_NORMAL, NULL)
+        : CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL, NULL);
+    if (s->file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(s->file, &sz)) {
+        CloseHandle(s->file);
+        s->file = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    *out_size = (uint64_t)sz.QuadPart;
+    return true;
+}
+
+/* Close the file, cut to 'length' when writing */
+static void fc_cap_file_close(fossil_cube_capture* s, uint64_t length) {
+    if (s->file == INVALID_HANDLE_VALUE) return;
+    if (s->writer) {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)length;
+        if (SetFilePointerEx(s->file, end, NULL, FILE_BEGIN)) SetEndOfFile(s->file);
+    }
+    CloseHandle(s->file);
+}
+
+/* The mapping itself extends the file */
+static bool fc_cap_grow(fossil_cube_capture* s, size_t size) {
+    fc_cap_unmap(s);
+    return fc_cap_map(s, size);
+}
+
+#else
+
+static uint64_t fc_cap_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static bool fc_cap_map(fossil_cube_capture* s, size_t size) {
+    const int prot = s->writer ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* p = mmap(NULL, size, prot, MAP_SHARED, s->fd, 0);
+    if (p == MAP_FAILED) return false;
+    s->base = (uint8_t*)p;
+    s->size = size;
+    return true;
+}
+
+static void fc_cap_unmap(fossil_cube_capture* s) {
+    if (s->base) munmap(s->base, s->size);
+    s->base = NULL;
+}
+
+static bool fc_cap_file_open(fossil_cube_capture* s, const char* path, uint64_t* out_size) {
+    s->fd = s->writer ? open(path, O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path, O_RDONLY);
+    if (s->fd < 0) return false;
+    struct stat st;
+    if (fstat(s->fd, &st) != 0) {
+        close(s->fd);
+        s->fd = -1;
+        return false;
+    }
+    *out_size = (uint64_t)st.st_size;
+    return true;
+}
+
+static void fc_cap_file_close(fossil_cube_capture* s, uint64_t length) {
+    if (s->fd < 0) return;
+    /* should the trim fail, the header's length still marks the end */
+    if (s->writer && ftruncate(s->fd, (off_t)length) != 0) s->writer = false;
+    close(s->fd);
+}
+
+static bool fc_cap_grow(fossil_cube_capture* s, size_t size) {
+    fc_cap_unmap(s);
+    if (ftruncate(s->fd, (off_t)size) != 0) return false;
+    return fc_cap_map(s, size);
+}
+
+#endif
+
+static void fc_cap_free(fossil_cube_capture* s, uint64_t length) {
+    fc_cap_unmap(s);
+    fc_cap_file_close(s, length);
+    free(s->frames);
+    free(s);
+}
+
+static fossil_cube_capture* fc_cap_alloc(bool writer) {
+    fossil_cube_capture* s = (fossil_cube_capture*)calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    s->writer = writer;
+#if defined(_WIN32)
+    s->file = INVALID_HANDLE_VALUE;
+#else
+    s->fd = -1;
+#endif
+    return s;
+}
+
+/* =========================
+   Writer
+   ========================= */
+
+fossil_cube_result fossil_cube_capture_create(fossil_cube_capture** out_cap, const char* path,
+                                              fossil_cube_capture_mode mode, int key_interval) {
+    if (!out_cap) return FOSSIL_CUBE_ERR_BADARGS;
+    *out_cap = NULL;
+    if (!path || (mode != FOSSIL_CUBE_CAPTURE_FULL && mode != FOSSIL_CUBE_CAPTURE_DAMAGE)) {
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    fossil_cube_capture* s = fc_cap_alloc(true);
+    if (!s) return FOSSIL_CUBE_ERR_OOM;
+    uint64_t existing = 0;
+    if (!fc_cap_file_open(s, path, &existing)) {
+        free(s);
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    if (!fc_cap_grow(s, (size_t)FC_CAP_GROW)) {
+        fc_cap_free(s, 0);
+        return FOSSIL_CUBE_ERR_OOM;
+    }
+    s->mode = mode;
+    s->key_interval = key_interval > 0 ? key_interval : 60;
+    s->t0 = fc_cap_now_ns();
+    fc_cap_header* h = fc_cap_hdr(s);
+    memset(h, 0, sizeof(*h));
+    h->version = FC_CAP_VERSION;
+    h->length = s->length = sizeof(fc_cap_header);
+    h->magic = FC_CAP_MAGIC;
+    *out_cap = s;
+    return FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_capture_write(fossil_cube_capture* s, const uint8_t* pixels,
+                                             int width, int height, int pitch,
+                                             fossil_cube_format format,
+                                             const fossil_cube_rect* rects, int rect_count) {
+    if (!s || !s->writer || !s->base || !pixels || width <= 0 || height <= 0 || rect_count < 0) {
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    const int bpp = fossil_cube_format_bpp(format);
+    const uint64_t row = (uint64_t)width * (uint64_t)bpp;
+    if (bpp == 0 || row > INT_MAX || (pitch != 0 && (uint64_t)pitch < row)) return FOSSIL_CUBE_ERR_BADARGS;
+    if (pitch == 0) pitch = (int)row;
+
+    fc_cap_record rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = FC_CAP_RECORD;
+    rec.width = width;
+    rec.height = height;
+    rec.format = (int32_t)format;
+    rec.time_ns = fc_cap_now_ns() - s->t0;
+    bool whole = !rects;
+    if (rects) {
+        for (int i = 0; i < rect_count; ++i) {
+            const long long x0 = rects[i].x > 0 ? rects[i].x : 0;
+            const long long y0 = rects[i].y > 0 ? rects[i].y : 0;
+            const long long x1 = (long long)rects[i].x + rects[i].w;
+            const long long y1 = (long long)rects[i].y + rects[i].h;
+            const long long cx1 = x1 < width ? x1 : width, cy1 = y1 < height ? y1 : height;
+            if (cx1 <= x0 || cy1 <= y0) continue;
+            if (rec.rect_count == FOSSIL_CUBE_MAX_DAMAGE) {
+                whole = true; /* more than a record holds: store the frame whole */
+                break;
+            }
+            fc_cap_rect* r = &rec.rects[rec.rect_count++];
+            r->x = (int32_t)x0;
+            r->y = (int32_t)y0;
+            r->w = (int32_t)(cx1 - x0);
+            r->h = (int32_t)(cy1 - y0);
+        }
+    }
+    if (whole) {
+        memset(rec.rects, 0, sizeof(rec.rects));
+        rec.rects[0].w = width;
+        rec.rects[0].h = height;
+        rec.rect_count = 1;
+    }
+    const bool key = s->mode == FOSSIL_CUBE_CAPTURE_FULL || whole || s->w != width || s->h != height ||
+                     s->format != (int)format || s->since_key + 1 >= s->key_interval;
+    if (key) {
+        rec.flags = FC_CAP_KEY;
+        rec.data_size = row * (uint64_t)height;
+    } else {
+        for (int i = 0; i < rec.rect_count; ++i) {
+            rec.data_size += (uint64_t)rec.rects[i].w * (uint64_t)bpp * (uint64_t)rec.rects[i].h;
+        }
+    }
+    rec.size = fc_cap_round(sizeof(rec) + rec.data_size, 8);
+
+    const uint64_t at = s->length;
+    const uint64_t need = at + rec.size;
+    if (need > (uint64_t)SIZE_MAX) return FOSSIL_CUBE_ERR_OOM;
+    if (need > s->size) {
+        uint64_t grow = (uint64_t)s->size * 2u;
+        if (grow < need + FC_CAP_GROW) grow = fc_cap_round(need + FC_CAP_GROW, FC_CAP_GROW);
+        if (grow > (uint64_t)SIZE_MAX) grow = need;
+        if (!fc_cap_grow(s, (size_t)grow)) {
+            /* keep what was captured so far readable */
+            if (!s->base) (void)fc_cap_map(s, (size_t)at);
+            return FOSSIL_CUBE_ERR_OOM;
+        }
+    }
+
+    uint8_t* out = s->base + at + sizeof(rec);
+    if (key) {
+        for (int y = 0; y < height; ++y) {
+            memcpy(out + (size_t)y * (size_t)row, pixels + (size_t)y * (size_t)pitch, (size_t)row);
+        }
+    } else {
+        for (int i = 0; i < rec.rect_count; ++i) {
+            const fc_cap_rect* r = &rec.rects[i];
+            const size_t len = (size_t)r->w * (size_t)bpp;
+            const uint8_t* src = pixels + (size_t)r->y * (size_t)pitch + (size_t)r->x * (size_t)bpp;
+            for (int y = 0; y < r->h; ++y, out += len) memcpy(out, src + (size_t)y * (size_t)pitch, len);
+        }
+    }
+    memcpy(s->base + at, &rec, sizeof(rec));
+    fc_cap_header* h = fc_cap_hdr(s);
+    h->frame_count++;
+    h->length = need; /* last: the record is complete */
+    s->length = need;
+
+    s->since_key = key ? 0 : s->since_key + 1;
+    s->w = width;
+    s->h = height;
+    s->format = (int)format;
+    return FOSSIL_CUBE_OK;
+}
+
+/* =========================
+   Reader
+   ========================= */
+
+static bool fc_cap_record_valid(const fc_cap_record* r, uint64_t room) {
+    if (room < sizeof(*r) || r->magic != FC_CAP_RECORD || r->size > room ||
+        r->size < sizeof(*r) || r->data_size > r->size - sizeof(*r)) {
+        return false;
+    }
+    const int bpp = fossil_cube_format_bpp((fossil_cube_format)r->format);
+    if (bpp == 0 || r->width <= 0 || r->height <= 0 ||
+        r->rect_count < 0 || r->rect_count > FOSSIL_CUBE_MAX_DAMAGE) {
+        return false;
+    }
+    uint64_t data = 0;
+    for (int i = 0; i < r->rect_count; ++i) {
+        const fc_cap_rect* q = &r->rects[i];
+        if (q->x < 0 || q->y < 0 || q->w <= 0 || q->h <= 0 ||
+            q->w > r->width - q->x || q->h > r->height - q->y) {
+            return false;
+        }
+        data += (uint64_t)q->w * (uint64_t)bpp * (uint64_t)q->h;
+    }
+    if (r->flags & FC_CAP_KEY) data = (uint64_t)r->width * (uint64_t)bpp * (uint64_t)r->height;
+    return data == r->data_size;
+}
+
+fossil_cube_result fossil_cube_capture_open(fossil_cube_capture** out_cap, const char* path) {
+    if (!out_cap || !path) return FOSSIL_CUBE_ERR_BADARGS;
+    *out_cap = NULL;
+    fossil_cube_capture* s = fc_cap_alloc(false);
+    if (!s) return FOSSIL_CUBE_ERR_OOM;
+    uint64_t size = 0;
+    if (!fc_cap_file_open(s, path, &size)) {
+        free(s);
+        return FOSSIL_CUBE_ERR_NOTINIT;
+    }
+    if (size < sizeof(fc_cap_header) || size > (uint64_t)SIZE_MAX || !fc_cap_map(s, (size_t)size)) {
+        fc_cap_free(s, 0);
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    const fc_cap_header* h = fc_cap_hdr(s);
+    if (h->magic != FC_CAP_MAGIC || h->version != FC_CAP_VERSION || h->length < sizeof(*h)) {
+        fc_cap_free(s, 0);
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+
+    /* index the records; a cut file ends at its last whole one */
+    const uint64_t end = h->length < size ? h->length : size;
+    int cap = 0;
+    uint64_t off = sizeof(*h);
+    while (off < end && s->count < INT_MAX) {
+        const fc_cap_record* r = (const fc_cap_record*)(s->base + off);
+        if (!fc_cap_record_valid(r, end - off)) break;
+        if (s->count == cap) {
+            const int ncap = cap ? (cap < INT_MAX / 2 ? cap * 2 : INT_MAX) : 256;
+            const fc_cap_record** n = (const fc_cap_record**)realloc(
+                (void*)s->frames, (size_t)ncap * sizeof(*n));
+            if (!n) {
+                fc_cap_free(s, 0);
+                return FOSSIL_CUBE_ERR_OOM;
+            }
+            s->frames = n;
+            cap = ncap;
+        }
+        s->frames[s->count++] = r;
+        off += r->size;
+    }
+    *out_cap = s;
+    return FOSSIL_CUBE_OK;
+}
+
+int fossil_cube_capture_count(const fossil_cube_capture* s) {
+    return (s && !s->writer) ? s->count : 0;
+}
+
+fossil_cube_result fossil_cube_capture_get(const fossil_cube_capture* s, int index,
+                                           fossil_cube_capture_frame* out_frame) {
+    if (!s || s->writer || !out_frame || index < 0 || index >= s->count) return FOSSIL_CUBE_ERR_BADARGS;
+    const fc_cap_record* r = s->frames[index];
+    out_frame->width = r->width;
+    out_frame->height = r->height;
+    out_frame->format = (fossil_cube_format)r->format;
+    out_frame->time_ns = r->time_ns;
+    out_frame->key = (r->flags & FC_CAP_KEY) != 0;
+    out_frame->rect_count = r->rect_count;
+    for (int i = 0; i < r->rect_count; ++i) {
+        out_frame->rects[i].x = r->rects[i].x;
+        out_frame->rects[i].y = r->rects[i].y;
+        out_frame->rects[i].w = r->rects[i].w;
+        out_frame->rects[i].h = r->rects[i].h;
+    }
+    out_frame->data = (const uint8_t*)(r + 1);
+    out_frame->size = (size_t)r->data_size;
+    return FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_capture_read(const fossil_cube_capture* s, int index,
+                                            uint8_t* pixels, int pitch) {
+    if (!s || s->writer || !pixels || index < 0 || index >= s->count) return FOSSIL_CUBE_ERR_BADARGS;
+    const fc_cap_record* last = s->frames[index];
+    const size_t bpp = (size_t)fossil_cube_format_bpp((fossil_cube_format)last->format);
+    const size_t row = (size_t)last->width * bpp;
+    if ((pitch != 0 && (size_t)pitch < row) || row > INT_MAX) return FOSSIL_CUBE_ERR_BADARGS;
+    if (pitch == 0) pitch = (int)row;
+
+    int k = index;
+    while (!(s->frames[k]->flags & FC_CAP_KEY)) {
+        if (k == 0) return FOSSIL_CUBE_ERR_BADARGS; /* file starts mid-stream */
+        --k;
+    }
+    for (int i = k; i <= index; ++i) {
+        const fc_cap_record* r = s->frames[i];
+        if (r->width != last->width || r->height != last->height || r->format != last->format) {
+            return FOSSIL_CUBE_ERR_BADARGS;
+        }
+        const uint8_t* data = (const uint8_t*)(r + 1);
+        if (r->flags & FC_CAP_KEY) {
+            for (int y = 0; y < r->height; ++y) {
+                memcpy(pixels + (size_t)y * (size_t)pitch, data + (size_t)y * row, row);
+            }
+            continue;
+        }
+        for (int j = 0; j < r->rect_count; ++j) {
+            const fc_cap_rect* q = &r->rects[j];
+            const size_t len = (size_t)q->w * bpp;
+            uint8_t* dst = pixels + (size_t)q->y * (size_t)pitch + (size_t)q->x * bpp;
+            for (int y = 0; y < q->h; ++y, data += len) memcpy(dst + (size_t)y * (size_t)pitch, data, len);
+        }
+    }
+    return FOSSIL_CUBE_OK;
+}
+
+/* =========================
+   Both sides
+   ========================= */
+
+void fossil_cube_capture_close(fossil_cube_capture* s) {
+    if (!s) return;
+    fc_cap_free(s, s->writer ? s->length : 0);
+}
+
+#endif /* FOSSIL_CUBE_NO_CAPTURE */
@@ -11,10 +11,33 @@
  * Copyright (C) 2024 Fossil Logic. All rights reserved.
  * -----------------------------------------------------------------------------
  */
+#if (defined(FOSSIL_CUBE_STATS) || !defined(FOSSIL_CUBE_NO_THREADS)) && !defined(_WIN32) && \
+    !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* clock_gettime under -std=c17 */
+#endif
 #include "fossil/cube/cube.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
+#include <math.h>
+
+#if defined(_WIN32) && (!defined(FOSSIL_CUBE_NO_THREADS) || defined(FOSSIL_CUBE_STATS))
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+#if !defined(FOSSIL_CUBE_NO_THREADS) && !defined(_WIN32)
+#include <pthread.h>
+#include <errno.h>
+#endif
+#if (defined(FOSSIL_CUBE_STATS) || !defined(FOSSIL_CUBE_NO_THREADS)) && !defined(_WIN32)
+#include <time.h>
+#endif
 
 /* =========================
    Internal state
@@ -25,7 +48,175 @@ typedef struct fc_clip {
     bool enabled;
 } fc_clip;
 
-typedef struct fc_ctx {
+/* Half-open integer rect [x0,x1) x [y0,y1) */
+typedef struct fc_irect {
+    int x0, y0, x1, y1;
+} fc_irect;
+
+/* Deferred draw command. Clip is stored unclamped ({0,0,INT_MAX,INT_MAX}
+   when clipping is off) and intersected with the framebuffer when run,
+   so a recorded buffer survives resizes. */
+typedef enum fc_cmd_kind {
+    FC_CMD_NOP = 0,
+    FC_CMD_CLEAR,
+    FC_CMD_PIXEL,
+    FC_CMD_FILL,
+    FC_CMD_LINE,
+    FC_CMD_BLIT,
+    FC_CMD_IMAGE,
+    FC_CMD_MASK,
+    FC_CMD_SCALED,
+    FC_CMD_PATH,
+    FC_CMD_COMPOSITE,
+    FC_CMD_PAINT
+} fc_cmd_kind;
+
+typedef struct fc_cmd {
+    uint8_t kind;
+    uint8_t rgba[4];     /* premultiplied */
+    uint8_t alpha;       /* blit/scaled: fossil_cube_alpha of src */
+    uint8_t filter;      /* scaled: fossil_cube_filter */
+    uint8_t blend;       /* composite: fossil_cube_blend */
+    int a0, a1, a2, a3;  /* fill/blit/image/mask/scaled/path/composite/paint: x, y, w, h; line: x0, y0, x1, y1 */
+    int src_pitch;       /* blit/mask/scaled/composite */
+    int s0, s1;          /* image: src x, y; scaled: src w, h; composite: src fossil_cube_format;
+                            mask: s0 masks in a run (0: the one at src) */
+    union {
+        const uint8_t* src;
+        const struct fc_mask_item* masks;
+        const struct fossil_cube_image* image;
+        const struct fc_path* path;
+        const struct fossil_cube_paint* paint;
+    };
+    fc_irect clip;
+    const struct fossil_cube_region* region; /* NULL: no clip region */
+} fc_cmd;
+
+/* One coverage mask of a mask run; a run's command box is their union */
+typedef struct fc_mask_item {
+    int x, y, w, h, pitch;
+    const uint8_t* cov;
+} fc_mask_item;
+
+/* Row of an image as its non-transparent runs [x0,x1), sorted; the gaps
+   between runs are fully transparent */
+typedef struct fc_run {
+    int x0, x1;
+    bool opaque;
+} fc_run;
+
+typedef struct fc_image_row {
+    fc_run* runs;
+    int count, cap;
+    bool blend_all; /* classification ran out of memory: blend the whole row */
+} fc_image_row;
+
+struct fossil_cube_image {
+    int w, h, pitch;
+    uint8_t* pixels;      /* premultiplied RGBA8, transparent pixels zeroed */
+    fc_image_row* rows;
+    int opaque_rows;      /* rows that are one opaque run: == h, fully opaque */
+};
+
+/* Gradient t is fixed point with FC_RAMP_ONE at the ramp's end; the top
+   8 bits of its fraction pick the ramp entry */
+enum { FC_RAMP_SIZE = 256 };
+#define FC_RAMP_ONE (1 << 24)
+
+typedef enum fc_paint_kind {
+    FC_PAINT_LINEAR,
+    FC_PAINT_RADIAL,
+    FC_PAINT_PATTERN
+} fc_paint_kind;
+
+struct fossil_cube_paint {
+    uint8_t kind;               /* fc_paint_kind */
+    uint8_t extend;             /* fossil_cube_extend */
+    bool opaque;                /* gradients: every ramp entry is opaque */
+    int64_t t0, dtx, dty;       /* linear: t at pixel (x, y) is t0 + x*dtx + y*dty */
+    float cx, cy, scale;        /* radial: t is the distance to (cx, cy) times scale */
+    const fossil_cube_image* image; /* pattern */
+    int ox, oy;
+    uint32_t ramp[FC_RAMP_SIZE];    /* premultiplied RGBA8 */
+};
+
+/* Clip region: y-bands, each a run of disjoint x-spans */
+typedef struct fc_xspan {
+    int x0, x1;
+} fc_xspan;
+
+typedef struct fc_band {
+    int y0, y1;
+    int first, count; /* spans[first, first + count) */
+} fc_band;
+
+struct fossil_cube_region {
+    fc_irect bounds;    /* all zero when empty */
+    int band_count, span_count;
+    fc_band* bands;     /* top to bottom; touching bands differ */
+    fc_xspan* spans;    /* per band left to right, never touching */
+};
+
+/* Line edge of a flattened shape, stored top to bottom */
+typedef struct fc_edge {
+    float x0, y0, x1, y1; /* y0 < y1 */
+    float dir;            /* +1 if the contour runs downwards here, -1 if up */
+    float xmin, xmax;
+} fc_edge;
+
+/* Flattened shape ready to rasterize, one allocation. Edges are binned
+   by rows so a band of rows only walks the edges that cross it. */
+typedef struct fc_path {
+    fc_irect box;        /* pixels the shape can touch */
+    int bin_h;           /* rows per bin, a multiple of FC_AA_ROWS */
+    int bin0, bins;      /* first bin (row / bin_h) and bin count */
+    const fc_edge* edges;
+    const uint32_t* bin_off; /* bins + 1 offsets into refs */
+    const uint32_t* refs;    /* edge indices per bin, in edge order */
+    const struct fossil_cube_paint* paint; /* NULL: the command's color */
+} fc_path;
+
+/* Edges of the shape being built by a draw call, reused across calls */
+typedef struct fc_path_builder {
+    fc_edge* edges;
+    size_t count, cap;
+    float fx, fy, lx, ly; /* first and last point of the open contour */
+    bool bad;             /* OOM or a non-finite coordinate: drop the shape */
+} fc_path_builder;
+
+/* Bump allocator for data that lives as long as a command buffer's
+   contents (a frame). Blocks chain in allocation order; cur is the one
+   being carved, the blocks after it are empty. */
+typedef struct fc_arena_block {
+    struct fc_arena_block* next;
+    size_t size, used; /* usable bytes after the header, bytes carved */
+} fc_arena_block;
+
+typedef struct fc_arena {
+    fc_arena_block* head;
+    fc_arena_block* cur;  /* NULL only while head is NULL */
+    size_t used;          /* bytes handed out since the last reset */
+    size_t peak;          /* most ever used between two resets */
+    size_t reserved;      /* bytes held in blocks */
+    size_t limit;         /* kept across resets; 0: FOSSIL_CUBE_DEFAULT_ARENA_LIMIT */
+    uint64_t block_allocs;
+} fc_arena;
+
+typedef struct fc_arena_mark {
+    fc_arena_block* block;
+    size_t block_used, used;
+} fc_arena_mark;
+
+struct fossil_cube_cmdbuf {
+    fc_cmd* cmds;
+    size_t count;
+    size_t cap;
+    fc_arena arena;      /* path records owned by the commands */
+};
+
+typedef struct fossil_cube_cmdbuf fc_cmdbuf;
+
+struct fossil_cube_ctx {
     int w, h;
     int pitch; /* bytes per row */
     uint8_t* pixels; /* RGBA8 */
@@ -34,242 +225,5523 @@ typedef struct fc_ctx {
     void* userdata;
 
     fc_clip clip;
+    const fossil_cube_region* region; /* clip region, NULL: none */
     bool initialized;
-} fc_ctx;
 
+    fossil_cube_mode mode;
+    bool in_frame;
+    fc_cmdbuf frame;     /* deferred commands of the current frame */
+    fc_cmdbuf* record;   /* user buffer being recorded, if any */
+    fossil_cube_result error; /* first command dropped since get_error */
+    fc_path_builder path;
+
+    /* tile binning for the parallel executor (grown, never shrunk) */
+    struct fc_pool* pool; /* NULL: single-threaded */
+    uint32_t* bin_start;  /* per tile: first index into bin_items */
+    uint32_t* bin_items;  /* command indices, grouped by tile */
+    size_t bin_start_cap, bin_items_cap;
+
+    int* batch_sort;      /* batch row sort scratch (grown, never shrunk) */
+    size_t batch_sort_cap;
+
+    /* damage since the last present, merged into a small rect list */
+    fc_irect damage[FOSSIL_CUBE_MAX_DAMAGE];
+    int damage_count;
+    fossil_cube_present_rects_fn present_rects;
+
+    struct fc_swap* swap; /* NULL: single buffer, inline present */
+    struct fc_encoder* enc; /* NULL: no encoder stage */
+
+    fossil_cube_alpha alpha; /* how incoming colors and blit sources are read */
+
+    fossil_cube_format format;
+    int bpp;                      /* bytes per pixel of format */
+    const struct fc_format* fmt;
+
+    /* framebuffer memory */
+    fossil_cube_allocator allocator; /* alloc == NULL: aligned malloc */
+    size_t align;
+    bool pad_rows, clear_on_resize;
+    bool external; /* pixels belong to the caller */
+
+#if defined(FOSSIL_CUBE_STATS)
+    fossil_cube_stats stats;
+    fossil_cube_prim_stats* stat_workers; /* per tile worker and primitive, folded after each frame */
+    uint64_t frame_t0;                    /* begin_frame time, 0 outside a frame */
+#endif
+};
+
+typedef struct fossil_cube_ctx fc_ctx;
+
+/* Default context behind the classic (context-free) API */
 static fc_ctx g_fc = {0};
 
 /* =========================
    Helpers
    ========================= */
 
-static inline uint8_t u8_clampi(int v) {
-    if (v < 0) return 0;
-    if (v > 255) return 255;
-    return (uint8_t)v;
+/* Pack RGBA bytes into the in-memory 32-bit pattern (endian-neutral) */
+static inline uint32_t fc_pack(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const uint8_t px[4] = { r, g, b, a };
+    uint32_t v;
+    memcpy(&v, px, sizeof(v));
+    return v;
+}
+
+static inline uint32_t fc_load_px(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void fc_store_px(uint8_t* p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+/* Alpha byte of a pixel word in either byte order (the top byte only on
+   little-endian hosts) */
+static inline uint32_t fc_px_alpha(uint32_t v) {
+    uint8_t px[4];
+    memcpy(px, &v, sizeof(px));
+    return px[3];
+}
+
+/* Exact (x + 127) / 255 for x in [0, 255*255] without a divide: with
+   t = x + 128 it equals (t + (t >> 8)) >> 8. Every blend in this file
+   rounds through this one identity; the SIMD kernels apply it per 16-bit
+   lane (a mulhi by 257 on x86 is the same computation). */
+static inline uint32_t fc_div255(uint32_t x) {
+    const uint32_t t = x + 128u;
+    return (t + (t >> 8)) >> 8;
+}
+
+/* fc_div255 on the two 16-bit lanes of a word holding bytes 0/2 or 1/3
+   of a pixel; lanes stay below 2^16 throughout so they never carry */
+#define FC_LANES 0x00FF00FFu
+
+static inline uint32_t fc_div255x2(uint32_t x) {
+    x += 0x00800080u;
+    return ((x + ((x >> 8) & FC_LANES)) >> 8) & FC_LANES;
+}
+
+static inline uint8_t fc_premul(uint8_t v, uint8_t a) {
+    return (uint8_t)fc_div255((uint32_t)v * a);
+}
+
+/* Premultiplied source over dst, all four bytes at once:
+   out = s + d*inv/255 with inv = 255 - sa. Valid premultiplied input
+   (s <= sa) keeps each sum <= 255, so there is nothing to clamp; other
+   input wraps per byte identically in every kernel. */
+static inline uint32_t fc_over_px(uint32_t d, uint32_t s, uint32_t inv) {
+    const uint32_t rb = fc_div255x2((d & FC_LANES) * inv) + (s & FC_LANES);
+    const uint32_t ga = fc_div255x2(((d >> 8) & FC_LANES) * inv) + ((s >> 8) & FC_LANES);
+    return (rb & FC_LANES) | ((ga & FC_LANES) << 8);
+}
+
+/* (s*a + d*inv) / 255 per byte with a + inv == 255, rounded once */
+static inline uint32_t fc_lerp_px(uint32_t d, uint32_t s, uint32_t a, uint32_t inv) {
+    const uint32_t rb = fc_div255x2((s & FC_LANES) * a + (d & FC_LANES) * inv);
+    const uint32_t ga = fc_div255x2(((s >> 8) & FC_LANES) * a + ((d >> 8) & FC_LANES) * inv);
+    return rb | (ga << 8);
 }
 
 static inline void blend_rgba_over(uint8_t* dst, uint8_t sr, uint8_t sg, uint8_t sb, uint8_t sa) {
-    /* Straight alpha source over straight alpha dst, dst assumed fully opaque or not
-       Formula: out = s + d*(1 - sa)
-       Operate in 0..255 integer space
-    */
-    const int da = dst[3];
-    const int inv_sa = 255 - sa;
+    fc_store_px(dst, fc_over_px(fc_load_px(dst), fc_pack(sr, sg, sb, sa), 255u - sa));
+}
 
-    const int r = (int)sr + ((int)dst[0] * inv_sa + 127) / 255;
-    const int g = (int)sg + ((int)dst[1] * inv_sa + 127) / 255;
-    const int b = (int)sb + ((int)dst[2] * inv_sa + 127) / 255;
-    const int a = sa + ((da * inv_sa + 127) / 255);
+static inline void blend_rgba_straight(uint8_t* dst, const uint8_t* src) {
+    /* Straight source over dst: out = (s*sa + d*(255 - sa)) / 255; the
+       alpha byte of s is forced to 255 so that lane is sa + d*(1 - sa) */
+    const uint32_t sa = src[3];
+    const uint32_t s = fc_load_px(src) | fc_pack(0, 0, 0, 255);
+    fc_store_px(dst, fc_lerp_px(fc_load_px(dst), s, sa, 255u - sa));
+}
 
-    dst[0] = u8_clampi(r);
-    dst[1] = u8_clampi(g);
-    dst[2] = u8_clampi(b);
-    dst[3] = u8_clampi(a);
+/* Premultiplied color s scaled by coverage m, then over d. m == 0 gives
+   d and m == 255 gives plain over exactly, so callers may skip those. */
+static inline uint32_t fc_mask_px(uint32_t d, uint32_t s, uint32_t m) {
+    const uint32_t sm = fc_div255x2((s & FC_LANES) * m) | (fc_div255x2(((s >> 8) & FC_LANES) * m) << 8);
+    return fc_over_px(d, sm, 255u - fc_px_alpha(sm));
 }
 
-static inline bool in_clip(int x, int y) {
-    if (!g_fc.clip.enabled) return true;
-    return (x >= g_fc.clip.x) && (y >= g_fc.clip.y) &&
-           (x < g_fc.clip.x + g_fc.clip.w) &&
-           (y < g_fc.clip.y + g_fc.clip.h);
+/* =========================
+   Span kernels
+   =========================
+   Row primitives used by every drawing path. The scalar set is the
+   reference; the SIMD sets must produce bit-identical output, which they
+   do by rounding through fc_div255 lane-wise. Colors reaching a kernel
+   are premultiplied except for blend_straight sources.
+*/
+
+typedef struct fc_span_ops {
+    /* dst[0..n) = px (opaque solid) */
+    void (*fill)(uint8_t* dst, int n, uint32_t px);
+    /* dst = s + d*(1 - sa) with a constant premultiplied source, 0 < sa < 255 */
+    void (*fill_blend)(uint8_t* dst, int n, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+    /* dst[0..n) = src[0..n) */
+    void (*copy)(uint8_t* dst, const uint8_t* src, int n);
+    /* per-pixel premultiplied source-over: sa==255 copies, sa==0 skips */
+    void (*blend)(uint8_t* dst, const uint8_t* src, int n);
+    /* per-pixel straight-alpha source-over, same fast paths */
+    void (*blend_straight)(uint8_t* dst, const uint8_t* src, int n);
+    /* constant premultiplied color scaled by an A8 coverage byte per pixel,
+       then source-over (fc_mask_px) */
+    void (*mask)(uint8_t* dst, const uint8_t* cov, int n, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+} fc_span_ops;
+
+static void span_fill_scalar(uint8_t* dst, int n, uint32_t px) {
+    for (int i = 0; i < n; ++i, dst += 4) fc_store_px(dst, px);
 }
 
-static inline void put_px_nocheck(int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    uint8_t* p = g_fc.pixels + (size_t)y * (size_t)g_fc.pitch + (size_t)x * 4u;
-    if (a == 255) {
-        p[0] = r; p[1] = g; p[2] = b; p[3] = 255;
-    } else if (a != 0) {
-        blend_rgba_over(p, r, g, b, a);
+static void span_fill_blend_scalar(uint8_t* dst, int n, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const uint32_t s = fc_pack(r, g, b, a);
+    const uint32_t inv = 255u - a;
+    for (int i = 0; i < n; ++i, dst += 4) fc_store_px(dst, fc_over_px(fc_load_px(dst), s, inv));
+}
+
+static void span_copy_scalar(uint8_t* dst, const uint8_t* src, int n) {
+    memcpy(dst, src, (size_t)n * 4u);
+}
+
+static void span_blend_scalar(uint8_t* dst, const uint8_t* src, int n) {
+    for (int i = 0; i < n; ++i, src += 4, dst += 4) {
+        const uint8_t sa = src[3];
+        if (sa == 255) {
+            dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 255;
+        } else if (sa != 0) {
+            blend_rgba_over(dst, src[0], src[1], src[2], sa);
+        }
     }
 }
 
-/* =========================
-   Public API
-   ========================= */
+static void span_blend_straight_scalar(uint8_t* dst, const uint8_t* src, int n) {
+    for (int i = 0; i < n; ++i, src += 4, dst += 4) {
+        const uint8_t sa = src[3];
+        if (sa == 255) {
+            dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 255;
+        } else if (sa != 0) {
+            blend_rgba_straight(dst, src);
+        }
+    }
+}
 
-fossil_cube_result fossil_cube_init(
-    int width, int height,
-    fossil_cube_present_fn present,
-    void* userdata) {
-    if (width <= 0 || height <= 0 || present == NULL) return FOSSIL_CUBE_ERR_BADARGS;
-    if (g_fc.initialized) fossil_cube_shutdown();
-
-    g_fc.w = width;
-    g_fc.h = height;
-    g_fc.pitch = width * 4;
-    g_fc.present = present;
-    g_fc.userdata = userdata;
-    g_fc.clip.enabled = false;
-
-    size_t sz = (size_t)g_fc.pitch * (size_t)g_fc.h;
-    g_fc.pixels = (uint8_t*)malloc(sz);
-    if (!g_fc.pixels) {
-        memset(&g_fc, 0, sizeof(g_fc));
-        return FOSSIL_CUBE_ERR_OOM;
+static void span_mask_scalar(uint8_t* dst, const uint8_t* cov, int n,
+                             uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const uint32_t s = fc_pack(r, g, b, a);
+    for (int i = 0; i < n; ++i, dst += 4) {
+        const uint32_t m = cov[i];
+        if (m == 0) continue;
+        if (m == 255 && a == 255) fc_store_px(dst, s);
+        else fc_store_px(dst, fc_mask_px(fc_load_px(dst), s, m));
     }
-    memset(g_fc.pixels, 0, sz);
+}
 
-    g_fc.initialized = true;
-    return FOSSIL_CUBE_OK;
+static const fc_span_ops g_span_scalar = {
+    span_fill_scalar, span_fill_blend_scalar, span_copy_scalar, span_blend_scalar,
+    span_blend_straight_scalar, span_mask_scalar
+};
+
+/* Gradient ramp lookup, also next to the span sets: out[i] is the ramp
+   entry for t + i*dt under extend (fossil_cube_extend). The caller keeps
+   t + i*dt inside int32 for i < n. */
+typedef void (*fc_ramp_fn)(uint32_t* out, int n, int32_t t, int32_t dt, const uint32_t* ramp, int extend);
+
+static inline int fc_ramp_index(int32_t t, int extend) {
+    const int i = t >> 16;
+    if (extend == FOSSIL_CUBE_EXTEND_PAD) return i < 0 ? 0 : i > FC_RAMP_SIZE - 1 ? FC_RAMP_SIZE - 1 : i;
+    if (extend == FOSSIL_CUBE_EXTEND_REPEAT) return i & (FC_RAMP_SIZE - 1);
+    /* reflect: every second period runs backwards */
+    const int v = i & (2 * FC_RAMP_SIZE - 1);
+    return v < FC_RAMP_SIZE ? v : v ^ (2 * FC_RAMP_SIZE - 1);
 }
 
-void fossil_cube_shutdown(void) {
-    if (!g_fc.initialized) return;
-    free(g_fc.pixels);
-    memset(&g_fc, 0, sizeof(g_fc));
+static void fc_ramp_scalar(uint32_t* out, int n, int32_t t, int32_t dt, const uint32_t* ramp, int extend) {
+    for (int i = 0; i < n; ++i, t += dt) out[i] = ramp[fc_ramp_index(t, extend)];
 }
 
-fossil_cube_result fossil_cube_resize(int new_width, int new_height) {
-    if (!g_fc.initialized) return FOSSIL_CUBE_ERR_NOTINIT;
-    if (new_width <= 0 || new_height <= 0) return FOSSIL_CUBE_ERR_BADARGS;
+/* Bilinear resampling of one output strip, RGBA8 in and premultiplied
+   RGBA8 out, so it sits next to the span sets rather than in them (the
+   result goes through whatever blend the format provides):
+     out[i] = lerp(lerp(p00, p01, fx[i]), lerp(p10, p11, fx[i]), fy)
+   with p00/p01 at byte offsets x0[i]/x1[i] of r0, p10/p11 the same in r1,
+   and every lerp (a*(256 - f) + b*f + 128) >> 8 per channel. With premul
+   each tap is premultiplied first (fc_premul per channel). */
+typedef void (*fc_bilerp_fn)(uint8_t* out, const uint8_t* r0, const uint8_t* r1,
+                             const int32_t* x0, const int32_t* x1, const uint8_t* fx,
+                             int n, uint32_t fy, bool premul);
 
-    int new_pitch = new_width * 4;
-    size_t sz = (size_t)new_pitch * (size_t)new_height;
-    uint8_t* npix = (uint8_t*)malloc(sz);
-    if (!npix) return FOSSIL_CUBE_ERR_OOM;
+static inline uint32_t fc_premul_px(uint32_t p, uint32_t a) {
+    if (a == 255) return p;
+    /* the alpha byte is forced to 255 so its lane comes out as a */
+    p |= fc_pack(0, 0, 0, 255);
+    return fc_div255x2((p & FC_LANES) * a) | (fc_div255x2(((p >> 8) & FC_LANES) * a) << 8);
+}
 
-    free(g_fc.pixels);
-    g_fc.pixels = npix;
-    g_fc.w = new_width;
-    g_fc.h = new_height;
-    g_fc.pitch = new_pitch;
-    g_fc.clip.enabled = false;
-    memset(g_fc.pixels, 0, sz);
-    return FOSSIL_CUBE_OK;
+/* Two taps of the lerp on both lane pairs; lanes stay below 2^16 */
+static inline uint32_t fc_lerp256_px(uint32_t p, uint32_t q, uint32_t f) {
+    const uint32_t g = 256u - f;
+    const uint32_t rb = (((p & FC_LANES) * g + (q & FC_LANES) * f + 0x00800080u) >> 8) & FC_LANES;
+    const uint32_t ga = ((((p >> 8) & FC_LANES) * g + ((q >> 8) & FC_LANES) * f + 0x00800080u) >> 8) & FC_LANES;
+    return rb | (ga << 8);
 }
 
-void fossil_cube_begin_frame(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    fossil_cube_clear(r, g, b, a);
+static inline uint32_t fc_tap_px(const uint8_t* p, bool premul) {
+    const uint32_t v = fc_load_px(p);
+    return premul ? fc_premul_px(v, p[3]) : v;
 }
 
-void fossil_cube_end_frame(void) {
-    if (!g_fc.initialized || !g_fc.present) return;
-    g_fc.present(g_fc.pixels, g_fc.w, g_fc.h, g_fc.pitch, g_fc.userdata);
+static void fc_bilerp_scalar(uint8_t* out, const uint8_t* r0, const uint8_t* r1,
+                             const int32_t* x0, const int32_t* x1, const uint8_t* fx,
+                             int n, uint32_t fy, bool premul) {
+    for (int i = 0; i < n; ++i, out += 4) {
+        const uint32_t f = fx[i];
+        const uint32_t top = fc_lerp256_px(fc_tap_px(r0 + x0[i], premul), fc_tap_px(r0 + x1[i], premul), f);
+        const uint32_t bot = fc_lerp256_px(fc_tap_px(r1 + x0[i], premul), fc_tap_px(r1 + x1[i], premul), f);
+        fc_store_px(out, fc_lerp256_px(top, bot, fy));
+    }
 }
 
-void fossil_cube_clear(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    if (!g_fc.initialized) return;
-    /* Fast clear: fill 32-bit pattern */
-    uint32_t color = (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | ((uint32_t)a << 24);
-    uint32_t* row = (uint32_t*)g_fc.pixels;
-    size_t count = (size_t)g_fc.w * (size_t)g_fc.h;
-    for (size_t i = 0; i < count; ++i) row[i] = color;
+#if !defined(FOSSIL_CUBE_NO_SIMD) && \
+    (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define FC_HAVE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define FC_TARGET_SSE2
+#define FC_TARGET_AVX2
+#else
+#define FC_TARGET_SSE2 __attribute__((target("sse2")))
+#define FC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/* fc_div255 per 16-bit lane: ((x + 128) * 257) >> 16 */
+FC_TARGET_SSE2 static inline __m128i sse2_div255_epu16(__m128i x) {
+    return _mm_mulhi_epu16(_mm_add_epi16(x, _mm_set1_epi16(128)), _mm_set1_epi16(257));
 }
 
-void fossil_cube_set_clip(int x, int y, int w, int h) {
-    if (!g_fc.initialized) return;
-    if (w <= 0 || h <= 0) {
-        g_fc.clip.enabled = false;
-        return;
+/* d*(255 - sa) / 255 for 2 pixels unpacked to 16-bit lanes */
+FC_TARGET_SSE2 static inline __m128i sse2_over_lo16(__m128i d16, __m128i inv16) {
+    return sse2_div255_epu16(_mm_mullo_epi16(d16, inv16));
+}
+
+FC_TARGET_SSE2 static inline __m128i sse2_over4(__m128i s, __m128i d) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi16(255);
+    __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+    __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+    __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+    __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+    __m128i r_lo = sse2_over_lo16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(c255, a_lo));
+    __m128i r_hi = sse2_over_lo16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(c255, a_hi));
+    return _mm_add_epi8(s, _mm_packus_epi16(r_lo, r_hi));
+}
+
+/* (s*a + d*(255 - a) + 127) / 255 for 2 pixels unpacked to 16-bit lanes */
+FC_TARGET_SSE2 static inline __m128i sse2_lerp_lo16(__m128i s16, __m128i d16, __m128i a16) {
+    const __m128i inv16 = _mm_sub_epi16(_mm_set1_epi16(255), a16);
+    return sse2_div255_epu16(_mm_add_epi16(_mm_mullo_epi16(s16, a16), _mm_mullo_epi16(d16, inv16)));
+}
+
+/* straight source over dst; the source alpha byte is forced to 255 so
+   the alpha lane comes out as sa + d*(1 - sa) */
+FC_TARGET_SSE2 static inline __m128i sse2_straight4(__m128i s, __m128i d, __m128i amask) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+    __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+    __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+    __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+    __m128i so = _mm_or_si128(s, amask);
+    __m128i r_lo = sse2_lerp_lo16(_mm_unpacklo_epi8(so, zero), _mm_unpacklo_epi8(d, zero), a_lo);
+    __m128i r_hi = sse2_lerp_lo16(_mm_unpackhi_epi8(so, zero), _mm_unpackhi_epi8(d, zero), a_hi);
+    return _mm_packus_epi16(r_lo, r_hi);
+}
+
+FC_TARGET_SSE2 static void span_fill_sse2(uint8_t* dst, int n, uint32_t px) {
+    const __m128i v = _mm_set1_epi32((int)px);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_si128((__m128i*)(dst + (size_t)i * 4u), v);
+    span_fill_scalar(dst + (size_t)i * 4u, n - i, px);
+}
+
+FC_TARGET_SSE2 static void span_fill_blend_sse2(uint8_t* dst, int n, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const __m128i s8 = _mm_set1_epi32((int)fc_pack(r, g, b, a));
+    const __m128i inv = _mm_set1_epi16((short)(255 - a));
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint8_t* p = dst + (size_t)i * 4u;
+        __m128i d = _mm_loadu_si128((const __m128i*)p);
+        __m128i lo = sse2_over_lo16(_mm_unpacklo_epi8(d, zero), inv);
+        __m128i hi = sse2_over_lo16(_mm_unpackhi_epi8(d, zero), inv);
+        _mm_storeu_si128((__m128i*)p, _mm_add_epi8(s8, _mm_packus_epi16(lo, hi)));
     }
-    /* clamp to framebuffer */
-    int x0 = x < 0 ? 0 : x;
-    int y0 = y < 0 ? 0 : y;
-    int x1 = x + w; if (x1 > g_fc.w) x1 = g_fc.w;
-    int y1 = y + h; if (y1 > g_fc.h) y1 = g_fc.h;
+    span_fill_blend_scalar(dst + (size_t)i * 4u, n - i, r, g, b, a);
+}
 
-    g_fc.clip.x = x0;
-    g_fc.clip.y = y0;
-    g_fc.clip.w = (x1 > x0) ? (x1 - x0) : 0;
-    g_fc.clip.h = (y1 > y0) ? (y1 - y0) : 0;
-    g_fc.clip.enabled = (g_fc.clip.w > 0 && g_fc.clip.h > 0);
+FC_TARGET_SSE2 static void span_blend_sse2(uint8_t* dst, const uint8_t* src, int n) {
+    const __m128i amask = _mm_set1_epi32((int)fc_pack(0, 0, 0, 255));
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const uint8_t* sp = src + (size_t)i * 4u;
+        uint8_t* dp = dst + (size_t)i * 4u;
+        __m128i s = _mm_loadu_si128((const __m128i*)sp);
+        __m128i sa = _mm_and_si128(s, amask);
+        int opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(sa, amask));
+        if (opaque == 0xFFFF) { _mm_storeu_si128((__m128i*)dp, s); continue; }
+        __m128i clear = _mm_cmpeq_epi32(sa, zero);
+        if (_mm_movemask_epi8(clear) == 0xFFFF) continue;
+        __m128i d = _mm_loadu_si128((const __m128i*)dp);
+        __m128i o = sse2_over4(s, d);
+        o = _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, o));
+        _mm_storeu_si128((__m128i*)dp, o);
+    }
+    span_blend_scalar(dst + (size_t)i * 4u, src + (size_t)i * 4u, n - i);
 }
 
-void fossil_cube_get_clip(int* x, int* y, int* w, int* h) {
-    if (x) *x = g_fc.clip.x;
-    if (y) *y = g_fc.clip.y;
-    if (w) *w = g_fc.clip.w;
-    if (h) *h = g_fc.clip.h;
+FC_TARGET_SSE2 static void span_blend_straight_sse2(uint8_t* dst, const uint8_t* src, int n) {
+    const __m128i amask = _mm_set1_epi32((int)fc_pack(0, 0, 0, 255));
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const uint8_t* sp = src + (size_t)i * 4u;
+        uint8_t* dp = dst + (size_t)i * 4u;
+        __m128i s = _mm_loadu_si128((const __m128i*)sp);
+        __m128i sa = _mm_and_si128(s, amask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, amask)) == 0xFFFF) { _mm_storeu_si128((__m128i*)dp, s); continue; }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero)) == 0xFFFF) continue;
+        /* sa == 0 lanes lerp back to d exactly, no select needed */
+        __m128i d = _mm_loadu_si128((const __m128i*)dp);
+        _mm_storeu_si128((__m128i*)dp, sse2_straight4(s, d, amask));
+    }
+    span_blend_straight_scalar(dst + (size_t)i * 4u, src + (size_t)i * 4u, n - i);
 }
 
-void fossil_cube_put_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    if (!g_fc.initialized) return;
-    if ((unsigned)x >= (unsigned)g_fc.w || (unsigned)y >= (unsigned)g_fc.h) return;
-    if (!in_clip(x, y)) return;
-    put_px_nocheck(x, y, r, g, b, a);
+/* 4 pixels: color and coverage widened to 16-bit lanes, scaled, then over */
+FC_TARGET_SSE2 static void span_mask_sse2(uint8_t* dst, const uint8_t* cov, int n,
+                                          uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i s8 = _mm_set1_epi32((int)fc_pack(r, g, b, a));
+    const __m128i s16 = _mm_unpacklo_epi8(s8, zero);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint8_t* p = dst + (size_t)i * 4u;
+        uint32_t m4;
+        memcpy(&m4, cov + i, sizeof(m4));
+        if (m4 == 0) continue;
+        if (m4 == 0xFFFFFFFFu && a == 255) { _mm_storeu_si128((__m128i*)p, s8); continue; }
+        __m128i m = _mm_cvtsi32_si128((int)m4);
+        m = _mm_unpacklo_epi8(m, m);
+        m = _mm_unpacklo_epi16(m, m); /* each coverage byte in all 4 bytes of its pixel */
+        __m128i sm_lo = sse2_div255_epu16(_mm_mullo_epi16(s16, _mm_unpacklo_epi8(m, zero)));
+        __m128i sm_hi = sse2_div255_epu16(_mm_mullo_epi16(s16, _mm_unpackhi_epi8(m, zero)));
+        __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sm_lo, 0xFF), 0xFF);
+        __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sm_hi, 0xFF), 0xFF);
+        __m128i d = _mm_loadu_si128((const __m128i*)p);
+        __m128i r_lo = sse2_over_lo16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(c255, a_lo));
+        __m128i r_hi = sse2_over_lo16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(c255, a_hi));
+        _mm_storeu_si128((__m128i*)p, _mm_add_epi8(_mm_packus_epi16(sm_lo, sm_hi),
+                                                   _mm_packus_epi16(r_lo, r_hi)));
+    }
+    span_mask_scalar(dst + (size_t)i * 4u, cov + i, n - i, r, g, b, a);
 }
 
-void fossil_cube_fill_rect(int x, int y, int w, int h,
-                           uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    if (!g_fc.initialized) return;
-    if (w <= 0 || h <= 0) return;
+/* 2x2 taps of 2 output pixels gathered into 16-bit lanes */
+FC_TARGET_SSE2 static inline __m128i sse2_tap2(const uint8_t* row, int32_t a, int32_t b) {
+    const __m128i p = _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)fc_load_px(row + a)),
+                                         _mm_cvtsi32_si128((int)fc_load_px(row + b)));
+    return _mm_unpacklo_epi8(p, _mm_setzero_si128());
+}
 
-    int x0 = x;
-    int y0 = y;
-    int x1 = x + w;
-    int y1 = y + h;
+FC_TARGET_SSE2 static inline __m128i sse2_premul16(__m128i p) {
+    const __m128i rgb = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i a255 = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, 0xFF), 0xFF);
+    a = _mm_or_si128(_mm_and_si128(a, rgb), a255);
+    return sse2_div255_epu16(_mm_mullo_epi16(p, a));
+}
 
-    if (x0 < 0) x0 = 0;
-    if (y0 < 0) y0 = 0;
-    if (x1 > g_fc.w) x1 = g_fc.w;
-    if (y1 > g_fc.h) y1 = g_fc.h;
+FC_TARGET_SSE2 static inline __m128i sse2_lerp256(__m128i p, __m128i q, __m128i f) {
+    const __m128i g = _mm_sub_epi16(_mm_set1_epi16(256), f);
+    const __m128i t = _mm_add_epi16(_mm_mullo_epi16(p, g), _mm_mullo_epi16(q, f));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_set1_epi16(128)), 8);
+}
 
-    for (int yy = y0; yy < y1; ++yy) {
-        for (int xx = x0; xx < x1; ++xx) {
-            if (!in_clip(xx, yy)) continue;
-            put_px_nocheck(xx, yy, r, g, b, a);
+FC_TARGET_SSE2 static void fc_bilerp_sse2(uint8_t* out, const uint8_t* r0, const uint8_t* r1,
+                                          const int32_t* x0, const int32_t* x1, const uint8_t* fx,
+                                          int n, uint32_t fy, bool premul) {
+    const __m128i wy = _mm_set1_epi16((short)fy);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i p00 = sse2_tap2(r0, x0[i], x0[i + 1]), p01 = sse2_tap2(r0, x1[i], x1[i + 1]);
+        __m128i p10 = sse2_tap2(r1, x0[i], x0[i + 1]), p11 = sse2_tap2(r1, x1[i], x1[i + 1]);
+        if (premul) {
+            p00 = sse2_premul16(p00); p01 = sse2_premul16(p01);
+            p10 = sse2_premul16(p10); p11 = sse2_premul16(p11);
         }
+        const short f0 = (short)fx[i], f1 = (short)fx[i + 1];
+        const __m128i wx = _mm_set_epi16(f1, f1, f1, f1, f0, f0, f0, f0);
+        const __m128i v = sse2_lerp256(sse2_lerp256(p00, p01, wx), sse2_lerp256(p10, p11, wx), wy);
+        _mm_storel_epi64((__m128i*)(out + (size_t)i * 4u), _mm_packus_epi16(v, v));
     }
+    fc_bilerp_scalar(out + (size_t)i * 4u, r0, r1, x0 + i, x1 + i, fx + i, n - i, fy, premul);
 }
 
-/* Bresenham line */
-void fossil_cube_draw_line(int x0, int y0, int x1, int y1,
-                           uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    if (!g_fc.initialized) return;
+static const fc_span_ops g_span_sse2 = {
+    span_fill_sse2, span_fill_blend_sse2, span_copy_scalar, span_blend_sse2,
+    span_blend_straight_sse2, span_mask_sse2
+};
 
-    int dx = (x1 > x0) ? (x1 - x0) : (x0 - x1);
-    int sx = (x0 < x1) ? 1 : -1;
-    int dy = (y1 > y0) ? (y0 - y1) : (y1 - y0); /* negative for standard algorithm */
-    int sy = (y0 < y1) ? 1 : -1;
-    int err = dx + dy;
+FC_TARGET_AVX2 static inline __m256i avx2_div255_epu16(__m256i x) {
+    return _mm256_mulhi_epu16(_mm256_add_epi16(x, _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+}
 
-    for (;;) {
-        fossil_cube_put_pixel(x0, y0, r, g, b, a);
-        if (x0 == x1 && y0 == y1) break;
-        int e2 = err << 1;
-        if (e2 >= dy) { err += dy; x0 += sx; }
-        if (e2 <= dx) { err += dx; y0 += sy; }
-        if ((unsigned)x0 >= (unsigned)g_fc.w && (unsigned)y0 >= (unsigned)g_fc.h) break;
+FC_TARGET_AVX2 static inline __m256i avx2_over_lo16(__m256i d16, __m256i inv16) {
+    return avx2_div255_epu16(_mm256_mullo_epi16(d16, inv16));
+}
+
+FC_TARGET_AVX2 static inline __m256i avx2_lerp_lo16(__m256i s16, __m256i d16, __m256i a16) {
+    const __m256i inv16 = _mm256_sub_epi16(_mm256_set1_epi16(255), a16);
+    return avx2_div255_epu16(_mm256_add_epi16(_mm256_mullo_epi16(s16, a16), _mm256_mullo_epi16(d16, inv16)));
+}
+
+FC_TARGET_AVX2 static void span_fill_avx2(uint8_t* dst, int n, uint32_t px) {
+    const __m256i v = _mm256_set1_epi32((int)px);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i*)(dst + (size_t)i * 4u), v);
+    /* the tails are SSE/scalar code: leave the upper YMM halves clean or
+       every legacy-SSE instruction after this pays a state transition */
+    _mm256_zeroupper();
+    span_fill_scalar(dst + (size_t)i * 4u, n - i, px);
+}
+
+FC_TARGET_AVX2 static void span_fill_blend_avx2(uint8_t* dst, int n, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const __m256i s8 = _mm256_set1_epi32((int)fc_pack(r, g, b, a));
+    const __m256i inv = _mm256_set1_epi16((short)(255 - a));
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8_t* p = dst + (size_t)i * 4u;
+        __m256i d = _mm256_loadu_si256((const __m256i*)p);
+        __m256i lo = avx2_over_lo16(_mm256_unpacklo_epi8(d, zero), inv);
+        __m256i hi = avx2_over_lo16(_mm256_unpackhi_epi8(d, zero), inv);
+        _mm256_storeu_si256((__m256i*)p, _mm256_add_epi8(s8, _mm256_packus_epi16(lo, hi)));
     }
+    _mm256_zeroupper();
+    span_fill_blend_scalar(dst + (size_t)i * 4u, n - i, r, g, b, a);
 }
 
-void fossil_cube_blit_rgba(int dst_x, int dst_y,
-                           const uint8_t* src, int src_w, int src_h, int src_pitch) {
-    if (!g_fc.initialized || !src || src_w <= 0 || src_h <= 0) return;
-
-    int x0 = dst_x < 0 ? 0 : dst_x;
-    int y0 = dst_y < 0 ? 0 : dst_y;
-    int x1 = dst_x + src_w; if (x1 > g_fc.w) x1 = g_fc.w;
-    int y1 = dst_y + src_h; if (y1 > g_fc.h) y1 = g_fc.h;
-    if (x0 >= x1 || y0 >= y1) return;
-
-    for (int y = y0; y < y1; ++y) {
-        const uint8_t* srow = src + (size_t)(y - dst_y) * (size_t)src_pitch
-                                   + (size_t)(x0 - dst_x) * 4u;
-        uint8_t* drow = g_fc.pixels + (size_t)y * (size_t)g_fc.pitch + (size_t)x0 * 4u;
-
-        for (int x = x0; x < x1; ++x) {
-            if (in_clip(x, y)) {
-                const uint8_t sr = srow[0], sg = srow[1], sb = srow[2], sa = srow[3];
-                if (sa == 255) {
-                    drow[0] = sr; drow[1] = sg; drow[2] = sb; drow[3] = 255;
-                } else if (sa != 0) {
-                    blend_rgba_over(drow, sr, sg, sb, sa);
-                }
-            }
-            srow += 4;
-            drow += 4;
+FC_TARGET_AVX2 static void span_blend_avx2(uint8_t* dst, const uint8_t* src, int n) {
+    const __m256i amask = _mm256_set1_epi32((int)fc_pack(0, 0, 0, 255));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i c255 = _mm256_set1_epi16(255);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const uint8_t* sp = src + (size_t)i * 4u;
+        uint8_t* dp = dst + (size_t)i * 4u;
+        __m256i s = _mm256_loadu_si256((const __m256i*)sp);
+        __m256i sa = _mm256_and_si256(s, amask);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, amask)) == -1) {
+            _mm256_storeu_si256((__m256i*)dp, s);
+            continue;
         }
+        __m256i clear = _mm256_cmpeq_epi32(sa, zero);
+        if (_mm256_movemask_epi8(clear) == -1) continue;
+        __m256i d = _mm256_loadu_si256((const __m256i*)dp);
+        __m256i s_lo = _mm256_unpacklo_epi8(s, zero);
+        __m256i s_hi = _mm256_unpackhi_epi8(s, zero);
+        __m256i a_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+        __m256i a_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+        __m256i r_lo = avx2_over_lo16(_mm256_unpacklo_epi8(d, zero), _mm256_sub_epi16(c255, a_lo));
+        __m256i r_hi = avx2_over_lo16(_mm256_unpackhi_epi8(d, zero), _mm256_sub_epi16(c255, a_hi));
+        __m256i o = _mm256_add_epi8(s, _mm256_packus_epi16(r_lo, r_hi));
+        o = _mm256_blendv_epi8(o, d, clear);
+        _mm256_storeu_si256((__m256i*)dp, o);
     }
+    _mm256_zeroupper();
+    span_blend_sse2(dst + (size_t)i * 4u, src + (size_t)i * 4u, n - i);
 }
 
-uint8_t* fossil_cube_framebuffer(int* out_w, int* out_h, int* out_pitch) {
-    if (out_w) *out_w = g_fc.w;
-    if (out_h) *out_h = g_fc.h;
-    if (out_pitch) *out_pitch = g_fc.pitch;
-    return g_fc.pixels;
+FC_TARGET_AVX2 static void span_blend_straight_avx2(uint8_t* dst, const uint8_t* src, int n) {
+    const __m256i amask = _mm256_set1_epi32((int)fc_pack(0, 0, 0, 255));
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const uint8_t* sp = src + (size_t)i * 4u;
+        uint8_t* dp = dst + (size_t)i * 4u;
+        __m256i s = _mm256_loadu_si256((const __m256i*)sp);
+        __m256i sa = _mm256_and_si256(s, amask);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, amask)) == -1) {
+            _mm256_storeu_si256((__m256i*)dp, s);
+            continue;
+        }
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, zero)) == -1) continue;
+        __m256i d = _mm256_loadu_si256((const __m256i*)dp);
+        __m256i s_lo = _mm256_unpacklo_epi8(s, zero);
+        __m256i s_hi = _mm256_unpackhi_epi8(s, zero);
+        __m256i a_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+        __m256i a_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+        __m256i so = _mm256_or_si256(s, amask);
+        __m256i r_lo = avx2_lerp_lo16(_mm256_unpacklo_epi8(so, zero), _mm256_unpacklo_epi8(d, zero), a_lo);
+        __m256i r_hi = avx2_lerp_lo16(_mm256_unpackhi_epi8(so, zero), _mm256_unpackhi_epi8(d, zero), a_hi);
+        _mm256_storeu_si256((__m256i*)dp, _mm256_packus_epi16(r_lo, r_hi));
+    }
+    _mm256_zeroupper();
+    span_blend_straight_sse2(dst + (size_t)i * 4u, src + (size_t)i * 4u, n - i);
+}
+
+FC_TARGET_AVX2 static void span_mask_avx2(uint8_t* dst, const uint8_t* cov, int n,
+                                          uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i c255 = _mm256_set1_epi16(255);
+    const __m256i s8 = _mm256_set1_epi32((int)fc_pack(r, g, b, a));
+    const __m256i s16 = _mm256_unpacklo_epi8(s8, zero);
+    const __m256i splat = _mm256_set1_epi32(0x01010101);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8_t* p = dst + (size_t)i * 4u;
+        uint64_t m8;
+        memcpy(&m8, cov + i, sizeof(m8));
+        if (m8 == 0) continue;
+        if (m8 == ~(uint64_t)0 && a == 255) { _mm256_storeu_si256((__m256i*)p, s8); continue; }
+        __m256i m = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(cov + i)));
+        m = _mm256_mullo_epi32(m, splat);
+        __m256i sm_lo = avx2_div255_epu16(_mm256_mullo_epi16(s16, _mm256_unpacklo_epi8(m, zero)));
+        __m256i sm_hi = avx2_div255_epu16(_mm256_mullo_epi16(s16, _mm256_unpackhi_epi8(m, zero)));
+        __m256i a_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sm_lo, 0xFF), 0xFF);
+        __m256i a_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sm_hi, 0xFF), 0xFF);
+        __m256i d = _mm256_loadu_si256((const __m256i*)p);
+        __m256i r_lo = avx2_over_lo16(_mm256_unpacklo_epi8(d, zero), _mm256_sub_epi16(c255, a_lo));
+        __m256i r_hi = avx2_over_lo16(_mm256_unpackhi_epi8(d, zero), _mm256_sub_epi16(c255, a_hi));
+        _mm256_storeu_si256((__m256i*)p, _mm256_add_epi8(_mm256_packus_epi16(sm_lo, sm_hi),
+                                                         _mm256_packus_epi16(r_lo, r_hi)));
+    }
+    _mm256_zeroupper();
+    span_mask_sse2(dst + (size_t)i * 4u, cov + i, n - i, r, g, b, a);
+}
+
+static const fc_span_ops g_span_avx2 = {
+    span_fill_avx2, span_fill_blend_avx2, span_copy_scalar, span_blend_avx2,
+    span_blend_straight_avx2, span_mask_avx2
+};
+
+/* Eight lookups per step: the index math of fc_ramp_index on 32-bit
+   lanes and a gather from the ramp */
+FC_TARGET_AVX2 static void fc_ramp_avx2(uint32_t* out, int n, int32_t t, int32_t dt,
+                                        const uint32_t* ramp, int extend) {
+    const __m256i last = _mm256_set1_epi32(FC_RAMP_SIZE - 1);
+    const __m256i mirror = _mm256_set1_epi32(2 * FC_RAMP_SIZE - 1);
+    const __m256i step = _mm256_set1_epi32(dt * 8);
+    __m256i v = _mm256_add_epi32(_mm256_set1_epi32(t),
+                                 _mm256_mullo_epi32(_mm256_set1_epi32(dt), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    int i = 0;
+    for (; i + 8 <= n; i += 8, v = _mm256_add_epi32(v, step)) {
+        __m256i idx = _mm256_srai_epi32(v, 16);
+        if (extend == FOSSIL_CUBE_EXTEND_PAD) {
+            idx = _mm256_min_epi32(_mm256_max_epi32(idx, _mm256_setzero_si256()), last);
+        } else if (extend == FOSSIL_CUBE_EXTEND_REPEAT) {
+            idx = _mm256_and_si256(idx, last);
+        } else {
+            idx = _mm256_and_si256(idx, mirror);
+            idx = _mm256_xor_si256(idx, _mm256_and_si256(_mm256_cmpgt_epi32(idx, last), mirror));
+        }
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_i32gather_epi32((const int*)ramp, idx, 4));
+    }
+    _mm256_zeroupper();
+    fc_ramp_scalar(out + i, n - i, t + i * dt, dt, ramp, extend);
+}
+
+/* Non-temporal fills for large clears: rows of a repeating 4-byte memory
+   pattern written with streaming stores, which bypass the cache instead
+   of reading every line in and evicting what the frame draws next. The
+   pattern is as laid out from a 4-byte-aligned address, so any pixel
+   size that divides 4 works once rows start on a whole pixel; the
+   unaligned head and tail of a row are byte stores. */
+static void fc_fill_pattern_bytes(uint8_t* p, size_t n, uint32_t word) {
+    uint8_t w[4];
+    memcpy(w, &word, sizeof(w));
+    for (size_t i = 0; i < n; ++i, ++p) *p = w[(uintptr_t)p & 3u];
+}
+
+FC_TARGET_SSE2 static void fc_stream_rows_sse2(uint8_t* row, ptrdiff_t pitch, int rows, size_t len,
+                                               uint32_t word) {
+    const __m128i v = _mm_set1_epi32((int)word);
+    for (int y = 0; y < rows; ++y, row += pitch) {
+        uint8_t* p = row;
+        uint8_t* const end = row + len;
+        size_t head = (size_t)(-(uintptr_t)p & 15u);
+        if (head > len) head = len;
+        fc_fill_pattern_bytes(p, head, word);
+        for (p += head; end - p >= 16; p += 16) _mm_stream_si128((__m128i*)p, v);
+        fc_fill_pattern_bytes(p, (size_t)(end - p), word);
+    }
+    /* streaming stores are weakly ordered: publish them before the pool
+       reports the band done */
+    _mm_sfence();
+}
+
+FC_TARGET_AVX2 static void fc_stream_rows_avx2(uint8_t* row, ptrdiff_t pitch, int rows, size_t len,
+                                               uint32_t word) {
+    const __m256i v = _mm256_set1_epi32((int)word);
+    for (int y = 0; y < rows; ++y, row += pitch) {
+        uint8_t* p = row;
+        uint8_t* const end = row + len;
+        size_t head = (size_t)(-(uintptr_t)p & 31u);
+        if (head > len) head = len;
+        fc_fill_pattern_bytes(p, head, word);
+        for (p += head; end - p >= 32; p += 32) _mm256_stream_si256((__m256i*)p, v);
+        fc_fill_pattern_bytes(p, (size_t)(end - p), word);
+    }
+    _mm256_zeroupper();
+    _mm_sfence();
+}
+
+static bool fc_cpu_has(fossil_cube_simd level) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+    __cpuid(info, 1);
+    if (level == FOSSIL_CUBE_SIMD_SSE2) return (info[3] & (1 << 26)) != 0;
+    if (level != FOSSIL_CUBE_SIMD_AVX2 || max_leaf < 7) return false;
+    /* OSXSAVE + AVX, and the OS must save YMM state */
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+    if ((_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    if (level == FOSSIL_CUBE_SIMD_SSE2) return __builtin_cpu_supports("sse2") != 0;
+    if (level == FOSSIL_CUBE_SIMD_AVX2) return __builtin_cpu_supports("avx2") != 0;
+    return false;
+#endif
+}
+#endif /* x86 */
+
+#if !defined(FOSSIL_CUBE_NO_SIMD) && \
+    (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64))
+#define FC_HAVE_NEON 1
+#include <arm_neon.h>
+
+/* fc_div255 per 16-bit lane, narrowed to bytes */
+static inline uint8x8_t neon_div255_u16(uint16x8_t x) {
+    uint16x8_t t = vaddq_u16(x, vdupq_n_u16(128));
+    return vshrn_n_u16(vsraq_n_u16(t, t, 8), 8);
+}
+
+static inline uint8x8_t neon_mul_div255(uint8x8_t d, uint8x8_t inv) {
+    return neon_div255_u16(vmull_u8(d, inv));
+}
+
+/* (s*a + d*inv) / 255 with inv = 255 - a */
+static inline uint8x8_t neon_lerp_div255(uint8x8_t s, uint8x8_t d, uint8x8_t a, uint8x8_t inv) {
+    return neon_div255_u16(vmlal_u8(vmull_u8(s, a), d, inv));
+}
+
+static void span_fill_neon(uint8_t* dst, int n, uint32_t px) {
+    const uint32x4_t v = vdupq_n_u32(px);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) vst1q_u8(dst + (size_t)i * 4u, vreinterpretq_u8_u32(v));
+    span_fill_scalar(dst + (size_t)i * 4u, n - i, px);
+}
+
+static void span_fill_blend_neon(uint8_t* dst, int n, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const uint8x8_t inv = vdup_n_u8((uint8_t)(255 - a));
+    const uint8x8_t sr = vdup_n_u8(r), sg = vdup_n_u8(g), sb = vdup_n_u8(b), sa = vdup_n_u8(a);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8_t* p = dst + (size_t)i * 4u;
+        uint8x8x4_t d = vld4_u8(p);
+        d.val[0] = vadd_u8(sr, neon_mul_div255(d.val[0], inv));
+        d.val[1] = vadd_u8(sg, neon_mul_div255(d.val[1], inv));
+        d.val[2] = vadd_u8(sb, neon_mul_div255(d.val[2], inv));
+        d.val[3] = vadd_u8(sa, neon_mul_div255(d.val[3], inv));
+        vst4_u8(p, d);
+    }
+    span_fill_blend_scalar(dst + (size_t)i * 4u, n - i, r, g, b, a);
+}
+
+static void span_blend_neon(uint8_t* dst, const uint8_t* src, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8_t* p = dst + (size_t)i * 4u;
+        uint8x8x4_t s = vld4_u8(src + (size_t)i * 4u);
+        uint8x8x4_t d = vld4_u8(p);
+        uint8x8_t inv = vmvn_u8(s.val[3]);
+        uint8x8_t clear = vceq_u8(s.val[3], vdup_n_u8(0));
+        for (int c = 0; c < 4; ++c) {
+            uint8x8_t o = vadd_u8(s.val[c], neon_mul_div255(d.val[c], inv));
+            d.val[c] = vbsl_u8(clear, d.val[c], o);
+        }
+        vst4_u8(p, d);
+    }
+    span_blend_scalar(dst + (size_t)i * 4u, src + (size_t)i * 4u, n - i);
+}
+
+static void span_blend_straight_neon(uint8_t* dst, const uint8_t* src, int n) {
+    const uint8x8_t full = vdup_n_u8(255);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8_t* p = dst + (size_t)i * 4u;
+        uint8x8x4_t s = vld4_u8(src + (size_t)i * 4u);
+        uint8x8x4_t d = vld4_u8(p);
+        uint8x8_t inv = vmvn_u8(s.val[3]);
+        d.val[0] = neon_lerp_div255(s.val[0], d.val[0], s.val[3], inv);
+        d.val[1] = neon_lerp_div255(s.val[1], d.val[1], s.val[3], inv);
+        d.val[2] = neon_lerp_div255(s.val[2], d.val[2], s.val[3], inv);
+        d.val[3] = neon_lerp_div255(full, d.val[3], s.val[3], inv);
+        vst4_u8(p, d);
+    }
+    span_blend_straight_scalar(dst + (size_t)i * 4u, src + (size_t)i * 4u, n - i);
+}
+
+static void span_mask_neon(uint8_t* dst, const uint8_t* cov, int n,
+                           uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const uint8x8_t col[4] = { vdup_n_u8(r), vdup_n_u8(g), vdup_n_u8(b), vdup_n_u8(a) };
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint8_t* p = dst + (size_t)i * 4u;
+        const uint8x8_t m = vld1_u8(cov + i);
+        uint8x8x4_t d = vld4_u8(p);
+        const uint8x8_t sa = neon_mul_div255(col[3], m);
+        const uint8x8_t inv = vmvn_u8(sa);
+        for (int c = 0; c < 3; ++c) {
+            d.val[c] = vadd_u8(neon_mul_div255(col[c], m), neon_mul_div255(d.val[c], inv));
+        }
+        d.val[3] = vadd_u8(sa, neon_mul_div255(d.val[3], inv));
+        vst4_u8(p, d);
+    }
+    span_mask_scalar(dst + (size_t)i * 4u, cov + i, n - i, r, g, b, a);
+}
+
+static inline uint16x8_t neon_tap2(const uint8_t* row, int32_t a, int32_t b) {
+    uint32x2_t p = vdup_n_u32(fc_load_px(row + a));
+    p = vset_lane_u32(fc_load_px(row + b), p, 1);
+    return vmovl_u8(vreinterpret_u8_u32(p));
+}
+
+static inline uint16x8_t neon_premul16(uint16x8_t p) {
+    static const uint16_t rgb_mask[8] = { 0xFFFF, 0xFFFF, 0xFFFF, 0, 0xFFFF, 0xFFFF, 0xFFFF, 0 };
+    static const uint16_t a255[8] = { 0, 0, 0, 255, 0, 0, 0, 255 };
+    const uint16x4_t lo = vdup_lane_u16(vget_low_u16(p), 3);
+    const uint16x4_t hi = vdup_lane_u16(vget_high_u16(p), 3);
+    uint16x8_t a = vcombine_u16(lo, hi);
+    a = vorrq_u16(vandq_u16(a, vld1q_u16(rgb_mask)), vld1q_u16(a255));
+    return vmovl_u8(neon_div255_u16(vmulq_u16(p, a)));
+}
+
+static inline uint16x8_t neon_lerp256(uint16x8_t p, uint16x8_t q, uint16x8_t f) {
+    const uint16x8_t g = vsubq_u16(vdupq_n_u16(256), f);
+    const uint16x8_t t = vaddq_u16(vmulq_u16(p, g), vmulq_u16(q, f));
+    return vshrq_n_u16(vaddq_u16(t, vdupq_n_u16(128)), 8);
+}
+
+static void fc_bilerp_neon(uint8_t* out, const uint8_t* r0, const uint8_t* r1,
+                           const int32_t* x0, const int32_t* x1, const uint8_t* fx,
+                           int n, uint32_t fy, bool premul) {
+    const uint16x8_t wy = vdupq_n_u16((uint16_t)fy);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        uint16x8_t p00 = neon_tap2(r0, x0[i], x0[i + 1]), p01 = neon_tap2(r0, x1[i], x1[i + 1]);
+        uint16x8_t p10 = neon_tap2(r1, x0[i], x0[i + 1]), p11 = neon_tap2(r1, x1[i], x1[i + 1]);
+        if (premul) {
+            p00 = neon_premul16(p00); p01 = neon_premul16(p01);
+            p10 = neon_premul16(p10); p11 = neon_premul16(p11);
+        }
+        const uint16x8_t wx = vcombine_u16(vdup_n_u16(fx[i]), vdup_n_u16(fx[i + 1]));
+        const uint16x8_t v = neon_lerp256(neon_lerp256(p00, p01, wx), neon_lerp256(p10, p11, wx), wy);
+        vst1_u8(out + (size_t)i * 4u, vmovn_u16(v));
+    }
+    fc_bilerp_scalar(out + (size_t)i * 4u, r0, r1, x0 + i, x1 + i, fx + i, n - i, fy, premul);
+}
+
+static const fc_span_ops g_span_neon = {
+    span_fill_neon, span_fill_blend_neon, span_copy_scalar, span_blend_neon,
+    span_blend_straight_neon, span_mask_neon
+};
+#endif /* NEON */
+
+static const fc_span_ops* g_ops = &g_span_scalar;
+static fc_bilerp_fn g_bilerp = fc_bilerp_scalar;
+/* streaming row fill for large clears; NULL: clear through the span fill
+   (NEON has no non-temporal store intrinsic) */
+typedef void (*fc_stream_fn)(uint8_t* row, ptrdiff_t pitch, int rows, size_t len, uint32_t word);
+static fc_stream_fn g_stream = NULL;
+static fc_ramp_fn g_ramp = fc_ramp_scalar; /* AVX2 only: the others have no gather */
+static fossil_cube_simd g_simd = FOSSIL_CUBE_SIMD_SCALAR;
+
+static bool fc_simd_supported(fossil_cube_simd level) {
+    switch (level) {
+    case FOSSIL_CUBE_SIMD_SCALAR: return true;
+#if defined(FC_HAVE_X86)
+    case FOSSIL_CUBE_SIMD_SSE2:
+    case FOSSIL_CUBE_SIMD_AVX2: return fc_cpu_has(level);
+#endif
+#if defined(FC_HAVE_NEON)
+    case FOSSIL_CUBE_SIMD_NEON: return true;
+#endif
+    default: return false;
+    }
+}
+
+static void fc_simd_apply(fossil_cube_simd level) {
+    g_simd = level;
+    switch (level) {
+#if defined(FC_HAVE_X86)
+    case FOSSIL_CUBE_SIMD_SSE2:
+        g_ops = &g_span_sse2; g_bilerp = fc_bilerp_sse2; g_stream = fc_stream_rows_sse2;
+        g_ramp = fc_ramp_scalar;
+        break;
+    case FOSSIL_CUBE_SIMD_AVX2:
+        g_ops = &g_span_avx2; g_bilerp = fc_bilerp_sse2; g_stream = fc_stream_rows_avx2;
+        g_ramp = fc_ramp_avx2;
+        break;
+#endif
+#if defined(FC_HAVE_NEON)
+    case FOSSIL_CUBE_SIMD_NEON:
+        g_ops = &g_span_neon; g_bilerp = fc_bilerp_neon; g_stream = NULL; g_ramp = fc_ramp_scalar;
+        break;
+#endif
+    default:
+        g_ops = &g_span_scalar; g_bilerp = fc_bilerp_scalar; g_stream = NULL; g_ramp = fc_ramp_scalar;
+        g_simd = FOSSIL_CUBE_SIMD_SCALAR;
+        break;
+    }
+}
+
+/* Pick the widest kernel set the CPU supports; run once via fc_simd_select */
+static void fc_simd_select_best(void) {
+    if (fc_simd_supported(FOSSIL_CUBE_SIMD_AVX2)) fc_simd_apply(FOSSIL_CUBE_SIMD_AVX2);
+    else if (fc_simd_supported(FOSSIL_CUBE_SIMD_SSE2)) fc_simd_apply(FOSSIL_CUBE_SIMD_SSE2);
+    else if (fc_simd_supported(FOSSIL_CUBE_SIMD_NEON)) fc_simd_apply(FOSSIL_CUBE_SIMD_NEON);
+    else fc_simd_apply(FOSSIL_CUBE_SIMD_SCALAR);
+}
+
+/* =========================
+   Pixel formats
+   =========================
+   Colors and blit sources always arrive as RGBA8; each format supplies
+   the native fill pattern and span kernels that convert on the fly, so
+   the framebuffer is never swizzled or converted as a separate pass.
+   - RGBA8 uses the dispatched SIMD set directly
+   - BGRA8 reuses it: colors are swapped once per span, blit sources are
+     swizzled through a small stack chunk
+   - RGB565 and A8 get scalar kernels generated by FC_DEFINE_FORMAT_SPANS
+     from a per-format pixel load/store
+*/
+
+typedef struct fc_format {
+    int bpp;
+    uint32_t (*pack)(uint8_t r, uint8_t g, uint8_t b, uint8_t a); /* native fill pattern */
+    const fc_span_ops* spans; /* NULL: the active RGBA8 set, g_ops */
+    /* one pixel to and from an RGBA8 word, for the per-pixel paths */
+    uint32_t (*load)(const uint8_t* p);
+    void (*store)(uint8_t* p, uint32_t px);
+} fc_format;
+
+static uint32_t fc_pack_rgba8(uint8_t r, uint8_t g, uint8_t b, uint8_t a) { return fc_pack(r, g, b, a); }
+static uint32_t fc_pack_bgra8(uint8_t r, uint8_t g, uint8_t b, uint8_t a) { return fc_pack(b, g, r, a); }
+
+static uint32_t fc_load_rgba8(const uint8_t* p) { return fc_load_px(p); }
+static void fc_store_rgba8(uint8_t* p, uint32_t px) { fc_store_px(p, px); }
+static uint32_t fc_load_bgra8(const uint8_t* p) { return fc_pack(p[2], p[1], p[0], p[3]); }
+
+static void fc_store_bgra8(uint8_t* p, uint32_t px) {
+    uint8_t c[4];
+    memcpy(c, &px, sizeof(c));
+    p[0] = c[2]; p[1] = c[1]; p[2] = c[0]; p[3] = c[3];
+}
+
+/* BGRA8 */
+
+enum { FC_SWIZZLE_CHUNK = 256 };
+
+static inline void fc_swizzle_rb(uint8_t* dst, const uint8_t* src, int n) {
+    for (int i = 0; i < n; ++i, src += 4, dst += 4) {
+        const uint8_t r = src[0];
+        dst[0] = src[2]; dst[1] = src[1]; dst[2] = r; dst[3] = src[3];
+    }
+}
+
+static void span_fill_bgra8(uint8_t* dst, int n, uint32_t px) {
+    g_ops->fill(dst, n, px);
+}
+
+static void span_fill_blend_bgra8(uint8_t* dst, int n, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    g_ops->fill_blend(dst, n, b, g, r, a);
+}
+
+static void span_copy_bgra8(uint8_t* dst, const uint8_t* src, int n) {
+    fc_swizzle_rb(dst, src, n);
+}
+
+static void span_blend_bgra8(uint8_t* dst, const uint8_t* src, int n) {
+    uint8_t tmp[FC_SWIZZLE_CHUNK * 4];
+    for (int i = 0; i < n; i += FC_SWIZZLE_CHUNK) {
+        const int k = n - i < FC_SWIZZLE_CHUNK ? n - i : FC_SWIZZLE_CHUNK;
+        fc_swizzle_rb(tmp, src + (size_t)i * 4u, k);
+        g_ops->blend(dst + (size_t)i * 4u, tmp, k);
+    }
+}
+
+static void span_blend_straight_bgra8(uint8_t* dst, const uint8_t* src, int n) {
+    uint8_t tmp[FC_SWIZZLE_CHUNK * 4];
+    for (int i = 0; i < n; i += FC_SWIZZLE_CHUNK) {
+        const int k = n - i < FC_SWIZZLE_CHUNK ? n - i : FC_SWIZZLE_CHUNK;
+        fc_swizzle_rb(tmp, src + (size_t)i * 4u, k);
+        g_ops->blend_straight(dst + (size_t)i * 4u, tmp, k);
+    }
+}
+
+static void span_mask_bgra8(uint8_t* dst, const uint8_t* cov, int n,
+                            uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    g_ops->mask(dst, cov, n, b, g, r, a);
+}
+
+static const fc_span_ops g_span_bgra8 = {
+    span_fill_bgra8, span_fill_blend_bgra8, span_copy_bgra8, span_blend_bgra8,
+    span_blend_straight_bgra8, span_mask_bgra8
+};
+
+/* RGB565: native-endian 16-bit words, R in the top 5 bits. Loads expand
+   by bit replication and read as opaque; stores round to nearest. */
+
+static inline uint32_t fc_load_rgb565(const uint8_t* p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    const unsigned r5 = v >> 11, g6 = (v >> 5) & 63u, b5 = v & 31u;
+    return fc_pack((uint8_t)((r5 << 3) | (r5 >> 2)), (uint8_t)((g6 << 2) | (g6 >> 4)),
+                   (uint8_t)((b5 << 3) | (b5 >> 2)), 255);
+}
+
+static inline uint16_t fc_rgb565(uint8_t r, uint8_t g, uint8_t b) {
+    /* exact round(c * 31 / 255) and round(c * 63 / 255) */
+    return (uint16_t)((((r * 249u + 1014u) >> 11) << 11) |
+                      (((g * 253u + 505u) >> 10) << 5) |
+                      ((b * 249u + 1014u) >> 11));
+}
+
+static inline void fc_store_rgb565(uint8_t* p, uint32_t px) {
+    uint8_t c[4];
+    memcpy(c, &px, sizeof(c));
+    const uint16_t v = fc_rgb565(c[0], c[1], c[2]);
+    memcpy(p, &v, sizeof(v));
+}
+
+static uint32_t fc_pack_rgb565(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    (void)a;
+    return fc_rgb565(r, g, b);
+}
+
+static void span_fill_rgb565(uint8_t* dst, int n, uint32_t px) {
+    const uint16_t v = (uint16_t)px;
+    for (int i = 0; i < n; ++i, dst += 2) memcpy(dst, &v, sizeof(v));
+}
+
+/* A8: one coverage byte per pixel, only the alpha of each draw is kept */
+
+static inline uint32_t fc_load_a8(const uint8_t* p) { return fc_pack(0, 0, 0, p[0]); }
+
+static inline void fc_store_a8(uint8_t* p, uint32_t px) {
+    uint8_t c[4];
+    memcpy(c, &px, sizeof(c));
+    p[0] = c[3];
+}
+
+static uint32_t fc_pack_a8(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    (void)r; (void)g; (void)b;
+    return a;
+}
+
+static void span_fill_a8(uint8_t* dst, int n, uint32_t px) {
+    memset(dst, (int)(px & 0xFFu), (size_t)n);
+}
+
+/* Scalar kernels for a format given its pixel LOAD (to an RGBA8 word) and
+   STORE; the math is the shared fc_over_px / fc_lerp_px */
+#define FC_DEFINE_FORMAT_SPANS(name, BPP, LOAD, STORE)                                      \
+    static void span_fill_blend_##name(uint8_t* dst, int n,                                 \
+                                       uint8_t r, uint8_t g, uint8_t b, uint8_t a) {        \
+        const uint32_t s = fc_pack(r, g, b, a);                                             \
+        const uint32_t inv = 255u - a;                                                      \
+        for (int i = 0; i < n; ++i, dst += (BPP)) STORE(dst, fc_over_px(LOAD(dst), s, inv)); \
+    }                                                                                       \
+    static void span_copy_##name(uint8_t* dst, const uint8_t* src, int n) {                 \
+        for (int i = 0; i < n; ++i, src += 4, dst += (BPP)) STORE(dst, fc_load_px(src));    \
+    }                                                                                       \
+    static void span_blend_##name(uint8_t* dst, const uint8_t* src, int n) {                \
+        for (int i = 0; i < n; ++i, src += 4, dst += (BPP)) {                               \
+            const uint32_t sa = src[3];                                                     \
+            if (sa == 255) STORE(dst, fc_load_px(src));                                     \
+            else if (sa != 0) STORE(dst, fc_over_px(LOAD(dst), fc_load_px(src), 255u - sa)); \
+        }                                                                                   \
+    }                                                                                       \
+    static void span_blend_straight_##name(uint8_t* dst, const uint8_t* src, int n) {       \
+        for (int i = 0; i < n; ++i, src += 4, dst += (BPP)) {                               \
+            const uint32_t sa = src[3];                                                     \
+            if (sa == 255) STORE(dst, fc_load_px(src));                                     \
+            else if (sa != 0) STORE(dst, fc_lerp_px(LOAD(dst),                              \
+                                         fc_load_px(src) | fc_pack(0, 0, 0, 255),           \
+                                         sa, 255u - sa));                                   \
+        }                                                                                   \
+    }                                                                                       \
+    static void span_mask_##name(uint8_t* dst, const uint8_t* cov, int n,                   \
+                                 uint8_t r, uint8_t g, uint8_t b, uint8_t a) {              \
+        const uint32_t s = fc_pack(r, g, b, a);                                             \
+        for (int i = 0; i < n; ++i, dst += (BPP)) {                                         \
+            if (cov[i] != 0) STORE(dst, fc_mask_px(LOAD(dst), s, cov[i]));                  \
+        }                                                                                   \
+    }                                                                                       \
+    static const fc_span_ops g_span_##name = {                                              \
+        span_fill_##name, span_fill_blend_##name, span_copy_##name, span_blend_##name,      \
+        span_blend_straight_##name, span_mask_##name                                        \
+    };
+
+FC_DEFINE_FORMAT_SPANS(rgb565, 2, fc_load_rgb565, fc_store_rgb565)
+FC_DEFINE_FORMAT_SPANS(a8, 1, fc_load_a8, fc_store_a8)
+
+static uint32_t fc_load_rgb565_px(const uint8_t* p) { return fc_load_rgb565(p); }
+static void fc_store_rgb565_px(uint8_t* p, uint32_t px) { fc_store_rgb565(p, px); }
+static uint32_t fc_load_a8_px(const uint8_t* p) { return fc_load_a8(p); }
+static void fc_store_a8_px(uint8_t* p, uint32_t px) { fc_store_a8(p, px); }
+
+static const fc_format g_formats[] = {
+    { 4, fc_pack_rgba8, NULL, fc_load_rgba8, fc_store_rgba8 },            /* FOSSIL_CUBE_FORMAT_RGBA8 */
+    { 4, fc_pack_bgra8, &g_span_bgra8, fc_load_bgra8, fc_store_bgra8 },   /* FOSSIL_CUBE_FORMAT_BGRA8 */
+    { 2, fc_pack_rgb565, &g_span_rgb565, fc_load_rgb565_px, fc_store_rgb565_px },
+    { 1, fc_pack_a8, &g_span_a8, fc_load_a8_px, fc_store_a8_px }
+};
+
+static inline bool fc_format_valid(fossil_cube_format format) {
+    return (unsigned)format < sizeof(g_formats) / sizeof(g_formats[0]);
+}
+
+static inline const fc_span_ops* fc_spans(const fc_ctx* c) {
+    return c->fmt->spans ? c->fmt->spans : g_ops;
+}
+
+/* Clip rect in effect, unclamped ({0,0,INT_MAX,INT_MAX} when disabled) */
+static inline fc_irect fc_clip_bounds(const fc_ctx* c) {
+    fc_irect b = { 0, 0, INT_MAX, INT_MAX };
+    if (c->clip.enabled) {
+        b.x0 = c->clip.x;
+        b.y0 = c->clip.y;
+        b.x1 = c->clip.x + c->clip.w;
+        b.y1 = c->clip.y + c->clip.h;
+    }
+    return b;
+}
+
+static inline bool fc_irect_intersect(const fc_irect* a, const fc_irect* b, fc_irect* out) {
+    out->x0 = a->x0 > b->x0 ? a->x0 : b->x0;
+    out->y0 = a->y0 > b->y0 ? a->y0 : b->y0;
+    out->x1 = a->x1 < b->x1 ? a->x1 : b->x1;
+    out->y1 = a->y1 < b->y1 ? a->y1 : b->y1;
+    return out->x0 < out->x1 && out->y0 < out->y1;
+}
+
+static inline bool fc_irect_contains(const fc_irect* outer, const fc_irect* inner) {
+    return inner->x0 >= outer->x0 && inner->y0 >= outer->y0 &&
+           inner->x1 <= outer->x1 && inner->y1 <= outer->y1;
+}
+
+/* Drawable area for a clip: the framebuffer intersected with it */
+static inline bool fc_bounds_for(const fc_ctx* c, const fc_irect* clip, fc_irect* out) {
+    const fc_irect fb = { 0, 0, c->w, c->h };
+    return fc_irect_intersect(&fb, clip, out);
 }
 
-int fossil_cube_width(void)  { return g_fc.w; }
-int fossil_cube_height(void) { return g_fc.h; }
+/* Clip a primitive's rect against the drawable area once, up front, so
+   inner loops run over spans with no per-pixel tests. Returns false when
+   nothing is visible. Widened to 64-bit so x + w cannot overflow. */
+static inline bool fc_clip_rect(const fc_irect* b, int x, int y, int w, int h, fc_irect* out) {
+    if (w <= 0 || h <= 0) return false;
+    long long x0 = x, y0 = y;
+    long long x1 = (long long)x + w, y1 = (long long)y + h;
+    if (x0 < b->x0) x0 = b->x0;
+    if (y0 < b->y0) y0 = b->y0;
+    if (x1 > b->x1) x1 = b->x1;
+    if (y1 > b->y1) y1 = b->y1;
+    if (x0 >= x1 || y0 >= y1) return false;
+    out->x0 = (int)x0; out->y0 = (int)y0;
+    out->x1 = (int)x1; out->y1 = (int)y1;
+    return true;
+}
+
+/* Index of the first band of a region ending below row y */
+static inline int fc_region_first(const fossil_cube_region* rg, int y) {
+    int lo = 0, hi = rg->band_count;
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        if (rg->bands[mid].y1 <= y) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Band holding row y, NULL if the row is outside the region */
+static inline const fc_band* fc_region_band(const fossil_cube_region* rg, int y) {
+    const int i = fc_region_first(rg, y);
+    return i < rg->band_count && rg->bands[i].y0 <= y ? &rg->bands[i] : NULL;
+}
+
+static inline uint8_t* fc_px_addr(const fc_ctx* c, int x, int y) {
+    return c->pixels + (size_t)y * (size_t)c->pitch + (size_t)x * (size_t)c->bpp;
+}
+
+/* Cohen-Sutherland outcode against a half-open rect */
+enum { FC_OUT_L = 1, FC_OUT_R = 2, FC_OUT_T = 4, FC_OUT_B = 8 };
+
+static inline int fc_outcode(int x, int y, const fc_irect* b) {
+    int code = 0;
+    if (x < b->x0) code |= FC_OUT_L; else if (x >= b->x1) code |= FC_OUT_R;
+    if (y < b->y0) code |= FC_OUT_T; else if (y >= b->y1) code |= FC_OUT_B;
+    return code;
+}
+
+static inline long long fc_floordiv(long long a, long long b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+static inline long long fc_ceildiv(long long a, long long b) {
+    return -fc_floordiv(-a, b);
+}
+
+/* Range of step indices k in [*k0, *k1] where base + dir*f(k) lies in
+   [lo, hi), for the minor-axis offset f(k) = floor((2mk + M) / 2M) of a
+   Bresenham line (M = major length, m = minor length, m <= M). */
+static void fc_line_minor_range(long long base, int dir, long long lo, long long hi,
+                                long long M, long long m, long long* k0, long long* k1) {
+    /* offsets j with base + dir*j in [lo, hi) */
+    long long jlo, jhi;
+    if (dir > 0) { jlo = lo - base; jhi = hi - 1 - base; }
+    else         { jlo = base - (hi - 1); jhi = base - lo; }
+    /* f(k) only takes values in [0, m]; clamping also bounds the products below */
+    if (jlo < 0) jlo = 0;
+    if (jhi > m) jhi = m;
+    if (jlo > jhi) { *k1 = *k0 - 1; return; }
+    if (m == 0) return;
+    /* f(k) >= jlo  <=>  k >= (2M*jlo - M) / 2m;  f(k) <= jhi  <=>  k < (2M*(jhi+1) - M) / 2m */
+    const long long kmin = fc_ceildiv(2 * M * jlo - M, 2 * m);
+    const long long kmax = fc_ceildiv(2 * M * (jhi + 1) - M, 2 * m) - 1;
+    if (kmin > *k0) *k0 = kmin;
+    if (kmax < *k1) *k1 = kmax;
+}
+
+/* =========================
+   Threads
+   =========================
+   Minimal portable layer for the tile worker pool: pthreads or Win32.
+   Compiled out by FOSSIL_CUBE_NO_THREADS (meson -Dwith_threads=disabled),
+   which keeps the single-threaded executor for embedded builds.
+*/
+
+typedef void (*fc_job_fn)(void* arg, int index, int worker);
+
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+#if defined(_WIN32)
+typedef HANDLE fc_thread;
+typedef CRITICAL_SECTION fc_mutex;
+typedef CONDITION_VARIABLE fc_cond;
+#define fc_mutex_init(m)    InitializeCriticalSection(m)
+#define fc_mutex_destroy(m) DeleteCriticalSection(m)
+#define fc_mutex_lock(m)    EnterCriticalSection(m)
+#define fc_mutex_unlock(m)  LeaveCriticalSection(m)
+#define fc_cond_init(cv)    InitializeConditionVariable(cv)
+#define fc_cond_destroy(cv) ((void)(cv))
+#define fc_cond_wait(cv, m) SleepConditionVariableCS(cv, m, INFINITE)
+#define fc_cond_signal(cv)  WakeConditionVariable(cv)
+#define fc_cond_broadcast(cv) WakeAllConditionVariable(cv)
+static inline long fc_atomic_inc(volatile long* v) { return InterlockedIncrement(v) - 1; }
+
+typedef ULONGLONG fc_deadline;
+
+static inline fc_deadline fc_deadline_in(int ms) { return GetTickCount64() + (ULONGLONG)ms; }
+
+/* One wait for cv; false once the deadline has passed */
+static inline bool fc_cond_wait_until(fc_cond* cv, fc_mutex* m, const fc_deadline* d) {
+    const ULONGLONG now = GetTickCount64();
+    if (now >= *d) return false;
+    SleepConditionVariableCS(cv, m, (DWORD)(*d - now));
+    return true;
+}
+#else
+typedef pthread_t fc_thread;
+typedef pthread_mutex_t fc_mutex;
+typedef pthread_cond_t fc_cond;
+#define fc_mutex_init(m)    pthread_mutex_init(m, NULL)
+#define fc_mutex_destroy(m) pthread_mutex_destroy(m)
+#define fc_mutex_lock(m)    pthread_mutex_lock(m)
+#define fc_mutex_unlock(m)  pthread_mutex_unlock(m)
+#define fc_cond_init(cv)    pthread_cond_init(cv, NULL)
+#define fc_cond_destroy(cv) pthread_cond_destroy(cv)
+#define fc_cond_wait(cv, m) pthread_cond_wait(cv, m)
+#define fc_cond_signal(cv)  pthread_cond_signal(cv)
+#define fc_cond_broadcast(cv) pthread_cond_broadcast(cv)
+static inline long fc_atomic_inc(volatile long* v) { return __atomic_fetch_add(v, 1, __ATOMIC_RELAXED); }
+
+typedef struct timespec fc_deadline;
+
+static inline fc_deadline fc_deadline_in(int ms) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    t.tv_sec += ms / 1000;
+    t.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (t.tv_nsec >= 1000000000L) {
+        ++t.tv_sec;
+        t.tv_nsec -= 1000000000L;
+    }
+    return t;
+}
+
+/* One wait for cv; false once the deadline has passed */
+static inline bool fc_cond_wait_until(fc_cond* cv, fc_mutex* m, const fc_deadline* d) {
+    return pthread_cond_timedwait(cv, m, d) != ETIMEDOUT;
+}
+#endif
+
+/* Kernel selection must not race when contexts are created on many threads */
+#if defined(_WIN32)
+static INIT_ONCE g_simd_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK fc_simd_once_cb(PINIT_ONCE once, PVOID param, PVOID* ctx) {
+    (void)once; (void)param; (void)ctx;
+    fc_simd_select_best();
+    return TRUE;
+}
+
+static void fc_simd_select(void) {
+    InitOnceExecuteOnce(&g_simd_once, fc_simd_once_cb, NULL, NULL);
+}
+#else
+static pthread_once_t g_simd_once = PTHREAD_ONCE_INIT;
+
+static void fc_simd_select(void) {
+    pthread_once(&g_simd_once, fc_simd_select_best);
+}
+#endif
+
+typedef struct fc_pool fc_pool;
+
+typedef struct fc_worker {
+    fc_pool* pool;
+    fc_thread thread;
+    int index; /* 1..nthreads; the caller is worker 0 */
+} fc_worker;
+
+struct fc_pool {
+    int nthreads; /* spawned workers, excluding the calling thread */
+    fc_worker* workers;
+    fc_mutex lock;
+    fc_cond wake;
+    fc_cond done;
+    unsigned generation;
+    int active;
+    bool quit;
+
+    fc_job_fn fn;
+    void* arg;
+    long count;
+    volatile long next;
+};
+
+static void fc_pool_drain(fc_pool* p, int worker) {
+    for (;;) {
+        const long i = fc_atomic_inc(&p->next);
+        if (i >= p->count) break;
+        p->fn(p->arg, (int)i, worker);
+    }
+}
+
+static void fc_worker_loop(fc_worker* w) {
+    fc_pool* p = w->pool;
+    unsigned seen = 0;
+    for (;;) {
+        fc_mutex_lock(&p->lock);
+        while (p->generation == seen && !p->quit) fc_cond_wait(&p->wake, &p->lock);
+        seen = p->generation;
+        const bool quit = p->quit;
+        fc_mutex_unlock(&p->lock);
+        if (quit) return;
+
+        fc_pool_drain(p, w->index);
+
+        fc_mutex_lock(&p->lock);
+        if (--p->active == 0) fc_cond_signal(&p->done);
+        fc_mutex_unlock(&p->lock);
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI fc_worker_main(LPVOID arg) { fc_worker_loop((fc_worker*)arg); return 0; }
+#else
+static void* fc_worker_main(void* arg) { fc_worker_loop((fc_worker*)arg); return NULL; }
+#endif
+
+static void fc_pool_destroy(fc_pool* p) {
+    if (!p) return;
+    fc_mutex_lock(&p->lock);
+    p->quit = true;
+    fc_cond_broadcast(&p->wake);
+    fc_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->nthreads; ++i) {
+#if defined(_WIN32)
+        WaitForSingleObject(p->workers[i].thread, INFINITE);
+        CloseHandle(p->workers[i].thread);
+#else
+        pthread_join(p->workers[i].thread, NULL);
+#endif
+    }
+    fc_cond_destroy(&p->wake);
+    fc_cond_destroy(&p->done);
+    fc_mutex_destroy(&p->lock);
+    free(p->workers);
+    free(p);
+}
+
+/* Pool running jobs on 'threads' threads in total (caller included) */
+static fc_pool* fc_pool_create(int threads) {
+    fc_pool* p = (fc_pool*)calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    p->workers = (fc_worker*)calloc((size_t)threads - 1u, sizeof(fc_worker));
+    if (!p->workers) { free(p); return NULL; }
+    fc_mutex_init(&p->lock);
+    fc_cond_init(&p->wake);
+    fc_cond_init(&p->done);
+    for (int i = 0; i < threads - 1; ++i) {
+        fc_worker* w = &p->workers[i];
+        w->pool = p;
+        w->index = i + 1;
+#if defined(_WIN32)
+        w->thread = CreateThread(NULL, 0, fc_worker_main, w, 0, NULL);
+        const bool ok = w->thread != NULL;
+#else
+        const bool ok = pthread_create(&w->thread, NULL, fc_worker_main, w) == 0;
+#endif
+        if (!ok) break;
+        p->nthreads = i + 1;
+    }
+    if (p->nthreads == 0) { fc_pool_destroy(p); return NULL; }
+    return p;
+}
+
+static int fc_pool_threads(const fc_pool* p) {
+    return p ? p->nthreads + 1 : 1;
+}
+
+/* Run fn(arg, i, worker) for i in [0, count) and wait for all of them */
+static void fc_pool_run(fc_pool* p, fc_job_fn fn, void* arg, int count) {
+    if (!p || count <= 1) {
+        for (int i = 0; i < count; ++i) fn(arg, i, 0);
+        return;
+    }
+    fc_mutex_lock(&p->lock);
+    p->fn = fn;
+    p->arg = arg;
+    p->count = count;
+    p->next = 0;
+    p->active = p->nthreads;
+    p->generation++;
+    fc_cond_broadcast(&p->wake);
+    fc_mutex_unlock(&p->lock);
+
+    fc_pool_drain(p, 0);
+
+    fc_mutex_lock(&p->lock);
+    while (p->active > 0) fc_cond_wait(&p->done, &p->lock);
+    fc_mutex_unlock(&p->lock);
+}
+#else
+typedef struct fc_pool fc_pool;
+
+static bool g_simd_selected = false;
+
+static void fc_simd_select(void) {
+    if (g_simd_selected) return;
+    g_simd_selected = true;
+    fc_simd_select_best();
+}
+
+static void fc_pool_destroy(fc_pool* p) { (void)p; }
+static int fc_pool_threads(const fc_pool* p) { (void)p; return 1; }
+
+static void fc_pool_run(fc_pool* p, fc_job_fn fn, void* arg, int count) {
+    (void)p;
+    for (int i = 0; i < count; ++i) fn(arg, i, 0);
+}
+#endif /* FOSSIL_CUBE_NO_THREADS */
+
+/* =========================
+   Paint shaders
+   =========================
+   A paint is evaluated a span at a time into premultiplied RGBA8, which
+   then goes through the format's copy (opaque paints) or blend kernel,
+   or is scaled by coverage first for shapes. Every pixel's value
+   depends only on its position, so tiles and chunks of any size give
+   the same bytes.
+   - linear: t is exact integer arithmetic, looked up FC_RAMP_BLOCK
+     pixels at a time through g_ramp; dtx is at most FC_RAMP_ONE, so a
+     block start reduced into [-2^30, 2^30] (pad) or modulo the reflect
+     period keeps every lane in int32 and picks the same entries
+   - radial: one sqrtf per pixel
+   - pattern: row segments copied out of the image
+*/
+
+enum { FC_PAINT_SPAN = 256, FC_RAMP_BLOCK = 64 };
+
+static inline bool fc_paint_opaque(const fossil_cube_paint* p) {
+    if (p->kind == FC_PAINT_PATTERN) return p->image->opaque_rows == p->image->h;
+    return p->opaque;
+}
+
+static inline int32_t fc_ramp_reduce(int64_t t, int extend) {
+    if (extend == FOSSIL_CUBE_EXTEND_PAD) {
+        const int64_t lim = (int64_t)1 << 30;
+        return (int32_t)(t < -lim ? -lim : t > lim ? lim : t);
+    }
+    return (int32_t)((uint64_t)t & (2u * FC_RAMP_ONE - 1u));
+}
+
+static inline int fc_wrap(long long v, int n) {
+    const long long m = v % n;
+    return (int)(m < 0 ? m + n : m);
+}
+
+/* n pixels of the paint starting at pixel (x, y) */
+static void fc_paint_span(const fossil_cube_paint* p, int x, int y, int n, uint32_t* out) {
+    switch ((fc_paint_kind)p->kind) {
+    case FC_PAINT_LINEAR:
+        for (int i = 0; i < n; i += FC_RAMP_BLOCK) {
+            const int k = n - i < FC_RAMP_BLOCK ? n - i : FC_RAMP_BLOCK;
+            const int64_t t = p->t0 + (int64_t)(x + i) * p->dtx + (int64_t)y * p->dty;
+            g_ramp(out + i, k, fc_ramp_reduce(t, p->extend), (int32_t)p->dtx, p->ramp, p->extend);
+        }
+        break;
+    case FC_PAINT_RADIAL: {
+        const float dy = (float)y + 0.5f - p->cy;
+        const float dy2 = dy * dy;
+        for (int i = 0; i < n; ++i) {
+            const float dx = (float)(x + i) + 0.5f - p->cx;
+            const float d = sqrtf(dx * dx + dy2) * p->scale;
+            const int32_t t = d < 1073741824.0f ? (int32_t)d : 1073741824;
+            out[i] = p->ramp[fc_ramp_index(t, p->extend)];
+        }
+        break;
+    }
+    case FC_PAINT_PATTERN: {
+        const fossil_cube_image* img = p->image;
+        const uint8_t* row = img->pixels + (size_t)fc_wrap((long long)y - p->oy, img->h) * (size_t)img->pitch;
+        int u = fc_wrap((long long)x - p->ox, img->w);
+        for (int i = 0; i < n;) {
+            const int k = n - i < img->w - u ? n - i : img->w - u;
+            memcpy(out + i, row + (size_t)u * 4u, (size_t)k * 4u);
+            i += k;
+            u = 0;
+        }
+        break;
+    }
+    }
+}
+
+/* Premultiplied pixels scaled by coverage, as fc_mask_px scales a color */
+static void fc_paint_coverage(uint32_t* px, const uint8_t* cov, int n) {
+    for (int i = 0; i < n; ++i) {
+        const uint32_t s = px[i], m = cov[i];
+        if (m == 255) continue;
+        px[i] = fc_div255x2((s & FC_LANES) * m) | (fc_div255x2(((s >> 8) & FC_LANES) * m) << 8);
+    }
+}
+
+/* =========================
+   Rasterizers
+   =========================
+   Execute one primitive against explicit drawable bounds (already
+   intersected with the framebuffer). Shared by immediate calls and the
+   command buffer executor.
+*/
+
+/* Clears of at least FC_STREAM_MIN bytes use the streaming fill, and with
+   a pool they are split into bands of at least FC_CLEAR_BAND bytes. Both
+   are far above a 64x64 tile, so a clear running inside a tile job never
+   starts a nested pool run. */
+enum {
+    FC_STREAM_MIN = 2 << 20,
+    FC_CLEAR_BAND = 512 << 10
+};
+
+typedef struct fc_clear_job {
+    const fc_span_ops* ops;
+    uint8_t* row;    /* first row */
+    ptrdiff_t pitch;
+    int rows, band;  /* total rows, rows per job */
+    int n;           /* pixels per row */
+    size_t len;      /* bytes per row */
+    uint32_t px;     /* native fill pattern */
+    uint32_t word;   /* px repeated over 4 bytes, for the streaming fill */
+    bool stream;
+} fc_clear_job;
+
+static void fc_clear_band(void* arg, int index, int worker) {
+    const fc_clear_job* j = (const fc_clear_job*)arg;
+    (void)worker;
+    const int y0 = index * j->band;
+    const int rows = j->rows - y0 < j->band ? j->rows - y0 : j->band;
+    uint8_t* row = j->row + (ptrdiff_t)y0 * j->pitch;
+    if (j->stream) {
+        g_stream(row, j->pitch, rows, j->len, j->word);
+        return;
+    }
+    for (int y = 0; y < rows; ++y, row += j->pitch) j->ops->fill(row, j->n, j->px);
+}
+
+static void fc_raster_clear(fc_ctx* c, const fc_irect* b, uint32_t px) {
+    /* Fast clear: fill the native pattern row by row */
+    fc_clear_job j;
+    j.ops = fc_spans(c);
+    j.row = fc_px_addr(c, b->x0, b->y0);
+    j.pitch = c->pitch;
+    j.rows = b->y1 - b->y0;
+    j.band = j.rows;
+    j.n = b->x1 - b->x0;
+    j.len = (size_t)j.n * (size_t)c->bpp;
+    j.px = px;
+    j.word = c->bpp == 4 ? px : c->bpp == 2 ? (px & 0xFFFFu) * 0x10001u : (px & 0xFFu) * 0x01010101u;
+    const size_t bytes = j.len * (size_t)j.rows;
+    /* the pattern lines up with 4-byte addresses only if every row starts
+       on a whole pixel */
+    j.stream = g_stream && bytes >= FC_STREAM_MIN && (uintptr_t)j.row % (uintptr_t)c->bpp == 0 &&
+               j.pitch % c->bpp == 0;
+
+    int count = 1;
+    const int threads = fc_pool_threads(c->pool);
+    if (threads > 1 && bytes >= 2u * FC_CLEAR_BAND) {
+        size_t jobs = bytes / FC_CLEAR_BAND;
+        if (jobs > (size_t)threads) jobs = (size_t)threads;
+        j.band = (int)(((size_t)j.rows + jobs - 1u) / jobs);
+        count = (j.rows + j.band - 1) / j.band;
+    }
+    fc_pool_run(c->pool, fc_clear_band, &j, count);
+}
+
+static void fc_raster_pixel(fc_ctx* c, const fc_irect* b, int x, int y,
+                            uint8_t r, uint8_t g, uint8_t bl, uint8_t a) {
+    if (x < b->x0 || y < b->y0 || x >= b->x1 || y >= b->y1) return;
+    uint8_t* p = fc_px_addr(c, x, y);
+    if (c->format == FOSSIL_CUBE_FORMAT_RGBA8) {
+        if (a == 255) {
+            p[0] = r; p[1] = g; p[2] = bl; p[3] = 255;
+        } else if (a != 0) {
+            blend_rgba_over(p, r, g, bl, a);
+        }
+    } else if (a == 255) {
+        fc_spans(c)->fill(p, 1, c->fmt->pack(r, g, bl, 255));
+    } else if (a != 0) {
+        fc_spans(c)->fill_blend(p, 1, r, g, bl, a);
+    }
+}
+
+/* One-pixel-wide fill (vertical lines, rect outlines) on 4-byte formats:
+   a single strided loop with 32-bit stores instead of a span call per
+   row. Same fc_over_px math as the span kernels. */
+static void fc_fill_column(fc_ctx* c, uint8_t* p, int h, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const ptrdiff_t pitch = c->pitch;
+    if (a == 255) {
+        const uint32_t px = c->fmt->pack(r, g, b, 255);
+        for (int i = 0; i < h; ++i, p += pitch) memcpy(p, &px, 4);
+        return;
+    }
+    if (c->format == FOSSIL_CUBE_FORMAT_BGRA8) { const uint8_t t = r; r = b; b = t; }
+    const uint32_t s = fc_pack(r, g, b, a);
+    const uint32_t inv = 255u - a;
+    for (int i = 0; i < h; ++i, p += pitch) fc_store_px(p, fc_over_px(fc_load_px(p), s, inv));
+}
+
+static void fc_raster_fill(fc_ctx* c, const fc_irect* b, int x, int y, int w, int h,
+                           uint8_t r, uint8_t g, uint8_t bl, uint8_t a) {
+    fc_irect rc;
+    if (a == 0 || !fc_clip_rect(b, x, y, w, h, &rc)) return;
+
+    const fc_span_ops* ops = fc_spans(c);
+    const int n = rc.x1 - rc.x0;
+    uint8_t* row = fc_px_addr(c, rc.x0, rc.y0);
+    if (n == 1 && c->bpp == 4) {
+        fc_fill_column(c, row, rc.y1 - rc.y0, r, g, bl, a);
+        return;
+    }
+    if (a == 255) {
+        const uint32_t px = c->fmt->pack(r, g, bl, 255);
+        for (int yy = rc.y0; yy < rc.y1; ++yy, row += c->pitch) ops->fill(row, n, px);
+    } else {
+        for (int yy = rc.y0; yy < rc.y1; ++yy, row += c->pitch) ops->fill_blend(row, n, r, g, bl, a);
+    }
+}
+
+/* Bresenham line, clipped before stepping: the visible range of steps is
+   solved exactly on both axes, so the loop runs with no per-pixel checks
+   and lines wholly outside the drawable area are rejected up front.
+   Returns the number of pixels drawn. */
+static uint64_t fc_raster_line(fc_ctx* c, const fc_irect* bounds, int x0, int y0, int x1, int y1,
+                               uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (a == 0) return 0;
+    const int c0 = fc_outcode(x0, y0, bounds);
+    const int c1 = fc_outcode(x1, y1, bounds);
+    if (c0 & c1) return 0; /* trivially outside */
+
+    const long long dx = (x1 > x0) ? ((long long)x1 - x0) : ((long long)x0 - x1);
+    const long long dy = (y1 > y0) ? ((long long)y1 - y0) : ((long long)y0 - y1);
+    const int sx = (x0 < x1) ? 1 : -1;
+    const int sy = (y0 < y1) ? 1 : -1;
+    const bool xmajor = dx >= dy;
+    const long long M = xmajor ? dx : dy;
+    const long long m = xmajor ? dy : dx;
+    if (M > INT_MAX) return 0; /* keeps the exact step math inside 64 bits */
+
+    long long k0 = 0, k1 = M;
+    if (c0 | c1) {
+        if (xmajor) {
+            fc_line_minor_range(x0, sx, bounds->x0, bounds->x1, M, M, &k0, &k1);
+            fc_line_minor_range(y0, sy, bounds->y0, bounds->y1, M, m, &k0, &k1);
+        } else {
+            fc_line_minor_range(y0, sy, bounds->y0, bounds->y1, M, M, &k0, &k1);
+            fc_line_minor_range(x0, sx, bounds->x0, bounds->x1, M, m, &k0, &k1);
+        }
+        if (k0 > k1) return 0;
+    }
+
+    /* jump to step k0: minor offset j = floor((2m*k0 + M) / 2M) */
+    const long long two_m = 2 * m;
+    const long long two_M = (M > 0) ? 2 * M : 1;
+    long long num = two_m * k0 + M;
+    const long long j = num / two_M;
+    num -= j * two_M;
+
+    const long long px = xmajor ? x0 + sx * k0 : x0 + sx * j;
+    const long long py = xmajor ? y0 + sy * j : y0 + sy * k0;
+    uint8_t* p = fc_px_addr(c, (int)px, (int)py);
+    const ptrdiff_t step_x = (ptrdiff_t)sx * c->bpp;
+    const ptrdiff_t step_y = (ptrdiff_t)sy * c->pitch;
+    const ptrdiff_t step_major = xmajor ? step_x : step_y;
+    const ptrdiff_t step_minor = xmajor ? step_y : step_x;
+    const uint32_t color = c->fmt->pack(r, g, b, 255);
+
+    if (c->bpp == 4) {
+        /* 4-byte formats blend inline; BGRA8 just swaps the color once */
+        if (c->format == FOSSIL_CUBE_FORMAT_BGRA8) { const uint8_t t = r; r = b; b = t; }
+        for (long long k = k0;; ++k) {
+            if (a == 255) memcpy(p, &color, 4);
+            else blend_rgba_over(p, r, g, b, a);
+            if (k == k1) break;
+            p += step_major;
+            num += two_m;
+            if (num >= two_M) { num -= two_M; p += step_minor; }
+        }
+        return (uint64_t)(k1 - k0 + 1);
+    }
+    const fc_span_ops* ops = fc_spans(c);
+    for (long long k = k0;; ++k) {
+        if (a == 255) ops->fill(p, 1, color);
+        else ops->fill_blend(p, 1, r, g, b, a);
+        if (k == k1) break;
+        p += step_major;
+        num += two_m;
+        if (num >= two_M) { num -= two_M; p += step_minor; }
+    }
+    return (uint64_t)(k1 - k0 + 1);
+}
+
+static void fc_raster_blit(fc_ctx* c, const fc_irect* b, int dst_x, int dst_y,
+                           const uint8_t* src, int src_w, int src_h, int src_pitch,
+                           fossil_cube_alpha alpha) {
+    fc_irect rc;
+    if (!fc_clip_rect(b, dst_x, dst_y, src_w, src_h, &rc)) return;
+    const fc_span_ops* ops = fc_spans(c);
+    void (*blend)(uint8_t*, const uint8_t*, int) =
+        alpha == FOSSIL_CUBE_ALPHA_PREMULTIPLIED ? ops->blend : ops->blend_straight;
+
+    const int n = rc.x1 - rc.x0;
+    const uint8_t* srow = src + (size_t)(rc.y0 - dst_y) * (size_t)src_pitch
+                              + (size_t)(rc.x0 - dst_x) * 4u;
+    uint8_t* drow = fc_px_addr(c, rc.x0, rc.y0);
+    for (int y = rc.y0; y < rc.y1; ++y, srow += src_pitch, drow += c->pitch) {
+        blend(drow, srow, n);
+    }
+}
+
+/* A8 coverage tinted with a premultiplied color */
+static void fc_raster_mask(fc_ctx* c, const fc_irect* b, int dst_x, int dst_y,
+                           const uint8_t* cov, int w, int h, int pitch,
+                           uint8_t r, uint8_t g, uint8_t bl, uint8_t a) {
+    fc_irect rc;
+    if (!fc_clip_rect(b, dst_x, dst_y, w, h, &rc)) return;
+    const fc_span_ops* ops = fc_spans(c);
+    const int n = rc.x1 - rc.x0;
+    const uint8_t* srow = cov + (size_t)(rc.y0 - dst_y) * (size_t)pitch + (size_t)(rc.x0 - dst_x);
+    uint8_t* drow = fc_px_addr(c, rc.x0, rc.y0);
+    for (int y = rc.y0; y < rc.y1; ++y, srow += pitch, drow += c->pitch) {
+        ops->mask(drow, srow, n, r, g, bl, a);
+    }
+}
+
+enum { FC_SCALE_STRIP = 256 };
+
+/* Source tap for dst pixel i of n covering s source pixels. Centers map
+   as u = (i + 0.5) * s / n - 0.5; nearest is floor(u + 0.5), bilinear
+   the pair at floor(u) with frac(u) in 1/256, both clamped to [0, s).
+   All integer: (2i + 1) * s < 2^63 for i < n <= INT_MAX. */
+static inline int fc_scale_nearest(long long i, int n, int s) {
+    const unsigned long long q = (unsigned long long)(2 * i + 1) * (unsigned long long)s;
+    const unsigned long long v = q / (2ull * (unsigned long long)n);
+    return v >= (unsigned long long)s ? s - 1 : (int)v;
+}
+
+static inline void fc_scale_linear(long long i, int n, int s, int* t0, int* t1, uint8_t* f) {
+    const long long num = (long long)((unsigned long long)(2 * i + 1) * (unsigned long long)s) - n;
+    const long long den = 2ll * n;
+    *t0 = *t1 = 0;
+    *f = 0;
+    if (num <= 0) return;
+    const long long v = num / den;
+    if (v >= s - 1) { *t0 = *t1 = s - 1; return; }
+    *t0 = (int)v;
+    *t1 = (int)v + 1;
+    *f = (uint8_t)(((num % den) * 256) / den);
+}
+
+/* Stretch src over the dst rect. The clipped rect is walked in strips of
+   FC_SCALE_STRIP columns: per strip the source column of every dst column
+   is worked out once, then each row is resampled into a stack buffer and
+   blended by the span kernels. Consecutive rows that sample the same
+   source rows reuse the buffer. */
+static void fc_raster_scaled(fc_ctx* c, const fc_irect* b, int dst_x, int dst_y, int dst_w, int dst_h,
+                             const uint8_t* src, int src_w, int src_h, int src_pitch,
+                             fossil_cube_alpha alpha, fossil_cube_filter filter) {
+    fc_irect rc;
+    if (!fc_clip_rect(b, dst_x, dst_y, dst_w, dst_h, &rc)) return;
+    const fc_span_ops* ops = fc_spans(c);
+    const bool bilinear = filter == FOSSIL_CUBE_FILTER_BILINEAR;
+    const bool straight = alpha != FOSSIL_CUBE_ALPHA_PREMULTIPLIED;
+    /* nearest taps stay in the source's alpha mode, bilinear output is premultiplied */
+    void (*blend)(uint8_t*, const uint8_t*, int) =
+        straight && !bilinear ? ops->blend_straight : ops->blend;
+
+    uint32_t strip[FC_SCALE_STRIP];
+    uint8_t* buf = (uint8_t*)strip;
+    int32_t x0[FC_SCALE_STRIP], x1[FC_SCALE_STRIP];
+    uint8_t fx[FC_SCALE_STRIP];
+
+    for (int sx = rc.x0; sx < rc.x1; sx += FC_SCALE_STRIP) {
+        const int n = rc.x1 - sx < FC_SCALE_STRIP ? rc.x1 - sx : FC_SCALE_STRIP;
+        for (int i = 0; i < n; ++i) {
+            const long long di = (long long)sx + i - dst_x;
+            if (bilinear) {
+                int t0, t1;
+                fc_scale_linear(di, dst_w, src_w, &t0, &t1, &fx[i]);
+                x0[i] = t0 * 4;
+                x1[i] = t1 * 4;
+            } else {
+                x0[i] = fc_scale_nearest(di, dst_w, src_w) * 4;
+            }
+        }
+
+        int last0 = -1, last1 = -1;
+        uint8_t lastf = 0;
+        uint8_t* drow = fc_px_addr(c, sx, rc.y0);
+        for (int y = rc.y0; y < rc.y1; ++y, drow += c->pitch) {
+            const long long dj = (long long)y - dst_y;
+            int v0, v1 = 0;
+            uint8_t fy = 0;
+            if (bilinear) fc_scale_linear(dj, dst_h, src_h, &v0, &v1, &fy);
+            else v0 = fc_scale_nearest(dj, dst_h, src_h);
+            if (v0 != last0 || v1 != last1 || fy != lastf) {
+                const uint8_t* r0 = src + (size_t)v0 * (size_t)src_pitch;
+                if (bilinear) {
+                    g_bilerp(buf, r0, src + (size_t)v1 * (size_t)src_pitch, x0, x1, fx, n, fy, straight);
+                } else {
+                    for (int i = 0; i < n; ++i) memcpy(buf + (size_t)i * 4u, r0 + x0[i], 4);
+                }
+                last0 = v0; last1 = v1; lastf = fy;
+            }
+            blend(drow, buf, n);
+        }
+    }
+}
+
+/* =========================
+   Coverage rasterizer
+   =========================
+   Anti-aliased shapes are flattened to line edges and rasterized by
+   signed-area accumulation (the stb_truetype / font-rs scheme): per row,
+   every edge deposits the area it sweeps into a row of cells, and the
+   running sum along the row is each pixel's coverage. |sum| is clamped
+   to 1, so same-direction contours that overlap saturate instead of
+   cancelling (nonzero fill).
+
+   Deposits are 16.16 fixed point and each row slice of an edge deposits
+   exactly its signed height, so sums are exact and order-free: a row is
+   walked in chunks of FC_AA_CHUNK cells, the first chunk folds everything
+   to its left into one carry cell and later chunks inherit the running
+   sum. Any split into chunks or tiles gives the same bytes. Coverage
+   rows go through the span mask kernel.
+*/
+
+enum { FC_AA_CHUNK = 256, FC_AA_ROWS = 16, FC_AA_MAX_BINS = 4096 };
+
+#define FC_AA_ONE 65536
+
+/* Cells are summed modulo 2^32; only the final running sum is read as
+   signed, which is exact for any realistic winding count */
+typedef struct fc_aa_row {
+    uint32_t* cells; /* [0] carry, [1 + k] column cx0 + k */
+    int* lo; int* hi; /* touched cells [lo, hi], lo > hi while untouched */
+    int cx0, n;       /* chunk columns [cx0, cx0 + n); deposits past it drop */
+    bool fold;       /* first chunk: deposits left of cx0 go to the carry */
+} fc_aa_row;
+
+static inline void fc_aa_touch(const fc_aa_row* row, int j0, int j1) {
+    if (j0 < *row->lo) *row->lo = j0;
+    if (j1 > *row->hi) *row->hi = j1;
+}
+
+/* floor/ceil/round without libm calls; shape coordinates are clamped to
+   +-2^24 so the int conversions are in range */
+static inline int fc_floori(float v) {
+    const int i = (int)v;
+    return i - ((float)i > v);
+}
+
+static inline int fc_ceili(float v) {
+    const int i = (int)v;
+    return i + ((float)i < v);
+}
+
+static inline int32_t fc_aa_fix(float v) {
+    const float f = v * (float)FC_AA_ONE;
+    return (int32_t)(f < 0.0f ? f - 0.5f : f + 0.5f);
+}
+
+static inline void fc_aa_put(const fc_aa_row* row, int x, int32_t v) {
+    const int k = x - row->cx0;
+    if (k < 0) {
+        if (row->fold) row->cells[0] += (uint32_t)v;
+    } else if (k < row->n) {
+        row->cells[k + 1] += (uint32_t)v;
+        fc_aa_touch(row, k + 1, k + 1);
+    }
+}
+
+/* v into every column of [x0, x1) */
+static inline void fc_aa_run(const fc_aa_row* row, int x0, int x1, int32_t v) {
+    if (x0 >= x1) return;
+    if (x0 < row->cx0) {
+        const int left = (x1 < row->cx0 ? x1 : row->cx0) - x0;
+        if (row->fold) row->cells[0] += (uint32_t)v * (uint32_t)left;
+        x0 = row->cx0;
+    }
+    const int end = x1 < row->cx0 + row->n ? x1 : row->cx0 + row->n;
+    if (x0 >= end) return;
+    for (int x = x0; x < end; ++x) row->cells[x - row->cx0 + 1] += (uint32_t)v;
+    fc_aa_touch(row, x0 - row->cx0 + 1, end - row->cx0);
+}
+
+/* One row slice of an edge, from xa at its top to xb at its bottom, with
+   signed height d (dfix in fixed point). The last cell takes whatever the
+   others left of dfix, so the slice sums to dfix exactly. */
+static void fc_aa_deposit(const fc_aa_row* row, float xa, float xb, float d, int32_t dfix) {
+    const float x0 = xa < xb ? xa : xb;
+    const float x1 = xa < xb ? xb : xa;
+    const int x0i = fc_floori(x0);
+    const float x0f = (float)x0i;
+    const int x1i = fc_ceili(x1);
+    if (x1i <= x0i + 1) {
+        const int32_t v = fc_aa_fix(d - d * (0.5f * (xa + xb) - x0f));
+        fc_aa_put(row, x0i, v);
+        fc_aa_put(row, x0i + 1, dfix - v);
+        return;
+    }
+    const float sl = 1.0f / (x1 - x0);
+    const float f0 = x0 - x0f;
+    const float a0 = 0.5f * sl * (1.0f - f0) * (1.0f - f0);
+    const float f1 = x1 - (float)x1i + 1.0f;
+    const float am = 0.5f * sl * f1 * f1;
+    uint32_t sum = (uint32_t)fc_aa_fix(d * a0);
+    fc_aa_put(row, x0i, (int32_t)sum);
+    if (x1i == x0i + 2) {
+        const int32_t v = fc_aa_fix(d * (1.0f - a0 - am));
+        fc_aa_put(row, x0i + 1, v);
+        sum += (uint32_t)v;
+    } else {
+        const float a1 = sl * (1.5f - f0);
+        const int32_t v1 = fc_aa_fix(d * (a1 - a0));
+        const int32_t vs = fc_aa_fix(d * sl);
+        const float a2 = a1 + (float)(x1i - x0i - 3) * sl;
+        const int32_t v2 = fc_aa_fix(d * (1.0f - a2 - am));
+        fc_aa_put(row, x0i + 1, v1);
+        fc_aa_run(row, x0i + 2, x1i - 1, vs);
+        fc_aa_put(row, x1i - 1, v2);
+        sum += (uint32_t)v1 + (uint32_t)vs * (uint32_t)(x1i - x0i - 3) + (uint32_t)v2;
+    }
+    fc_aa_put(row, x1i, (int32_t)((uint32_t)dfix - sum));
+}
+
+/* Rows [ya, yb) of one edge into the chunk at cx0 */
+static void fc_aa_edge(uint32_t (*acc)[FC_AA_CHUNK + 1], int* lo, int* hi,
+                       int ya, int yb, int cx0, int n, bool fold, const fc_edge* e) {
+    if (e->xmin >= (float)(cx0 + n)) return; /* every cell right of the chunk */
+    /* every cell left of the chunk: only the carry sees it */
+    const bool left = e->xmax + 1.0f < (float)cx0;
+    if (left && !fold) return;
+    const int e0 = fc_floori(e->y0), e1 = fc_ceili(e->y1);
+    const int r0 = e0 > ya ? e0 : ya;
+    const int r1 = e1 < yb ? e1 : yb;
+    const float dxdy = (e->x1 - e->x0) / (e->y1 - e->y0);
+    for (int y = r0; y < r1; ++y) {
+        const float t0 = (float)y > e->y0 ? (float)y : e->y0;
+        const float t1 = (float)(y + 1) < e->y1 ? (float)(y + 1) : e->y1;
+        if (t1 <= t0) continue;
+        const float d = (t1 - t0) * e->dir;
+        const int32_t dfix = fc_aa_fix(d);
+        if (left) { acc[y - ya][0] += (uint32_t)dfix; continue; }
+        /* x at both ends straight from the edge, never stepped, so any
+           grouping of rows gives the same deposits */
+        const fc_aa_row row = { acc[y - ya], &lo[y - ya], &hi[y - ya], cx0, n, fold };
+        fc_aa_deposit(&row, e->x0 + (t0 - e->y0) * dxdy, e->x0 + (t1 - e->y0) * dxdy, d, dfix);
+    }
+}
+
+static inline uint8_t fc_aa_cov(uint32_t sum) {
+    const int64_t s = (int32_t)sum;
+    const int64_t v = s < 0 ? -s : s;
+    return v >= FC_AA_ONE ? 255 : (uint8_t)((v * 255 + FC_AA_ONE / 2) >> 16);
+}
+
+/* Painted coverage: the shaded span scaled by coverage, then blended */
+static void fc_aa_emit_paint(fc_ctx* c, const fc_span_ops* ops, int x, int y, const uint8_t* cov, int n,
+                             const fossil_cube_paint* paint) {
+    uint32_t buf[FC_AA_CHUNK];
+    fc_paint_span(paint, x, y, n, buf);
+    fc_paint_coverage(buf, cov, n);
+    ops->blend(fc_px_addr(c, x, y), (const uint8_t*)buf, n);
+}
+
+static inline void fc_aa_emit_run(fc_ctx* c, const fc_span_ops* ops, int x, int y, const uint8_t* cov,
+                                  int n, const uint8_t* k, const fossil_cube_paint* paint) {
+    if (paint) fc_aa_emit_paint(c, ops, x, y, cov, n, paint);
+    else ops->mask(fc_px_addr(c, x, y), cov, n, k[0], k[1], k[2], k[3]);
+}
+
+/* Tint (or paint) coverage [x0, x1) of a row, trimmed of zero coverage
+   at both ends and cut to the region's spans on the row; returns the
+   pixels handed to the kernel */
+static inline int fc_aa_emit(fc_ctx* c, const fc_span_ops* ops, int cx0, int y, const uint8_t* cov,
+                             int x0, int x1, const uint8_t* k, const fossil_cube_paint* paint,
+                             const fossil_cube_region* rg) {
+    while (x0 < x1 && cov[x0] == 0) ++x0;
+    while (x1 > x0 && cov[x1 - 1] == 0) --x1;
+    if (x0 >= x1) return 0;
+    if (!rg) {
+        fc_aa_emit_run(c, ops, cx0 + x0, y, cov + x0, x1 - x0, k, paint);
+        return x1 - x0;
+    }
+    const fc_band* band = fc_region_band(rg, y);
+    int px = 0;
+    for (int j = band ? band->first : 0; band && j < band->first + band->count; ++j) {
+        const int a = rg->spans[j].x0 - cx0 > x0 ? rg->spans[j].x0 - cx0 : x0;
+        const int e = rg->spans[j].x1 - cx0 < x1 ? rg->spans[j].x1 - cx0 : x1;
+        if (a >= e) continue;
+        fc_aa_emit_run(c, ops, cx0 + a, y, cov + a, e - a, k, paint);
+        px += e - a;
+    }
+    return px;
+}
+
+static uint64_t fc_raster_path(fc_ctx* c, const fc_irect* b, const fc_path* path, const uint8_t* k,
+                               const fossil_cube_region* rg) {
+    fc_irect rc;
+    if (!fc_irect_intersect(&path->box, b, &rc)) return 0;
+    if (rg && !fc_irect_intersect(&rc, &rg->bounds, &rc)) return 0;
+    uint64_t px = 0;
+    const fc_span_ops* ops = fc_spans(c);
+    const fossil_cube_paint* paint = path->paint;
+    /* cells are zeroed once and cleared again after each use, over the
+       touched range only */
+    uint32_t acc[FC_AA_ROWS][FC_AA_CHUNK + 1];
+    uint32_t carry[FC_AA_ROWS];
+    int lo[FC_AA_ROWS], hi[FC_AA_ROWS];
+    uint8_t cov[FC_AA_CHUNK];
+    const int rows = rc.y1 - rc.y0 < FC_AA_ROWS ? rc.y1 - rc.y0 : FC_AA_ROWS;
+    const int cols = rc.x1 - rc.x0 < FC_AA_CHUNK ? rc.x1 - rc.x0 : FC_AA_CHUNK;
+    for (int i = 0; i < rows; ++i) memset(acc[i], 0, sizeof(uint32_t) * (size_t)(cols + 1));
+
+    for (int ya = rc.y0; ya < rc.y1;) {
+        const int band_end = ya - ya % FC_AA_ROWS + FC_AA_ROWS;
+        const int yb = band_end < rc.y1 ? band_end : rc.y1;
+        const int bin = ya / path->bin_h - path->bin0;
+        const uint32_t* ref0 = path->refs + path->bin_off[bin];
+        const uint32_t* ref1 = path->refs + path->bin_off[bin + 1];
+        for (int y = ya; y < yb; ++y) carry[y - ya] = 0;
+        for (int cx0 = rc.x0; cx0 < rc.x1; cx0 += FC_AA_CHUNK) {
+            const bool fold = cx0 == rc.x0;
+            const int n = rc.x1 - cx0 < FC_AA_CHUNK ? rc.x1 - cx0 : FC_AA_CHUNK;
+            for (int y = ya; y < yb; ++y) {
+                acc[y - ya][0] = carry[y - ya];
+                lo[y - ya] = FC_AA_CHUNK + 1;
+                hi[y - ya] = 0;
+            }
+            for (const uint32_t* i = ref0; i < ref1; ++i) {
+                fc_aa_edge(acc, lo, hi, ya, yb, cx0, n, fold, &path->edges[*i]);
+            }
+            for (int y = ya; y < yb; ++y) {
+                uint32_t* cells = acc[y - ya];
+                uint32_t sum = cells[0];
+                /* columns before the first touched cell see only the carry,
+                   columns after the last one the full sum */
+                const int xa = lo[y - ya] - 1 < n ? lo[y - ya] - 1 : n;
+                const int xb = hi[y - ya];
+                const uint8_t c0 = fc_aa_cov(sum);
+                if (c0 && xa > 0) { memset(cov, c0, (size_t)xa); px += (uint64_t)fc_aa_emit(c, ops, cx0, y, cov, 0, xa, k, paint, rg); }
+                /* coverage only changes at nonzero cells; gaps of 8 or more
+                   uncovered columns split the span. Uncovered columns up to
+                   the next nonzero cell are passed in one step, zeroed only
+                   while they may still join the open span. */
+                uint8_t cur = c0;
+                int run = -1, last = -1;
+                for (int x = xa; x < xb; ++x) {
+                    if (cur == 0) {
+                        int nx = x;
+                        while (nx < xb && cells[nx + 1] == 0) ++nx;
+                        if (run >= 0 && nx - 1 - last >= 8) {
+                            px += (uint64_t)fc_aa_emit(c, ops, cx0, y, cov, run, last + 1, k, paint, rg);
+                            run = -1;
+                        } else if (run >= 0) {
+                            memset(cov + x, 0, (size_t)(nx - x));
+                        }
+                        x = nx;
+                        if (x == xb) break;
+                    }
+                    if (cells[x + 1]) { sum += cells[x + 1]; cur = fc_aa_cov(sum); }
+                    cov[x] = cur;
+                    if (cur) {
+                        if (run < 0) run = x;
+                        last = x;
+                    } else if (run >= 0 && x - last >= 8) {
+                        px += (uint64_t)fc_aa_emit(c, ops, cx0, y, cov, run, last + 1, k, paint, rg);
+                        run = -1;
+                    }
+                }
+                if (run >= 0) px += (uint64_t)fc_aa_emit(c, ops, cx0, y, cov, run, last + 1, k, paint, rg);
+                const int from = xb > xa ? xb : xa;
+                const uint8_t c1 = fc_aa_cov(sum);
+                if (c1 && from < n) {
+                    memset(cov + from, c1, (size_t)(n - from));
+                    px += (uint64_t)fc_aa_emit(c, ops, cx0, y, cov, from, n, k, paint, rg);
+                }
+                carry[y - ya] = sum;
+                cells[0] = 0;
+                if (lo[y - ya] <= hi[y - ya]) {
+                    memset(cells + lo[y - ya], 0, sizeof(uint32_t) * (size_t)(hi[y - ya] - lo[y - ya] + 1));
+                }
+            }
+        }
+        ya = yb;
+    }
+    return px;
+}
+
+/* Image sub-rect: per row only the runs inside [u0,u1) are touched;
+   opaque runs are copied, the rest blended (pixel counts added to
+   *copied and *blended) */
+static void fc_raster_image(fc_ctx* c, const fc_irect* b, const fossil_cube_image* img,
+                            int src_x, int src_y, int dst_x, int dst_y, int w, int h,
+                            uint64_t* copied, uint64_t* blended) {
+    fc_irect rc;
+    if (!fc_clip_rect(b, dst_x, dst_y, w, h, &rc)) return;
+    const fc_span_ops* ops = fc_spans(c);
+    const int u0 = src_x + (rc.x0 - dst_x), u1 = u0 + (rc.x1 - rc.x0);
+    const int du = dst_x - src_x; /* dst x of source column u is u + du */
+    uint8_t* drow = c->pixels + (size_t)rc.y0 * (size_t)c->pitch;
+    for (int y = rc.y0; y < rc.y1; ++y, drow += c->pitch) {
+        const int v = src_y + (y - dst_y);
+        const fc_image_row* row = &img->rows[v];
+        const uint8_t* srow = img->pixels + (size_t)v * (size_t)img->pitch;
+        if (row->blend_all) {
+            ops->blend(drow + (size_t)rc.x0 * (size_t)c->bpp, srow + (size_t)u0 * 4u, u1 - u0);
+            *blended += (uint64_t)(u1 - u0);
+            continue;
+        }
+
+        /* first run ending after u0 */
+        int lo = 0, hi = row->count;
+        while (lo < hi) {
+            const int mid = (lo + hi) / 2;
+            if (row->runs[mid].x1 <= u0) lo = mid + 1;
+            else hi = mid;
+        }
+        for (int i = lo; i < row->count && row->runs[i].x0 < u1; ++i) {
+            const fc_run* r = &row->runs[i];
+            const int x0 = r->x0 > u0 ? r->x0 : u0;
+            const int x1 = r->x1 < u1 ? r->x1 : u1;
+            uint8_t* d = drow + (size_t)(x0 + du) * (size_t)c->bpp;
+            const uint8_t* sp = srow + (size_t)x0 * 4u;
+            if (r->opaque) { ops->copy(d, sp, x1 - x0); *copied += (uint64_t)(x1 - x0); }
+            else { ops->blend(d, sp, x1 - x0); *blended += (uint64_t)(x1 - x0); }
+        }
+    }
+}
+
+/* Paint over a rect, a span of FC_PAINT_SPAN at a time; opaque paints
+   are copied, the rest blended */
+static void fc_raster_paint(fc_ctx* c, const fc_irect* b, int x, int y, int w, int h,
+                            const fossil_cube_paint* paint, uint64_t* copied, uint64_t* blended) {
+    fc_irect rc;
+    if (!fc_clip_rect(b, x, y, w, h, &rc)) return;
+    const fc_span_ops* ops = fc_spans(c);
+    const bool opaque = fc_paint_opaque(paint);
+    void (*put)(uint8_t*, const uint8_t*, int) = opaque ? ops->copy : ops->blend;
+    uint32_t buf[FC_PAINT_SPAN];
+    uint8_t* drow = c->pixels + (size_t)rc.y0 * (size_t)c->pitch;
+    for (int j = rc.y0; j < rc.y1; ++j, drow += c->pitch) {
+        for (int i = rc.x0; i < rc.x1; i += FC_PAINT_SPAN) {
+            const int n = rc.x1 - i < FC_PAINT_SPAN ? rc.x1 - i : FC_PAINT_SPAN;
+            fc_paint_span(paint, i, j, n, buf);
+            put(drow + (size_t)i * (size_t)c->bpp, (const uint8_t*)buf, n);
+        }
+    }
+    const uint64_t area = (uint64_t)(rc.x1 - rc.x0) * (uint64_t)(rc.y1 - rc.y0);
+    if (opaque) *copied += area;
+    else *blended += area;
+}
+
+/* Saturating per-byte sum; a lane that carried into bit 8 becomes 255 */
+static inline uint32_t fc_add_px(uint32_t d, uint32_t s) {
+    const uint32_t rb = (d & FC_LANES) + (s & FC_LANES);
+    const uint32_t ga = ((d >> 8) & FC_LANES) + ((s >> 8) & FC_LANES);
+    return ((rb | ((rb >> 8) & FC_LANES) * 255u) & FC_LANES) |
+           (((ga | ((ga >> 8) & FC_LANES) * 255u) & FC_LANES) << 8);
+}
+
+/* Premultiplied multiply: s*d + s*(1 - da) + d*(1 - sa) per byte, rounded
+   once; on the alpha byte that is sa + da*(1 - sa) */
+static inline uint32_t fc_multiply_px(uint32_t d, uint32_t s) {
+    uint8_t dc[4], sc[4], o[4];
+    memcpy(dc, &d, sizeof(dc));
+    memcpy(sc, &s, sizeof(sc));
+    const uint32_t ida = 255u - dc[3], isa = 255u - sc[3];
+    for (int i = 0; i < 4; ++i) {
+        const uint32_t v = fc_div255((uint32_t)sc[i] * dc[i] + sc[i] * ida + dc[i] * isa);
+        o[i] = (uint8_t)(v > 255u ? 255u : v); /* only out-of-range input gets here */
+    }
+    uint32_t v;
+    memcpy(&v, o, sizeof(v));
+    return v;
+}
+
+/* n premultiplied RGBA8 source pixels combined into dst by mode */
+static void fc_composite_span(fc_ctx* c, const fc_span_ops* ops, fossil_cube_blend mode,
+                              uint8_t* dst, const uint8_t* src, int n) {
+    switch (mode) {
+    case FOSSIL_CUBE_BLEND_COPY:
+        ops->copy(dst, src, n);
+        return;
+    case FOSSIL_CUBE_BLEND_ADD:
+        for (int i = 0; i < n; ++i, src += 4, dst += c->bpp)
+            c->fmt->store(dst, fc_add_px(c->fmt->load(dst), fc_load_px(src)));
+        return;
+    case FOSSIL_CUBE_BLEND_MULTIPLY:
+        for (int i = 0; i < n; ++i, src += 4, dst += c->bpp)
+            c->fmt->store(dst, fc_multiply_px(c->fmt->load(dst), fc_load_px(src)));
+        return;
+    default:
+        ops->blend(dst, src, n);
+        return;
+    }
+}
+
+/* Another framebuffer (src already at the first pixel of the rect) onto
+   this one. An RGBA8 source at full opacity goes to the kernels as is;
+   anything else is converted to premultiplied RGBA8 and scaled by the
+   opacity a stack chunk at a time. */
+static void fc_raster_composite(fc_ctx* c, const fc_irect* b, int dst_x, int dst_y, int w, int h,
+                                const uint8_t* src, int src_pitch, fossil_cube_format src_format,
+                                uint8_t opacity, fossil_cube_blend mode) {
+    fc_irect rc;
+    if (!fc_clip_rect(b, dst_x, dst_y, w, h, &rc)) return;
+    const fc_format* sf = &g_formats[src_format];
+    const fc_span_ops* ops = fc_spans(c);
+    const int n = rc.x1 - rc.x0;
+    const bool direct = src_format == FOSSIL_CUBE_FORMAT_RGBA8 && opacity == 255;
+    const uint8_t* srow = src + (size_t)(rc.y0 - dst_y) * (size_t)src_pitch
+                              + (size_t)(rc.x0 - dst_x) * (size_t)sf->bpp;
+    uint8_t* drow = fc_px_addr(c, rc.x0, rc.y0);
+    uint8_t tmp[FC_SWIZZLE_CHUNK * 4];
+    for (int y = rc.y0; y < rc.y1; ++y, srow += src_pitch, drow += c->pitch) {
+        if (direct) {
+            fc_composite_span(c, ops, mode, drow, srow, n);
+            continue;
+        }
+        for (int i = 0; i < n; i += FC_SWIZZLE_CHUNK) {
+            const int k = n - i < FC_SWIZZLE_CHUNK ? n - i : FC_SWIZZLE_CHUNK;
+            const uint8_t* sp = srow + (size_t)i * (size_t)sf->bpp;
+            for (int j = 0; j < k; ++j, sp += sf->bpp) {
+                uint32_t v = sf->load(sp);
+                if (opacity != 255) {
+                    v = fc_div255x2((v & FC_LANES) * opacity) |
+                        (fc_div255x2(((v >> 8) & FC_LANES) * opacity) << 8);
+                }
+                fc_store_px(tmp + (size_t)j * 4u, v);
+            }
+            fc_composite_span(c, ops, mode, drow + (size_t)i * (size_t)c->bpp, tmp, k);
+        }
+    }
+}
+
+/* =========================
+   Frame arena
+   ========================= */
+
+#define FC_ARENA_ALIGN 16u
+#define FC_ARENA_HEADER ((sizeof(fc_arena_block) + FC_ARENA_ALIGN - 1u) & ~(size_t)(FC_ARENA_ALIGN - 1u))
+#define FC_ARENA_MIN_BLOCK ((size_t)64u << 10)
+
+static fc_arena_block* fc_arena_block_new(fc_arena* a, size_t size) {
+    fc_arena_block* b = (fc_arena_block*)malloc(FC_ARENA_HEADER + size);
+    if (!b) return NULL;
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    a->reserved += size;
+    ++a->block_allocs;
+    return b;
+}
+
+static void fc_arena_release(fc_arena* a) {
+    for (fc_arena_block* b = a->head; b;) {
+        fc_arena_block* next = b->next;
+        free(b);
+        b = next;
+    }
+    a->head = a->cur = NULL;
+    a->reserved = 0;
+}
+
+/* 16-byte aligned, valid until the next reset (or a rewind past it) */
+static void* fc_arena_alloc(fc_arena* a, size_t size) {
+    if (size > SIZE_MAX / 4u) return NULL;
+    size = (size + FC_ARENA_ALIGN - 1u) & ~(size_t)(FC_ARENA_ALIGN - 1u);
+    fc_arena_block* b = a->cur;
+    fc_arena_block* last = b;
+    while (b && b->size - b->used < size) {
+        last = b;
+        b = b->next;
+        if (b) b->used = 0;
+    }
+    if (!b) {
+        /* grow geometrically so a frame needs few blocks before the reset
+           folds them into one */
+        size_t want = last ? last->size * 2u : FC_ARENA_MIN_BLOCK;
+        if (want < size) want = size;
+        b = fc_arena_block_new(a, want);
+        if (!b) return NULL;
+        if (last) last->next = b;
+        else a->head = b;
+    }
+    a->cur = b;
+    void* p = (uint8_t*)b + FC_ARENA_HEADER + b->used;
+    b->used += size;
+    a->used += size;
+    if (a->used > a->peak) a->peak = a->used;
+    return p;
+}
+
+static inline fc_arena_mark fc_arena_get_mark(const fc_arena* a) {
+    fc_arena_mark m = { a->cur, a->cur ? a->cur->used : 0, a->used };
+    return m;
+}
+
+/* Drop everything allocated after the mark */
+static void fc_arena_rewind(fc_arena* a, fc_arena_mark m) {
+    a->cur = m.block ? m.block : a->head;
+    if (a->cur) a->cur->used = m.block_used;
+    a->used = m.used;
+}
+
+/* Start over. A frame that needed several blocks leaves one block of
+   their total size behind, so steady-state frames make no allocator
+   calls; memory beyond the limit is given back. */
+static void fc_arena_reset(fc_arena* a) {
+    const size_t limit = a->limit ? a->limit : FOSSIL_CUBE_DEFAULT_ARENA_LIMIT;
+    a->used = 0;
+    if (a->head && (a->head->next || a->head->size > limit)) {
+        const size_t total = a->reserved;
+        fc_arena_release(a);
+        if (total <= limit) a->head = fc_arena_block_new(a, total);
+    }
+    a->cur = a->head;
+    if (a->head) a->head->used = 0;
+}
+
+/* =========================
+   Command buffers
+   ========================= */
+
+static bool fc_cmdbuf_push(fc_cmdbuf* buf, const fc_cmd* cmd) {
+    if (buf->count == buf->cap) {
+        size_t ncap = buf->cap ? buf->cap * 2u : 256u;
+        fc_cmd* n = (fc_cmd*)realloc(buf->cmds, ncap * sizeof(*n));
+        if (!n) return false;
+        buf->cmds = n;
+        buf->cap = ncap;
+    }
+    buf->cmds[buf->count++] = *cmd;
+    return true;
+}
+
+static void fc_cmdbuf_clear(fc_cmdbuf* buf) {
+    fc_arena_reset(&buf->arena);
+    buf->count = 0;
+}
+
+static void fc_cmdbuf_free(fc_cmdbuf* buf) {
+    fc_arena_release(&buf->arena);
+    free(buf->cmds);
+    buf->cmds = NULL;
+    buf->count = buf->cap = 0;
+}
+
+/* On OOM a deferred command is dropped, like any other draw that cannot
+   run in this core; the first such error sticks until get_error */
+static inline void fc_set_error(fc_ctx* c, fossil_cube_result err) {
+    if (c->error == FOSSIL_CUBE_OK) c->error = err;
+}
+
+/* Where draw calls go right now: a user recording, the deferred frame,
+   or NULL for immediate execution */
+static inline fc_cmdbuf* fc_sink(fc_ctx* c) {
+    if (c->record) return c->record;
+    if (c->mode == FOSSIL_CUBE_MODE_DEFERRED && c->in_frame) return &c->frame;
+    return NULL;
+}
+
+/* colors are premultiplied once here; clear stores its color as given */
+static inline void fc_cmd_color(const fc_ctx* c, fc_cmd* cmd, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (c->alpha == FOSSIL_CUBE_ALPHA_STRAIGHT && cmd->kind != FC_CMD_CLEAR && a != 255) {
+        r = fc_premul(r, a); g = fc_premul(g, a); b = fc_premul(b, a);
+    }
+    cmd->rgba[0] = r; cmd->rgba[1] = g; cmd->rgba[2] = b; cmd->rgba[3] = a;
+}
+
+static inline fc_cmd fc_make_cmd(const fc_ctx* c, fc_cmd_kind kind, int a0, int a1, int a2, int a3,
+                                 uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fc_cmd cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.kind = (uint8_t)kind;
+    fc_cmd_color(c, &cmd, r, g, b, a);
+    cmd.alpha = (uint8_t)c->alpha;
+    cmd.a0 = a0; cmd.a1 = a1; cmd.a2 = a2; cmd.a3 = a3;
+    cmd.clip = fc_clip_bounds(c);
+    cmd.region = c->region;
+    return cmd;
+}
+
+/* Screen-space box a command can touch; false if it touches nothing */
+static bool fc_cmd_bbox(const fc_ctx* c, const fc_cmd* cmd, fc_irect* out) {
+    fc_irect b;
+    if (!fc_bounds_for(c, &cmd->clip, &b)) return false;
+    if (cmd->region && !fc_irect_intersect(&b, &cmd->region->bounds, &b)) return false;
+    switch ((fc_cmd_kind)cmd->kind) {
+    case FC_CMD_CLEAR:
+        *out = b;
+        return true;
+    case FC_CMD_PIXEL:
+        return fc_clip_rect(&b, cmd->a0, cmd->a1, 1, 1, out);
+    case FC_CMD_FILL:
+    case FC_CMD_BLIT:
+    case FC_CMD_IMAGE:
+    case FC_CMD_MASK:
+    case FC_CMD_SCALED:
+    case FC_CMD_PATH:
+    case FC_CMD_COMPOSITE:
+    case FC_CMD_PAINT:
+        return fc_clip_rect(&b, cmd->a0, cmd->a1, cmd->a2, cmd->a3, out);
+    case FC_CMD_LINE: {
+        const int lx = cmd->a0 < cmd->a2 ? cmd->a0 : cmd->a2;
+        const int ly = cmd->a1 < cmd->a3 ? cmd->a1 : cmd->a3;
+        const long long lw = (long long)(cmd->a0 < cmd->a2 ? cmd->a2 : cmd->a0) - lx + 1;
+        const long long lh = (long long)(cmd->a1 < cmd->a3 ? cmd->a3 : cmd->a1) - ly + 1;
+        return fc_clip_rect(&b, lx, ly, lw > INT_MAX ? INT_MAX : (int)lw,
+                            lh > INT_MAX ? INT_MAX : (int)lh, out);
+    }
+    default:
+        return false;
+    }
+}
+
+/* True if every source pixel a blit draws inside bb has alpha 255; the
+   scan stops at the first that does not */
+static bool fc_blit_opaque(const fc_cmd* cmd, const fc_irect* bb) {
+    const uint8_t* row = cmd->src + (size_t)(bb->y0 - cmd->a1) * (size_t)cmd->src_pitch
+                                  + (size_t)(bb->x0 - cmd->a0) * 4u + 3u;
+    const int n = bb->x1 - bb->x0;
+    for (int y = bb->y0; y < bb->y1; ++y, row += cmd->src_pitch) {
+        uint8_t all = 255;
+        for (int x = 0; x < n; ++x) all &= row[(size_t)x * 4u];
+        if (all != 255) return false;
+    }
+    return true;
+}
+
+/* True if the command overwrites every pixel of its bbox regardless of
+   what was there before; a region leaves holes in the bbox. Blits are
+   scanned for their alpha, so only when scan is set. */
+static inline bool fc_cmd_is_opaque_cover(const fc_cmd* cmd, const fc_irect* bb, bool scan) {
+    if (cmd->region) return false;
+    return cmd->kind == FC_CMD_CLEAR || (cmd->kind == FC_CMD_FILL && cmd->rgba[3] == 255) ||
+           (cmd->kind == FC_CMD_IMAGE && cmd->image->opaque_rows == cmd->image->h) ||
+           (cmd->kind == FC_CMD_PAINT && fc_paint_opaque(cmd->paint)) ||
+           (cmd->kind == FC_CMD_BLIT && scan && fc_blit_opaque(cmd, bb));
+}
+
+enum { FC_MAX_OCCLUDERS = 8 };
+
+/* Limit a clear to what later occluders leave of its bbox: an occluder
+   spanning the whole width cuts rows off the top or bottom, one spanning
+   the whole height cuts columns off a side, until nothing changes (so a
+   clear hidden by several occluders together goes too). Only the clip
+   shrinks; the clear still counts as an occluder with its full bbox.
+   False if nothing is left. */
+static bool fc_clear_trim(const fc_irect* occ, int nocc, const fc_irect* bb, fc_irect* clip) {
+    fc_irect r = *bb;
+    bool changed = true;
+    while (changed && r.x0 < r.x1 && r.y0 < r.y1) {
+        changed = false;
+        for (int k = 0; k < nocc; ++k) {
+            const fc_irect* o = &occ[k];
+            if (o->x0 <= r.x0 && o->x1 >= r.x1) {
+                if (o->y0 <= r.y0 && o->y1 > r.y0) { r.y0 = o->y1; changed = true; }
+                if (o->y1 >= r.y1 && o->y0 < r.y1) { r.y1 = o->y0; changed = true; }
+            } else if (o->y0 <= r.y0 && o->y1 >= r.y1) {
+                if (o->x0 <= r.x0 && o->x1 > r.x0) { r.x0 = o->x1; changed = true; }
+                if (o->x1 >= r.x1 && o->x0 < r.x1) { r.x1 = o->x0; changed = true; }
+            }
+            if (r.x0 >= r.x1 || r.y0 >= r.y1) return false;
+        }
+    }
+    if (r.x0 >= r.x1 || r.y0 >= r.y1) return false;
+    *clip = r;
+    return true;
+}
+
+/* Frame optimizer, run once before execution:
+   1. drop commands whose bbox is fully covered by a later opaque cover
+      (they can never show), and cut clears down to the part later
+      occluders leave uncovered; a blit's source is scanned only when
+      earlier commands could be hidden by it
+   2. merge consecutive fills of the same color, clip and region whose rects
+      share a full edge into one rect
+   Order between overlapping commands is never changed, so the output is
+   identical to executing the commands as recorded. */
+static void fc_cmdbuf_optimize(const fc_ctx* c, fc_cmdbuf* buf) {
+    fc_irect occ[FC_MAX_OCCLUDERS];
+    int nocc = 0;
+
+    for (size_t i = buf->count; i-- > 0;) {
+        fc_cmd* cmd = &buf->cmds[i];
+        fc_irect bb;
+        if (!fc_cmd_bbox(c, cmd, &bb)) { cmd->kind = FC_CMD_NOP; continue; }
+
+        bool hidden = false;
+        for (int k = 0; k < nocc && !hidden; ++k) hidden = fc_irect_contains(&occ[k], &bb);
+        if (hidden) { cmd->kind = FC_CMD_NOP; continue; }
+        if (cmd->kind == FC_CMD_CLEAR && !fc_clear_trim(occ, nocc, &bb, &cmd->clip)) {
+            cmd->kind = FC_CMD_NOP;
+            continue;
+        }
+
+        if (fc_cmd_is_opaque_cover(cmd, &bb, i > 0)) {
+            /* keep the largest occluders */
+            const long long area = (long long)(bb.x1 - bb.x0) * (bb.y1 - bb.y0);
+            int slot = nocc < FC_MAX_OCCLUDERS ? nocc++ : -1;
+            if (slot < 0) {
+                long long smallest = area;
+                for (int k = 0; k < FC_MAX_OCCLUDERS; ++k) {
+                    const long long ka = (long long)(occ[k].x1 - occ[k].x0) * (occ[k].y1 - occ[k].y0);
+                    if (ka < smallest) { smallest = ka; slot = k; }
+                }
+            }
+            if (slot >= 0) occ[slot] = bb;
+        }
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < buf->count; ++i) {
+        const fc_cmd* cmd = &buf->cmds[i];
+        if (cmd->kind == FC_CMD_NOP) continue;
+        if (out > 0 && cmd->kind == FC_CMD_FILL) {
+            fc_cmd* prev = &buf->cmds[out - 1];
+            if (prev->kind == FC_CMD_FILL && memcmp(prev->rgba, cmd->rgba, 4) == 0 &&
+                memcmp(&prev->clip, &cmd->clip, sizeof(fc_irect)) == 0 && prev->region == cmd->region &&
+                prev->a2 > 0 && prev->a3 > 0 && cmd->a2 > 0 && cmd->a3 > 0) {
+                if (prev->a0 == cmd->a0 && prev->a2 == cmd->a2 &&
+                    (long long)prev->a1 + prev->a3 == cmd->a1 &&
+                    (long long)prev->a3 + cmd->a3 <= INT_MAX) {
+                    prev->a3 += cmd->a3;
+                    continue;
+                }
+                if (prev->a1 == cmd->a1 && prev->a3 == cmd->a3 &&
+                    (long long)prev->a0 + prev->a2 == cmd->a0 &&
+                    (long long)prev->a2 + cmd->a2 <= INT_MAX) {
+                    prev->a2 += cmd->a2;
+                    continue;
+                }
+            }
+        }
+        buf->cmds[out++] = *cmd;
+    }
+    buf->count = out;
+}
+
+/* =========================
+   Frame statistics
+   =========================
+   Compiled in with FOSSIL_CUBE_STATS (meson -Dwith_stats=enabled). Calls
+   are counted at submission, pixels where commands run (tile workers
+   count into their own slots, folded after the frame), times around
+   end_frame's execution and the present callback.
+*/
+
+#if defined(FOSSIL_CUBE_STATS)
+#define FC_STAT(...) __VA_ARGS__
+
+/* Counters are indexed by kind - FC_CMD_CLEAR: the kinds from CLEAR to
+   PAINT must keep the order of fossil_cube_prim, one slot each */
+_Static_assert(FC_CMD_CLEAR - FC_CMD_CLEAR == FOSSIL_CUBE_PRIM_CLEAR, "first command kind is not the first primitive");
+_Static_assert(FC_CMD_PAINT - FC_CMD_CLEAR == FOSSIL_CUBE_PRIM_PAINT, "last command kind is not the last primitive");
+_Static_assert(FC_CMD_PAINT - FC_CMD_CLEAR + 1 == FOSSIL_CUBE_PRIM_COUNT, "a command kind has no primitive counter");
+_Static_assert(sizeof(((fossil_cube_stats*)0)->prim) / sizeof(fossil_cube_prim_stats) == FOSSIL_CUBE_PRIM_COUNT,
+               "prim counters do not cover every primitive");
+
+static uint64_t fc_now_ns(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER f, t;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&t);
+    return (uint64_t)((double)t.QuadPart * 1e9 / (double)f.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void fc_stat_time(fossil_cube_timing* t, uint64_t ns) {
+    ++t->count;
+    t->last_ns = ns;
+    t->total_ns += ns;
+    if (ns > t->max_ns) t->max_ns = ns;
+}
+
+/* Pixel counters of one executed command; line, image, path, paint and
+   mask runs report what they drew, every other kind covers its clipped rect */
+static void fc_stat_pixels(const fc_cmd* cmd, const fc_irect* b, uint64_t copied, uint64_t blended,
+                           fossil_cube_prim_stats* st) {
+    fc_irect rc = *b;
+    switch ((fc_cmd_kind)cmd->kind) {
+    case FC_CMD_CLEAR:
+        copied = (uint64_t)(rc.x1 - rc.x0) * (uint64_t)(rc.y1 - rc.y0);
+        break;
+    case FC_CMD_PIXEL:
+    case FC_CMD_FILL:
+    case FC_CMD_BLIT:
+    case FC_CMD_MASK:
+    case FC_CMD_SCALED:
+    case FC_CMD_COMPOSITE: {
+        if (cmd->kind == FC_CMD_MASK && cmd->s0 != 0) break; /* a run reports what it drew */
+        const bool px = cmd->kind == FC_CMD_PIXEL;
+        if (!fc_clip_rect(b, cmd->a0, cmd->a1, px ? 1 : cmd->a2, px ? 1 : cmd->a3, &rc)) return;
+        const uint64_t area = (uint64_t)(rc.x1 - rc.x0) * (uint64_t)(rc.y1 - rc.y0);
+        const bool copy = ((cmd->kind == FC_CMD_PIXEL || cmd->kind == FC_CMD_FILL) && cmd->rgba[3] == 255) ||
+                          (cmd->kind == FC_CMD_COMPOSITE && cmd->blend == FOSSIL_CUBE_BLEND_COPY);
+        if (copy) copied = area;
+        else blended = area;
+        break;
+    }
+    default:
+        break;
+    }
+    fossil_cube_prim_stats* p = &st[cmd->kind - FC_CMD_CLEAR];
+    p->pixels += copied + blended;
+    p->copied += copied;
+    p->blended += blended;
+}
+#else
+#define FC_STAT(...)
+#endif
+
+/* Run a command inside bounds; st receives the pixel counters (per
+   primitive) when stats are compiled in */
+static void fc_cmd_raster(fc_ctx* c, const fc_cmd* cmd, const fc_irect* bounds,
+                          fossil_cube_prim_stats* st) {
+    const fc_irect b = *bounds;
+    const uint8_t* k = cmd->rgba;
+    uint64_t copied = 0, blended = 0;
+    switch ((fc_cmd_kind)cmd->kind) {
+    case FC_CMD_CLEAR:
+        fc_raster_clear(c, &b, c->fmt->pack(k[0], k[1], k[2], k[3]));
+        break;
+    case FC_CMD_PIXEL:
+        fc_raster_pixel(c, &b, cmd->a0, cmd->a1, k[0], k[1], k[2], k[3]);
+        break;
+    case FC_CMD_FILL:
+        fc_raster_fill(c, &b, cmd->a0, cmd->a1, cmd->a2, cmd->a3, k[0], k[1], k[2], k[3]);
+        break;
+    case FC_CMD_LINE: {
+        const uint64_t n = fc_raster_line(c, &b, cmd->a0, cmd->a1, cmd->a2, cmd->a3, k[0], k[1], k[2], k[3]);
+        if (k[3] == 255) copied = n;
+        else blended = n;
+        break;
+    }
+    case FC_CMD_BLIT:
+        fc_raster_blit(c, &b, cmd->a0, cmd->a1, cmd->src, cmd->a2, cmd->a3, cmd->src_pitch,
+                       (fossil_cube_alpha)cmd->alpha);
+        break;
+    case FC_CMD_IMAGE:
+        fc_raster_image(c, &b, cmd->image, cmd->s0, cmd->s1,
+                        cmd->a0, cmd->a1, cmd->a2, cmd->a3, &copied, &blended);
+        break;
+    case FC_CMD_MASK:
+        if (cmd->s0 == 0) {
+            fc_raster_mask(c, &b, cmd->a0, cmd->a1, cmd->src, cmd->a2, cmd->a3, cmd->src_pitch,
+                           k[0], k[1], k[2], k[3]);
+            break;
+        }
+        for (int i = 0; i < cmd->s0; ++i) {
+            const fc_mask_item* m = &cmd->masks[i];
+            fc_irect rc;
+            if (!fc_clip_rect(&b, m->x, m->y, m->w, m->h, &rc)) continue;
+            fc_raster_mask(c, &rc, m->x, m->y, m->cov, m->w, m->h, m->pitch, k[0], k[1], k[2], k[3]);
+            blended += (uint64_t)(rc.x1 - rc.x0) * (uint64_t)(rc.y1 - rc.y0);
+        }
+        break;
+    case FC_CMD_SCALED:
+        fc_raster_scaled(c, &b, cmd->a0, cmd->a1, cmd->a2, cmd->a3,
+                         cmd->src, cmd->s0, cmd->s1, cmd->src_pitch,
+                         (fossil_cube_alpha)cmd->alpha, (fossil_cube_filter)cmd->filter);
+        break;
+    case FC_CMD_PATH:
+        blended = fc_raster_path(c, &b, cmd->path, k, cmd->region);
+        break;
+    case FC_CMD_COMPOSITE:
+        fc_raster_composite(c, &b, cmd->a0, cmd->a1, cmd->a2, cmd->a3, cmd->src, cmd->src_pitch,
+                            (fossil_cube_format)cmd->s0, k[3], (fossil_cube_blend)cmd->blend);
+        break;
+    case FC_CMD_PAINT:
+        fc_raster_paint(c, &b, cmd->a0, cmd->a1, cmd->a2, cmd->a3, cmd->paint, &copied, &blended);
+        break;
+    default:
+        return;
+    }
+#if defined(FOSSIL_CUBE_STATS)
+    if (st) fc_stat_pixels(cmd, &b, copied, blended, st);
+#else
+    (void)st; (void)copied; (void)blended;
+#endif
+}
+
+/* Run one command clipped by its own clip and by 'extra'. With a
+   region, rect primitives run once per band span they overlap
+   (the pieces are disjoint, so every pixel is drawn once, as the tile
+   split relies on); shapes clip their coverage spans themselves */
+static void fc_cmd_exec_one(fc_ctx* c, const fc_cmd* cmd, const fc_irect* extra,
+                            fossil_cube_prim_stats* st) {
+    fc_irect clip, b;
+    if (!fc_irect_intersect(&cmd->clip, extra, &clip)) return;
+    if (!fc_bounds_for(c, &clip, &b)) return;
+    const fossil_cube_region* rg = cmd->region;
+    if (!rg || cmd->kind == FC_CMD_PATH) {
+        fc_cmd_raster(c, cmd, &b, st);
+        return;
+    }
+    fc_irect box;
+    if (!fc_cmd_bbox(c, cmd, &box) || !fc_irect_intersect(&box, &b, &box)) return;
+    for (int i = fc_region_first(rg, box.y0); i < rg->band_count && rg->bands[i].y0 < box.y1; ++i) {
+        const fc_band* band = &rg->bands[i];
+        for (int j = band->first; j < band->first + band->count; ++j) {
+            const fc_irect span = { rg->spans[j].x0, band->y0, rg->spans[j].x1, band->y1 };
+            fc_irect piece;
+            if (fc_irect_intersect(&span, &box, &piece)) fc_cmd_raster(c, cmd, &piece, st);
+        }
+    }
+}
+
+/* Counters for commands run on the calling thread */
+static inline fossil_cube_prim_stats* fc_stat_slot(fc_ctx* c) {
+#if defined(FOSSIL_CUBE_STATS)
+    return c->stats.prim;
+#else
+    (void)c;
+    return NULL;
+#endif
+}
+
+static void fc_cmd_exec(fc_ctx* c, const fc_cmd* cmds, size_t count, const fc_irect* extra) {
+    for (size_t i = 0; i < count; ++i) fc_cmd_exec_one(c, &cmds[i], extra, fc_stat_slot(c));
+}
+
+/* =========================
+   Tile-binned executor
+   =========================
+   The framebuffer is split into FC_TILE x FC_TILE tiles. Each command is
+   binned into every tile its bbox touches, then tiles are rasterized in
+   parallel: a tile runs its commands in submission order, clipped to the
+   tile, so workers never touch the same bytes and the output matches the
+   serial executor exactly.
+*/
+
+enum { FC_TILE = FOSSIL_CUBE_ENCODE_TILE }; /* the encoder's tiles too */
+
+typedef struct fc_tile_job {
+    fc_ctx* c;
+    const fc_cmd* cmds;
+    int tiles_x;
+    bool encode; /* encode each tile once rasterized */
+    fossil_cube_prim_stats* stats; /* per worker, FOSSIL_CUBE_PRIM_COUNT each; NULL: not counted */
+} fc_tile_job;
+
+static bool fc_encode_prepare(fc_ctx* c);  /* see "Frame encoder" */
+static void fc_encode_tile(fc_ctx* c, int index);
+
+static bool fc_grow_u32(uint32_t** arr, size_t* cap, size_t need) {
+    if (need <= *cap) return true;
+    size_t ncap = *cap ? *cap : 1024u;
+    while (ncap < need) ncap *= 2u;
+    uint32_t* n = (uint32_t*)realloc(*arr, ncap * sizeof(uint32_t));
+    if (!n) return false;
+    *arr = n;
+    *cap = ncap;
+    return true;
+}
+
+static void fc_tile_run(void* arg, int index, int worker) {
+    const fc_tile_job* job = (const fc_tile_job*)arg;
+    fc_ctx* c = job->c;
+    fossil_cube_prim_stats* st = job->stats ? job->stats + (size_t)worker * FOSSIL_CUBE_PRIM_COUNT : NULL;
+    const int tx = index % job->tiles_x, ty = index / job->tiles_x;
+    const fc_irect tile = { tx * FC_TILE, ty * FC_TILE,
+                            tx * FC_TILE + FC_TILE, ty * FC_TILE + FC_TILE };
+    for (uint32_t i = c->bin_start[index]; i < c->bin_start[index + 1]; ++i) {
+        fc_cmd_exec_one(c, &job->cmds[c->bin_items[i]], &tile, st);
+    }
+    if (job->encode) fc_encode_tile(c, index);
+}
+
+/* Bin and rasterize a command list; false if binning could not allocate
+   (the caller then falls back to the serial executor). *encoded tells
+   whether the tiles were encoded as well. */
+static bool fc_tiles_exec(fc_ctx* c, const fc_cmd* cmds, size_t count, bool* encoded) {
+    const int tiles_x = (c->w + FC_TILE - 1) / FC_TILE;
+    const int tiles_y = (c->h + FC_TILE - 1) / FC_TILE;
+    const size_t ntiles = (size_t)tiles_x * (size_t)tiles_y;
+    if (count > UINT32_MAX) return false;
+    if (!fc_grow_u32(&c->bin_start, &c->bin_start_cap, ntiles + 1u)) return false;
+    memset(c->bin_start, 0, (ntiles + 1u) * sizeof(uint32_t));
+
+    /* pass 1: count commands per tile */
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        fc_irect bb;
+        if (!fc_cmd_bbox(c, &cmds[i], &bb)) continue;
+        for (int ty = bb.y0 / FC_TILE; ty <= (bb.y1 - 1) / FC_TILE; ++ty)
+            for (int tx = bb.x0 / FC_TILE; tx <= (bb.x1 - 1) / FC_TILE; ++tx)
+                c->bin_start[(size_t)ty * (size_t)tiles_x + (size_t)tx + 1u]++;
+        total += (size_t)((bb.y1 - 1) / FC_TILE - bb.y0 / FC_TILE + 1) *
+                 (size_t)((bb.x1 - 1) / FC_TILE - bb.x0 / FC_TILE + 1);
+    }
+    if (total > UINT32_MAX) return false;
+    if (!fc_grow_u32(&c->bin_items, &c->bin_items_cap, total ? total : 1u)) return false;
+    for (size_t t = 0; t < ntiles; ++t) c->bin_start[t + 1] += c->bin_start[t];
+
+    /* pass 2: scatter, using bin_start[t] as a cursor then shifting back */
+    for (size_t i = 0; i < count; ++i) {
+        fc_irect bb;
+        if (!fc_cmd_bbox(c, &cmds[i], &bb)) continue;
+        for (int ty = bb.y0 / FC_TILE; ty <= (bb.y1 - 1) / FC_TILE; ++ty)
+            for (int tx = bb.x0 / FC_TILE; tx <= (bb.x1 - 1) / FC_TILE; ++tx)
+                c->bin_items[c->bin_start[(size_t)ty * (size_t)tiles_x + (size_t)tx]++] = (uint32_t)i;
+    }
+    for (size_t t = ntiles; t > 0; --t) c->bin_start[t] = c->bin_start[t - 1];
+    c->bin_start[0] = 0;
+
+    fc_tile_job job = { c, cmds, tiles_x, c->enc && fc_encode_prepare(c), NULL };
+#if defined(FOSSIL_CUBE_STATS)
+    if (!c->stat_workers) {
+        c->stat_workers = (fossil_cube_prim_stats*)calloc((size_t)FOSSIL_CUBE_MAX_THREADS * FOSSIL_CUBE_PRIM_COUNT,
+                                                           sizeof(fossil_cube_prim_stats));
+    }
+    job.stats = c->stat_workers;
+#endif
+    fc_pool_run(c->pool, fc_tile_run, &job, (int)ntiles);
+    *encoded = job.encode;
+#if defined(FOSSIL_CUBE_STATS)
+    if (job.stats) {
+        const int threads = fc_pool_threads(c->pool);
+        for (int w = 0; w < threads; ++w) {
+            fossil_cube_prim_stats* ws = job.stats + (size_t)w * FOSSIL_CUBE_PRIM_COUNT;
+            for (int i = 0; i < FOSSIL_CUBE_PRIM_COUNT; ++i) {
+                c->stats.prim[i].pixels += ws[i].pixels;
+                c->stats.prim[i].copied += ws[i].copied;
+                c->stats.prim[i].blended += ws[i].blended;
+            }
+            memset(ws, 0, sizeof(fossil_cube_prim_stats) * FOSSIL_CUBE_PRIM_COUNT);
+        }
+    }
+#endif
+    return true;
+}
+
+static const fc_irect g_no_clip = { 0, 0, INT_MAX, INT_MAX };
+
+/* =========================
+   Damage tracking
+   =========================
+   Every primitive reports the screen box it touched. Boxes are merged
+   into at most FOSSIL_CUBE_MAX_DAMAGE rects: contained boxes vanish, and
+   when the list is full the pair whose union adds the least area is
+   merged. The list is handed to present_rects and reset after present.
+*/
+
+static inline long long fc_irect_area(const fc_irect* r) {
+    return (long long)(r->x1 - r->x0) * (long long)(r->y1 - r->y0);
+}
+
+static inline fc_irect fc_irect_union(const fc_irect* a, const fc_irect* b) {
+    fc_irect u;
+    u.x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+    u.y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+    u.x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+    u.y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+    return u;
+}
+
+static void fc_rects_add(fc_irect* list, int* count, const fc_irect* r) {
+    fc_irect add = *r;
+    for (;;) {
+        int n = *count;
+        for (int i = 0; i < n; ++i) {
+            if (fc_irect_contains(&list[i], &add)) return;
+        }
+        /* drop rects the new one swallows */
+        for (int i = 0; i < n;) {
+            if (fc_irect_contains(&add, &list[i])) list[i] = list[--n];
+            else ++i;
+        }
+        *count = n;
+        if (n < FOSSIL_CUBE_MAX_DAMAGE) {
+            list[(*count)++] = add;
+            return;
+        }
+        /* full: merge 'add' with the rect that grows least, then retry */
+        int best = 0;
+        long long best_cost = LLONG_MAX;
+        for (int i = 0; i < n; ++i) {
+            const fc_irect u = fc_irect_union(&list[i], &add);
+            const long long cost = fc_irect_area(&u) - fc_irect_area(&list[i]) - fc_irect_area(&add);
+            if (cost < best_cost) { best_cost = cost; best = i; }
+        }
+        add = fc_irect_union(&list[best], &add);
+        list[best] = list[--*count];
+    }
+}
+
+static inline void fc_damage_add(fc_ctx* c, const fc_irect* r) {
+    fc_rects_add(c->damage, &c->damage_count, r);
+}
+
+static inline void fc_damage_all(fc_ctx* c) {
+    c->damage[0].x0 = 0;
+    c->damage[0].y0 = 0;
+    c->damage[0].x1 = c->w;
+    c->damage[0].y1 = c->h;
+    c->damage_count = (c->w > 0 && c->h > 0) ? 1 : 0;
+}
+
+static inline void fc_damage_cmd(fc_ctx* c, const fc_cmd* cmd) {
+    fc_irect bb;
+    if (fc_cmd_bbox(c, cmd, &bb)) fc_damage_add(c, &bb);
+}
+
+/* =========================
+   Frame encoder
+   =========================
+   Tiles are the executor's FC_TILE grid, so a tile worker can encode
+   what it just rasterized. A tile codes the bbox of the damage inside it:
+   the box is XORed with the previous frame (which then takes the new
+   pixels) and the XOR stream is run-length coded into the tile's own
+   slot of the packet buffer. Slots are sized for the raw fallback, so
+   workers never share bytes; the slots are packed behind the header
+   once every tile is done.
+*/
+
+enum {
+    FC_PKT_HEADER = 24,
+    FC_PKT_TILE = 16,
+    FC_PKT_RLE = 0,
+    FC_PKT_RAW = 1,
+    FC_PKT_KEY = 1 /* header flag */
+};
+
+static const uint8_t g_pkt_magic[4] = { 'F', 'C', 'X', 'D' };
+
+typedef struct fc_encoder {
+    fossil_cube_packet_fn fn;
+    void* userdata;
+    uint32_t sequence;
+    bool key;        /* next packet codes every tile against zeros */
+    uint8_t* prev;   /* last encoded frame, tightly packed */
+    int w, h;        /* size of prev; a change forces a key frame */
+    int tiles_x, tiles_y;
+    size_t slot;     /* bytes reserved per tile in out */
+    uint8_t* out;
+    size_t out_cap;
+    uint32_t* sizes; /* per tile: bytes written, 0 when it had no damage */
+    size_t sizes_cap;
+} fc_encoder;
+
+static inline void fc_put16(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void fc_put32(uint8_t* p, uint32_t v) {
+    fc_put16(p, v);
+    fc_put16(p + 2, v >> 16);
+}
+
+static inline uint32_t fc_get16(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static inline uint32_t fc_get32(const uint8_t* p) {
+    return fc_get16(p) | fc_get16(p + 2) << 16;
+}
+
+/* The bytes of one pixel in a word: XOR works bytewise, so whatever the
+   host byte order, storing the word back yields the same bytes */
+static inline uint32_t fc_pkt_load(const uint8_t* p, int bpp) {
+    uint32_t v = 0;
+    switch (bpp) {
+    case 4: memcpy(&v, p, 4); break;
+    case 2: memcpy(&v, p, 2); break;
+    default: memcpy(&v, p, 1); break;
+    }
+    return v;
+}
+
+static inline void fc_pkt_store(uint8_t* p, uint32_t v, int bpp) {
+    switch (bpp) {
+    case 4: memcpy(p, &v, 4); break;
+    case 2: memcpy(p, &v, 2); break;
+    default: memcpy(p, &v, 1); break;
+    }
+}
+
+static void fc_encoder_free(fc_ctx* c) {
+    fc_encoder* e = c->enc;
+    if (!e) return;
+    free(e->prev);
+    free(e->out);
+    free(e->sizes);
+    free(e);
+    c->enc = NULL;
+}
+
+/* Size the buffers for the current framebuffer; false when out of memory
+   (the frame then goes unencoded and the next packet is a key frame) */
+static bool fc_encode_prepare(fc_ctx* c) {
+    fc_encoder* e = c->enc;
+    const size_t row = (size_t)c->w * (size_t)c->bpp;
+    if (e->w != c->w || e->h != c->h) {
+        free(e->prev);
+        e->prev = (uint8_t*)malloc(row * (size_t)c->h);
+        e->w = e->prev ? c->w : 0;
+        e->h = e->prev ? c->h : 0;
+        e->key = true;
+        if (!e->prev) return false;
+    }
+    e->tiles_x = (c->w + FC_TILE - 1) / FC_TILE;
+    e->tiles_y = (c->h + FC_TILE - 1) / FC_TILE;
+    const size_t ntiles = (size_t)e->tiles_x * (size_t)e->tiles_y;
+    e->slot = FC_PKT_TILE + (size_t)FC_TILE * FC_TILE * (size_t)c->bpp;
+    const size_t need = FC_PKT_HEADER + ntiles * e->slot;
+    if (need > e->out_cap) {
+        uint8_t* out = (uint8_t*)realloc(e->out, need);
+        if (!out) {
+            e->key = true;
+            return false;
+        }
+        e->out = out;
+        e->out_cap = need;
+    }
+    if (!fc_grow_u32(&e->sizes, &e->sizes_cap, ntiles)) {
+        e->key = true;
+        return false;
+    }
+    if (e->key) memset(e->prev, 0, row * (size_t)c->h);
+    return true;
+}
+
+/* XOR-RLE ops over d[0, n); 0 when they would not fit in limit bytes */
+static size_t fc_encode_rle(const uint32_t* d, size_t n, int bpp, uint8_t* out, size_t limit) {
+    size_t o = 0;
+    for (size_t i = 0; i < n;) {
+        size_t k = 1;
+        if (d[i] == 0) {
+            while (i + k < n && k < 128 && d[i + k] == 0) ++k;
+            if (o + 1 > limit) return 0;
+            out[o++] = (uint8_t)(k - 1);
+        } else if (i + 1 < n && d[i + 1] == d[i]) {
+            while (i + k < n && k < 64 && d[i + k] == d[i]) ++k;
+            if (o + 1 + (size_t)bpp > limit) return 0;
+            out[o++] = (uint8_t)(0xC0u | (k - 1));
+            fc_pkt_store(out + o, d[i], bpp);
+            o += (size_t)bpp;
+        } else {
+            /* literals up to the next unchanged pixel or repeat */
+            while (i + k < n && k < 64 && d[i + k] != 0 &&
+                   (i + k + 1 >= n || d[i + k + 1] != d[i + k])) ++k;
+            if (o + 1 + k * (size_t)bpp > limit) return 0;
+            out[o++] = (uint8_t)(0x80u | (k - 1));
+            for (size_t j = 0; j < k; ++j, o += (size_t)bpp) fc_pkt_store(out + o, d[i + j], bpp);
+        }
+        i += k;
+    }
+    return o;
+}
+
+static void fc_encode_tile(fc_ctx* c, int index) {
+    fc_encoder* e = c->enc;
+    const int tx = index % e->tiles_x, ty = index / e->tiles_x;
+    const fc_irect fb = { 0, 0, c->w, c->h };
+    const fc_irect cell = { tx * FC_TILE, ty * FC_TILE, tx * FC_TILE + FC_TILE, ty * FC_TILE + FC_TILE };
+    fc_irect tile, box;
+    fc_irect_intersect(&fb, &cell, &tile);
+    e->sizes[index] = 0;
+    if (e->key) {
+        box = tile;
+    } else {
+        bool any = false;
+        for (int i = 0; i < c->damage_count; ++i) {
+            fc_irect r;
+            if (!fc_irect_intersect(&c->damage[i], &tile, &r)) continue;
+            box = any ? fc_irect_union(&box, &r) : r;
+            any = true;
+        }
+        if (!any) return;
+    }
+
+    const int bpp = c->bpp, bw = box.x1 - box.x0, bh = box.y1 - box.y0;
+    const size_t prow = (size_t)c->w * (size_t)bpp, len = (size_t)bw * (size_t)bpp;
+    uint32_t d[FC_TILE * FC_TILE];
+    size_t n = 0;
+    for (int y = box.y0; y < box.y1; ++y) {
+        const uint8_t* src = c->pixels + (size_t)y * (size_t)c->pitch + (size_t)box.x0 * (size_t)bpp;
+        uint8_t* old = e->prev + (size_t)y * prow + (size_t)box.x0 * (size_t)bpp;
+        for (int x = 0; x < bw; ++x) {
+            d[n++] = fc_pkt_load(src + (size_t)x * (size_t)bpp, bpp) ^
+                     fc_pkt_load(old + (size_t)x * (size_t)bpp, bpp);
+        }
+        memcpy(old, src, len);
+    }
+
+    uint8_t* slot = e->out + FC_PKT_HEADER + (size_t)index * e->slot;
+    uint8_t* payload = slot + FC_PKT_TILE;
+    const size_t raw = len * (size_t)bh;
+    size_t size = fc_encode_rle(d, n, bpp, payload, raw - 1u);
+    uint8_t mode = FC_PKT_RLE;
+    if (size == 0) {
+        /* the new pixels themselves: they are in prev by now */
+        for (int y = box.y0; y < box.y1; ++y) {
+            memcpy(payload + (size_t)(y - box.y0) * len,
+                   e->prev + (size_t)y * prow + (size_t)box.x0 * (size_t)bpp, len);
+        }
+        size = raw;
+        mode = FC_PKT_RAW;
+    }
+    fc_put16(slot, (uint32_t)tx);
+    fc_put16(slot + 2, (uint32_t)ty);
+    slot[4] = (uint8_t)(box.x0 - tile.x0);
+    slot[5] = (uint8_t)(box.y0 - tile.y0);
+    slot[6] = (uint8_t)bw;
+    slot[7] = (uint8_t)bh;
+    slot[8] = mode;
+    slot[9] = slot[10] = slot[11] = 0;
+    fc_put32(slot + 12, (uint32_t)size);
+    e->sizes[index] = (uint32_t)(FC_PKT_TILE + size);
+}
+
+static void fc_encode_job(void* arg, int index, int worker) {
+    (void)worker;
+    fc_encode_tile((fc_ctx*)arg, index);
+}
+
+/* Finish the frame's packet and hand it over; 'encoded' when the tile
+   executor already coded every tile */
+static void fc_encode_frame(fc_ctx* c, bool encoded) {
+    fc_encoder* e = c->enc;
+    if (!encoded) {
+        if (!fc_encode_prepare(c)) return;
+        fc_pool_run(c->pool, fc_encode_job, c, e->tiles_x * e->tiles_y);
+    }
+    const size_t ntiles = (size_t)e->tiles_x * (size_t)e->tiles_y;
+    size_t o = FC_PKT_HEADER;
+    uint32_t count = 0;
+    for (size_t t = 0; t < ntiles; ++t) {
+        if (!e->sizes[t]) continue;
+        memmove(e->out + o, e->out + FC_PKT_HEADER + t * e->slot, e->sizes[t]);
+        o += e->sizes[t];
+        ++count;
+    }
+    uint8_t* h = e->out;
+    memcpy(h, g_pkt_magic, 4);
+    fc_put32(h + 4, e->sequence++);
+    fc_put32(h + 8, (uint32_t)c->w);
+    fc_put32(h + 12, (uint32_t)c->h);
+    h[16] = (uint8_t)c->format;
+    h[17] = e->key ? FC_PKT_KEY : 0;
+    fc_put16(h + 18, 0);
+    fc_put32(h + 20, count);
+    e->key = false;
+    e->fn(e->out, o, e->userdata);
+}
+
+fossil_cube_result fossil_cube_decode_info(const uint8_t* data, size_t size,
+                                           fossil_cube_packet_info* out_info) {
+    if (!data || !out_info || size < FC_PKT_HEADER || memcmp(data, g_pkt_magic, 4) != 0) {
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    const uint32_t w = fc_get32(data + 8), h = fc_get32(data + 12), tiles = fc_get32(data + 20);
+    const fossil_cube_format format = (fossil_cube_format)data[16];
+    if (w == 0 || h == 0 || w > INT_MAX || h > INT_MAX || tiles > INT_MAX || !fc_format_valid(format)) {
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    out_info->width = (int)w;
+    out_info->height = (int)h;
+    out_info->format = format;
+    out_info->sequence = fc_get32(data + 4);
+    out_info->key = (data[17] & FC_PKT_KEY) != 0;
+    out_info->tile_count = (int)tiles;
+    return FOSSIL_CUBE_OK;
+}
+
+/* Apply XOR-RLE ops to a w x h box (row step pitch); false if they do
+   not cover it exactly */
+static bool fc_decode_rle(const uint8_t* p, size_t size, uint8_t* dst, int pitch,
+                          int w, int h, int bpp) {
+    const size_t n = (size_t)w * (size_t)h;
+    size_t i = 0, o = 0;
+    int x = 0;
+    uint8_t* row = dst;
+    while (o < size) {
+        const uint8_t op = p[o++];
+        const size_t k = (size_t)(op & (op & 0x80u ? 0x3Fu : 0x7Fu)) + 1u;
+        if (k > n - i) return false;
+        const bool literal = (op & 0xC0u) == 0x80u;
+        const size_t payload = (op & 0x80u) ? (literal ? k : 1u) * (size_t)bpp : 0u;
+        if (payload > size - o) return false;
+        const uint8_t* v = p + o;
+        o += payload;
+        for (size_t j = 0; j < k; ++j) {
+            if (op & 0x80u) {
+                uint8_t* px = row + (size_t)x * (size_t)bpp;
+                fc_pkt_store(px, fc_pkt_load(px, bpp) ^ fc_pkt_load(v, bpp), bpp);
+                if (literal) v += bpp;
+            }
+            if (++x == w) {
+                x = 0;
+                row += pitch;
+            }
+        }
+        i += k;
+    }
+    return i == n;
+}
+
+fossil_cube_result fossil_cube_decode(const uint8_t* data, size_t size,
+                                      uint8_t* pixels, int width, int height, int pitch,
+                                      fossil_cube_format format) {
+    fossil_cube_packet_info info;
+    if (fossil_cube_decode_info(data, size, &info) != FOSSIL_CUBE_OK || !pixels) return FOSSIL_CUBE_ERR_BADARGS;
+    if (info.width != width || info.height != height || info.format != format) return FOSSIL_CUBE_ERR_BADARGS;
+    const int bpp = g_formats[format].bpp;
+    const long long row = (long long)width * bpp;
+    if (row > INT_MAX || (pitch != 0 && pitch < row)) return FOSSIL_CUBE_ERR_BADARGS;
+    if (pitch == 0) pitch = (int)row;
+
+    size_t o = FC_PKT_HEADER;
+    for (int t = 0; t < info.tile_count; ++t) {
+        if (size - o < FC_PKT_TILE) return FOSSIL_CUBE_ERR_BADARGS;
+        const uint8_t* tile = data + o;
+        const long long x = (long long)fc_get16(tile) * FC_TILE + tile[4];
+        const long long y = (long long)fc_get16(tile + 2) * FC_TILE + tile[5];
+        const int w = tile[6], h = tile[7];
+        const size_t len = fc_get32(tile + 12);
+        o += FC_PKT_TILE;
+        if (w == 0 || h == 0 || tile[4] + w > FC_TILE || tile[5] + h > FC_TILE ||
+            x + w > width || y + h > height || len > size - o) {
+            return FOSSIL_CUBE_ERR_BADARGS;
+        }
+        uint8_t* dst = pixels + (size_t)y * (size_t)pitch + (size_t)x * (size_t)bpp;
+        const size_t box_row = (size_t)w * (size_t)bpp;
+        if (tile[8] == FC_PKT_RAW) {
+            if (len != box_row * (size_t)h) return FOSSIL_CUBE_ERR_BADARGS;
+            for (int j = 0; j < h; ++j) memcpy(dst + (size_t)j * (size_t)pitch, data + o + (size_t)j * box_row, box_row);
+        } else if (tile[8] == FC_PKT_RLE) {
+            if (info.key) {
+                for (int j = 0; j < h; ++j) memset(dst + (size_t)j * (size_t)pitch, 0, box_row);
+            }
+            if (!fc_decode_rle(data + o, len, dst, pitch, w, h, bpp)) return FOSSIL_CUBE_ERR_BADARGS;
+        } else {
+            return FOSSIL_CUBE_ERR_BADARGS;
+        }
+        o += len;
+    }
+    return FOSSIL_CUBE_OK;
+}
+
+/* =========================
+   Framebuffer memory
+   =========================
+   Framebuffers come from the allocator hook or an aligned malloc, with
+   rows optionally padded to the same alignment. External buffers are
+   rendered into in place and never freed here.
+*/
+
+static void* fc_aligned_malloc(size_t size, size_t align) {
+    if (size > SIZE_MAX - align - sizeof(void*)) return NULL;
+    uint8_t* raw = (uint8_t*)malloc(size + align - 1 + sizeof(void*));
+    if (!raw) return NULL;
+    const uintptr_t at = ((uintptr_t)raw + sizeof(void*) + align - 1) & ~(uintptr_t)(align - 1);
+    void* p = raw + (at - (uintptr_t)raw);
+    memcpy((uint8_t*)p - sizeof(void*), &raw, sizeof(raw));
+    return p;
+}
+
+static void fc_aligned_free(void* p) {
+    if (!p) return;
+    void* raw;
+    memcpy(&raw, (uint8_t*)p - sizeof(void*), sizeof(raw));
+    free(raw);
+}
+
+static uint8_t* fc_fb_alloc(const fc_ctx* c, size_t size) {
+    if (c->allocator.alloc) return (uint8_t*)c->allocator.alloc(size, c->align, c->allocator.user);
+    return (uint8_t*)fc_aligned_malloc(size, c->align);
+}
+
+static void fc_fb_free(const fc_ctx* c, void* p, size_t size) {
+    if (!p) return;
+    if (c->allocator.alloc) {
+        if (c->allocator.free) c->allocator.free(p, size, c->allocator.user);
+        return;
+    }
+    fc_aligned_free(p);
+}
+
+/* Row pitch for an internally allocated framebuffer; 0 if it overflows */
+static int fc_fb_pitch(const fc_ctx* c, int width) {
+    long long pitch = (long long)width * c->bpp;
+    if (c->pad_rows) pitch = (pitch + (long long)c->align - 1) & ~((long long)c->align - 1);
+    return pitch <= INT_MAX ? (int)pitch : 0;
+}
+
+static inline size_t fc_fb_size(const fc_ctx* c) {
+    return (size_t)c->pitch * (size_t)c->h;
+}
+
+/* =========================
+   Images
+   =========================
+   Pixels are stored premultiplied so every draw can take the cheaper
+   premultiplied path. Opaque runs shorter than FC_RUN_MIN and
+   transparent gaps shorter than it inside a row are folded into the
+   neighbouring translucent run; the blend handles both exactly and a
+   long row of tiny runs would otherwise cost more in loop overhead than
+   it saves.
+*/
+
+enum { FC_RUN_MIN = 8 };
+
+static bool fc_image_row_push(fc_image_row* row, int x0, int x1, bool opaque) {
+    if (row->count > 0) {
+        fc_run* last = &row->runs[row->count - 1];
+        if (last->x1 == x0 && last->opaque == opaque) {
+            last->x1 = x1;
+            return true;
+        }
+    }
+    if (row->count == row->cap) {
+        const int ncap = row->cap ? row->cap * 2 : 4;
+        fc_run* n = (fc_run*)realloc(row->runs, (size_t)ncap * sizeof(*n));
+        if (!n) return false;
+        row->runs = n;
+        row->cap = ncap;
+    }
+    row->runs[row->count].x0 = x0;
+    row->runs[row->count].x1 = x1;
+    row->runs[row->count].opaque = opaque;
+    ++row->count;
+    return true;
+}
+
+static inline bool fc_image_row_full(const fossil_cube_image* img, const fc_image_row* row) {
+    return row->count == 1 && row->runs[0].opaque && row->runs[0].x0 == 0 && row->runs[0].x1 == img->w;
+}
+
+/* 0: transparent, 1: opaque, 2: translucent */
+static inline int fc_alpha_class(uint8_t a) {
+    return a == 0 ? 0 : (a == 255 ? 1 : 2);
+}
+
+/* Rebuild the runs of row y; on OOM the whole row is blended, which
+   draws correctly, just slower */
+static bool fc_image_classify(fossil_cube_image* img, int y) {
+    fc_image_row* row = &img->rows[y];
+    const bool was_full = fc_image_row_full(img, row);
+    const uint8_t* p = img->pixels + (size_t)y * (size_t)img->pitch;
+    bool ok = true;
+    row->count = 0;
+    for (int x = 0; x < img->w && ok;) {
+        const int kind = fc_alpha_class(p[(size_t)x * 4u + 3]);
+        int x1 = x + 1;
+        while (x1 < img->w && fc_alpha_class(p[(size_t)x1 * 4u + 3]) == kind) ++x1;
+        const bool longish = x1 - x >= FC_RUN_MIN;
+        if (kind == 0 && (longish || x == 0 || x1 == img->w)) {
+            x = x1; /* skipped gap */
+            continue;
+        }
+        ok = fc_image_row_push(row, x, x1, kind == 1 && longish);
+        x = x1;
+    }
+    row->blend_all = !ok;
+    if (!ok) row->count = 0;
+    img->opaque_rows += (int)fc_image_row_full(img, row) - (int)was_full;
+    return ok;
+}
+
+/* Copy a source rect in, premultiplied, with transparent pixels zeroed */
+static void fc_image_load(fossil_cube_image* img, int x, int y, const uint8_t* rgba,
+                          int w, int h, int pitch, fossil_cube_alpha alpha) {
+    for (int j = 0; j < h; ++j) {
+        const uint8_t* s = rgba + (size_t)j * (size_t)pitch;
+        uint8_t* d = img->pixels + (size_t)(y + j) * (size_t)img->pitch + (size_t)x * 4u;
+        memcpy(d, s, (size_t)w * 4u);
+        for (int i = 0; i < w; ++i, d += 4) {
+            const uint8_t a = d[3];
+            if (a == 255) continue;
+            if (a == 0) { memset(d, 0, 4); continue; }
+            if (alpha == FOSSIL_CUBE_ALPHA_STRAIGHT) {
+                d[0] = fc_premul(d[0], a); d[1] = fc_premul(d[1], a); d[2] = fc_premul(d[2], a);
+            }
+        }
+    }
+}
+
+void fossil_cube_image_destroy(fossil_cube_image* img) {
+    if (!img) return;
+    if (img->rows) {
+        for (int y = 0; y < img->h; ++y) free(img->rows[y].runs);
+        free(img->rows);
+    }
+    fc_aligned_free(img->pixels);
+    free(img);
+}
+
+fossil_cube_result fossil_cube_image_create(fossil_cube_image** out, const uint8_t* rgba,
+                                            int width, int height, int pitch,
+                                            fossil_cube_alpha alpha) {
+    if (!out) return FOSSIL_CUBE_ERR_BADARGS;
+    *out = NULL;
+    if (width <= 0 || height <= 0) return FOSSIL_CUBE_ERR_BADARGS;
+    const long long row = (long long)width * 4;
+    const long long ipitch = (row + FOSSIL_CUBE_DEFAULT_ALIGN - 1) & ~(long long)(FOSSIL_CUBE_DEFAULT_ALIGN - 1);
+    if (ipitch > INT_MAX || (pitch != 0 && pitch < row)) return FOSSIL_CUBE_ERR_BADARGS;
+    if ((size_t)ipitch > SIZE_MAX / (size_t)height) return FOSSIL_CUBE_ERR_OOM;
+
+    fossil_cube_image* img = (fossil_cube_image*)calloc(1, sizeof(*img));
+    if (!img) return FOSSIL_CUBE_ERR_OOM;
+    img->w = width;
+    img->h = height;
+    img->pitch = (int)ipitch;
+    img->pixels = (uint8_t*)fc_aligned_malloc((size_t)ipitch * (size_t)height, FOSSIL_CUBE_DEFAULT_ALIGN);
+    img->rows = (fc_image_row*)calloc((size_t)height, sizeof(*img->rows));
+    if (!img->pixels || !img->rows) {
+        fossil_cube_image_destroy(img);
+        return FOSSIL_CUBE_ERR_OOM;
+    }
+    memset(img->pixels, 0, (size_t)ipitch * (size_t)height);
+    if (rgba) {
+        /* NULL rgba: a transparent image (an empty atlas to update into) */
+        fc_image_load(img, 0, 0, rgba, width, height, pitch ? pitch : (int)row, alpha);
+        for (int y = 0; y < height; ++y) (void)fc_image_classify(img, y);
+    }
+    *out = img;
+    return FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_image_update(fossil_cube_image* img, int x, int y,
+                                            const uint8_t* rgba, int width, int height, int pitch,
+                                            fossil_cube_alpha alpha) {
+    if (!img || !rgba || width <= 0 || height <= 0 || x < 0 || y < 0 ||
+        width > img->w - x || height > img->h - y) {
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    const int row = width * 4;
+    if (pitch != 0 && pitch < row) return FOSSIL_CUBE_ERR_BADARGS;
+    fc_image_load(img, x, y, rgba, width, height, pitch ? pitch : row, alpha);
+    fossil_cube_result res = FOSSIL_CUBE_OK;
+    for (int j = y; j < y + height; ++j) {
+        if (!fc_image_classify(img, j)) res = FOSSIL_CUBE_ERR_OOM;
+    }
+    return res;
+}
+
+int fossil_cube_image_width(const fossil_cube_image* img) { return img ? img->w : 0; }
+int fossil_cube_image_height(const fossil_cube_image* img) { return img ? img->h : 0; }
+
+/* =========================
+   Paints
+   =========================
+   Construction only; the shaders are with the rasterizers. Ramp entry i
+   is the color at offset (i + 0.5) / FC_RAMP_SIZE, interpolated between
+   the premultiplied stops around it.
+*/
+
+static inline bool fc_finite(float v) {
+    return v == v && v - v == 0.0f;
+}
+
+static inline float fc_clamp01(float v) {
+    return v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+}
+
+static inline int64_t fc_round_i64(double v) {
+    const double lim = 72057594037927936.0; /* 2^56: t0 + x*dtx stays in int64 */
+    v = v < -lim ? -lim : v > lim ? lim : v;
+    return (int64_t)(v < 0.0 ? v - 0.5 : v + 0.5);
+}
+
+static fossil_cube_result fc_paint_gradient(fossil_cube_paint** out, fc_paint_kind kind,
+                                            const fossil_cube_color_stop* stops, int count,
+                                            fossil_cube_extend extend) {
+    if (!out) return FOSSIL_CUBE_ERR_BADARGS;
+    *out = NULL;
+    if (!stops || count <= 0 || (unsigned)extend > FOSSIL_CUBE_EXTEND_REFLECT) return FOSSIL_CUBE_ERR_BADARGS;
+    for (int i = 0; i < count; ++i) {
+        if (!fc_finite(stops[i].offset)) return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    fossil_cube_paint* p = (fossil_cube_paint*)calloc(1, sizeof(*p));
+    if (!p) return FOSSIL_CUBE_ERR_OOM;
+    p->kind = (uint8_t)kind;
+    p->extend = (uint8_t)extend;
+    p->opaque = true;
+
+    int k = 0; /* last stop at or before the entry, at offset lo */
+    float lo = fc_clamp01(stops[0].offset);
+    for (int i = 0; i < FC_RAMP_SIZE; ++i) {
+        const float pos = ((float)i + 0.5f) / (float)FC_RAMP_SIZE;
+        /* offsets clamped to [0, 1] and raised to their predecessor */
+        float hi = lo;
+        while (k + 1 < count) {
+            hi = fc_clamp01(stops[k + 1].offset);
+            if (hi < lo) hi = lo;
+            if (hi > pos) break;
+            ++k;
+            lo = hi;
+        }
+        const fossil_cube_color_stop* s0 = &stops[k];
+        const fossil_cube_color_stop* s1 = s0;
+        float f = 0.0f;
+        if (k + 1 < count && pos > lo) {
+            s1 = &stops[k + 1];
+            f = (pos - lo) / (hi - lo);
+        }
+        const uint8_t c0[4] = { fc_premul(s0->r, s0->a), fc_premul(s0->g, s0->a), fc_premul(s0->b, s0->a), s0->a };
+        const uint8_t c1[4] = { fc_premul(s1->r, s1->a), fc_premul(s1->g, s1->a), fc_premul(s1->b, s1->a), s1->a };
+        uint8_t px[4];
+        for (int ch = 0; ch < 4; ++ch) {
+            px[ch] = (uint8_t)((float)c0[ch] + ((float)c1[ch] - (float)c0[ch]) * f + 0.5f);
+        }
+        p->ramp[i] = fc_pack(px[0], px[1], px[2], px[3]);
+        p->opaque = p->opaque && px[3] == 255;
+    }
+    *out = p;
+    return FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_paint_linear(fossil_cube_paint** out, float x0, float y0, float x1, float y1,
+                                            const fossil_cube_color_stop* stops, int count,
+                                            fossil_cube_extend extend) {
+    if (out) *out = NULL;
+    if (!fc_finite(x0) || !fc_finite(y0) || !fc_finite(x1) || !fc_finite(y1)) return FOSSIL_CUBE_ERR_BADARGS;
+    const fossil_cube_result res = fc_paint_gradient(out, FC_PAINT_LINEAR, stops, count, extend);
+    if (res != FOSSIL_CUBE_OK) return res;
+    fossil_cube_paint* p = *out;
+    /* t = (pixel center - p0) . (p1 - p0) / |p1 - p0|^2, per pixel step
+       clamped to a whole ramp */
+    const double dx = (double)x1 - x0, dy = (double)y1 - y0;
+    const double len2 = dx * dx + dy * dy;
+    if (!(len2 > 0.0)) {
+        p->t0 = FC_RAMP_ONE - 1; /* the last stop in every extend mode */
+        return FOSSIL_CUBE_OK;
+    }
+    double gx = dx / len2 * FC_RAMP_ONE, gy = dy / len2 * FC_RAMP_ONE;
+    gx = gx < -FC_RAMP_ONE ? -FC_RAMP_ONE : gx > FC_RAMP_ONE ? FC_RAMP_ONE : gx;
+    gy = gy < -FC_RAMP_ONE ? -FC_RAMP_ONE : gy > FC_RAMP_ONE ? FC_RAMP_ONE : gy;
+    p->dtx = fc_round_i64(gx);
+    p->dty = fc_round_i64(gy);
+    p->t0 = fc_round_i64((0.5 - x0) * gx + (0.5 - y0) * gy);
+    return FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_paint_radial(fossil_cube_paint** out, float cx, float cy, float radius,
+                                            const fossil_cube_color_stop* stops, int count,
+                                            fossil_cube_extend extend) {
+    if (out) *out = NULL;
+    if (!fc_finite(cx) || !fc_finite(cy) || !fc_finite(radius) || !(radius > 0.0f)) return FOSSIL_CUBE_ERR_BADARGS;
+    const fossil_cube_result res = fc_paint_gradient(out, FC_PAINT_RADIAL, stops, count, extend);
+    if (res != FOSSIL_CUBE_OK) return res;
+    (*out)->cx = cx;
+    (*out)->cy = cy;
+    (*out)->scale = (float)FC_RAMP_ONE / radius;
+    return FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_paint_pattern(fossil_cube_paint** out, const fossil_cube_image* image,
+                                             int origin_x, int origin_y) {
+    if (!out) return FOSSIL_CUBE_ERR_BADARGS;
+    *out = NULL;
+    if (!image) return FOSSIL_CUBE_ERR_BADARGS;
+    fossil_cube_paint* p = (fossil_cube_paint*)calloc(1, sizeof(*p));
+    if (!p) return FOSSIL_CUBE_ERR_OOM;
+    p->kind = FC_PAINT_PATTERN;
+    p->image = image;
+    p->ox = origin_x;
+    p->oy = origin_y;
+    *out = p;
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_paint_destroy(fossil_cube_paint* paint) {
+    free(paint);
+}
+
+/* =========================
+   Clip regions
+   =========================
+   Built by a sweep over the distinct rect edges, top to bottom: the slab
+   between two edges gets the merged x-intervals of the rects covering
+   it, minus those of the subtracted rects, and a slab whose spans match
+   the band just above extends that band. Bands and spans are packed
+   behind the region in one block.
+*/
+
+static int fc_int_cmp(const void* a, const void* b) {
+    const int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static int fc_xspan_cmp(const void* a, const void* b) {
+    return fc_int_cmp(&((const fc_xspan*)a)->x0, &((const fc_xspan*)b)->x0);
+}
+
+/* Non-empty rects as boxes, right and bottom edges clamped to INT_MAX */
+static int fc_region_boxes(const fossil_cube_rect* rects, int count, fc_irect* out) {
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        const fossil_cube_rect* r = &rects[i];
+        if (r->w <= 0 || r->h <= 0) continue;
+        const long long x1 = (long long)r->x + r->w, y1 = (long long)r->y + r->h;
+        out[n].x0 = r->x;
+        out[n].y0 = r->y;
+        out[n].x1 = x1 > INT_MAX ? INT_MAX : (int)x1;
+        out[n].y1 = y1 > INT_MAX ? INT_MAX : (int)y1;
+        ++n;
+    }
+    return n;
+}
+
+/* Sorted, merged x-intervals of the boxes covering slab [ya, yb) */
+static int fc_region_slab(const fc_irect* boxes, int count, int ya, int yb, fc_xspan* out) {
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        if (boxes[i].y0 <= ya && boxes[i].y1 >= yb) {
+            out[n].x0 = boxes[i].x0;
+            out[n].x1 = boxes[i].x1;
+            ++n;
+        }
+    }
+    if (n < 2) return n;
+    qsort(out, (size_t)n, sizeof(*out), fc_xspan_cmp);
+    int m = 0;
+    for (int i = 1; i < n; ++i) {
+        if (out[i].x0 <= out[m].x1) {
+            if (out[i].x1 > out[m].x1) out[m].x1 = out[i].x1;
+        } else {
+            out[++m] = out[i];
+        }
+    }
+    return m + 1;
+}
+
+/* a minus b, both sorted and merged; out holds na + nb */
+static int fc_xspan_subtract(const fc_xspan* a, int na, const fc_xspan* b, int nb, fc_xspan* out) {
+    int n = 0, j = 0;
+    for (int i = 0; i < na; ++i) {
+        int cur = a[i].x0;
+        while (j < nb && b[j].x1 <= cur) ++j;
+        for (int k = j; k < nb && b[k].x0 < a[i].x1; ++k) {
+            if (b[k].x0 > cur) {
+                out[n].x0 = cur;
+                out[n].x1 = b[k].x0;
+                ++n;
+            }
+            if (b[k].x1 > cur) cur = b[k].x1;
+        }
+        if (cur < a[i].x1) {
+            out[n].x0 = cur;
+            out[n].x1 = a[i].x1;
+            ++n;
+        }
+    }
+    return n;
+}
+
+/* Bands and spans as the sweep produces them */
+typedef struct fc_region_acc {
+    fc_band* bands;
+    fc_xspan* spans;
+    size_t band_cap, span_cap;
+    int band_count, span_count;
+} fc_region_acc;
+
+static bool fc_region_append(fc_region_acc* acc, int ya, int yb, const fc_xspan* spans, int n) {
+    fc_band* prev = acc->band_count ? &acc->bands[acc->band_count - 1] : NULL;
+    if (prev && prev->y1 == ya && prev->count == n &&
+        memcmp(acc->spans + prev->first, spans, (size_t)n * sizeof(*spans)) == 0) {
+        prev->y1 = yb;
+        return true;
+    }
+    if ((size_t)acc->band_count == acc->band_cap) {
+        const size_t ncap = acc->band_cap ? acc->band_cap * 2u : 16u;
+        fc_band* nb = (fc_band*)realloc(acc->bands, ncap * sizeof(*nb));
+        if (!nb) return false;
+        acc->bands = nb;
+        acc->band_cap = ncap;
+    }
+    if ((size_t)acc->span_count + (size_t)n > acc->span_cap) {
+        size_t ncap = acc->span_cap ? acc->span_cap * 2u : 64u;
+        while (ncap < (size_t)acc->span_count + (size_t)n) ncap *= 2u;
+        fc_xspan* ns = (fc_xspan*)realloc(acc->spans, ncap * sizeof(*ns));
+        if (!ns) return false;
+        acc->spans = ns;
+        acc->span_cap = ncap;
+    }
+    fc_band* bd = &acc->bands[acc->band_count++];
+    bd->y0 = ya;
+    bd->y1 = yb;
+    bd->first = acc->span_count;
+    bd->count = n;
+    memcpy(acc->spans + acc->span_count, spans, (size_t)n * sizeof(*spans));
+    acc->span_count += n;
+    return true;
+}
+
+/* Sweep na boxes to add and ns to subtract; ys holds 2 * (na + ns) ints
+   and slab 3 * (na + ns) spans of scratch */
+static bool fc_region_sweep(fc_region_acc* acc, const fc_irect* boxes, int na, int ns, int* ys, fc_xspan* slab) {
+    int ny = 0;
+    for (int i = 0; i < na + ns; ++i) {
+        ys[ny++] = boxes[i].y0;
+        ys[ny++] = boxes[i].y1;
+    }
+    qsort(ys, (size_t)ny, sizeof(*ys), fc_int_cmp);
+    fc_xspan* add = slab;
+    fc_xspan* cut = slab + na;
+    fc_xspan* left = slab + na + ns;
+    for (int i = 0; i + 1 < ny; ++i) {
+        const int ya = ys[i], yb = ys[i + 1];
+        if (ya == yb) continue;
+        const int nadd = fc_region_slab(boxes, na, ya, yb, add);
+        if (nadd == 0) continue;
+        const int ncut = fc_region_slab(boxes + na, ns, ya, yb, cut);
+        const int n = fc_xspan_subtract(add, nadd, cut, ncut, left);
+        if (n > 0 && !fc_region_append(acc, ya, yb, left, n)) return false;
+    }
+    return true;
+}
+
+/* One block: the region, then its bands, then its spans */
+static fossil_cube_region* fc_region_pack(const fc_region_acc* acc) {
+    const int nb = acc->band_count, ns = acc->span_count;
+    fossil_cube_region* rg = (fossil_cube_region*)malloc(sizeof(*rg) + (size_t)nb * sizeof(fc_band) +
+                                                         (size_t)ns * sizeof(fc_xspan));
+    if (!rg) return NULL;
+    memset(&rg->bounds, 0, sizeof(rg->bounds));
+    rg->band_count = nb;
+    rg->span_count = ns;
+    rg->bands = (fc_band*)(rg + 1);
+    rg->spans = (fc_xspan*)(rg->bands + nb);
+    if (nb == 0) return rg;
+    memcpy(rg->bands, acc->bands, (size_t)nb * sizeof(fc_band));
+    memcpy(rg->spans, acc->spans, (size_t)ns * sizeof(fc_xspan));
+    rg->bounds.x0 = INT_MAX;
+    rg->bounds.x1 = INT_MIN;
+    for (int i = 0; i < nb; ++i) {
+        const fc_xspan* first = &rg->spans[rg->bands[i].first];
+        const fc_xspan* last = first + rg->bands[i].count - 1;
+        if (first->x0 < rg->bounds.x0) rg->bounds.x0 = first->x0;
+        if (last->x1 > rg->bounds.x1) rg->bounds.x1 = last->x1;
+    }
+    rg->bounds.y0 = rg->bands[0].y0;
+    rg->bounds.y1 = rg->bands[nb - 1].y1;
+    return rg;
+}
+
+static fossil_cube_result fc_region_build(fossil_cube_region** out, const fossil_cube_rect* rects, int count,
+                                          const fossil_cube_rect* sub, int sub_count) {
+    if (!out) return FOSSIL_CUBE_ERR_BADARGS;
+    *out = NULL;
+    if (count < 0 || sub_count < 0 || (count > 0 && !rects) || (sub_count > 0 && !sub)) {
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    const size_t total = (size_t)count + (size_t)sub_count + 1u;
+    fc_irect* boxes = (fc_irect*)malloc(total * sizeof(*boxes));
+    int* ys = (int*)malloc(total * 2u * sizeof(*ys));
+    fc_xspan* slab = (fc_xspan*)malloc(total * 3u * sizeof(*slab));
+    fc_region_acc acc;
+    memset(&acc, 0, sizeof(acc));
+    bool ok = boxes && ys && slab;
+    if (ok) {
+        const int na = fc_region_boxes(rects, count, boxes);
+        const int ns = fc_region_boxes(sub, sub_count, boxes + na);
+        ok = fc_region_sweep(&acc, boxes, na, ns, ys, slab);
+    }
+    if (ok) *out = fc_region_pack(&acc);
+    free(boxes);
+    free(ys);
+    free(slab);
+    free(acc.bands);
+    free(acc.spans);
+    return *out ? FOSSIL_CUBE_OK : FOSSIL_CUBE_ERR_OOM;
+}
+
+fossil_cube_result fossil_cube_region_create(fossil_cube_region** out_region,
+                                             const fossil_cube_rect* rects, int count) {
+    return fc_region_build(out_region, rects, count, NULL, 0);
+}
+
+fossil_cube_result fossil_cube_region_create_diff(fossil_cube_region** out_region,
+                                                  const fossil_cube_rect* rects, int count,
+                                                  const fossil_cube_rect* subtract, int subtract_count) {
+    return fc_region_build(out_region, rects, count, subtract, subtract_count);
+}
+
+void fossil_cube_region_destroy(fossil_cube_region* region) {
+    free(region);
+}
+
+fossil_cube_rect fossil_cube_region_bounds(const fossil_cube_region* region) {
+    fossil_cube_rect r = { 0, 0, 0, 0 };
+    if (region && region->band_count) {
+        r.x = region->bounds.x0;
+        r.y = region->bounds.y0;
+        r.w = region->bounds.x1 - region->bounds.x0;
+        r.h = region->bounds.y1 - region->bounds.y0;
+    }
+    return r;
+}
+
+int fossil_cube_region_rects(const fossil_cube_region* region, fossil_cube_rect* out_rects, int max_rects) {
+    if (!region) return 0;
+    if (!out_rects) return region->span_count;
+    int n = 0;
+    for (int i = 0; i < region->band_count; ++i) {
+        const fc_band* bd = &region->bands[i];
+        for (int j = bd->first; j < bd->first + bd->count && n < max_rects; ++j) {
+            out_rects[n].x = region->spans[j].x0;
+            out_rects[n].y = bd->y0;
+            out_rects[n].w = region->spans[j].x1 - region->spans[j].x0;
+            out_rects[n].h = bd->y1 - bd->y0;
+            ++n;
+        }
+    }
+    return n;
+}
+
+/* =========================
+   Swapchain
+   =========================
+   With N >= 2 buffers end_frame hands the finished buffer to present and
+   moves drawing to a free one; the consumer gives it back with
+   release_buffer. Each buffer keeps the damage of frames presented since
+   it was last current, and those rects are copied from the newest buffer
+   the first time it is touched again (a full clear skips the copy).
+*/
+
+typedef struct fc_swap {
+    uint8_t* bufs[FOSSIL_CUBE_MAX_BUFFERS];
+    bool busy[FOSSIL_CUBE_MAX_BUFFERS]; /* handed to present, not released */
+    fc_irect stale[FOSSIL_CUBE_MAX_BUFFERS][FOSSIL_CUBE_MAX_DAMAGE];
+    int stale_count[FOSSIL_CUBE_MAX_BUFFERS];
+    int count, cur, prev;
+    bool pending; /* current buffer still owes its stale rects */
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+    fc_mutex lock;
+    fc_cond freed;
+#endif
+} fc_swap;
+
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+#define fc_swap_lock(s)   fc_mutex_lock(&(s)->lock)
+#define fc_swap_unlock(s) fc_mutex_unlock(&(s)->lock)
+#else
+#define fc_swap_lock(s)   ((void)(s))
+#define fc_swap_unlock(s) ((void)(s))
+#endif
+
+static void fc_swap_sync(fc_ctx* c) {
+    fc_swap* s = c->swap;
+    if (!s || !s->pending) return;
+    s->pending = false;
+    const uint8_t* src = s->bufs[s->prev];
+    for (int i = 0; i < s->stale_count[s->cur]; ++i) {
+        const fc_irect* r = &s->stale[s->cur][i];
+        const size_t off = (size_t)r->y0 * (size_t)c->pitch + (size_t)r->x0 * (size_t)c->bpp;
+        const size_t len = (size_t)(r->x1 - r->x0) * (size_t)c->bpp;
+        for (int y = r->y0; y < r->y1; ++y) {
+            const size_t row = off + (size_t)(y - r->y0) * (size_t)c->pitch;
+            memcpy(c->pixels + row, src + row, len);
+        }
+    }
+    s->stale_count[s->cur] = 0;
+}
+
+/* the current buffer is about to be overwritten completely */
+static inline void fc_swap_drop(fc_ctx* c) {
+    fc_swap* s = c->swap;
+    if (!s) return;
+    s->pending = false;
+    s->stale_count[s->cur] = 0;
+}
+
+/* Wait until no buffer is held by the consumer; false (and nothing
+   reclaimed) if one is still held after FOSSIL_CUBE_RELEASE_TIMEOUT_MS.
+   Without threads nobody else can release, so held buffers are simply
+   reclaimed. */
+static bool fc_swap_drain(fc_swap* s) {
+    bool drained = true;
+    fc_swap_lock(s);
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+    const fc_deadline d = fc_deadline_in(FOSSIL_CUBE_RELEASE_TIMEOUT_MS);
+    for (int i = 0; i < s->count && drained; ++i) {
+        while (s->busy[i] && drained) drained = fc_cond_wait_until(&s->freed, &s->lock, &d);
+        drained = !s->busy[i];
+    }
+#endif
+    for (int i = 0; i < s->count && drained; ++i) s->busy[i] = false;
+    fc_swap_unlock(s);
+    return drained;
+}
+
+/* Back to a single buffer; the current one stays as c->pixels. */
+static void fc_swap_free(fc_ctx* c) {
+    fc_swap* s = c->swap;
+    if (!s) return;
+    for (int i = 0; i < s->count; ++i) {
+        if (i != s->cur) fc_fb_free(c, s->bufs[i], fc_fb_size(c));
+    }
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+    fc_cond_destroy(&s->freed);
+    fc_mutex_destroy(&s->lock);
+#endif
+    free(s);
+    c->swap = NULL;
+}
+
+static fossil_cube_result fc_swap_create(fc_ctx* c, int count) {
+    fc_swap* s = (fc_swap*)calloc(1, sizeof(*s));
+    if (!s) return FOSSIL_CUBE_ERR_OOM;
+    const size_t sz = fc_fb_size(c);
+    s->bufs[0] = c->pixels;
+    for (int i = 1; i < count; ++i) {
+        s->bufs[i] = fc_fb_alloc(c, sz);
+        if (!s->bufs[i]) {
+            while (--i > 0) fc_fb_free(c, s->bufs[i], sz);
+            free(s);
+            return FOSSIL_CUBE_ERR_OOM;
+        }
+        memcpy(s->bufs[i], c->pixels, sz);
+    }
+    s->count = count;
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+    fc_mutex_init(&s->lock);
+    fc_cond_init(&s->freed);
+#endif
+    c->swap = s;
+    return FOSSIL_CUBE_OK;
+}
+
+static void fc_present_call(fc_ctx* c) {
+    if (!c->present_rects && !c->present) return;
+    FC_STAT(const uint64_t t0 = fc_now_ns());
+    if (c->present_rects) {
+        fossil_cube_rect rects[FOSSIL_CUBE_MAX_DAMAGE];
+        const int n = fossil_cube_get_damage_ex(c, rects, FOSSIL_CUBE_MAX_DAMAGE);
+        c->present_rects(c->pixels, c->w, c->h, c->pitch, rects, n, c->userdata);
+    } else {
+        c->present(c->pixels, c->w, c->h, c->pitch, c->userdata);
+    }
+    FC_STAT(fc_stat_time(&c->stats.present, fc_now_ns() - t0));
+}
+
+static void fc_swap_present(fc_ctx* c) {
+    fc_swap* s = c->swap;
+    fc_swap_sync(c); /* nothing drew this frame: still owed from before */
+    for (int i = 0; i < s->count; ++i) {
+        if (i == s->cur) continue;
+        for (int d = 0; d < c->damage_count; ++d) {
+            fc_rects_add(s->stale[i], &s->stale_count[i], &c->damage[d]);
+        }
+    }
+
+    /* without a callback nobody will release the buffer */
+    const bool handed = c->present || c->present_rects;
+    fc_swap_lock(s);
+    s->busy[s->cur] = handed;
+    fc_swap_unlock(s);
+    fc_present_call(c); /* unlocked: the consumer may release from inside */
+
+    s->prev = s->cur;
+    int next = -1;
+    fc_swap_lock(s);
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+    const fc_deadline d = fc_deadline_in(FOSSIL_CUBE_RELEASE_TIMEOUT_MS);
+    bool waiting = true;
+#else
+    const bool waiting = false;
+#endif
+    for (;;) {
+        for (int k = 1; k <= s->count && next < 0; ++k) {
+            const int i = (s->prev + k) % s->count;
+            if (!s->busy[i]) next = i;
+        }
+        if (next >= 0) break;
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+        if (waiting) waiting = fc_cond_wait_until(&s->freed, &s->lock, &d);
+#endif
+        if (!waiting) {
+            /* no release in time (or no threads to wait on): take back
+               the next buffer in turn */
+            next = (s->prev + 1) % s->count;
+            s->busy[next] = false;
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+            fc_set_error(c, FOSSIL_CUBE_ERR_TIMEOUT);
+#endif
+        }
+    }
+    fc_swap_unlock(s);
+    s->cur = next;
+    s->pending = s->stale_count[next] > 0;
+    c->pixels = s->bufs[next];
+}
+
+/* Immediate calls run now and report damage; otherwise they are recorded */
+static void fc_submit(fc_ctx* c, const fc_cmd* cmd) {
+    fc_cmdbuf* sink = fc_sink(c);
+#if defined(FOSSIL_CUBE_STATS)
+    if (!c->record) ++c->stats.prim[cmd->kind - FC_CMD_CLEAR].calls;
+#endif
+    if (sink) {
+        if (!fc_cmdbuf_push(sink, cmd)) fc_set_error(c, FOSSIL_CUBE_ERR_OOM);
+        return;
+    }
+    if (cmd->kind == FC_CMD_CLEAR) fc_swap_drop(c);
+    else fc_swap_sync(c);
+    fc_cmd_exec_one(c, cmd, &g_no_clip, fc_stat_slot(c));
+    fc_damage_cmd(c, cmd);
+}
+
+/* =========================
+   Context lifecycle
+   ========================= */
+
+static fossil_cube_result fc_ctx_setup(fc_ctx* c, const fossil_cube_config* cfg) {
+    fc_simd_select();
+    memset(c, 0, sizeof(*c));
+    c->format = cfg->format;
+    c->fmt = &g_formats[cfg->format];
+    c->bpp = c->fmt->bpp;
+    c->w = cfg->width;
+    c->h = cfg->height;
+    c->present = cfg->present;
+    c->userdata = cfg->userdata;
+    c->clip.enabled = false;
+    if (cfg->allocator) c->allocator = *cfg->allocator;
+    c->align = cfg->align ? cfg->align : FOSSIL_CUBE_DEFAULT_ALIGN;
+    if (c->align < sizeof(void*)) c->align = sizeof(void*);
+    c->pad_rows = cfg->pad_rows;
+    c->clear_on_resize = cfg->clear_on_resize;
+    c->frame.arena.limit = cfg->arena_limit;
+    c->pitch = cfg->pitch ? cfg->pitch : fc_fb_pitch(c, cfg->width);
+
+    if (cfg->pixels) {
+        c->pixels = (uint8_t*)cfg->pixels;
+        c->external = true;
+    } else {
+        c->pixels = c->pitch ? fc_fb_alloc(c, fc_fb_size(c)) : NULL;
+        if (!c->pixels) {
+            memset(c, 0, sizeof(*c));
+            return FOSSIL_CUBE_ERR_OOM;
+        }
+        memset(c->pixels, 0, fc_fb_size(c));
+    }
+    fc_damage_all(c); /* nothing has been presented yet */
+
+    c->initialized = true;
+    return FOSSIL_CUBE_OK;
+}
+
+static void fc_ctx_release(fc_ctx* c) {
+    if (!c->initialized) return;
+    fc_swap_free(c);
+    fc_encoder_free(c);
+    fc_pool_destroy(c->pool);
+    free(c->bin_start);
+    free(c->bin_items);
+    free(c->batch_sort);
+    FC_STAT(free(c->stat_workers));
+    fc_cmdbuf_free(&c->frame);
+    free(c->path.edges);
+    if (!c->external) fc_fb_free(c, c->pixels, fc_fb_size(c));
+    memset(c, 0, sizeof(*c));
+}
+
+static inline fossil_cube_config fc_config(int width, int height,
+                                           fossil_cube_present_fn present, void* userdata) {
+    fossil_cube_config cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.width = width;
+    cfg.height = height;
+    cfg.format = FOSSIL_CUBE_FORMAT_RGBA8;
+    cfg.present = present;
+    cfg.userdata = userdata;
+    return cfg;
+}
+
+/* Caller pixels and pitches must keep every pixel naturally aligned */
+static inline bool fc_px_aligned(const void* pixels, int pitch, int bpp) {
+    return (uintptr_t)pixels % (uintptr_t)bpp == 0 && pitch % bpp == 0;
+}
+
+static inline bool fc_config_valid(const fossil_cube_config* cfg) {
+    if (!cfg || cfg->width <= 0 || cfg->height <= 0 || !fc_format_valid(cfg->format)) return false;
+    const long long row = (long long)cfg->width * g_formats[cfg->format].bpp;
+    if (row > INT_MAX) return false;
+    if (cfg->align & (cfg->align - 1)) return false; /* power of two */
+    if (cfg->pitch != 0 && cfg->pitch < row) return false;
+    if (!fc_px_aligned(cfg->pixels, cfg->pitch, g_formats[cfg->format].bpp)) return false;
+    if (cfg->allocator && !cfg->allocator->alloc) return false;
+    return true;
+}
+
+fossil_cube_result fossil_cube_ctx_create(fossil_cube_ctx** out_ctx,
+                                          int width, int height,
+                                          fossil_cube_present_fn present,
+                                          void* userdata) {
+    const fossil_cube_config cfg = fc_config(width, height, present, userdata);
+    return fossil_cube_ctx_create_with(out_ctx, &cfg);
+}
+
+fossil_cube_result fossil_cube_ctx_create_with(fossil_cube_ctx** out_ctx,
+                                               const fossil_cube_config* config) {
+    if (!out_ctx) return FOSSIL_CUBE_ERR_BADARGS;
+    *out_ctx = NULL;
+    if (!fc_config_valid(config)) return FOSSIL_CUBE_ERR_BADARGS;
+
+    fc_ctx* c = (fc_ctx*)malloc(sizeof(*c));
+    if (!c) return FOSSIL_CUBE_ERR_OOM;
+    fossil_cube_result res = fc_ctx_setup(c, config);
+    if (res != FOSSIL_CUBE_OK) {
+        free(c);
+        return res;
+    }
+    *out_ctx = c;
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_ctx_destroy(fossil_cube_ctx* ctx) {
+    if (!ctx || ctx == &g_fc) return;
+    fc_ctx_release(ctx);
+    free(ctx);
+}
+
+fossil_cube_ctx* fossil_cube_default_ctx(void) {
+    return g_fc.initialized ? &g_fc : NULL;
+}
+
+fossil_cube_result fossil_cube_init(
+    int width, int height,
+    fossil_cube_present_fn present,
+    void* userdata) {
+    const fossil_cube_config cfg = fc_config(width, height, present, userdata);
+    return fossil_cube_init_with(&cfg);
+}
+
+fossil_cube_result fossil_cube_init_with(const fossil_cube_config* config) {
+    if (!fc_config_valid(config) || config->present == NULL) return FOSSIL_CUBE_ERR_BADARGS;
+    fc_ctx_release(&g_fc);
+    return fc_ctx_setup(&g_fc, config);
+}
+
+void fossil_cube_shutdown(void) {
+    fc_ctx_release(&g_fc);
+}
+
+/* =========================
+   Context API
+   ========================= */
+
+fossil_cube_result fossil_cube_resize_ex(fossil_cube_ctx* c, int new_width, int new_height) {
+    if (!c || !c->initialized) return FOSSIL_CUBE_ERR_NOTINIT;
+    if (new_width <= 0 || new_height <= 0 || c->external) return FOSSIL_CUBE_ERR_BADARGS;
+
+    const int new_pitch = fc_fb_pitch(c, new_width);
+    if (new_pitch == 0) return FOSSIL_CUBE_ERR_BADARGS;
+    const int buffers = fossil_cube_get_buffers_ex(c);
+    if (c->swap && !fc_swap_drain(c->swap)) return FOSSIL_CUBE_ERR_TIMEOUT;
+    /* allocate first: on failure the old framebuffer and chain stay */
+    size_t sz = (size_t)new_pitch * (size_t)new_height;
+    uint8_t* npix = fc_fb_alloc(c, sz);
+    if (!npix) return FOSSIL_CUBE_ERR_OOM;
+    fc_swap_free(c);
+
+    fc_fb_free(c, c->pixels, fc_fb_size(c));
+    c->pixels = npix;
+    c->w = new_width;
+    c->h = new_height;
+    c->pitch = new_pitch;
+    c->clip.enabled = false;
+    c->region = NULL;
+    if (c->clear_on_resize) memset(c->pixels, 0, sz);
+    fc_damage_all(c);
+    return buffers > 1 ? fc_swap_create(c, buffers) : FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_set_buffers_ex(fossil_cube_ctx* c, int count) {
+    if (!c || !c->initialized) return FOSSIL_CUBE_ERR_NOTINIT;
+    if (count < 1 || count > FOSSIL_CUBE_MAX_BUFFERS || c->in_frame) return FOSSIL_CUBE_ERR_BADARGS;
+    if (count == fossil_cube_get_buffers_ex(c)) return FOSSIL_CUBE_OK;
+    if (c->external) return FOSSIL_CUBE_ERR_BADARGS; /* chain external buffers with attach */
+    if (c->swap) {
+        if (!fc_swap_drain(c->swap)) return FOSSIL_CUBE_ERR_TIMEOUT;
+        fc_swap_sync(c);
+        fc_swap_free(c);
+    }
+    return count > 1 ? fc_swap_create(c, count) : FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_attach_ex(fossil_cube_ctx* c, void* pixels,
+                                         int width, int height, int pitch) {
+    if (!c || !c->initialized) return FOSSIL_CUBE_ERR_NOTINIT;
+    if (!pixels || width <= 0 || height <= 0 || c->in_frame || c->swap) return FOSSIL_CUBE_ERR_BADARGS;
+    const long long row = (long long)width * c->bpp;
+    if (row > INT_MAX || (pitch != 0 && pitch < row)) return FOSSIL_CUBE_ERR_BADARGS;
+    if (!fc_px_aligned(pixels, pitch, c->bpp)) return FOSSIL_CUBE_ERR_BADARGS;
+
+    if (!c->external) fc_fb_free(c, c->pixels, fc_fb_size(c));
+    c->pixels = (uint8_t*)pixels;
+    c->external = true;
+    c->w = width;
+    c->h = height;
+    c->pitch = pitch ? pitch : (int)row;
+    c->clip.enabled = false;
+    c->region = NULL;
+    fc_damage_all(c);
+    return FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_set_encoder_ex(fossil_cube_ctx* c, fossil_cube_packet_fn packet, void* userdata) {
+    if (!c || !c->initialized) return FOSSIL_CUBE_ERR_NOTINIT;
+    if (c->in_frame) return FOSSIL_CUBE_ERR_BADARGS;
+    if (!packet) {
+        fc_encoder_free(c);
+        return FOSSIL_CUBE_OK;
+    }
+    if (!c->enc) {
+        c->enc = (fc_encoder*)calloc(1, sizeof(fc_encoder));
+        if (!c->enc) return FOSSIL_CUBE_ERR_OOM;
+    }
+    /* a new consumer starts from a key frame */
+    c->enc->fn = packet;
+    c->enc->userdata = userdata;
+    c->enc->sequence = 0;
+    c->enc->key = true;
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_request_key_frame_ex(fossil_cube_ctx* c) {
+    if (c && c->enc) c->enc->key = true;
+}
+
+int fossil_cube_get_buffers_ex(const fossil_cube_ctx* c) {
+    return (c && c->swap) ? c->swap->count : 1;
+}
+
+fossil_cube_result fossil_cube_release_buffer_ex(fossil_cube_ctx* c, const uint8_t* pixels) {
+    if (!c || !c->initialized) return FOSSIL_CUBE_ERR_NOTINIT;
+    fc_swap* s = c->swap;
+    if (!s) return FOSSIL_CUBE_OK; /* single buffer: present is synchronous */
+    fossil_cube_result res = FOSSIL_CUBE_ERR_BADARGS;
+    fc_swap_lock(s);
+    for (int i = 0; i < s->count; ++i) {
+        if (s->bufs[i] == pixels && s->busy[i]) {
+            s->busy[i] = false;
+#if !defined(FOSSIL_CUBE_NO_THREADS)
+            fc_cond_broadcast(&s->freed);
+#endif
+            res = FOSSIL_CUBE_OK;
+            break;
+        }
+    }
+    fc_swap_unlock(s);
+    return res;
+}
+
+void fossil_cube_set_mode_ex(fossil_cube_ctx* c, fossil_cube_mode mode) {
+    if (!c || !c->initialized || c->in_frame) return;
+    c->mode = mode;
+}
+
+fossil_cube_mode fossil_cube_get_mode_ex(const fossil_cube_ctx* c) {
+    return c ? c->mode : FOSSIL_CUBE_MODE_IMMEDIATE;
+}
+
+fossil_cube_result fossil_cube_set_threads_ex(fossil_cube_ctx* c, int threads) {
+    if (!c || !c->initialized) return FOSSIL_CUBE_ERR_NOTINIT;
+    if (threads < 0 || threads > FOSSIL_CUBE_MAX_THREADS || c->in_frame) return FOSSIL_CUBE_ERR_BADARGS;
+    if (threads == 0) threads = 1;
+    if (threads == fc_pool_threads(c->pool)) return FOSSIL_CUBE_OK;
+#if defined(FOSSIL_CUBE_NO_THREADS)
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+#else
+    fc_pool_destroy(c->pool);
+    c->pool = NULL;
+    if (threads == 1) return FOSSIL_CUBE_OK;
+    c->pool = fc_pool_create(threads);
+    return c->pool ? FOSSIL_CUBE_OK : FOSSIL_CUBE_ERR_OOM;
+#endif
+}
+
+int fossil_cube_get_threads_ex(const fossil_cube_ctx* c) {
+    return c ? fc_pool_threads(c->pool) : 1;
+}
+
+void fossil_cube_set_arena_limit_ex(fossil_cube_ctx* c, size_t bytes) {
+    if (c && c->initialized) c->frame.arena.limit = bytes;
+}
+
+void fossil_cube_get_arena_stats_ex(const fossil_cube_ctx* c, fossil_cube_arena_stats* out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!c || !c->initialized) return;
+    const fc_arena* a = &c->frame.arena;
+    out->used = a->used;
+    out->peak = a->peak;
+    out->reserved = a->reserved;
+    out->limit = a->limit ? a->limit : FOSSIL_CUBE_DEFAULT_ARENA_LIMIT;
+    out->block_allocs = a->block_allocs;
+}
+
+fossil_cube_result fossil_cube_get_stats_ex(const fossil_cube_ctx* c, fossil_cube_stats* out) {
+    if (!out) return FOSSIL_CUBE_ERR_BADARGS;
+    memset(out, 0, sizeof(*out));
+#if defined(FOSSIL_CUBE_STATS)
+    if (!c || !c->initialized) return FOSSIL_CUBE_ERR_NOTINIT;
+    *out = c->stats;
+    return FOSSIL_CUBE_OK;
+#else
+    (void)c;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+#endif
+}
+
+void fossil_cube_reset_stats_ex(fossil_cube_ctx* c) {
+#if defined(FOSSIL_CUBE_STATS)
+    if (c && c->initialized) memset(&c->stats, 0, sizeof(c->stats));
+#else
+    (void)c;
+#endif
+}
+
+void fossil_cube_begin_frame_ex(fossil_cube_ctx* c, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized) return;
+    FC_STAT(c->frame_t0 = fc_now_ns());
+    fc_cmdbuf_clear(&c->frame);
+    c->in_frame = true;
+    fc_swap_drop(c); /* the frame starts with a full clear */
+    /* which belongs to the frame, not to a recording left open */
+    fc_cmdbuf* record = c->record;
+    c->record = NULL;
+    fossil_cube_clear_ex(c, r, g, b, a);
+    c->record = record;
+}
+
+void fossil_cube_begin_frame_retain_ex(fossil_cube_ctx* c) {
+    if (!c || !c->initialized) return;
+    FC_STAT(c->frame_t0 = fc_now_ns());
+    fc_cmdbuf_clear(&c->frame);
+    c->in_frame = true;
+    fc_swap_sync(c);
+}
+
+void fossil_cube_end_frame_ex(fossil_cube_ctx* c) {
+    if (!c || !c->initialized) return;
+    bool encoded = false;
+    if (c->in_frame && c->frame.count) {
+        FC_STAT(const uint64_t t0 = fc_now_ns());
+        fc_cmdbuf_optimize(c, &c->frame);
+        for (size_t i = 0; i < c->frame.count; ++i) fc_damage_cmd(c, &c->frame.cmds[i]);
+        if (!c->pool || !fc_tiles_exec(c, c->frame.cmds, c->frame.count, &encoded)) {
+            fc_cmd_exec(c, c->frame.cmds, c->frame.count, &g_no_clip);
+        }
+        FC_STAT(fc_stat_time(&c->stats.render, fc_now_ns() - t0));
+    }
+    fc_cmdbuf_clear(&c->frame);
+    c->in_frame = false;
+    if (c->enc) fc_encode_frame(c, encoded);
+    if (c->swap) fc_swap_present(c);
+    else fc_present_call(c);
+    c->damage_count = 0;
+#if defined(FOSSIL_CUBE_STATS)
+    ++c->stats.frames;
+    if (c->frame_t0) fc_stat_time(&c->stats.frame, fc_now_ns() - c->frame_t0);
+    c->frame_t0 = 0;
+#endif
+}
+
+void fossil_cube_set_present_rects_ex(fossil_cube_ctx* c, fossil_cube_present_rects_fn present_rects) {
+    if (c && c->initialized) c->present_rects = present_rects;
+}
+
+void fossil_cube_add_damage_ex(fossil_cube_ctx* c, int x, int y, int w, int h) {
+    if (!c || !c->initialized) return;
+    const fc_irect fb = { 0, 0, c->w, c->h };
+    fc_irect r;
+    if (fc_clip_rect(&fb, x, y, w, h, &r)) fc_damage_add(c, &r);
+}
+
+int fossil_cube_get_damage_ex(const fossil_cube_ctx* c, fossil_cube_rect* out_rects, int max_rects) {
+    if (!c || !c->initialized) return 0;
+    int n = c->damage_count < max_rects ? c->damage_count : max_rects;
+    if (!out_rects || n < 0) n = 0;
+    for (int i = 0; i < n; ++i) {
+        out_rects[i].x = c->damage[i].x0;
+        out_rects[i].y = c->damage[i].y0;
+        out_rects[i].w = c->damage[i].x1 - c->damage[i].x0;
+        out_rects[i].h = c->damage[i].y1 - c->damage[i].y0;
+    }
+    return n;
+}
+
+void fossil_cube_clear_ex(fossil_cube_ctx* c, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized) return;
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_CLEAR, 0, 0, 0, 0, r, g, b, a);
+    cmd.clip = g_no_clip; /* clear ignores the clip rect and region */
+    cmd.region = NULL;
+    fc_submit(c, &cmd);
+}
+
+void fossil_cube_set_clip_ex(fossil_cube_ctx* c, int x, int y, int w, int h) {
+    if (!c || !c->initialized) return;
+    if (w <= 0 || h <= 0) {
+        c->clip.enabled = false;
+        return;
+    }
+    /* clamp to framebuffer */
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + w; if (x1 > c->w) x1 = c->w;
+    int y1 = y + h; if (y1 > c->h) y1 = c->h;
+
+    c->clip.x = x0;
+    c->clip.y = y0;
+    c->clip.w = (x1 > x0) ? (x1 - x0) : 0;
+    c->clip.h = (y1 > y0) ? (y1 - y0) : 0;
+    c->clip.enabled = (c->clip.w > 0 && c->clip.h > 0);
+}
+
+void fossil_cube_get_clip_ex(const fossil_cube_ctx* c, int* x, int* y, int* w, int* h) {
+    const bool on = c && c->clip.enabled; /* all zero when disabled, so it round-trips through set_clip */
+    if (x) *x = on ? c->clip.x : 0;
+    if (y) *y = on ? c->clip.y : 0;
+    if (w) *w = on ? c->clip.w : 0;
+    if (h) *h = on ? c->clip.h : 0;
+}
+
+void fossil_cube_set_clip_region_ex(fossil_cube_ctx* c, const fossil_cube_region* region) {
+    if (c && c->initialized) c->region = region;
+}
+
+const fossil_cube_region* fossil_cube_get_clip_region_ex(const fossil_cube_ctx* c) {
+    return c ? c->region : NULL;
+}
+
+void fossil_cube_put_pixel_ex(fossil_cube_ctx* c, int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized || a == 0) return;
+    const fc_cmd cmd = fc_make_cmd(c, FC_CMD_PIXEL, x, y, 1, 1, r, g, b, a);
+    fc_submit(c, &cmd);
+}
+
+void fossil_cube_fill_rect_ex(fossil_cube_ctx* c, int x, int y, int w, int h,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized || a == 0 || w <= 0 || h <= 0) return;
+    const fc_cmd cmd = fc_make_cmd(c, FC_CMD_FILL, x, y, w, h, r, g, b, a);
+    fc_submit(c, &cmd);
+}
+
+/* Axis-aligned lines cover exactly a 1px rect: they are submitted as
+   fills so they take the span kernels, fill merging and occlusion culling */
+static inline void fc_line_shape(fc_cmd* cmd, int x0, int y0, int x1, int y1) {
+    const long long len = (x0 == x1) ? (long long)y1 - y0 : (long long)x1 - x0;
+    cmd->kind = FC_CMD_LINE;
+    cmd->a0 = x0; cmd->a1 = y0; cmd->a2 = x1; cmd->a3 = y1;
+    if ((x0 == x1 || y0 == y1) && (len < 0 ? -len : len) < INT_MAX) {
+        const int lo = (int)(len < 0 ? len : 0);
+        const int n = (int)(len < 0 ? -len : len) + 1;
+        cmd->kind = FC_CMD_FILL;
+        if (x0 == x1) { cmd->a1 = y0 + lo; cmd->a2 = 1; cmd->a3 = n; }
+        else          { cmd->a0 = x0 + lo; cmd->a2 = n; cmd->a3 = 1; }
+    }
+}
+
+void fossil_cube_draw_line_ex(fossil_cube_ctx* c, int x0, int y0, int x1, int y1,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized || a == 0) return;
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_LINE, x0, y0, x1, y1, r, g, b, a);
+    fc_line_shape(&cmd, x0, y0, x1, y1);
+    fc_submit(c, &cmd);
+}
+
+void fossil_cube_draw_hline_ex(fossil_cube_ctx* c, int x, int y, int w,
+                               uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_fill_rect_ex(c, x, y, w, 1, r, g, b, a);
+}
+
+void fossil_cube_draw_vline_ex(fossil_cube_ctx* c, int x, int y, int h,
+                               uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_fill_rect_ex(c, x, y, 1, h, r, g, b, a);
+}
+
+void fossil_cube_draw_rect_ex(fossil_cube_ctx* c, int x, int y, int w, int h,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (w <= 0 || h <= 0) return;
+    /* four disjoint sides, so a translucent outline blends each pixel once */
+    fossil_cube_fill_rect_ex(c, x, y, w, 1, r, g, b, a);
+    if (h == 1) return;
+    fossil_cube_fill_rect_ex(c, x, (int)((long long)y + h - 1), w, 1, r, g, b, a);
+    if (h == 2) return;
+    fossil_cube_fill_rect_ex(c, x, y + 1, 1, h - 2, r, g, b, a);
+    if (w > 1) fossil_cube_fill_rect_ex(c, (int)((long long)x + w - 1), y + 1, 1, h - 2, r, g, b, a);
+}
+
+void fossil_cube_blit_rgba_ex(fossil_cube_ctx* c, int dst_x, int dst_y,
+                              const uint8_t* src, int src_w, int src_h, int src_pitch) {
+    if (!c) return;
+    fossil_cube_blit_rgba_alpha_ex(c, dst_x, dst_y, src, src_w, src_h, src_pitch, c->alpha);
+}
+
+void fossil_cube_blit_rgba_alpha_ex(fossil_cube_ctx* c, int dst_x, int dst_y,
+                                    const uint8_t* src, int src_w, int src_h, int src_pitch,
+                                    fossil_cube_alpha alpha) {
+    if (!c || !c->initialized || !src || src_w <= 0 || src_h <= 0) return;
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_BLIT, dst_x, dst_y, src_w, src_h, 0, 0, 0, 0);
+    cmd.src = src;
+    cmd.src_pitch = src_pitch;
+    cmd.alpha = (uint8_t)(alpha == FOSSIL_CUBE_ALPHA_PREMULTIPLIED ? alpha : FOSSIL_CUBE_ALPHA_STRAIGHT);
+    fc_submit(c, &cmd);
+}
+
+void fossil_cube_blit_mask_ex(fossil_cube_ctx* c, int dst_x, int dst_y,
+                              const uint8_t* coverage, int w, int h, int pitch,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized || !coverage || w <= 0 || h <= 0 || a == 0) return;
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_MASK, dst_x, dst_y, w, h, r, g, b, a);
+    cmd.src = coverage;
+    cmd.src_pitch = pitch;
+    fc_submit(c, &cmd);
+}
+
+/* Batches: the clip is resolved and the command prepared once, then each
+   block of FC_BATCH_BLOCK elements goes through a branch-free visibility
+   pass (written for the vectorizer) before any command is built. While
+   recording only the clip rejects, since a recording may be replayed
+   into a larger context. */
+enum { FC_BATCH_BLOCK = 256 };
+
+typedef struct fc_batch {
+    fc_cmd_kind kind;            /* FILL: x, y, w, h; LINE: x0, y0, x1, y1; BLIT: x, y, src w, src h */
+    const int* a[4];
+    const uint8_t* rgba;         /* FILL, LINE */
+    size_t stride;
+    const uint8_t* const* src;   /* BLIT */
+    const int* pitch;            /* BLIT, may be NULL */
+} fc_batch;
+
+/* Elements of [base, base + n) that reach b, in order */
+static int fc_batch_visible(const fc_batch* bt, const fc_irect* b, int base, int n, int* out) {
+    const int* a0 = bt->a[0] + base;
+    const int* a1 = bt->a[1] + base;
+    const int* a2 = bt->a[2] + base;
+    const int* a3 = bt->a[3] + base;
+    uint8_t vis[FC_BATCH_BLOCK];
+    if (bt->kind == FC_CMD_LINE) {
+        for (int i = 0; i < n; ++i) {
+            const int x0 = a0[i] < a2[i] ? a0[i] : a2[i], x1 = a0[i] < a2[i] ? a2[i] : a0[i];
+            const int y0 = a1[i] < a3[i] ? a1[i] : a3[i], y1 = a1[i] < a3[i] ? a3[i] : a1[i];
+            vis[i] = (uint8_t)((x0 < b->x1) & (x1 >= b->x0) & (y0 < b->y1) & (y1 >= b->y0));
+        }
+    } else {
+        for (int i = 0; i < n; ++i) {
+            const long long x1 = (long long)a0[i] + a2[i], y1 = (long long)a1[i] + a3[i];
+            vis[i] = (uint8_t)((a2[i] > 0) & (a3[i] > 0) & (a0[i] < b->x1) & (a1[i] < b->y1) &
+                               (x1 > b->x0) & (y1 > b->y0));
+        }
+    }
+    if (bt->rgba && bt->stride) {
+        const uint8_t* alpha = bt->rgba + (size_t)base * bt->stride + 3;
+        for (int i = 0; i < n; ++i) vis[i] &= (uint8_t)(alpha[(size_t)i * bt->stride] != 0);
+    }
+    if (bt->src) {
+        for (int i = 0; i < n; ++i) vis[i] &= (uint8_t)(bt->src[base + i] != NULL);
+    }
+    int k = 0;
+    for (int i = 0; i < n; ++i) {
+        out[k] = base + i;
+        k += vis[i];
+    }
+    return k;
+}
+
+static void fc_batch_submit(fc_ctx* c, const fc_batch* bt, const fc_cmd* proto, int i) {
+    fc_cmd cmd = *proto;
+    const int v0 = bt->a[0][i], v1 = bt->a[1][i], v2 = bt->a[2][i], v3 = bt->a[3][i];
+    if (bt->kind == FC_CMD_LINE) {
+        fc_line_shape(&cmd, v0, v1, v2, v3);
+    } else {
+        cmd.a0 = v0; cmd.a1 = v1; cmd.a2 = v2; cmd.a3 = v3;
+    }
+    if (bt->kind == FC_CMD_BLIT) {
+        cmd.src = bt->src[i];
+        cmd.src_pitch = bt->pitch ? bt->pitch[i] : 0;
+    } else if (bt->stride) {
+        const uint8_t* k = bt->rgba + (size_t)i * bt->stride;
+        fc_cmd_color(c, &cmd, k[0], k[1], k[2], k[3]);
+    }
+    fc_submit(c, &cmd);
+}
+
+/* Top row of an element, clamped to the framebuffer */
+static inline int fc_batch_row(const fc_ctx* c, const fc_batch* bt, int i) {
+    int y = bt->a[1][i];
+    if (bt->kind == FC_CMD_LINE && bt->a[3][i] < y) y = bt->a[3][i];
+    return y < 0 ? 0 : (y >= c->h ? c->h - 1 : y);
+}
+
+/* Stable counting sort of idx[0, n) into out by top row; start has h + 1 slots */
+static void fc_batch_sort_rows(const fc_ctx* c, const fc_batch* bt, const int* idx, int n,
+                               int* out, int* start) {
+    memset(start, 0, ((size_t)c->h + 1u) * sizeof(*start));
+    for (int j = 0; j < n; ++j) ++start[fc_batch_row(c, bt, idx[j]) + 1];
+    for (int y = 0; y < c->h; ++y) start[y + 1] += start[y];
+    for (int j = 0; j < n; ++j) out[start[fc_batch_row(c, bt, idx[j])]++] = idx[j];
+}
+
+/* Scratch for a row sort of count elements: survivors, sorted order and
+   row starts. NULL when it cannot be had. */
+static int* fc_batch_scratch(fc_ctx* c, int count) {
+    const size_t need = 2u * (size_t)count + (size_t)c->h + 1u;
+    if (need > c->batch_sort_cap) {
+        int* n = (int*)realloc(c->batch_sort, need * sizeof(*n));
+        if (!n) return NULL;
+        c->batch_sort = n;
+        c->batch_sort_cap = need;
+    }
+    return c->batch_sort;
+}
+
+static void fc_batch_run(fc_ctx* c, const fc_batch* bt, int count, fossil_cube_batch_order order) {
+    const fc_irect clip = fc_clip_bounds(c);
+    fc_irect b = clip;
+    if (!c->record && !fc_bounds_for(c, &clip, &b)) return;
+    if (c->region && !fc_irect_intersect(&b, &c->region->bounds, &b)) return;
+    const uint8_t* k = bt->rgba;
+    const fc_cmd proto = k ? fc_make_cmd(c, bt->kind, 0, 0, 0, 0, k[0], k[1], k[2], k[3])
+                           : fc_make_cmd(c, bt->kind, 0, 0, 0, 0, 0, 0, 0, 0);
+    int* sorted = (order == FOSSIL_CUBE_BATCH_BY_ROW && count > 1) ? fc_batch_scratch(c, count) : NULL;
+    int idx[FC_BATCH_BLOCK];
+    int kept = 0;
+    for (int base = 0; base < count; base += FC_BATCH_BLOCK) {
+        const int n = count - base < FC_BATCH_BLOCK ? count - base : FC_BATCH_BLOCK;
+        const int vis = fc_batch_visible(bt, &b, base, n, idx);
+        if (sorted) {
+            memcpy(sorted + kept, idx, (size_t)vis * sizeof(*idx));
+            kept += vis;
+        } else {
+            for (int j = 0; j < vis; ++j) fc_batch_submit(c, bt, &proto, idx[j]);
+        }
+    }
+    if (!sorted) return;
+    int* out = sorted + count;
+    fc_batch_sort_rows(c, bt, sorted, kept, out, out + count);
+    for (int j = 0; j < kept; ++j) fc_batch_submit(c, bt, &proto, out[j]);
+}
+
+void fossil_cube_fill_rects_ex(fossil_cube_ctx* c, const int* x, const int* y, const int* w, const int* h,
+                               int count, const uint8_t* rgba, int rgba_stride,
+                               fossil_cube_batch_order order) {
+    if (!c || !c->initialized || !x || !y || !w || !h || !rgba || count <= 0 || rgba_stride < 0) return;
+    if (rgba_stride == 0 && rgba[3] == 0) return;
+    const fc_batch bt = { FC_CMD_FILL, { x, y, w, h }, rgba, (size_t)rgba_stride, NULL, NULL };
+    fc_batch_run(c, &bt, count, order);
+}
+
+void fossil_cube_draw_lines_ex(fossil_cube_ctx* c, const int* x0, const int* y0, const int* x1,
+                               const int* y1, int count, const uint8_t* rgba, int rgba_stride,
+                               fossil_cube_batch_order order) {
+    if (!c || !c->initialized || !x0 || !y0 || !x1 || !y1 || !rgba || count <= 0 || rgba_stride < 0) return;
+    if (rgba_stride == 0 && rgba[3] == 0) return;
+    const fc_batch bt = { FC_CMD_LINE, { x0, y0, x1, y1 }, rgba, (size_t)rgba_stride, NULL, NULL };
+    fc_batch_run(c, &bt, count, order);
+}
+
+void fossil_cube_blit_many_ex(fossil_cube_ctx* c, const int* dst_x, const int* dst_y,
+                              const uint8_t* const* src, const int* src_w, const int* src_h,
+                              const int* src_pitch, int count, fossil_cube_batch_order order) {
+    if (!c || !c->initialized || !dst_x || !dst_y || !src || !src_w || !src_h || count <= 0) return;
+    const fc_batch bt = { FC_CMD_BLIT, { dst_x, dst_y, src_w, src_h }, NULL, 0, src, src_pitch };
+    fc_batch_run(c, &bt, count, order);
+}
+
+/* A mask run is one FC_CMD_MASK over the union of its visible masks; the
+   list lives in the sink buffer's arena like a path record, or borrows
+   the frame arena when drawn right away */
+void fossil_cube_blit_masks_ex(fossil_cube_ctx* c, const int* dst_x, const int* dst_y,
+                               const uint8_t* const* coverage, const int* w, const int* h,
+                               const int* pitch, int count, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized || !dst_x || !dst_y || !coverage || !w || !h || count <= 0 || a == 0) return;
+    const fc_irect clip = fc_clip_bounds(c);
+    fc_irect vb = clip;
+    if (!c->record && !fc_bounds_for(c, &clip, &vb)) return;
+    if (c->region && !fc_irect_intersect(&vb, &c->region->bounds, &vb)) return;
+
+    const fc_batch bt = { FC_CMD_MASK, { dst_x, dst_y, w, h }, NULL, 0, coverage, pitch };
+    int idx[FC_BATCH_BLOCK];
+    int vis = 0;
+    for (int base = 0; base < count; base += FC_BATCH_BLOCK) {
+        const int n = count - base < FC_BATCH_BLOCK ? count - base : FC_BATCH_BLOCK;
+        vis += fc_batch_visible(&bt, &vb, base, n, idx);
+    }
+    if (vis == 0) return;
+
+    fc_cmdbuf* sink = fc_sink(c);
+    fc_arena* arena = sink ? &sink->arena : &c->frame.arena;
+    const fc_arena_mark mark = fc_arena_get_mark(arena);
+    fc_mask_item* items = (fc_mask_item*)fc_arena_alloc(arena, (size_t)vis * sizeof(*items));
+    if (!items) {
+        fc_set_error(c, FOSSIL_CUBE_ERR_OOM);
+        return;
+    }
+    long long x0 = LLONG_MAX, y0 = LLONG_MAX, x1 = LLONG_MIN, y1 = LLONG_MIN;
+    int kept = 0;
+    for (int base = 0; base < count; base += FC_BATCH_BLOCK) {
+        const int n = count - base < FC_BATCH_BLOCK ? count - base : FC_BATCH_BLOCK;
+        const int nv = fc_batch_visible(&bt, &vb, base, n, idx);
+        for (int j = 0; j < nv; ++j) {
+            const int i = idx[j];
+            fc_mask_item* m = &items[kept++];
+            m->x = dst_x[i]; m->y = dst_y[i];
+            m->w = w[i]; m->h = h[i];
+            m->pitch = pitch && pitch[i] ? pitch[i] : w[i];
+            m->cov = coverage[i];
+            if (m->x < x0) x0 = m->x;
+            if (m->y < y0) y0 = m->y;
+            if ((long long)m->x + m->w > x1) x1 = (long long)m->x + m->w;
+            if ((long long)m->y + m->h > y1) y1 = (long long)m->y + m->h;
+        }
+    }
+    const long long bw = x1 - x0, bh = y1 - y0;
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_MASK, (int)x0, (int)y0, bw > INT_MAX ? INT_MAX : (int)bw,
+                             bh > INT_MAX ? INT_MAX : (int)bh, r, g, b, a);
+    cmd.masks = items;
+    cmd.s0 = kept;
+    fc_submit(c, &cmd);
+    if (!sink) fc_arena_rewind(arena, mark);
+}
+
+/* Shapes: a draw call flattens into c->path, then fc_path_submit bins the
+   edges into one record and submits it as a single FC_CMD_PATH. The
+   record lives in the sink buffer while deferred, and in c->path.tmp
+   (reused) when drawn at once. Coordinates are clamped to +-2^24 so every
+   cell index fits an int. */
+#define FC_AA_COORD_MAX 16777216.0f
+#define FC_PI 3.14159265358979323846f
+
+static void fc_path_reset(fc_ctx* c) {
+    fc_path_builder* pb = &c->path;
+    pb->count = 0;
+    pb->bad = false;
+    pb->fx = pb->fy = pb->lx = pb->ly = 0.0f;
+}
+
+static void fc_path_edge(fc_ctx* c, float x0, float y0, float x1, float y1) {
+    fc_path_builder* pb = &c->path;
+    if (y0 == y1) return; /* horizontal edges sweep no area */
+    if (pb->count == pb->cap) {
+        size_t ncap = pb->cap ? pb->cap * 2u : 64u;
+        fc_edge* n = (fc_edge*)realloc(pb->edges, ncap * sizeof(*n));
+        if (!n) { pb->bad = true; fc_set_error(c, FOSSIL_CUBE_ERR_OOM); return; }
+        pb->edges = n;
+        pb->cap = ncap;
+    }
+    fc_edge* e = &pb->edges[pb->count++];
+    const bool down = y0 < y1;
+    e->x0 = down ? x0 : x1; e->y0 = down ? y0 : y1;
+    e->x1 = down ? x1 : x0; e->y1 = down ? y1 : y0;
+    e->dir = down ? 1.0f : -1.0f;
+    e->xmin = x0 < x1 ? x0 : x1;
+    e->xmax = x0 < x1 ? x1 : x0;
+}
+
+static inline float fc_path_coord(fc_ctx* c, float v) {
+    if (v != v) { c->path.bad = true; return 0.0f; }
+    return v < -FC_AA_COORD_MAX ? -FC_AA_COORD_MAX : v > FC_AA_COORD_MAX ? FC_AA_COORD_MAX : v;
+}
+
+static void fc_path_close(fc_ctx* c) {
+    fc_path_builder* pb = &c->path;
+    fc_path_edge(c, pb->lx, pb->ly, pb->fx, pb->fy);
+    pb->lx = pb->fx;
+    pb->ly = pb->fy;
+}
+
+static void fc_path_move(fc_ctx* c, float x, float y) {
+    fc_path_close(c);
+    c->path.fx = c->path.lx = fc_path_coord(c, x);
+    c->path.fy = c->path.ly = fc_path_coord(c, y);
+}
+
+static void fc_path_line(fc_ctx* c, float x, float y) {
+    x = fc_path_coord(c, x);
+    y = fc_path_coord(c, y);
+    fc_path_edge(c, c->path.lx, c->path.ly, x, y);
+    c->path.lx = x;
+    c->path.ly = y;
+}
+
+/* Segments for an arc of radius r so the chord strays at most 1/8 px,
+   and at least one per 45 degrees */
+static int fc_arc_steps(float r, float sweep) {
+    const float lo = ceilf(sweep / (0.25f * FC_PI));
+    const float n = r <= 0.0625f ? lo : ceilf(sweep / (2.0f * acosf(1.0f - 0.125f / r)));
+    return n < lo ? (int)lo : n > 1024.0f ? 1024 : (int)n;
+}
+
+/* Line to the points of an arc from angle t0 to t1, both ends included.
+   Shapes run with decreasing angles (counter-clockwise on a y-down
+   screen), the same winding as stroke quads, so unions saturate. */
+static void fc_path_arc(fc_ctx* c, float cx, float cy, float r, float t0, float t1) {
+    const int n = fc_arc_steps(r, fabsf(t1 - t0));
+    /* vertices pushed out so each chord's segment has the sector's area */
+    const float step = fabsf(t1 - t0) / (float)n;
+    const float rv = r * sqrtf(step / sinf(step));
+    for (int i = 0; i <= n; ++i) {
+        const float t = t0 + (t1 - t0) * (float)i / (float)n;
+        fc_path_line(c, cx + rv * cosf(t), cy + rv * sinf(t));
+    }
+}
+
+static void fc_path_circle(fc_ctx* c, float cx, float cy, float r) {
+    fc_path_move(c, cx + r, cy);
+    fc_path_arc(c, cx, cy, r, 0.0f, -2.0f * FC_PI);
+    fc_path_close(c);
+}
+
+/* Stroke of one segment as a quad, butt ends */
+static void fc_path_segment(fc_ctx* c, float x0, float y0, float x1, float y1, float hw) {
+    const float dx = x1 - x0, dy = y1 - y0;
+    const float len = sqrtf(dx * dx + dy * dy);
+    if (!(len > 0.0f)) return;
+    const float nx = -dy / len * hw, ny = dx / len * hw;
+    fc_path_move(c, x0 + nx, y0 + ny);
+    fc_path_line(c, x1 + nx, y1 + ny);
+    fc_path_line(c, x1 - nx, y1 - ny);
+    fc_path_line(c, x0 - nx, y0 - ny);
+    fc_path_close(c);
+}
+
+/* Submit the built shape in a color, or with a paint when paint is set */
+static void fc_path_submit(fc_ctx* c, uint8_t r, uint8_t g, uint8_t b, uint8_t a,
+                           const fossil_cube_paint* paint) {
+    fc_path_builder* pb = &c->path;
+    fc_path_close(c);
+    if (pb->bad || pb->count == 0) return;
+
+    float minx = pb->edges[0].xmin, maxx = pb->edges[0].xmax;
+    float miny = pb->edges[0].y0, maxy = pb->edges[0].y1;
+    for (size_t i = 1; i < pb->count; ++i) {
+        const fc_edge* e = &pb->edges[i];
+        if (e->xmin < minx) minx = e->xmin;
+        if (e->xmax > maxx) maxx = e->xmax;
+        if (e->y0 < miny) miny = e->y0;
+        if (e->y1 > maxy) maxy = e->y1;
+    }
+    fc_irect box = { fc_floori(minx), fc_floori(miny), fc_ceili(maxx), fc_ceili(maxy) };
+    if (box.x1 == box.x0) ++box.x1; /* a vertical sliver still touches its column */
+    const int ry0 = box.y0 > 0 ? box.y0 : 0;
+    if (box.y1 <= ry0) return; /* above the surface */
+
+    /* bin height: FC_AA_ROWS, coarser for tall shapes or many tall edges */
+    const int rows = box.y1 - ry0;
+    int bin_h = FC_AA_ROWS * ((rows + FC_AA_ROWS * FC_AA_MAX_BINS - 1) / (FC_AA_ROWS * FC_AA_MAX_BINS));
+    int bin0, bins;
+    size_t refs;
+    for (;;) {
+        bin0 = ry0 / bin_h;
+        bins = (box.y1 - 1) / bin_h - bin0 + 1;
+        refs = 0;
+        for (size_t i = 0; i < pb->count; ++i) {
+            const fc_edge* e = &pb->edges[i];
+            const int e0 = fc_floori(e->y0) > ry0 ? fc_floori(e->y0) : ry0;
+            const int e1 = fc_ceili(e->y1);
+            if (e1 > e0) refs += (size_t)((e1 - 1) / bin_h - e0 / bin_h + 1);
+        }
+        if (bins == 1 || refs <= 64u * pb->count + 4u * (size_t)bins) break;
+        bin_h *= 2;
+    }
+
+    const size_t size = sizeof(fc_path) + pb->count * sizeof(fc_edge) +
+                        ((size_t)bins + 1u + refs) * sizeof(uint32_t);
+    /* deferred and recorded shapes live in the buffer's arena; immediate
+       ones borrow the frame arena and give it back right after drawing */
+    fc_cmdbuf* sink = fc_sink(c);
+    fc_arena* arena = sink ? &sink->arena : &c->frame.arena;
+    const fc_arena_mark mark = fc_arena_get_mark(arena);
+    void* blob = fc_arena_alloc(arena, size);
+    if (!blob) {
+        fc_set_error(c, FOSSIL_CUBE_ERR_OOM);
+        return;
+    }
+
+    fc_path* path = (fc_path*)blob;
+    fc_edge* edges = (fc_edge*)(path + 1);
+    uint32_t* off = (uint32_t*)(edges + pb->count);
+    uint32_t* ref = off + bins + 1;
+    memcpy(edges, pb->edges, pb->count * sizeof(fc_edge));
+    memset(off, 0, ((size_t)bins + 1u) * sizeof(uint32_t));
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < pb->count; ++i) {
+            const int e0 = fc_floori(edges[i].y0) > ry0 ? fc_floori(edges[i].y0) : ry0;
+            const int e1 = fc_ceili(edges[i].y1);
+            if (e1 <= e0) continue;
+            for (int k = e0 / bin_h - bin0; k <= (e1 - 1) / bin_h - bin0; ++k) {
+                if (pass == 0) ++off[k + 1];
+                else ref[off[k]++] = (uint32_t)i;
+            }
+        }
+        if (pass == 0) {
+            for (int k = 0; k < bins; ++k) off[k + 1] += off[k];
+        }
+    }
+    /* the fill pass advanced each offset to the next bin's start */
+    for (int k = bins; k > 0; --k) off[k] = off[k - 1];
+    off[0] = 0;
+
+    path->box = box;
+    path->bin_h = bin_h;
+    path->bin0 = bin0;
+    path->bins = bins;
+    path->edges = edges;
+    path->bin_off = off;
+    path->refs = ref;
+    path->paint = paint;
+
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_PATH, box.x0, box.y0, box.x1 - box.x0, box.y1 - box.y0, r, g, b, a);
+    cmd.path = path;
+    fc_submit(c, &cmd);
+    if (!sink) fc_arena_rewind(arena, mark);
+}
+
+static void fc_path_polygon(fc_ctx* c, const float* xy, int count) {
+    fc_path_move(c, xy[0], xy[1]);
+    for (int i = 1; i < count; ++i) fc_path_line(c, xy[2 * i], xy[2 * i + 1]);
+}
+
+static void fc_path_rounded_rect(fc_ctx* c, float x, float y, float w, float h, float radius) {
+    const float lim = 0.5f * (w < h ? w : h);
+    const float rr = radius > lim ? lim : radius > 0.0f ? radius : 0.0f;
+    fc_path_move(c, x + w, y + rr);
+    if (rr > 0.0f) {
+        fc_path_arc(c, x + w - rr, y + rr, rr, 0.0f, -0.5f * FC_PI);
+        fc_path_arc(c, x + rr, y + rr, rr, -0.5f * FC_PI, -FC_PI);
+        fc_path_arc(c, x + rr, y + h - rr, rr, -FC_PI, -1.5f * FC_PI);
+        fc_path_arc(c, x + w - rr, y + h - rr, rr, -1.5f * FC_PI, -2.0f * FC_PI);
+    } else {
+        fc_path_line(c, x, y);
+        fc_path_line(c, x, y + h);
+        fc_path_line(c, x + w, y + h);
+    }
+}
+
+void fossil_cube_fill_polygon_ex(fossil_cube_ctx* c, const float* xy, int count,
+                                 uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized || !xy || count < 3 || a == 0) return;
+    fc_path_reset(c);
+    fc_path_polygon(c, xy, count);
+    fc_path_submit(c, r, g, b, a, NULL);
+}
+
+void fossil_cube_draw_polyline_ex(fossil_cube_ctx* c, const float* xy, int count, float width,
+                                  uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized || !xy || count < 2 || !(width > 0.0f) || a == 0) return;
+    const float hw = 0.5f * width;
+    fc_path_reset(c);
+    for (int i = 0; i + 1 < count; ++i) {
+        fc_path_segment(c, xy[2 * i], xy[2 * i + 1], xy[2 * i + 2], xy[2 * i + 3], hw);
+        if (width > 2.0f && i > 0) fc_path_circle(c, xy[2 * i], xy[2 * i + 1], hw);
+    }
+    fc_path_submit(c, r, g, b, a, NULL);
+}
+
+void fossil_cube_draw_line_aa_ex(fossil_cube_ctx* c, float x0, float y0, float x1, float y1, float width,
+                                 uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const float xy[4] = { x0, y0, x1, y1 };
+    fossil_cube_draw_polyline_ex(c, xy, 2, width, r, g, b, a);
+}
+
+void fossil_cube_fill_circle_ex(fossil_cube_ctx* c, float cx, float cy, float radius,
+                                uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized || !(radius > 0.0f) || a == 0) return;
+    fc_path_reset(c);
+    fc_path_circle(c, cx, cy, radius);
+    fc_path_submit(c, r, g, b, a, NULL);
+}
+
+void fossil_cube_fill_rounded_rect_ex(fossil_cube_ctx* c, float x, float y, float w, float h, float radius,
+                                      uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!c || !c->initialized || !(w > 0.0f) || !(h > 0.0f) || a == 0) return;
+    fc_path_reset(c);
+    fc_path_rounded_rect(c, x, y, w, h, radius);
+    fc_path_submit(c, r, g, b, a, NULL);
+}
+
+/* Painted fills: the same shapes, shaded by the paint */
+
+void fossil_cube_fill_rect_paint_ex(fossil_cube_ctx* c, int x, int y, int w, int h,
+                                    const fossil_cube_paint* paint) {
+    if (!c || !c->initialized || !paint || w <= 0 || h <= 0) return;
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_PAINT, x, y, w, h, 255, 255, 255, 255);
+    cmd.paint = paint;
+    fc_submit(c, &cmd);
+}
+
+void fossil_cube_fill_polygon_paint_ex(fossil_cube_ctx* c, const float* xy, int count,
+                                       const fossil_cube_paint* paint) {
+    if (!c || !c->initialized || !paint || !xy || count < 3) return;
+    fc_path_reset(c);
+    fc_path_polygon(c, xy, count);
+    fc_path_submit(c, 255, 255, 255, 255, paint);
+}
+
+void fossil_cube_fill_circle_paint_ex(fossil_cube_ctx* c, float cx, float cy, float radius,
+                                      const fossil_cube_paint* paint) {
+    if (!c || !c->initialized || !paint || !(radius > 0.0f)) return;
+    fc_path_reset(c);
+    fc_path_circle(c, cx, cy, radius);
+    fc_path_submit(c, 255, 255, 255, 255, paint);
+}
+
+void fossil_cube_fill_rounded_rect_paint_ex(fossil_cube_ctx* c, float x, float y, float w, float h,
+                                            float radius, const fossil_cube_paint* paint) {
+    if (!c || !c->initialized || !paint || !(w > 0.0f) || !(h > 0.0f)) return;
+    fc_path_reset(c);
+    fc_path_rounded_rect(c, x, y, w, h, radius);
+    fc_path_submit(c, 255, 255, 255, 255, paint);
+}
+
+void fossil_cube_blit_scaled_ex(fossil_cube_ctx* c, int dst_x, int dst_y, int dst_w, int dst_h,
+                                const uint8_t* src, int src_w, int src_h, int src_pitch,
+                                fossil_cube_filter filter) {
+    if (!c || !c->initialized || !src || dst_w <= 0 || dst_h <= 0 || src_w <= 0 || src_h <= 0) return;
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_SCALED, dst_x, dst_y, dst_w, dst_h, 0, 0, 0, 0);
+    cmd.src = src;
+    cmd.src_pitch = src_pitch;
+    cmd.s0 = src_w;
+    cmd.s1 = src_h;
+    cmd.filter = (uint8_t)(filter == FOSSIL_CUBE_FILTER_BILINEAR ? filter : FOSSIL_CUBE_FILTER_NEAREST);
+    fc_submit(c, &cmd);
+}
+
+void fossil_cube_draw_image_ex(fossil_cube_ctx* c, const fossil_cube_image* image,
+                               int dst_x, int dst_y) {
+    if (!image) return;
+    fossil_cube_draw_image_rect_ex(c, image, 0, 0, image->w, image->h, dst_x, dst_y);
+}
+
+void fossil_cube_draw_image_rect_ex(fossil_cube_ctx* c, const fossil_cube_image* image,
+                                    int src_x, int src_y, int src_w, int src_h,
+                                    int dst_x, int dst_y) {
+    if (!c || !c->initialized || !image || src_w <= 0 || src_h <= 0) return;
+    /* clamp the source rect to the image, moving the destination with it */
+    long long x0 = src_x, y0 = src_y;
+    long long x1 = x0 + src_w, y1 = y0 + src_h;
+    long long dx = dst_x, dy = dst_y;
+    if (x0 < 0) { dx -= x0; x0 = 0; }
+    if (y0 < 0) { dy -= y0; y0 = 0; }
+    if (x1 > image->w) x1 = image->w;
+    if (y1 > image->h) y1 = image->h;
+    if (x0 >= x1 || y0 >= y1 || dx > INT_MAX || dy > INT_MAX) return;
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_IMAGE, (int)dx, (int)dy, (int)(x1 - x0), (int)(y1 - y0),
+                             0, 0, 0, 0);
+    cmd.image = image;
+    cmd.s0 = (int)x0;
+    cmd.s1 = (int)y0;
+    fc_submit(c, &cmd);
+}
+
+void fossil_cube_composite_ex(fossil_cube_ctx* c, const fossil_cube_ctx* src,
+                              int src_x, int src_y, int src_w, int src_h,
+                              int dst_x, int dst_y, uint8_t opacity, fossil_cube_blend blend) {
+    if (!c || !c->initialized || !src || !src->initialized || src == c || !src->pixels) return;
+    if (src_w <= 0 || src_h <= 0 || (unsigned)blend > FOSSIL_CUBE_BLEND_MULTIPLY) return;
+    if (opacity == 0 && blend != FOSSIL_CUBE_BLEND_COPY) return;
+    /* clamp the source rect to the framebuffer, moving the destination with it */
+    long long x0 = src_x, y0 = src_y;
+    long long x1 = x0 + src_w, y1 = y0 + src_h;
+    long long dx = dst_x, dy = dst_y;
+    if (x0 < 0) { dx -= x0; x0 = 0; }
+    if (y0 < 0) { dy -= y0; y0 = 0; }
+    if (x1 > src->w) x1 = src->w;
+    if (y1 > src->h) y1 = src->h;
+    if (x0 >= x1 || y0 >= y1 || dx > INT_MAX || dy > INT_MAX) return;
+    /* opacity travels as the alpha of a premultiplied black */
+    fc_cmd cmd = fc_make_cmd(c, FC_CMD_COMPOSITE, (int)dx, (int)dy, (int)(x1 - x0), (int)(y1 - y0),
+                             0, 0, 0, opacity);
+    cmd.src = src->pixels + (size_t)y0 * (size_t)src->pitch + (size_t)x0 * (size_t)src->bpp;
+    cmd.src_pitch = src->pitch;
+    cmd.s0 = (int)src->format;
+    cmd.blend = (uint8_t)blend;
+    fc_submit(c, &cmd);
+}
+
+void fossil_cube_set_alpha_ex(fossil_cube_ctx* c, fossil_cube_alpha alpha) {
+    if (!c || !c->initialized) return;
+    c->alpha = alpha == FOSSIL_CUBE_ALPHA_PREMULTIPLIED ? alpha : FOSSIL_CUBE_ALPHA_STRAIGHT;
+}
+
+fossil_cube_alpha fossil_cube_get_alpha_ex(const fossil_cube_ctx* c) {
+    return c ? c->alpha : FOSSIL_CUBE_ALPHA_STRAIGHT;
+}
+
+/* Recording & replay */
+
+fossil_cube_result fossil_cube_cmdbuf_create(fossil_cube_cmdbuf** out_buf) {
+    if (!out_buf) return FOSSIL_CUBE_ERR_BADARGS;
+    *out_buf = (fc_cmdbuf*)calloc(1, sizeof(fc_cmdbuf));
+    return *out_buf ? FOSSIL_CUBE_OK : FOSSIL_CUBE_ERR_OOM;
+}
+
+void fossil_cube_cmdbuf_destroy(fossil_cube_cmdbuf* buf) {
+    if (!buf) return;
+    fc_cmdbuf_free(buf);
+    free(buf);
+}
+
+void fossil_cube_cmdbuf_reset(fossil_cube_cmdbuf* buf) {
+    if (buf) fc_cmdbuf_clear(buf);
+}
+
+size_t fossil_cube_cmdbuf_count(const fossil_cube_cmdbuf* buf) {
+    return buf ? buf->count : 0;
+}
+
+fossil_cube_result fossil_cube_record_begin_ex(fossil_cube_ctx* c, fossil_cube_cmdbuf* buf) {
+    if (!c || !c->initialized) return FOSSIL_CUBE_ERR_NOTINIT;
+    if (!buf || c->record) return FOSSIL_CUBE_ERR_BADARGS;
+    c->record = buf;
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_record_end_ex(fossil_cube_ctx* c) {
+    if (c) c->record = NULL;
+}
+
+fossil_cube_result fossil_cube_get_error_ex(fossil_cube_ctx* c) {
+    if (!c) return FOSSIL_CUBE_ERR_BADARGS;
+    const fossil_cube_result err = c->error;
+    c->error = FOSSIL_CUBE_OK;
+    return err;
+}
+
+void fossil_cube_replay_ex(fossil_cube_ctx* c, const fossil_cube_cmdbuf* buf) {
+    if (!c || !c->initialized || !buf || buf == c->record) return;
+    const fc_irect clip = fc_clip_bounds(c);
+    for (size_t i = 0; i < buf->count; ++i) {
+        fc_cmd cmd = buf->cmds[i];
+        if (!fc_irect_intersect(&cmd.clip, &clip, &cmd.clip)) continue;
+        if (!cmd.region && cmd.kind != FC_CMD_CLEAR) cmd.region = c->region;
+        fc_submit(c, &cmd);
+    }
+}
+
+uint8_t* fossil_cube_framebuffer_ex(fossil_cube_ctx* c, int* out_w, int* out_h, int* out_pitch) {
+    if (!c) {
+        if (out_w) *out_w = 0;
+        if (out_h) *out_h = 0;
+        if (out_pitch) *out_pitch = 0;
+        return NULL;
+    }
+    fc_swap_sync(c); /* the caller may read or write it directly */
+    if (out_w) *out_w = c->w;
+    if (out_h) *out_h = c->h;
+    if (out_pitch) *out_pitch = c->pitch;
+    return c->pixels;
+}
+
+int fossil_cube_width_ex(const fossil_cube_ctx* c)  { return c ? c->w : 0; }
+int fossil_cube_height_ex(const fossil_cube_ctx* c) { return c ? c->h : 0; }
+
+fossil_cube_format fossil_cube_get_format_ex(const fossil_cube_ctx* c) {
+    return c ? c->format : FOSSIL_CUBE_FORMAT_RGBA8;
+}
+
+/* =========================
+   Default-context API
+   ========================= */
+
+fossil_cube_result fossil_cube_resize(int new_width, int new_height) {
+    return fossil_cube_resize_ex(&g_fc, new_width, new_height);
+}
+
+void fossil_cube_begin_frame(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_begin_frame_ex(&g_fc, r, g, b, a);
+}
+
+void fossil_cube_end_frame(void) {
+    fossil_cube_end_frame_ex(&g_fc);
+}
+
+void fossil_cube_clear(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_clear_ex(&g_fc, r, g, b, a);
+}
+
+void fossil_cube_set_clip(int x, int y, int w, int h) {
+    fossil_cube_set_clip_ex(&g_fc, x, y, w, h);
+}
+
+void fossil_cube_get_clip(int* x, int* y, int* w, int* h) {
+    fossil_cube_get_clip_ex(&g_fc, x, y, w, h);
+}
+
+void fossil_cube_set_clip_region(const fossil_cube_region* region) {
+    fossil_cube_set_clip_region_ex(&g_fc, region);
+}
+
+const fossil_cube_region* fossil_cube_get_clip_region(void) {
+    return fossil_cube_get_clip_region_ex(&g_fc);
+}
+
+void fossil_cube_put_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_put_pixel_ex(&g_fc, x, y, r, g, b, a);
+}
+
+void fossil_cube_fill_rect(int x, int y, int w, int h,
+                           uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_fill_rect_ex(&g_fc, x, y, w, h, r, g, b, a);
+}
+
+void fossil_cube_draw_line(int x0, int y0, int x1, int y1,
+                           uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_draw_line_ex(&g_fc, x0, y0, x1, y1, r, g, b, a);
+}
+
+void fossil_cube_draw_hline(int x, int y, int w, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_draw_hline_ex(&g_fc, x, y, w, r, g, b, a);
+}
+
+void fossil_cube_draw_vline(int x, int y, int h, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_draw_vline_ex(&g_fc, x, y, h, r, g, b, a);
+}
+
+void fossil_cube_draw_rect(int x, int y, int w, int h,
+                           uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_draw_rect_ex(&g_fc, x, y, w, h, r, g, b, a);
+}
+
+void fossil_cube_blit_rgba(int dst_x, int dst_y,
+                           const uint8_t* src, int src_w, int src_h, int src_pitch) {
+    fossil_cube_blit_rgba_ex(&g_fc, dst_x, dst_y, src, src_w, src_h, src_pitch);
+}
+
+void fossil_cube_blit_rgba_alpha(int dst_x, int dst_y,
+                                 const uint8_t* src, int src_w, int src_h, int src_pitch,
+                                 fossil_cube_alpha alpha) {
+    fossil_cube_blit_rgba_alpha_ex(&g_fc, dst_x, dst_y, src, src_w, src_h, src_pitch, alpha);
+}
+
+void fossil_cube_fill_rects(const int* x, const int* y, const int* w, const int* h, int count,
+                            const uint8_t* rgba, int rgba_stride, fossil_cube_batch_order order) {
+    fossil_cube_fill_rects_ex(&g_fc, x, y, w, h, count, rgba, rgba_stride, order);
+}
+
+void fossil_cube_draw_lines(const int* x0, const int* y0, const int* x1, const int* y1, int count,
+                            const uint8_t* rgba, int rgba_stride, fossil_cube_batch_order order) {
+    fossil_cube_draw_lines_ex(&g_fc, x0, y0, x1, y1, count, rgba, rgba_stride, order);
+}
+
+void fossil_cube_blit_many(const int* dst_x, const int* dst_y, const uint8_t* const* src,
+                           const int* src_w, const int* src_h, const int* src_pitch, int count,
+                           fossil_cube_batch_order order) {
+    fossil_cube_blit_many_ex(&g_fc, dst_x, dst_y, src, src_w, src_h, src_pitch, count, order);
+}
+
+void fossil_cube_blit_masks(const int* dst_x, const int* dst_y, const uint8_t* const* coverage,
+                            const int* w, const int* h, const int* pitch, int count,
+                            uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_blit_masks_ex(&g_fc, dst_x, dst_y, coverage, w, h, pitch, count, r, g, b, a);
+}
+
+void fossil_cube_blit_mask(int dst_x, int dst_y, const uint8_t* coverage, int w, int h, int pitch,
+                           uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_blit_mask_ex(&g_fc, dst_x, dst_y, coverage, w, h, pitch, r, g, b, a);
+}
+
+void fossil_cube_draw_line_aa(float x0, float y0, float x1, float y1, float width,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_draw_line_aa_ex(&g_fc, x0, y0, x1, y1, width, r, g, b, a);
+}
+
+void fossil_cube_draw_polyline(const float* xy, int count, float width,
+                               uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_draw_polyline_ex(&g_fc, xy, count, width, r, g, b, a);
+}
+
+void fossil_cube_fill_polygon(const float* xy, int count, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_fill_polygon_ex(&g_fc, xy, count, r, g, b, a);
+}
+
+void fossil_cube_fill_circle(float cx, float cy, float radius, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_fill_circle_ex(&g_fc, cx, cy, radius, r, g, b, a);
+}
+
+void fossil_cube_fill_rounded_rect(float x, float y, float w, float h, float radius,
+                                   uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fossil_cube_fill_rounded_rect_ex(&g_fc, x, y, w, h, radius, r, g, b, a);
+}
+
+void fossil_cube_fill_rect_paint(int x, int y, int w, int h, const fossil_cube_paint* paint) {
+    fossil_cube_fill_rect_paint_ex(&g_fc, x, y, w, h, paint);
+}
+
+void fossil_cube_fill_polygon_paint(const float* xy, int count, const fossil_cube_paint* paint) {
+    fossil_cube_fill_polygon_paint_ex(&g_fc, xy, count, paint);
+}
+
+void fossil_cube_fill_circle_paint(float cx, float cy, float radius, const fossil_cube_paint* paint) {
+    fossil_cube_fill_circle_paint_ex(&g_fc, cx, cy, radius, paint);
+}
+
+void fossil_cube_fill_rounded_rect_paint(float x, float y, float w, float h, float radius,
+                                         const fossil_cube_paint* paint) {
+    fossil_cube_fill_rounded_rect_paint_ex(&g_fc, x, y, w, h, radius, paint);
+}
+
+void fossil_cube_blit_scaled(int dst_x, int dst_y, int dst_w, int dst_h,
+                             const uint8_t* src, int src_w, int src_h, int src_pitch,
+                             fossil_cube_filter filter) {
+    fossil_cube_blit_scaled_ex(&g_fc, dst_x, dst_y, dst_w, dst_h, src, src_w, src_h, src_pitch, filter);
+}
+
+void fossil_cube_draw_image(const fossil_cube_image* image, int dst_x, int dst_y) {
+    fossil_cube_draw_image_ex(&g_fc, image, dst_x, dst_y);
+}
+
+void fossil_cube_draw_image_rect(const fossil_cube_image* image,
+                                 int src_x, int src_y, int src_w, int src_h,
+                                 int dst_x, int dst_y) {
+    fossil_cube_draw_image_rect_ex(&g_fc, image, src_x, src_y, src_w, src_h, dst_x, dst_y);
+}
+
+void fossil_cube_composite(const fossil_cube_ctx* src, int src_x, int src_y, int src_w, int src_h,
+                           int dst_x, int dst_y, uint8_t opacity, fossil_cube_blend blend) {
+    fossil_cube_composite_ex(&g_fc, src, src_x, src_y, src_w, src_h, dst_x, dst_y, opacity, blend);
+}
+
+void fossil_cube_set_alpha(fossil_cube_alpha alpha) {
+    fossil_cube_set_alpha_ex(&g_fc, alpha);
+}
+
+fossil_cube_alpha fossil_cube_get_alpha(void) {
+    return fossil_cube_get_alpha_ex(&g_fc);
+}
+
+uint8_t* fossil_cube_framebuffer(int* out_w, int* out_h, int* out_pitch) {
+    return fossil_cube_framebuffer_ex(&g_fc, out_w, out_h, out_pitch);
+}
+
+void fossil_cube_set_mode(fossil_cube_mode mode) {
+    fossil_cube_set_mode_ex(&g_fc, mode);
+}
+
+fossil_cube_mode fossil_cube_get_mode(void) {
+    return fossil_cube_get_mode_ex(&g_fc);
+}
+
+fossil_cube_result fossil_cube_record_begin(fossil_cube_cmdbuf* buf) {
+    return fossil_cube_record_begin_ex(&g_fc, buf);
+}
+
+void fossil_cube_record_end(void) {
+    fossil_cube_record_end_ex(&g_fc);
+}
+
+void fossil_cube_replay(const fossil_cube_cmdbuf* buf) {
+    fossil_cube_replay_ex(&g_fc, buf);
+}
+
+fossil_cube_result fossil_cube_get_error(void) {
+    return fossil_cube_get_error_ex(&g_fc);
+}
+
+fossil_cube_result fossil_cube_set_threads(int threads) {
+    return fossil_cube_set_threads_ex(&g_fc, threads);
+}
+
+int fossil_cube_get_threads(void) {
+    return fossil_cube_get_threads_ex(&g_fc);
+}
+
+void fossil_cube_set_arena_limit(size_t bytes) {
+    fossil_cube_set_arena_limit_ex(&g_fc, bytes);
+}
+
+void fossil_cube_get_arena_stats(fossil_cube_arena_stats* out) {
+    fossil_cube_get_arena_stats_ex(&g_fc, out);
+}
+
+fossil_cube_result fossil_cube_get_stats(fossil_cube_stats* out) {
+    return fossil_cube_get_stats_ex(&g_fc, out);
+}
+
+void fossil_cube_reset_stats(void) {
+    fossil_cube_reset_stats_ex(&g_fc);
+}
+
+void fossil_cube_begin_frame_retain(void) {
+    fossil_cube_begin_frame_retain_ex(&g_fc);
+}
+
+void fossil_cube_set_present_rects(fossil_cube_present_rects_fn present_rects) {
+    fossil_cube_set_present_rects_ex(&g_fc, present_rects);
+}
+
+void fossil_cube_add_damage(int x, int y, int w, int h) {
+    fossil_cube_add_damage_ex(&g_fc, x, y, w, h);
+}
+
+int fossil_cube_get_damage(fossil_cube_rect* out_rects, int max_rects) {
+    return fossil_cube_get_damage_ex(&g_fc, out_rects, max_rects);
+}
+
+fossil_cube_result fossil_cube_set_buffers(int count) {
+    return fossil_cube_set_buffers_ex(&g_fc, count);
+}
+
+int fossil_cube_get_buffers(void) {
+    return fossil_cube_get_buffers_ex(&g_fc);
+}
+
+fossil_cube_result fossil_cube_attach(void* pixels, int width, int height, int pitch) {
+    return fossil_cube_attach_ex(&g_fc, pixels, width, height, pitch);
+}
+
+fossil_cube_result fossil_cube_release_buffer(const uint8_t* pixels) {
+    return fossil_cube_release_buffer_ex(&g_fc, pixels);
+}
+
+fossil_cube_result fossil_cube_set_encoder(fossil_cube_packet_fn packet, void* userdata) {
+    return fossil_cube_set_encoder_ex(&g_fc, packet, userdata);
+}
+
+void fossil_cube_request_key_frame(void) {
+    fossil_cube_request_key_frame_ex(&g_fc);
+}
+
+int fossil_cube_width(void)  { return fossil_cube_width_ex(&g_fc); }
+int fossil_cube_height(void) { return fossil_cube_height_ex(&g_fc); }
+
+fossil_cube_format fossil_cube_get_format(void) {
+    return fossil_cube_get_format_ex(&g_fc);
+}
+
+int fossil_cube_format_bpp(fossil_cube_format format) {
+    return fc_format_valid(format) ? g_formats[format].bpp : 0;
+}
+
+/* =========================
+   Kernel selection
+   ========================= */
+
+fossil_cube_simd fossil_cube_simd_level(void) {
+    fc_simd_select();
+    return g_simd;
+}
+
+fossil_cube_result fossil_cube_set_simd_level(fossil_cube_simd level) {
+    fc_simd_select();
+    if (!fc_simd_supported(level)) return FOSSIL_CUBE_ERR_BADARGS;
+    fc_simd_apply(level);
+    return FOSSIL_CUBE_OK;
+}
+
+/* =========================
+   Alpha conversion
+   ========================= */
+
+void fossil_cube_premultiply(uint8_t* pixels, int width, int height, int pitch) {
+    if (!pixels || width <= 0 || height <= 0) return;
+    for (int y = 0; y < height; ++y) {
+        uint8_t* p = pixels + (ptrdiff_t)y * pitch;
+        for (int x = 0; x < width; ++x, p += 4) {
+            const uint8_t a = p[3];
+            if (a == 255) continue;
+            p[0] = fc_premul(p[0], a);
+            p[1] = fc_premul(p[1], a);
+            p[2] = fc_premul(p[2], a);
+        }
+    }
+}
+
+void fossil_cube_unpremultiply(uint8_t* pixels, int width, int height, int pitch) {
+    if (!pixels || width <= 0 || height <= 0) return;
+    for (int y = 0; y < height; ++y) {
+        uint8_t* p = pixels + (ptrdiff_t)y * pitch;
+        for (int x = 0; x < width; ++x, p += 4) {
+            const int a = p[3];
+            if (a == 255) continue;
+            if (a == 0) { p[0] = p[1] = p[2] = 0; continue; }
+            for (int k = 0; k < 3; ++k) {
+                const int v = ((int)p[k] * 255 + a / 2) / a;
+                p[k] = (uint8_t)(v > 255 ? 255 : v); /* invalid input: c > a */
+            }
+        }
+    }
+}
@@ -0,0 +1,112 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CUBE_CAPTURE_H
+#define FOSSIL_CUBE_CAPTURE_H
+
+/* Frame capture
+   - an append-only file of raw frames, written through a memory mapping:
+     capturing a frame is one copy of its pixels into the page cache, the
+     file grows in large steps and is trimmed on close
+   - each record has a small header (size, format, time, damage rects)
+     followed by the pixels: the whole frame (a key frame) or, in DAMAGE
+     mode, just the pixels inside the rects
+   - DAMAGE mode writes a key frame first, every key_interval frames and
+     whenever the size or format changes, which bounds the work of
+     recreating any one frame
+   - the file header's length is updated after each record, so a file
+     left behind by a crash reads back up to its last complete frame
+   - records are in the writer's byte order
+   - the reader maps the file and indexes it on open: frames are then
+     read by index in any order
+   - compiled to FOSSIL_CUBE_ERR_UNSUPPORTED stubs with
+     FOSSIL_CUBE_NO_CAPTURE (meson -Dwith_capture=disabled)
+
+   Capture from a present_rects callback:
+       fossil_cube_capture_create(&cap, "run.fcap", FOSSIL_CUBE_CAPTURE_DAMAGE, 60);
+       ... in present_rects:
+       fossil_cube_capture_write(cap, pixels, w, h, pitch, format, rects, rect_count);
+       ...
+       fossil_cube_capture_close(cap);
+
+   Replay:
+       fossil_cube_capture_open(&cap, "run.fcap");
+       fossil_cube_capture_get(cap, 42, &frame);
+       fossil_cube_capture_read(cap, 42, pixels, pitch);
+*/
+
+#include "cube.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fossil_cube_capture fossil_cube_capture;
+
+typedef enum fossil_cube_capture_mode {
+    FOSSIL_CUBE_CAPTURE_FULL = 0,  /* every frame whole */
+    FOSSIL_CUBE_CAPTURE_DAMAGE = 1 /* damage rects plus periodic key frames */
+} fossil_cube_capture_mode;
+
+/* One captured frame as stored */
+typedef struct fossil_cube_capture_frame {
+    int width, height;
+    fossil_cube_format format;
+    uint64_t time_ns;      /* since the capture was created */
+    bool key;              /* data holds the whole frame */
+    int rect_count;        /* damage reported for the frame */
+    fossil_cube_rect rects[FOSSIL_CUBE_MAX_DAMAGE];
+    const uint8_t* data;   /* key: rows of width pixels; otherwise each
+                              rect's rows in turn, tightly packed */
+    size_t size;           /* bytes at data */
+} fossil_cube_capture_frame;
+
+/* Writer
+   - path is created or truncated
+   - key_interval: DAMAGE mode key frame spacing, <= 0 picks 60; ignored
+     in FULL mode
+*/
+fossil_cube_result fossil_cube_capture_create(fossil_cube_capture** out_cap, const char* path,
+                                              fossil_cube_capture_mode mode, int key_interval);
+
+/* Append a frame. rects NULL means the whole frame changed; a rect_count
+   of 0 records a frame where nothing changed. Rects are clipped to the
+   frame; when more than FOSSIL_CUBE_MAX_DAMAGE remain the frame is
+   recorded as a key frame with one whole-frame rect. */
+fossil_cube_result fossil_cube_capture_write(fossil_cube_capture* cap, const uint8_t* pixels,
+                                             int width, int height, int pitch,
+                                             fossil_cube_format format,
+                                             const fossil_cube_rect* rects, int rect_count);
+
+/* Reader */
+fossil_cube_result fossil_cube_capture_open(fossil_cube_capture** out_cap, const char* path);
+int fossil_cube_capture_count(const fossil_cube_capture* cap);
+
+/* The record as stored; data points into the mapping and stays valid
+   until close */
+fossil_cube_result fossil_cube_capture_get(const fossil_cube_capture* cap, int index,
+                                           fossil_cube_capture_frame* out_frame);
+
+/* Recreate frame 'index' whole into pixels (pitch 0 = tightly packed),
+   starting from the key frame before it */
+fossil_cube_result fossil_cube_capture_read(const fossil_cube_capture* cap, int index,
+                                            uint8_t* pixels, int pitch);
+
+/* Both sides; the writer trims the file to its length */
+void fossil_cube_capture_close(fossil_cube_capture* cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FOSSIL_CUBE_CAPTURE_H */
@@ -18,8 +18,10 @@
 #include <stdint.h>
 
 /* Fossil CUBE: minimal, portable, software 2D core (no GL, no OS deps)
-   - Single instance, single-threaded core
-   - Your app provides a 'present' callback to display the RGBA buffer
+   - Any number of independent contexts; one context per thread at a time
+   - The classic API below drives a built-in default context
+   - Your app provides a 'present' callback to display the framebuffer
+     in its native format (RGBA8 by default)
 */
 
 #include <stddef.h>
@@ -35,37 +37,239 @@ typedef enum fossil_cube_result {
     FOSSIL_CUBE_OK = 0,
     FOSSIL_CUBE_ERR_BADARGS = -1,
     FOSSIL_CUBE_ERR_OOM = -2,
-    FOSSIL_CUBE_ERR_NOTINIT = -3
+    FOSSIL_CUBE_ERR_NOTINIT = -3,
+    FOSSIL_CUBE_ERR_UNSUPPORTED = -4, /* feature compiled out of this build */
+    FOSSIL_CUBE_ERR_TIMEOUT = -5      /* a consumer did not release a buffer in time */
 } fossil_cube_result;
 
 /* Present callback:
-   - pixels: pointer to tightly-packed RGBA8 buffer (row-major)
+   - pixels: pointer to the framebuffer in its native format (row-major,
+     RGBA8 unless another format was configured)
    - width/height: size in pixels
-   - pitch: bytes per row (always width*4 in this core)
+   - pitch: bytes per row (width * bytes per pixel unless padded or
+     configured otherwise)
    - userdata: passthrough pointer you supplied at init
 */
 typedef void (*fossil_cube_present_fn)(
     const uint8_t* pixels, int width, int height, int pitch, void* userdata);
 
+/* Pixel formats
+   - RGBA8 (default): bytes R,G,B,A
+   - BGRA8: bytes B,G,R,A, as GDI and most scanout engines want
+   - RGB565: native-endian 16-bit words, R in the top bits; reads as opaque
+   - A8: one coverage byte per pixel; only the alpha of each draw is kept
+   - colors and blit sources are RGBA8 whatever the format; the
+     framebuffer, pitch and present callback use the native layout
+*/
+typedef enum fossil_cube_format {
+    FOSSIL_CUBE_FORMAT_RGBA8 = 0,
+    FOSSIL_CUBE_FORMAT_BGRA8 = 1,
+    FOSSIL_CUBE_FORMAT_RGB565 = 2,
+    FOSSIL_CUBE_FORMAT_A8 = 3
+} fossil_cube_format;
+
+/* Framebuffer allocator hook; free may be NULL for arena-style memory.
+   align is a power of two. */
+typedef struct fossil_cube_allocator {
+    void* (*alloc)(size_t size, size_t align, void* user);
+    void (*free)(void* ptr, size_t size, void* user);
+    void* user;
+} fossil_cube_allocator;
+
+#define FOSSIL_CUBE_DEFAULT_ALIGN 64
+
+/* Init options; zero-initialize and set what you need
+   - pitch: bytes per row of the initial framebuffer, >= width * bytes per
+     pixel and a multiple of it; 0 (and every resize) derives it from the
+     width, padded up to align when pad_rows is set
+   - align: framebuffer alignment (power of two); 0 = FOSSIL_CUBE_DEFAULT_ALIGN
+   - pixels: caller-owned framebuffer (e.g. a mapped scanout or shared
+     memory buffer) rendered into directly, aligned to the bytes per pixel;
+     never freed or zero-filled by the core; resize is rejected, use
+     fossil_cube_attach instead
+   - allocator: used for every framebuffer the core allocates; NULL = malloc
+   - clear_on_resize: zero-fill after resize (contents are undefined otherwise)
+   - arena_limit: frame arena memory kept between frames (see "Frame
+     arena"); 0 = FOSSIL_CUBE_DEFAULT_ARENA_LIMIT
+*/
+typedef struct fossil_cube_config {
+    int width, height;
+    fossil_cube_format format;
+    fossil_cube_present_fn present;
+    void* userdata;
+
+    int pitch;
+    bool pad_rows;
+    size_t align;
+    void* pixels;
+    const fossil_cube_allocator* allocator;
+    bool clear_on_resize;
+    size_t arena_limit;
+} fossil_cube_config;
+
 /* Init / Shutdown */
 fossil_cube_result fossil_cube_init(
     int width, int height,
     fossil_cube_present_fn present,
     void* userdata);
+fossil_cube_result fossil_cube_init_with(const fossil_cube_config* config);
 
 void fossil_cube_shutdown(void);
 
 /* Resize the internal framebuffer (contents are undefined after) */
 fossil_cube_result fossil_cube_resize(int new_width, int new_height);
 
+/* Render into caller memory from now on (pitch 0 = tightly packed); the
+   previous internal framebuffer is freed. pixels and pitch must be
+   multiples of the bytes per pixel. Not available with set_buffers > 1. */
+fossil_cube_result fossil_cube_attach(void* pixels, int width, int height, int pitch);
+
 /* Begin/End frame workflow */
 void fossil_cube_begin_frame(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 void fossil_cube_end_frame(void); /* calls your present() */
 
+/* Dirty rectangles
+   - the core records the box each primitive touches and merges them into
+     at most FOSSIL_CUBE_MAX_DAMAGE rects (a full clear or resize damages
+     everything); the list is reset after each end_frame
+   - begin_frame_retain starts a frame without clearing: the previous
+     contents stay and only what you draw is damaged
+   - with a present_rects callback set, end_frame calls it with the damage
+     list instead of present (rect_count may be 0 when nothing changed)
+   - add_damage reports custom drawing done through fossil_cube_framebuffer
+*/
+#define FOSSIL_CUBE_MAX_DAMAGE 16
+
+typedef struct fossil_cube_rect {
+    int x, y, w, h;
+} fossil_cube_rect;
+
+typedef void (*fossil_cube_present_rects_fn)(
+    const uint8_t* pixels, int width, int height, int pitch,
+    const fossil_cube_rect* rects, int rect_count, void* userdata);
+
+void fossil_cube_begin_frame_retain(void);
+void fossil_cube_set_present_rects(fossil_cube_present_rects_fn present_rects);
+void fossil_cube_add_damage(int x, int y, int w, int h);
+int fossil_cube_get_damage(fossil_cube_rect* out_rects, int max_rects);
+
+/* Swapchain and asynchronous present
+   - set_buffers(n), n in 1..FOSSIL_CUBE_MAX_BUFFERS; 1 (the default) keeps a
+     single framebuffer and an inline present
+   - with n >= 2, end_frame hands the finished buffer to present/present_rects
+     and switches drawing to a free buffer; the consumer may keep reading
+     'pixels' after the callback returns and calls release_buffer(pixels)
+     when done, from any thread
+   - when every buffer is held, end_frame waits up to
+     FOSSIL_CUBE_RELEASE_TIMEOUT_MS for a release, then takes back the next
+     buffer in turn and records FOSSIL_CUBE_ERR_TIMEOUT for get_error;
+     builds without threads cannot wait and take it back at once
+   - retained frames stay correct: regions damaged since a buffer was last
+     drawn are copied into it before it is touched again
+   - the framebuffer pointer changes every frame; set_buffers and resize wait
+     up to the same timeout for all buffers to be released, and otherwise
+     return FOSSIL_CUBE_ERR_TIMEOUT with nothing changed
+*/
+#define FOSSIL_CUBE_MAX_BUFFERS 4
+#ifndef FOSSIL_CUBE_RELEASE_TIMEOUT_MS
+#define FOSSIL_CUBE_RELEASE_TIMEOUT_MS 1000
+#endif
+
+fossil_cube_result fossil_cube_set_buffers(int count);
+int fossil_cube_get_buffers(void);
+fossil_cube_result fossil_cube_release_buffer(const uint8_t* pixels);
+
+/* Frame encoder
+   - set_encoder adds a stage to end_frame that codes each frame into one
+     packet for streaming and hands it to the callback before present;
+     NULL removes the stage
+   - the framebuffer is cut into FOSSIL_CUBE_ENCODE_TILE square tiles; in
+     each, the box around the damage is XORed with the previous frame and
+     run-length coded (stored raw when that is not smaller)
+   - tiles are encoded in parallel on the tile workers; deferred frames
+     with threads encode every tile right after rasterizing it, while its
+     pixels are still in cache
+   - the first packet, the first after a resize and the next one after
+     request_key_frame is a key frame coding the whole framebuffer; the
+     others code just the damage, so report custom drawing with add_damage
+   - a frame without damage yields a packet with no tiles; data is valid
+     until the callback returns, which must not draw to the context
+   - fossil_cube_decode applies packets in order to a framebuffer of the
+     same size and format (RGB565 words are sent in the producer's byte
+     order)
+
+   Packet layout, integers little-endian:
+     header (24 bytes): u32 magic "FCXD", u32 sequence, u32 width,
+       u32 height, u8 format, u8 flags (1: key frame), u16 0, u32 tiles
+     per tile (16 bytes): u16 column, u16 row, u8 x, y, w, h (the box
+       within the tile), u8 mode, u8[3] 0, u32 payload bytes; then payload
+     mode 1 (raw): the box's pixels, row by row
+     mode 0 (XOR-RLE): ops over the box's pixels row by row, XORed into
+       the previous frame (zeros for a key frame), one control byte each:
+       0x00 | n-1: skip n pixels (n <= 128)
+       0x80 | n-1: n XOR values follow (n <= 64)
+       0xC0 | n-1: one XOR value for n pixels (n <= 64)
+*/
+#define FOSSIL_CUBE_ENCODE_TILE 64
+
+typedef void (*fossil_cube_packet_fn)(const uint8_t* data, size_t size, void* userdata);
+
+typedef struct fossil_cube_packet_info {
+    int width, height;
+    fossil_cube_format format;
+    uint32_t sequence; /* 0, 1, 2, ... since set_encoder */
+    bool key;
+    int tile_count;
+} fossil_cube_packet_info;
+
+fossil_cube_result fossil_cube_set_encoder(fossil_cube_packet_fn packet, void* userdata);
+void fossil_cube_request_key_frame(void);
+
+fossil_cube_result fossil_cube_decode_info(const uint8_t* data, size_t size,
+                                           fossil_cube_packet_info* out_info);
+/* pitch 0 = tightly packed. FOSSIL_CUBE_ERR_BADARGS for a packet of
+   another size or format, or a corrupt one (pixels may then be partly
+   updated: request a key frame). */
+fossil_cube_result fossil_cube_decode(const uint8_t* data, size_t size,
+                                      uint8_t* pixels, int width, int height, int pitch,
+                                      fossil_cube_format format);
+
 /* Immediate 2D drawing (software) */
 void fossil_cube_clear(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 void fossil_cube_set_clip(int x, int y, int w, int h); /* set clip rect; w/h<=0 disables clipping */
-void fossil_cube_get_clip(int* x, int* y, int* w, int* h);
+void fossil_cube_get_clip(int* x, int* y, int* w, int* h); /* all 0 when disabled */
+
+/* Clip regions
+   - a region is a union of rects, optionally minus another union (the
+     visible part of a window under others), stored as y-bands of
+     disjoint x-spans; it is built once and can be reused every frame
+   - while set, every primitive except clear is drawn only inside both
+     the clip rect and the region, in one pass: rect primitives run once
+     per span they overlap, shapes are clipped span by span as their
+     coverage is emitted
+   - a command recorded without a region takes the one set when it is
+     replayed; one recorded with a region keeps it
+   - like images, regions are not tied to a context and must outlive
+     any frame or command buffer that uses them; resize and attach drop
+     the region along with the clip rect
+*/
+typedef struct fossil_cube_region fossil_cube_region;
+
+fossil_cube_result fossil_cube_region_create(fossil_cube_region** out_region,
+                                             const fossil_cube_rect* rects, int count);
+/* rects minus the union of subtract */
+fossil_cube_result fossil_cube_region_create_diff(fossil_cube_region** out_region,
+                                                  const fossil_cube_rect* rects, int count,
+                                                  const fossil_cube_rect* subtract, int subtract_count);
+void fossil_cube_region_destroy(fossil_cube_region* region);
+/* All zero for an empty region */
+fossil_cube_rect fossil_cube_region_bounds(const fossil_cube_region* region);
+/* The region as disjoint rects, top to bottom: writes up to max_rects and
+   returns how many were written, or the total when out_rects is NULL */
+int fossil_cube_region_rects(const fossil_cube_region* region, fossil_cube_rect* out_rects, int max_rects);
+
+void fossil_cube_set_clip_region(const fossil_cube_region* region); /* NULL: none */
+const fossil_cube_region* fossil_cube_get_clip_region(void);
 
 void fossil_cube_put_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
@@ -73,32 +277,1181 @@ void fossil_cube_put_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_
 void fossil_cube_fill_rect(int x, int y, int w, int h,
                            uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
-/* 1px line (alpha-blended) using Bresenham */
+/* 1px line (alpha-blended) using Bresenham; horizontal and vertical
+   lines are detected and drawn as 1px fills (same pixels) */
 void fossil_cube_draw_line(int x0, int y0, int x1, int y1,
                            uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
-/* Blit a source RGBA buffer (premultiplied or straight? -> straight alpha expected) */
+/* Axis-aligned 1px lines from (x, y) spanning w / h pixels, and a 1px
+   rectangle outline whose corners are blended only once */
+void fossil_cube_draw_hline(int x, int y, int w, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_draw_vline(int x, int y, int h, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_draw_rect(int x, int y, int w, int h,
+                           uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+/* Anti-aliased shapes
+   - float coordinates; pixel (x, y) covers [x, x+1) x [y, y+1), so a
+     1-wide horizontal line at y = 10.5 exactly covers row 10
+   - each call is one shape: edges are accumulated as signed area per
+     pixel and the coverage is blended by the same kernel as blit_mask
+   - overlaps within a shape (joins, self-crossing polylines and
+     polygons) are filled once (nonzero rule)
+   - lines and polylines have butt ends; polyline joins are round when
+     the width is above 2 (thinner joins close up by the overlap)
+   - a polyline with thousands of points is a single shape and a single
+     command; prefer it to one draw_line_aa per segment
+   - coordinates are clamped to +-2^24; colors follow the alpha setting
+*/
+void fossil_cube_draw_line_aa(float x0, float y0, float x1, float y1, float width,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_draw_polyline(const float* xy, int count, float width, /* count points */
+                               uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_fill_polygon(const float* xy, int count, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_fill_circle(float cx, float cy, float radius, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_fill_rounded_rect(float x, float y, float w, float h, float radius,
+                                   uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+/* Alpha interpretation
+   - STRAIGHT (default): colors and blit sources carry unassociated alpha;
+     colors are premultiplied once per call, blits use (s*sa + d*(1-sa))
+   - PREMULTIPLIED: values are used as given with s + d*(1-sa); inputs
+     must satisfy r,g,b <= a (larger values wrap rather than saturate)
+   - the framebuffer itself holds premultiplied pixels; clear stores its
+     color unchanged in either mode
+*/
+typedef enum fossil_cube_alpha {
+    FOSSIL_CUBE_ALPHA_STRAIGHT = 0,
+    FOSSIL_CUBE_ALPHA_PREMULTIPLIED = 1
+} fossil_cube_alpha;
+
+void fossil_cube_set_alpha(fossil_cube_alpha alpha); /* per surface */
+fossil_cube_alpha fossil_cube_get_alpha(void);
+
+/* Blit a source RGBA buffer, read with the surface's alpha setting */
 void fossil_cube_blit_rgba(int dst_x, int dst_y,
                            const uint8_t* src, int src_w, int src_h, int src_pitch);
 
+/* Blit with an explicit per-blit alpha interpretation */
+void fossil_cube_blit_rgba_alpha(int dst_x, int dst_y,
+                                 const uint8_t* src, int src_w, int src_h, int src_pitch,
+                                 fossil_cube_alpha alpha);
+
+/* Tint an A8 coverage mask (one byte per pixel, e.g. a glyph) with a
+   color, read with the surface's alpha setting, and blend it over */
+void fossil_cube_blit_mask(int dst_x, int dst_y, const uint8_t* coverage, int w, int h, int pitch,
+                           uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+/* Scaled blits
+   - the src_w x src_h source is stretched over the dst_w x dst_h rect and
+     blended in one pass: source rows are resampled a strip at a time into
+     a small stack buffer, nothing is allocated and the source is read once
+   - pixel centers map exactly (integer step tables, no accumulated error);
+     samples past the source edge clamp to it
+   - NEAREST picks one source pixel; BILINEAR weighs the 2x2 around the
+     sample point in 1/256 steps, premultiplying straight sources per tap
+     so transparent neighbours do not bleed their color
+   - read with the surface's alpha setting; a 1:1 NEAREST blit equals
+     blit_rgba
+*/
+typedef enum fossil_cube_filter {
+    FOSSIL_CUBE_FILTER_NEAREST = 0,
+    FOSSIL_CUBE_FILTER_BILINEAR = 1
+} fossil_cube_filter;
+
+void fossil_cube_blit_scaled(int dst_x, int dst_y, int dst_w, int dst_h,
+                             const uint8_t* src, int src_w, int src_h, int src_pitch,
+                             fossil_cube_filter filter);
+
+/* In-place conversion of RGBA buffers between straight and premultiplied */
+void fossil_cube_premultiply(uint8_t* pixels, int width, int height, int pitch);
+void fossil_cube_unpremultiply(uint8_t* pixels, int width, int height, int pitch);
+
+/* Batches
+   - structure-of-arrays forms of fill_rect, draw_line and blit_rgba for
+     views that draw thousands of small primitives: the context and clip
+     are checked once, the whole batch is clipped in one branch-free pass
+     over the arrays, and only the elements left are drawn, each exactly
+     as its single call would draw it
+   - every array holds count entries; rgba holds 4 bytes per element,
+     rgba_stride bytes apart (0: the first color for all), read with the
+     surface's alpha setting
+   - blit_many reads each source with the surface's alpha setting;
+     src_pitch may be NULL for tightly packed sources
+   - BY_ROW draws the elements top row first instead of in array order
+     (elements starting on the same row keep their order), so the
+     framebuffer is walked once; it changes the result only where
+     elements overlap. Without the memory for the sort the batch is
+     drawn in array order.
+   - each element counts as one call in the frame statistics
+   - blit_masks tints count A8 masks with one color and draws them as a
+     single mask command (one call in the statistics), in array order;
+     that is how draw_text draws a string. pitch may be NULL, and a 0
+     entry means tightly packed.
+*/
+typedef enum fossil_cube_batch_order {
+    FOSSIL_CUBE_BATCH_IN_ORDER = 0,
+    FOSSIL_CUBE_BATCH_BY_ROW = 1
+} fossil_cube_batch_order;
+
+void fossil_cube_fill_rects(const int* x, const int* y, const int* w, const int* h, int count,
+                            const uint8_t* rgba, int rgba_stride, fossil_cube_batch_order order);
+void fossil_cube_draw_lines(const int* x0, const int* y0, const int* x1, const int* y1, int count,
+                            const uint8_t* rgba, int rgba_stride, fossil_cube_batch_order order);
+void fossil_cube_blit_many(const int* dst_x, const int* dst_y, const uint8_t* const* src,
+                           const int* src_w, const int* src_h, const int* src_pitch, int count,
+                           fossil_cube_batch_order order);
+void fossil_cube_blit_masks(const int* dst_x, const int* dst_y, const uint8_t* const* coverage,
+                            const int* w, const int* h, const int* pitch, int count,
+                            uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+/* Images and atlases
+   - an image owns a premultiplied, row-aligned copy of its RGBA8 source;
+     straight sources are converted once at create/update
+   - each row is classified into transparent, opaque and translucent runs
+     up front: transparent runs are skipped, opaque runs are copied and
+     only translucent ones are blended
+   - draw_image_rect draws a sub-rect (an atlas cell); the source rect is
+     clamped to the image
+   - update replaces a sub-rect and reclassifies only the rows it touches
+   - images are not tied to a context; like blit sources they must outlive
+     any frame or command buffer that draws them
+*/
+typedef struct fossil_cube_image fossil_cube_image;
+
+fossil_cube_result fossil_cube_image_create(fossil_cube_image** out_image,
+                                            const uint8_t* rgba, int width, int height, int pitch,
+                                            fossil_cube_alpha alpha);
+fossil_cube_result fossil_cube_image_update(fossil_cube_image* image, int x, int y,
+                                            const uint8_t* rgba, int width, int height, int pitch,
+                                            fossil_cube_alpha alpha);
+void fossil_cube_image_destroy(fossil_cube_image* image);
+int fossil_cube_image_width(const fossil_cube_image* image);
+int fossil_cube_image_height(const fossil_cube_image* image);
+
+void fossil_cube_draw_image(const fossil_cube_image* image, int dst_x, int dst_y);
+void fossil_cube_draw_image_rect(const fossil_cube_image* image,
+                                 int src_x, int src_y, int src_w, int src_h,
+                                 int dst_x, int dst_y);
+
+/* Paints
+   - a paint fills a shape with a color ramp or a tiled image instead of
+     one color: the *_paint fills take it where the solid calls take
+     r, g, b, a, and draw exactly like them when the paint is one color
+   - gradient stops are straight RGBA at offsets in [0, 1], in order:
+     offsets are clamped and one below its predecessor is raised to it,
+     so equal offsets make a hard edge
+   - the ramp is interpolated premultiplied into a 256-entry table once
+     at create; drawing is a table lookup per pixel
+   - LINEAR: t runs from 0 at (x0, y0) to 1 at (x1, y1), constant along
+     the perpendiculars; a ramp shorter than a pixel is drawn over one
+     pixel and a zero-length one paints its last stop
+   - RADIAL: t runs from 0 at the center to 1 at radius
+   - extend picks what t outside [0, 1] shows: PAD the end stops, REPEAT
+     the ramp again, REFLECT it mirrored
+   - PATTERN: the image repeated in both directions with its pixel (0, 0)
+     at (origin_x, origin_y); the image must outlive the paint
+   - positions are framebuffer pixels, sampled at pixel centers; the
+     surface's alpha setting does not apply
+   - like images, paints are not tied to a context and must outlive any
+     frame or command buffer that draws them
+*/
+typedef struct fossil_cube_paint fossil_cube_paint;
+
+typedef struct fossil_cube_color_stop {
+    float offset;
+    uint8_t r, g, b, a;
+} fossil_cube_color_stop;
+
+typedef enum fossil_cube_extend {
+    FOSSIL_CUBE_EXTEND_PAD = 0,
+    FOSSIL_CUBE_EXTEND_REPEAT = 1,
+    FOSSIL_CUBE_EXTEND_REFLECT = 2
+} fossil_cube_extend;
+
+fossil_cube_result fossil_cube_paint_linear(fossil_cube_paint** out_paint,
+                                            float x0, float y0, float x1, float y1,
+                                            const fossil_cube_color_stop* stops, int count,
+                                            fossil_cube_extend extend);
+fossil_cube_result fossil_cube_paint_radial(fossil_cube_paint** out_paint,
+                                            float cx, float cy, float radius,
+                                            const fossil_cube_color_stop* stops, int count,
+                                            fossil_cube_extend extend);
+fossil_cube_result fossil_cube_paint_pattern(fossil_cube_paint** out_paint, const fossil_cube_image* image,
+                                             int origin_x, int origin_y);
+void fossil_cube_paint_destroy(fossil_cube_paint* paint);
+
+void fossil_cube_fill_rect_paint(int x, int y, int w, int h, const fossil_cube_paint* paint);
+void fossil_cube_fill_polygon_paint(const float* xy, int count, const fossil_cube_paint* paint);
+void fossil_cube_fill_circle_paint(float cx, float cy, float radius, const fossil_cube_paint* paint);
+void fossil_cube_fill_rounded_rect_paint(float x, float y, float w, float h, float radius,
+                                         const fossil_cube_paint* paint);
+
+/* Compositing
+   - composite draws a rect of another context's framebuffer onto this
+     one at (dst_x, dst_y), through the clip; the source rect is clamped
+     to the source framebuffer
+   - any source format works: pixels read as premultiplied RGBA8, so
+     RGB565 is opaque and A8 is black coverage
+   - opacity scales the source first (255 = as is); the blend mode then
+     combines it with the destination:
+       OVER      s + d*(1 - sa)
+       COPY      s (replaces the rect, transparent pixels included)
+       ADD       min(s + d, 1)
+       MULTIPLY  s*d + s*(1 - da) + d*(1 - sa)
+   - like a blit source, the source is read when the command runs: in
+     deferred mode or when recording, leave it alone until the
+     destination frame ends. Source and destination must differ.
+   - see layer.h for cached offscreen layers built on this
+*/
+typedef enum fossil_cube_blend {
+    FOSSIL_CUBE_BLEND_OVER = 0,
+    FOSSIL_CUBE_BLEND_COPY = 1,
+    FOSSIL_CUBE_BLEND_ADD = 2,
+    FOSSIL_CUBE_BLEND_MULTIPLY = 3
+} fossil_cube_blend;
+
+typedef struct fossil_cube_ctx fossil_cube_ctx; /* see "Contexts" */
+
+void fossil_cube_composite(const fossil_cube_ctx* src, int src_x, int src_y, int src_w, int src_h,
+                           int dst_x, int dst_y, uint8_t opacity, fossil_cube_blend blend);
+
 /* Access to the raw framebuffer if the app wants to do custom drawing */
 uint8_t* fossil_cube_framebuffer(int* out_w, int* out_h, int* out_pitch);
 
+/* Deferred rendering
+   - IMMEDIATE (default): every call draws at once
+   - DEFERRED: calls between begin_frame and end_frame are appended to a
+     command buffer; end_frame drops fully overdrawn commands, merges
+     adjacent same-color fills, then executes the whole frame in one pass.
+     Output is identical to immediate mode.
+   - pointers passed to blit_rgba must stay valid until the commands run
+   - the mode can only change outside a frame
+*/
+typedef enum fossil_cube_mode {
+    FOSSIL_CUBE_MODE_IMMEDIATE = 0,
+    FOSSIL_CUBE_MODE_DEFERRED = 1
+} fossil_cube_mode;
+
+void fossil_cube_set_mode(fossil_cube_mode mode);
+fossil_cube_mode fossil_cube_get_mode(void);
+
+/* Parallel tile rasterizer
+   - with threads > 1, deferred end_frame bins commands into 64x64 tiles
+     and rasterizes tiles on a worker pool (the calling thread included);
+     output is identical to the single-threaded path
+   - 0 or 1 means single-threaded (default); immediate mode is unaffected
+   - returns UNSUPPORTED for threads > 1 in builds without threads
+     (meson -Dwith_threads=disabled), which keep the serial executor
+*/
+#define FOSSIL_CUBE_MAX_THREADS 256
+
+fossil_cube_result fossil_cube_set_threads(int threads);
+int fossil_cube_get_threads(void);
+
+/* Recorded command buffers
+   - between record_begin and record_end, draw calls (including clear and
+     nested replays) are appended to 'buf' instead of drawing
+   - replay runs a buffer now, or appends it to the current deferred
+     frame; the clip in effect at replay further clips every command
+   - a buffer can be replayed any number of times, across frames
+   - begin_frame's clear always goes to the frame, even while recording
+   - a command that cannot be stored (out of memory) is dropped;
+     get_error returns the first such error since it was last called,
+     then resets to FOSSIL_CUBE_OK
+*/
+typedef struct fossil_cube_cmdbuf fossil_cube_cmdbuf;
+
+fossil_cube_result fossil_cube_cmdbuf_create(fossil_cube_cmdbuf** out_buf);
+void fossil_cube_cmdbuf_destroy(fossil_cube_cmdbuf* buf);
+void fossil_cube_cmdbuf_reset(fossil_cube_cmdbuf* buf);
+size_t fossil_cube_cmdbuf_count(const fossil_cube_cmdbuf* buf);
+
+fossil_cube_result fossil_cube_record_begin(fossil_cube_cmdbuf* buf);
+void fossil_cube_record_end(void);
+void fossil_cube_replay(const fossil_cube_cmdbuf* buf);
+fossil_cube_result fossil_cube_get_error(void);
+
+/* Frame arena
+   - transient data of a frame (the shape records behind deferred and
+     recorded anti-aliased draws) is bump-allocated from blocks owned by
+     the context, or by the command buffer being recorded, and dropped in
+     one step when the frame or buffer is reset
+   - a reset folds the blocks a frame needed into one, so once frames
+     stop growing the frame loop makes no allocator calls at all
+   - limit: the most memory kept across resets; a bigger frame still
+     runs, its blocks are freed at the next reset. Takes effect then.
+   - stats cover the context's own arena; block_allocs only grows when
+     the allocator is called, so a flat count means no frame mallocs
+*/
+#define FOSSIL_CUBE_DEFAULT_ARENA_LIMIT ((size_t)16u << 20)
+
+typedef struct fossil_cube_arena_stats {
+    size_t used;           /* bytes handed out since the last reset */
+    size_t peak;           /* most used between two resets */
+    size_t reserved;       /* bytes currently held */
+    size_t limit;          /* bytes kept across resets */
+    uint64_t block_allocs; /* blocks taken from malloc so far */
+} fossil_cube_arena_stats;
+
+void fossil_cube_set_arena_limit(size_t bytes); /* 0 = default */
+void fossil_cube_get_arena_stats(fossil_cube_arena_stats* out);
+
+/* Frame statistics
+   - opt-in: compiled in with meson -Dwith_stats=enabled (defines
+     FOSSIL_CUBE_STATS for the library); otherwise nothing is counted and
+     get_stats returns FOSSIL_CUBE_ERR_UNSUPPORTED
+   - per primitive: calls are the draw commands submitted to the frame or
+     drawn immediately (a replay counts its commands again, recording
+     counts nothing, draw_rect is up to four fills); pixels are those
+     handed to a kernel after clipping, split into copied (opaque writes)
+     and blended. Commands culled by the deferred optimizer draw nothing.
+   - times are monotonic nanoseconds: frame from begin_frame to the end
+     of end_frame, render the deferred execution inside end_frame,
+     present the present / present_rects callback
+   - counters accumulate until reset_stats
+*/
+typedef enum fossil_cube_prim {
+    FOSSIL_CUBE_PRIM_CLEAR = 0,
+    FOSSIL_CUBE_PRIM_PIXEL,
+    FOSSIL_CUBE_PRIM_FILL,   /* fill_rect, hline/vline, axis-aligned draw_line */
+    FOSSIL_CUBE_PRIM_LINE,
+    FOSSIL_CUBE_PRIM_BLIT,
+    FOSSIL_CUBE_PRIM_IMAGE,
+    FOSSIL_CUBE_PRIM_MASK,   /* blit_mask, text */
+    FOSSIL_CUBE_PRIM_SCALED,
+    FOSSIL_CUBE_PRIM_PATH,   /* anti-aliased shapes */
+    FOSSIL_CUBE_PRIM_COMPOSITE,
+    FOSSIL_CUBE_PRIM_PAINT,  /* fill_rect_paint; painted shapes count as PATH */
+    FOSSIL_CUBE_PRIM_COUNT
+} fossil_cube_prim;
+
+typedef struct fossil_cube_prim_stats {
+    uint64_t calls;
+    uint64_t pixels;  /* copied + blended */
+    uint64_t copied;
+    uint64_t blended;
+} fossil_cube_prim_stats;
+
+typedef struct fossil_cube_timing {
+    uint64_t count;
+    uint64_t last_ns, total_ns, max_ns;
+} fossil_cube_timing;
+
+typedef struct fossil_cube_stats {
+    uint64_t frames; /* end_frame calls */
+    fossil_cube_prim_stats prim[FOSSIL_CUBE_PRIM_COUNT];
+    fossil_cube_timing frame, render, present;
+} fossil_cube_stats;
+
+fossil_cube_result fossil_cube_get_stats(fossil_cube_stats* out);
+void fossil_cube_reset_stats(void);
+
+/* SIMD span kernels
+   - the core picks the widest kernel set the CPU supports at init
+   - every set produces bit-identical output to the scalar reference
+   - set_simd_level exists for testing/benchmarking; returns BADARGS if
+     the requested set is not available on this CPU or build. It is
+     process-wide: do not call it while other threads are rendering
+*/
+typedef enum fossil_cube_simd {
+    FOSSIL_CUBE_SIMD_SCALAR = 0,
+    FOSSIL_CUBE_SIMD_SSE2 = 1,
+    FOSSIL_CUBE_SIMD_AVX2 = 2,
+    FOSSIL_CUBE_SIMD_NEON = 3
+} fossil_cube_simd;
+
+fossil_cube_simd fossil_cube_simd_level(void);
+fossil_cube_result fossil_cube_set_simd_level(fossil_cube_simd level);
+
 /* Utilities */
 int fossil_cube_width(void);
 int fossil_cube_height(void);
+fossil_cube_format fossil_cube_get_format(void);
+int fossil_cube_format_bpp(fossil_cube_format format); /* 0 if unknown */
+
+/* Contexts
+   - opaque handle owning a framebuffer, clip and present callback
+   - distinct contexts share no per-context state: render them on
+     separate threads freely, but never use one context from two threads
+     at once
+   - the kernel tables are process-wide: fossil_cube_set_simd_level
+     rewrites them and must not race with rendering on any context
+   - present may be NULL for offscreen contexts (end_frame then no-ops)
+   - the classic API above is a thin wrapper over the default context
+     created by fossil_cube_init
+*/
+typedef struct fossil_cube_ctx fossil_cube_ctx;
+
+fossil_cube_result fossil_cube_ctx_create(fossil_cube_ctx** out_ctx,
+                                          int width, int height,
+                                          fossil_cube_present_fn present,
+                                          void* userdata);
+fossil_cube_result fossil_cube_ctx_create_with(fossil_cube_ctx** out_ctx,
+                                               const fossil_cube_config* config);
+void fossil_cube_ctx_destroy(fossil_cube_ctx* ctx);
+
+/* The context behind the classic API (NULL until fossil_cube_init) */
+fossil_cube_ctx* fossil_cube_default_ctx(void);
+
+fossil_cube_result fossil_cube_resize_ex(fossil_cube_ctx* ctx, int new_width, int new_height);
+
+void fossil_cube_begin_frame_ex(fossil_cube_ctx* ctx, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_end_frame_ex(fossil_cube_ctx* ctx);
+void fossil_cube_begin_frame_retain_ex(fossil_cube_ctx* ctx);
+void fossil_cube_set_present_rects_ex(fossil_cube_ctx* ctx, fossil_cube_present_rects_fn present_rects);
+void fossil_cube_add_damage_ex(fossil_cube_ctx* ctx, int x, int y, int w, int h);
+int fossil_cube_get_damage_ex(const fossil_cube_ctx* ctx, fossil_cube_rect* out_rects, int max_rects);
+fossil_cube_result fossil_cube_attach_ex(fossil_cube_ctx* ctx, void* pixels,
+                                         int width, int height, int pitch);
+fossil_cube_result fossil_cube_set_buffers_ex(fossil_cube_ctx* ctx, int count);
+int fossil_cube_get_buffers_ex(const fossil_cube_ctx* ctx);
+fossil_cube_result fossil_cube_release_buffer_ex(fossil_cube_ctx* ctx, const uint8_t* pixels);
+fossil_cube_result fossil_cube_set_encoder_ex(fossil_cube_ctx* ctx, fossil_cube_packet_fn packet, void* userdata);
+void fossil_cube_request_key_frame_ex(fossil_cube_ctx* ctx);
+
+void fossil_cube_clear_ex(fossil_cube_ctx* ctx, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_set_clip_ex(fossil_cube_ctx* ctx, int x, int y, int w, int h);
+void fossil_cube_get_clip_ex(const fossil_cube_ctx* ctx, int* x, int* y, int* w, int* h);
+void fossil_cube_set_clip_region_ex(fossil_cube_ctx* ctx, const fossil_cube_region* region);
+const fossil_cube_region* fossil_cube_get_clip_region_ex(const fossil_cube_ctx* ctx);
+
+void fossil_cube_put_pixel_ex(fossil_cube_ctx* ctx, int x, int y,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_fill_rect_ex(fossil_cube_ctx* ctx, int x, int y, int w, int h,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_draw_line_ex(fossil_cube_ctx* ctx, int x0, int y0, int x1, int y1,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_draw_hline_ex(fossil_cube_ctx* ctx, int x, int y, int w,
+                               uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_draw_vline_ex(fossil_cube_ctx* ctx, int x, int y, int h,
+                               uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_draw_rect_ex(fossil_cube_ctx* ctx, int x, int y, int w, int h,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_draw_line_aa_ex(fossil_cube_ctx* ctx, float x0, float y0, float x1, float y1,
+                                 float width, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_draw_polyline_ex(fossil_cube_ctx* ctx, const float* xy, int count, float width,
+                                  uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_fill_polygon_ex(fossil_cube_ctx* ctx, const float* xy, int count,
+                                 uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_fill_circle_ex(fossil_cube_ctx* ctx, float cx, float cy, float radius,
+                                uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_fill_rounded_rect_ex(fossil_cube_ctx* ctx, float x, float y, float w, float h,
+                                      float radius, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_blit_rgba_ex(fossil_cube_ctx* ctx, int dst_x, int dst_y,
+                              const uint8_t* src, int src_w, int src_h, int src_pitch);
+void fossil_cube_blit_rgba_alpha_ex(fossil_cube_ctx* ctx, int dst_x, int dst_y,
+                                    const uint8_t* src, int src_w, int src_h, int src_pitch,
+                                    fossil_cube_alpha alpha);
+void fossil_cube_blit_mask_ex(fossil_cube_ctx* ctx, int dst_x, int dst_y,
+                              const uint8_t* coverage, int w, int h, int pitch,
+                              uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_blit_scaled_ex(fossil_cube_ctx* ctx, int dst_x, int dst_y, int dst_w, int dst_h,
+                                const uint8_t* src, int src_w, int src_h, int src_pitch,
+                                fossil_cube_filter filter);
+void fossil_cube_draw_image_ex(fossil_cube_ctx* ctx, const fossil_cube_image* image,
+                               int dst_x, int dst_y);
+void fossil_cube_draw_image_rect_ex(fossil_cube_ctx* ctx, const fossil_cube_image* image,
+                                    int src_x, int src_y, int src_w, int src_h,
+                                    int dst_x, int dst_y);
+void fossil_cube_fill_rects_ex(fossil_cube_ctx* ctx, const int* x, const int* y, const int* w, const int* h,
+                               int count, const uint8_t* rgba, int rgba_stride,
+                               fossil_cube_batch_order order);
+void fossil_cube_draw_lines_ex(fossil_cube_ctx* ctx, const int* x0, const int* y0, const int* x1,
+                               const int* y1, int count, const uint8_t* rgba, int rgba_stride,
+                               fossil_cube_batch_order order);
+void fossil_cube_blit_many_ex(fossil_cube_ctx* ctx, const int* dst_x, const int* dst_y,
+                              const uint8_t* const* src, const int* src_w, const int* src_h,
+                              const int* src_pitch, int count, fossil_cube_batch_order order);
+void fossil_cube_blit_masks_ex(fossil_cube_ctx* ctx, const int* dst_x, const int* dst_y,
+                               const uint8_t* const* coverage, const int* w, const int* h,
+                               const int* pitch, int count, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_fill_rect_paint_ex(fossil_cube_ctx* ctx, int x, int y, int w, int h,
+                                    const fossil_cube_paint* paint);
+void fossil_cube_fill_polygon_paint_ex(fossil_cube_ctx* ctx, const float* xy, int count,
+                                       const fossil_cube_paint* paint);
+void fossil_cube_fill_circle_paint_ex(fossil_cube_ctx* ctx, float cx, float cy, float radius,
+                                      const fossil_cube_paint* paint);
+void fossil_cube_fill_rounded_rect_paint_ex(fossil_cube_ctx* ctx, float x, float y, float w, float h,
+                                            float radius, const fossil_cube_paint* paint);
+void fossil_cube_composite_ex(fossil_cube_ctx* ctx, const fossil_cube_ctx* src,
+                              int src_x, int src_y, int src_w, int src_h,
+                              int dst_x, int dst_y, uint8_t opacity, fossil_cube_blend blend);
+void fossil_cube_set_alpha_ex(fossil_cube_ctx* ctx, fossil_cube_alpha alpha);
+fossil_cube_alpha fossil_cube_get_alpha_ex(const fossil_cube_ctx* ctx);
+
+uint8_t* fossil_cube_framebuffer_ex(fossil_cube_ctx* ctx, int* out_w, int* out_h, int* out_pitch);
+int fossil_cube_width_ex(const fossil_cube_ctx* ctx);
+int fossil_cube_height_ex(const fossil_cube_ctx* ctx);
+fossil_cube_format fossil_cube_get_format_ex(const fossil_cube_ctx* ctx);
+
+void fossil_cube_set_mode_ex(fossil_cube_ctx* ctx, fossil_cube_mode mode);
+fossil_cube_mode fossil_cube_get_mode_ex(const fossil_cube_ctx* ctx);
+fossil_cube_result fossil_cube_set_threads_ex(fossil_cube_ctx* ctx, int threads);
+int fossil_cube_get_threads_ex(const fossil_cube_ctx* ctx);
+fossil_cube_result fossil_cube_record_begin_ex(fossil_cube_ctx* ctx, fossil_cube_cmdbuf* buf);
+void fossil_cube_record_end_ex(fossil_cube_ctx* ctx);
+void fossil_cube_replay_ex(fossil_cube_ctx* ctx, const fossil_cube_cmdbuf* buf);
+fossil_cube_result fossil_cube_get_error_ex(fossil_cube_ctx* ctx);
+void fossil_cube_set_arena_limit_ex(fossil_cube_ctx* ctx, size_t bytes);
+void fossil_cube_get_arena_stats_ex(const fossil_cube_ctx* ctx, fossil_cube_arena_stats* out);
+fossil_cube_result fossil_cube_get_stats_ex(const fossil_cube_ctx* ctx, fossil_cube_stats* out);
+void fossil_cube_reset_stats_ex(fossil_cube_ctx* ctx);
 
 #ifdef __cplusplus
 }
 #include <stdexcept>
 #include <vector>
 #include <string>
+#include <cstring>
+#include <climits>
+#include <span>
+#include <utility>
 
 namespace fossil {
 
 namespace cube {
 
+/* C++ layer
+   - Context, Surface and Image own their C handle: movable, not copyable
+   - only constructors throw (fossil::cube::Error); every other member is
+     a noexcept inline forward to the *_ex function and never allocates
+   - a moved-from object may only be assigned to or destroyed
+   - SurfaceView<F> plus the fill/blit templates write a framebuffer
+     directly with the format and blend mode fixed at compile time, so the
+     pixel loops carry no format or mode branch. Output is bit-identical
+     to the core's kernels. Like fossil_cube_framebuffer they bypass the
+     clip, damage and deferred queue: report what you touch with
+     add_damage.
+*/
+
+using Result = fossil_cube_result;
+using Rect = fossil_cube_rect;
 
+enum class Format : int {
+    RGBA8 = FOSSIL_CUBE_FORMAT_RGBA8,
+    BGRA8 = FOSSIL_CUBE_FORMAT_BGRA8,
+    RGB565 = FOSSIL_CUBE_FORMAT_RGB565,
+    A8 = FOSSIL_CUBE_FORMAT_A8
+};
+
+enum class Alpha : int {
+    Straight = FOSSIL_CUBE_ALPHA_STRAIGHT,
+    Premultiplied = FOSSIL_CUBE_ALPHA_PREMULTIPLIED
+};
+
+enum class Filter : int {
+    Nearest = FOSSIL_CUBE_FILTER_NEAREST,
+    Bilinear = FOSSIL_CUBE_FILTER_BILINEAR
+};
+
+enum class Extend : int {
+    Pad = FOSSIL_CUBE_EXTEND_PAD,
+    Repeat = FOSSIL_CUBE_EXTEND_REPEAT,
+    Reflect = FOSSIL_CUBE_EXTEND_REFLECT
+};
+
+enum class BatchOrder : int {
+    InOrder = FOSSIL_CUBE_BATCH_IN_ORDER,
+    ByRow = FOSSIL_CUBE_BATCH_BY_ROW
+};
+
+enum class Mode : int {
+    Immediate = FOSSIL_CUBE_MODE_IMMEDIATE,
+    Deferred = FOSSIL_CUBE_MODE_DEFERRED
+};
+
+/* See "Compositing"; the fill/blit templates take the same modes */
+enum class Blend : int {
+    Over = FOSSIL_CUBE_BLEND_OVER,
+    Copy = FOSSIL_CUBE_BLEND_COPY,
+    Add = FOSSIL_CUBE_BLEND_ADD,
+    Multiply = FOSSIL_CUBE_BLEND_MULTIPLY
+};
+
+constexpr int bytes_per_pixel(Format format) noexcept {
+    switch (format) {
+    case Format::RGBA8:
+    case Format::BGRA8: return 4;
+    case Format::RGB565: return 2;
+    case Format::A8: return 1;
+    }
+    return 0;
+}
+
+class Error : public std::runtime_error {
+public:
+    explicit Error(Result result)
+        : std::runtime_error(describe(result)), result_(result) {}
+    Result result() const noexcept { return result_; }
+
+    static const char* describe(Result result) noexcept {
+        switch (result) {
+        case FOSSIL_CUBE_OK: return "fossil cube: ok";
+        case FOSSIL_CUBE_ERR_BADARGS: return "fossil cube: bad arguments";
+        case FOSSIL_CUBE_ERR_OOM: return "fossil cube: out of memory";
+        case FOSSIL_CUBE_ERR_NOTINIT: return "fossil cube: not initialized";
+        case FOSSIL_CUBE_ERR_UNSUPPORTED: return "fossil cube: unsupported in this build";
+        case FOSSIL_CUBE_ERR_TIMEOUT: return "fossil cube: timed out waiting for a buffer release";
+        }
+        return "fossil cube: unknown error";
+    }
+
+private:
+    Result result_;
+};
+
+/* RGBA8 color, straight or premultiplied depending on how it is used */
+struct Color {
+    uint8_t r = 0, g = 0, b = 0, a = 255;
+
+    /* 0xRRGGBBAA */
+    static constexpr Color hex(uint32_t rrggbbaa) noexcept {
+        return Color{ (uint8_t)(rrggbbaa >> 24), (uint8_t)(rrggbbaa >> 16),
+                      (uint8_t)(rrggbbaa >> 8), (uint8_t)rrggbbaa };
+    }
+    constexpr Color premultiplied() const noexcept;
+
+    friend constexpr bool operator==(const Color&, const Color&) noexcept = default;
+};
+static_assert(sizeof(Color) == 4, "Color spans are passed as RGBA8 bytes");
+
+namespace detail {
+
+/* The core's exact (x + 127) / 255 */
+constexpr uint32_t div255(uint32_t x) noexcept {
+    const uint32_t t = x + 128u;
+    return (t + (t >> 8)) >> 8;
+}
+
+constexpr uint8_t premul(uint8_t v, uint8_t a) noexcept {
+    return (uint8_t)div255((uint32_t)v * a);
+}
+
+/* Premultiplied s over d with inv = 255 - sa, wrapping per byte like
+   fc_over_px */
+constexpr Color over(Color d, Color s, uint32_t inv) noexcept {
+    return Color{ (uint8_t)(s.r + div255(d.r * inv)), (uint8_t)(s.g + div255(d.g * inv)),
+                  (uint8_t)(s.b + div255(d.b * inv)), (uint8_t)(s.a + div255(d.a * inv)) };
+}
+
+/* Straight s over d: (s*sa + d*(255 - sa)) / 255, alpha becomes sa + d*(1 - sa) */
+constexpr Color over_straight(Color d, Color s) noexcept {
+    const uint32_t sa = s.a, inv = 255u - sa;
+    return Color{ (uint8_t)div255(s.r * sa + d.r * inv), (uint8_t)div255(s.g * sa + d.g * inv),
+                  (uint8_t)div255(s.b * sa + d.b * inv), (uint8_t)div255(255u * sa + d.a * inv) };
+}
+
+/* Saturating sum, like fc_add_px */
+constexpr Color add(Color d, Color s) noexcept {
+    const auto sat = [](unsigned v) { return (uint8_t)(v > 255u ? 255u : v); };
+    return Color{ sat(d.r + s.r), sat(d.g + s.g), sat(d.b + s.b), sat(d.a + s.a) };
+}
+
+/* s*d + s*(1 - da) + d*(1 - sa), like fc_multiply_px */
+constexpr Color multiply(Color d, Color s) noexcept {
+    const uint32_t ida = 255u - d.a, isa = 255u - s.a;
+    const auto ch = [&](uint32_t dc, uint32_t sc) {
+        const uint32_t v = div255(sc * dc + sc * ida + dc * isa);
+        return (uint8_t)(v > 255u ? 255u : v);
+    };
+    return Color{ ch(d.r, s.r), ch(d.g, s.g), ch(d.b, s.b), ch(d.a, s.a) };
+}
+
+/* One premultiplied source pixel through an Add or Multiply blend */
+template <Blend B>
+constexpr Color combine(Color d, Color s) noexcept {
+    if constexpr (B == Blend::Add) return add(d, s);
+    else return multiply(d, s);
+}
+
+/* Per-format load to and store from RGBA8, matching the core's spans */
+template <Format F> struct Pixel;
+
+template <> struct Pixel<Format::RGBA8> {
+    static Color load(const uint8_t* p) noexcept { return Color{ p[0], p[1], p[2], p[3] }; }
+    static void store(uint8_t* p, Color c) noexcept { p[0] = c.r; p[1] = c.g; p[2] = c.b; p[3] = c.a; }
+};
+
+template <> struct Pixel<Format::BGRA8> {
+    static Color load(const uint8_t* p) noexcept { return Color{ p[2], p[1], p[0], p[3] }; }
+    static void store(uint8_t* p, Color c) noexcept { p[0] = c.b; p[1] = c.g; p[2] = c.r; p[3] = c.a; }
+};
+
+template <> struct Pixel<Format::RGB565> {
+    static Color load(const uint8_t* p) noexcept {
+        uint16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        const unsigned r5 = v >> 11, g6 = (v >> 5) & 63u, b5 = v & 31u;
+        return Color{ (uint8_t)((r5 << 3) | (r5 >> 2)), (uint8_t)((g6 << 2) | (g6 >> 4)),
+                      (uint8_t)((b5 << 3) | (b5 >> 2)), 255 };
+    }
+    static void store(uint8_t* p, Color c) noexcept {
+        const uint16_t v = (uint16_t)((((c.r * 249u + 1014u) >> 11) << 11) |
+                                      (((c.g * 253u + 505u) >> 10) << 5) |
+                                      ((c.b * 249u + 1014u) >> 11));
+        std::memcpy(p, &v, sizeof(v));
+    }
+};
+
+template <> struct Pixel<Format::A8> {
+    static Color load(const uint8_t* p) noexcept { return Color{ 0, 0, 0, p[0] }; }
+    static void store(uint8_t* p, Color c) noexcept { p[0] = c.a; }
+};
+
+/* Clip (x, y, w, h) to [0, width) x [0, height); false if nothing is left */
+constexpr bool clip(int width, int height, int& x, int& y, int& w, int& h,
+                    int* skip_x = nullptr, int* skip_y = nullptr) noexcept {
+    if (w <= 0 || h <= 0) return false;
+    long long x0 = x, y0 = y, x1 = (long long)x + w, y1 = (long long)y + h;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > width) x1 = width;
+    if (y1 > height) y1 = height;
+    if (x0 >= x1 || y0 >= y1) return false;
+    if (skip_x) *skip_x = (int)(x0 - x);
+    if (skip_y) *skip_y = (int)(y0 - y);
+    x = (int)x0; y = (int)y0; w = (int)(x1 - x0); h = (int)(y1 - y0);
+    return true;
+}
+
+} // namespace detail
+
+constexpr Color Color::premultiplied() const noexcept {
+    if (a == 255) return *this;
+    return Color{ detail::premul(r, a), detail::premul(g, a), detail::premul(b, a), a };
+}
+
+/* Read-only RGBA8 source: width x height pixels, pitch bytes per row
+   (0 = tightly packed); valid() checks the span covers every row */
+struct ImageView {
+    std::span<const uint8_t> bytes;
+    int width = 0, height = 0, pitch = 0;
+
+    constexpr ImageView() noexcept = default;
+    constexpr ImageView(std::span<const uint8_t> pixels, int w, int h, int row_pitch = 0) noexcept
+        : bytes(pixels), width(w), height(h), pitch(row_pitch ? row_pitch : w * 4) {}
+
+    constexpr bool valid() const noexcept {
+        return width > 0 && height > 0 && pitch >= width * 4 &&
+               bytes.size() >= (size_t)(height - 1) * (size_t)pitch + (size_t)width * 4u;
+    }
+    constexpr const uint8_t* data() const noexcept { return bytes.data(); }
+    constexpr const uint8_t* pixel(int x, int y) const noexcept {
+        return bytes.data() + (size_t)y * (size_t)pitch + (size_t)x * 4u;
+    }
+};
+
+/* Writable framebuffer whose format is part of its type */
+template <Format F>
+struct SurfaceView {
+    static constexpr Format format = F;
+    static constexpr int bpp = bytes_per_pixel(F);
+
+    uint8_t* pixels = nullptr;
+    int width = 0, height = 0, pitch = 0;
+
+    constexpr bool empty() const noexcept { return !pixels || width <= 0 || height <= 0; }
+    constexpr uint8_t* pixel(int x, int y) const noexcept {
+        return pixels + (size_t)y * (size_t)pitch + (size_t)x * (size_t)bpp;
+    }
+    std::span<uint8_t> row(int y) const noexcept {
+        return { pixel(0, y), (size_t)width * (size_t)bpp };
+    }
+    Color load(int x, int y) const noexcept { return detail::Pixel<F>::load(pixel(x, y)); }
+};
+
+/* Fill a rect of a typed surface.
+   - Copy stores the color unchanged, like clear
+   - the other modes read the color with alpha A (straight colors are
+     premultiplied once); Over then matches fill_rect */
+template <Blend B = Blend::Over, Alpha A = Alpha::Straight, Format F>
+void fill(const SurfaceView<F>& dst, Rect rect, Color color) noexcept {
+    using P = detail::Pixel<F>;
+    int x = rect.x, y = rect.y, w = rect.w, h = rect.h;
+    if (dst.empty() || !detail::clip(dst.width, dst.height, x, y, w, h)) return;
+    if constexpr (B != Blend::Copy) {
+        if constexpr (A == Alpha::Straight) color = color.premultiplied();
+    }
+    if constexpr (B == Blend::Add || B == Blend::Multiply) {
+        for (int j = 0; j < h; ++j) {
+            uint8_t* p = dst.pixel(x, y + j);
+            for (int i = 0; i < w; ++i, p += SurfaceView<F>::bpp) P::store(p, detail::combine<B>(P::load(p), color));
+        }
+        return;
+    }
+    if (B == Blend::Over && color.a == 0) return;
+    if (B == Blend::Copy || color.a == 255) {
+        for (int j = 0; j < h; ++j) {
+            uint8_t* p = dst.pixel(x, y + j);
+            for (int i = 0; i < w; ++i, p += SurfaceView<F>::bpp) P::store(p, color);
+        }
+        return;
+    }
+    const uint32_t inv = 255u - color.a;
+    for (int j = 0; j < h; ++j) {
+        uint8_t* p = dst.pixel(x, y + j);
+        for (int i = 0; i < w; ++i, p += SurfaceView<F>::bpp) P::store(p, detail::over(P::load(p), color, inv));
+    }
+}
+
+/* Blit an RGBA8 source at (x, y) of a typed surface.
+   - Copy stores the source unchanged
+   - the other modes read the source with alpha A; Over matches
+     blit_rgba_alpha and skips transparent pixels */
+template <Blend B = Blend::Over, Alpha A = Alpha::Straight, Format F>
+void blit(const SurfaceView<F>& dst, int x, int y, const ImageView& src) noexcept {
+    using P = detail::Pixel<F>;
+    int w = src.width, h = src.height, sx = 0, sy = 0;
+    if (dst.empty() || !src.valid() || !detail::clip(dst.width, dst.height, x, y, w, h, &sx, &sy)) return;
+    for (int j = 0; j < h; ++j) {
+        const uint8_t* s = src.pixel(sx, sy + j);
+        uint8_t* p = dst.pixel(x, y + j);
+        for (int i = 0; i < w; ++i, s += 4, p += SurfaceView<F>::bpp) {
+            const Color c{ s[0], s[1], s[2], s[3] };
+            if constexpr (B == Blend::Copy) {
+                P::store(p, c);
+            } else if constexpr (B == Blend::Add || B == Blend::Multiply) {
+                const Color sc = A == Alpha::Straight ? c.premultiplied() : c;
+                P::store(p, detail::combine<B>(P::load(p), sc));
+            } else if (c.a == 255) {
+                P::store(p, c);
+            } else if (c.a != 0) {
+                if constexpr (A == Alpha::Straight) P::store(p, detail::over_straight(P::load(p), c));
+                else P::store(p, detail::over(P::load(p), c, 255u - c.a));
+            }
+        }
+    }
+}
+
+class Image;
+class Paint;
+class Region;
+
+/* A rendering context; present may be null for an offscreen one */
+class Context {
+public:
+    Context(int width, int height, fossil_cube_present_fn present = nullptr, void* userdata = nullptr) {
+        check(fossil_cube_ctx_create(&ctx_, width, height, present, userdata));
+    }
+    explicit Context(const fossil_cube_config& config) {
+        check(fossil_cube_ctx_create_with(&ctx_, &config));
+    }
+    /* Take ownership of a handle from fossil_cube_ctx_create */
+    explicit Context(fossil_cube_ctx* adopt) noexcept : ctx_(adopt) {}
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+    Context(Context&& other) noexcept : ctx_(std::exchange(other.ctx_, nullptr)) {}
+    Context& operator=(Context&& other) noexcept {
+        if (this != &other) {
+            fossil_cube_ctx_destroy(ctx_);
+            ctx_ = std::exchange(other.ctx_, nullptr);
+        }
+        return *this;
+    }
+    ~Context() { fossil_cube_ctx_destroy(ctx_); }
+
+    fossil_cube_ctx* get() const noexcept { return ctx_; }
+    fossil_cube_ctx* release() noexcept { return std::exchange(ctx_, nullptr); }
+    explicit operator bool() const noexcept { return ctx_ != nullptr; }
+
+    int width() const noexcept { return fossil_cube_width_ex(ctx_); }
+    int height() const noexcept { return fossil_cube_height_ex(ctx_); }
+    Format format() const noexcept { return (Format)fossil_cube_get_format_ex(ctx_); }
+    Result resize(int width, int height) noexcept { return fossil_cube_resize_ex(ctx_, width, height); }
+
+    void begin_frame(Color c) noexcept { fossil_cube_begin_frame_ex(ctx_, c.r, c.g, c.b, c.a); }
+    void begin_frame_retain() noexcept { fossil_cube_begin_frame_retain_ex(ctx_); }
+    void end_frame() noexcept { fossil_cube_end_frame_ex(ctx_); }
+    void add_damage(Rect r) noexcept { fossil_cube_add_damage_ex(ctx_, r.x, r.y, r.w, r.h); }
+    Result set_encoder(fossil_cube_packet_fn packet, void* userdata) noexcept {
+        return fossil_cube_set_encoder_ex(ctx_, packet, userdata);
+    }
+    void request_key_frame() noexcept { fossil_cube_request_key_frame_ex(ctx_); }
+
+    void set_mode(Mode mode) noexcept { fossil_cube_set_mode_ex(ctx_, (fossil_cube_mode)mode); }
+    Mode mode() const noexcept { return (Mode)fossil_cube_get_mode_ex(ctx_); }
+    Result set_threads(int threads) noexcept { return fossil_cube_set_threads_ex(ctx_, threads); }
+    void set_alpha(Alpha alpha) noexcept { fossil_cube_set_alpha_ex(ctx_, (fossil_cube_alpha)alpha); }
+    Alpha alpha() const noexcept { return (Alpha)fossil_cube_get_alpha_ex(ctx_); }
+
+    void set_clip(Rect r) noexcept { fossil_cube_set_clip_ex(ctx_, r.x, r.y, r.w, r.h); }
+    void reset_clip() noexcept { fossil_cube_set_clip_ex(ctx_, 0, 0, 0, 0); }
+    Rect clip() const noexcept {
+        Rect r{};
+        fossil_cube_get_clip_ex(ctx_, &r.x, &r.y, &r.w, &r.h);
+        return r;
+    }
+    /* region must outlive its use; nullptr removes it */
+    void set_clip_region(const Region* region) noexcept;
+
+    void clear(Color c) noexcept { fossil_cube_clear_ex(ctx_, c.r, c.g, c.b, c.a); }
+    void put_pixel(int x, int y, Color c) noexcept { fossil_cube_put_pixel_ex(ctx_, x, y, c.r, c.g, c.b, c.a); }
+    void fill_rect(Rect r, Color c) noexcept { fossil_cube_fill_rect_ex(ctx_, r.x, r.y, r.w, r.h, c.r, c.g, c.b, c.a); }
+    void draw_rect(Rect r, Color c) noexcept { fossil_cube_draw_rect_ex(ctx_, r.x, r.y, r.w, r.h, c.r, c.g, c.b, c.a); }
+    void draw_line(int x0, int y0, int x1, int y1, Color c) noexcept {
+        fossil_cube_draw_line_ex(ctx_, x0, y0, x1, y1, c.r, c.g, c.b, c.a);
+    }
+    void draw_hline(int x, int y, int w, Color c) noexcept { fossil_cube_draw_hline_ex(ctx_, x, y, w, c.r, c.g, c.b, c.a); }
+    void draw_vline(int x, int y, int h, Color c) noexcept { fossil_cube_draw_vline_ex(ctx_, x, y, h, c.r, c.g, c.b, c.a); }
+
+    void draw_line_aa(float x0, float y0, float x1, float y1, float width, Color c) noexcept {
+        fossil_cube_draw_line_aa_ex(ctx_, x0, y0, x1, y1, width, c.r, c.g, c.b, c.a);
+    }
+    /* xy holds x,y pairs */
+    void draw_polyline(std::span<const float> xy, float width, Color c) noexcept {
+        fossil_cube_draw_polyline_ex(ctx_, xy.data(), (int)(xy.size() / 2), width, c.r, c.g, c.b, c.a);
+    }
+    void fill_polygon(std::span<const float> xy, Color c) noexcept {
+        fossil_cube_fill_polygon_ex(ctx_, xy.data(), (int)(xy.size() / 2), c.r, c.g, c.b, c.a);
+    }
+    void fill_circle(float cx, float cy, float radius, Color c) noexcept {
+        fossil_cube_fill_circle_ex(ctx_, cx, cy, radius, c.r, c.g, c.b, c.a);
+    }
+    void fill_rounded_rect(float x, float y, float w, float h, float radius, Color c) noexcept {
+        fossil_cube_fill_rounded_rect_ex(ctx_, x, y, w, h, radius, c.r, c.g, c.b, c.a);
+    }
+    /* Batches (see "Batches"): parallel spans of one length, and one color
+       for all or one per element; mismatched lengths are ignored */
+    void fill_rects(std::span<const int> x, std::span<const int> y, std::span<const int> w,
+                    std::span<const int> h, std::span<const Color> colors,
+                    BatchOrder order = BatchOrder::InOrder) noexcept {
+        const size_t n = x.size();
+        if (y.size() != n || w.size() != n || h.size() != n || n > INT_MAX) return;
+        if (colors.size() != 1 && colors.size() != n) return;
+        fossil_cube_fill_rects_ex(ctx_, x.data(), y.data(), w.data(), h.data(), (int)n,
+                                  reinterpret_cast<const uint8_t*>(colors.data()), colors.size() == 1 ? 0 : (int)sizeof(Color),
+                                  (fossil_cube_batch_order)order);
+    }
+    void draw_lines(std::span<const int> x0, std::span<const int> y0, std::span<const int> x1,
+                    std::span<const int> y1, std::span<const Color> colors,
+                    BatchOrder order = BatchOrder::InOrder) noexcept {
+        const size_t n = x0.size();
+        if (y0.size() != n || x1.size() != n || y1.size() != n || n > INT_MAX) return;
+        if (colors.size() != 1 && colors.size() != n) return;
+        fossil_cube_draw_lines_ex(ctx_, x0.data(), y0.data(), x1.data(), y1.data(), (int)n,
+                                  reinterpret_cast<const uint8_t*>(colors.data()), colors.size() == 1 ? 0 : (int)sizeof(Color),
+                                  (fossil_cube_batch_order)order);
+    }
+    void fill_rect(Rect r, const Paint& paint) noexcept;
+    void fill_polygon(std::span<const float> xy, const Paint& paint) noexcept;
+    void fill_circle(float cx, float cy, float radius, const Paint& paint) noexcept;
+    void fill_rounded_rect(float x, float y, float w, float h, float radius, const Paint& paint) noexcept;
+
+    /* Views that do not cover their rows are ignored */
+    void blit(int x, int y, const ImageView& src) noexcept {
+        if (src.valid()) fossil_cube_blit_rgba_ex(ctx_, x, y, src.data(), src.width, src.height, src.pitch);
+    }
+    void blit(int x, int y, const ImageView& src, Alpha alpha) noexcept {
+        if (src.valid()) {
+            fossil_cube_blit_rgba_alpha_ex(ctx_, x, y, src.data(), src.width, src.height, src.pitch,
+                                           (fossil_cube_alpha)alpha);
+        }
+    }
+    void blit_scaled(Rect dst, const ImageView& src, Filter filter = Filter::Nearest) noexcept {
+        if (src.valid()) {
+            fossil_cube_blit_scaled_ex(ctx_, dst.x, dst.y, dst.w, dst.h, src.data(), src.width, src.height,
+                                       src.pitch, (fossil_cube_filter)filter);
+        }
+    }
+    /* A8 coverage, pitch bytes per row (0 = w) */
+    void blit_mask(int x, int y, std::span<const uint8_t> coverage, int w, int h, int pitch, Color c) noexcept {
+        if (!pitch) pitch = w;
+        if (w > 0 && h > 0 && pitch >= w && coverage.size() >= (size_t)(h - 1) * (size_t)pitch + (size_t)w) {
+            fossil_cube_blit_mask_ex(ctx_, x, y, coverage.data(), w, h, pitch, c.r, c.g, c.b, c.a);
+        }
+    }
+    void draw_image(const Image& image, int x, int y) noexcept;
+    void draw_image(const Image& image, Rect src, int x, int y) noexcept;
+    void composite(const Context& src, Rect src_rect, int x, int y,
+                   uint8_t opacity = 255, Blend blend = Blend::Over) noexcept {
+        fossil_cube_composite_ex(ctx_, src.ctx_, src_rect.x, src_rect.y, src_rect.w, src_rect.h, x, y,
+                                 opacity, (fossil_cube_blend)blend);
+    }
+
+    /* The framebuffer as a typed view; empty when the context holds
+       another format */
+    template <Format F>
+    SurfaceView<F> view() noexcept {
+        if (!ctx_ || format() != F) return {};
+        SurfaceView<F> v;
+        v.pixels = fossil_cube_framebuffer_ex(ctx_, &v.width, &v.height, &v.pitch);
+        return v;
+    }
+
+protected:
+    static void check(Result result) {
+        if (result != FOSSIL_CUBE_OK) throw Error(result);
+    }
+
+    fossil_cube_ctx* ctx_ = nullptr;
+};
+
+/* Offscreen context whose format is fixed by its type */
+template <Format F>
+class Surface : public Context {
+public:
+    Surface(int width, int height) : Context(config(width, height)) {}
+
+    SurfaceView<F> view() noexcept { return Context::view<F>(); }
+
+private:
+    static fossil_cube_config config(int width, int height) noexcept {
+        fossil_cube_config cfg{};
+        cfg.width = width;
+        cfg.height = height;
+        cfg.format = (fossil_cube_format)F;
+        return cfg;
+    }
+};
+
+/* Owned premultiplied image (see "Images and atlases") */
+class Image {
+public:
+    explicit Image(const ImageView& src, Alpha alpha = Alpha::Straight) {
+        const Result r = src.valid()
+            ? fossil_cube_image_create(&image_, src.data(), src.width, src.height, src.pitch,
+                                       (fossil_cube_alpha)alpha)
+            : FOSSIL_CUBE_ERR_BADARGS;
+        if (r != FOSSIL_CUBE_OK) throw Error(r);
+    }
+
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+    Image(Image&& other) noexcept : image_(std::exchange(other.image_, nullptr)) {}
+    Image& operator=(Image&& other) noexcept {
+        if (this != &other) {
+            fossil_cube_image_destroy(image_);
+            image_ = std::exchange(other.image_, nullptr);
+        }
+        return *this;
+    }
+    ~Image() { fossil_cube_image_destroy(image_); }
+
+    const fossil_cube_image* get() const noexcept { return image_; }
+    int width() const noexcept { return fossil_cube_image_width(image_); }
+    int height() const noexcept { return fossil_cube_image_height(image_); }
+
+    Result update(int x, int y, const ImageView& src, Alpha alpha = Alpha::Straight) noexcept {
+        if (!src.valid()) return FOSSIL_CUBE_ERR_BADARGS;
+        return fossil_cube_image_update(image_, x, y, src.data(), src.width, src.height, src.pitch,
+                                        (fossil_cube_alpha)alpha);
+    }
+
+private:
+    fossil_cube_image* image_ = nullptr;
+};
+
+/* Owned gradient or pattern paint (see "Paints") */
+class Paint {
+public:
+    static Paint linear(float x0, float y0, float x1, float y1,
+                        std::span<const fossil_cube_color_stop> stops, Extend extend = Extend::Pad) {
+        Paint p;
+        p.check(fossil_cube_paint_linear(&p.paint_, x0, y0, x1, y1, stops.data(), (int)stops.size(),
+                                         (fossil_cube_extend)extend));
+        return p;
+    }
+    static Paint radial(float cx, float cy, float radius,
+                        std::span<const fossil_cube_color_stop> stops, Extend extend = Extend::Pad) {
+        Paint p;
+        p.check(fossil_cube_paint_radial(&p.paint_, cx, cy, radius, stops.data(), (int)stops.size(),
+                                         (fossil_cube_extend)extend));
+        return p;
+    }
+    /* image must outlive the paint */
+    static Paint pattern(const Image& image, int origin_x = 0, int origin_y = 0) {
+        Paint p;
+        p.check(fossil_cube_paint_pattern(&p.paint_, image.get(), origin_x, origin_y));
+        return p;
+    }
+
+    Paint(const Paint&) = delete;
+    Paint& operator=(const Paint&) = delete;
+    Paint(Paint&& other) noexcept : paint_(std::exchange(other.paint_, nullptr)) {}
+    Paint& operator=(Paint&& other) noexcept {
+        if (this != &other) {
+            fossil_cube_paint_destroy(paint_);
+            paint_ = std::exchange(other.paint_, nullptr);
+        }
+        return *this;
+    }
+    ~Paint() { fossil_cube_paint_destroy(paint_); }
+
+    const fossil_cube_paint* get() const noexcept { return paint_; }
+
+private:
+    Paint() noexcept = default;
+    static void check(Result r) {
+        if (r != FOSSIL_CUBE_OK) throw Error(r);
+    }
+
+    fossil_cube_paint* paint_ = nullptr;
+};
+
+/* Owned clip region (see "Clip regions") */
+class Region {
+public:
+    explicit Region(std::span<const Rect> rects, std::span<const Rect> subtract = {}) {
+        const Result r = subtract.empty()
+            ? fossil_cube_region_create(&region_, rects.data(), (int)rects.size())
+            : fossil_cube_region_create_diff(&region_, rects.data(), (int)rects.size(),
+                                             subtract.data(), (int)subtract.size());
+        if (r != FOSSIL_CUBE_OK) throw Error(r);
+    }
+
+    Region(const Region&) = delete;
+    Region& operator=(const Region&) = delete;
+    Region(Region&& other) noexcept : region_(std::exchange(other.region_, nullptr)) {}
+    Region& operator=(Region&& other) noexcept {
+        if (this != &other) {
+            fossil_cube_region_destroy(region_);
+            region_ = std::exchange(other.region_, nullptr);
+        }
+        return *this;
+    }
+    ~Region() { fossil_cube_region_destroy(region_); }
+
+    Rect bounds() const noexcept { return fossil_cube_region_bounds(region_); }
+    std::vector<Rect> rects() const {
+        std::vector<Rect> out((size_t)fossil_cube_region_rects(region_, nullptr, 0));
+        fossil_cube_region_rects(region_, out.data(), (int)out.size());
+        return out;
+    }
+    const fossil_cube_region* get() const noexcept { return region_; }
+
+private:
+    fossil_cube_region* region_ = nullptr;
+};
+
+inline void Context::set_clip_region(const Region* region) noexcept {
+    fossil_cube_set_clip_region_ex(ctx_, region ? region->get() : nullptr);
+}
+
+inline void Context::fill_rect(Rect r, const Paint& paint) noexcept {
+    fossil_cube_fill_rect_paint_ex(ctx_, r.x, r.y, r.w, r.h, paint.get());
+}
+
+inline void Context::fill_polygon(std::span<const float> xy, const Paint& paint) noexcept {
+    fossil_cube_fill_polygon_paint_ex(ctx_, xy.data(), (int)(xy.size() / 2), paint.get());
+}
+
+inline void Context::fill_circle(float cx, float cy, float radius, const Paint& paint) noexcept {
+    fossil_cube_fill_circle_paint_ex(ctx_, cx, cy, radius, paint.get());
+}
+
+inline void Context::fill_rounded_rect(float x, float y, float w, float h, float radius,
+                                       const Paint& paint) noexcept {
+    fossil_cube_fill_rounded_rect_paint_ex(ctx_, x, y, w, h, radius, paint.get());
+}
+
+inline void Context::draw_image(const Image& image, int x, int y) noexcept {
+    fossil_cube_draw_image_ex(ctx_, image.get(), x, y);
+}
+
+inline void Context::draw_image(const Image& image, Rect src, int x, int y) noexcept {
+    fossil_cube_draw_image_rect_ex(ctx_, image.get(), src.x, src.y, src.w, src.h, x, y);
+}
 
 } // namespace cube
 
@@ -15,5 +15,10 @@
 #define FOSSIL_OPENCUBE_FRAMEWORK_H
 
 #include "cube.h"
+#include "shm.h"
+#include "capture.h"
+#include "text.h"
+#include "layer.h"
+#include "scene.h"
 
 #endif /* FOSSIL_OPENCUBE_FRAMEWORK_H */
@@ -0,0 +1,70 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CUBE_LAYER_H
+#define FOSSIL_CUBE_LAYER_H
+
+/* Layers
+   - a layer is an offscreen context plus a valid flag: draw a widget or
+     panel into it once, then draw_layer composites the cached pixels, one
+     blit per frame instead of every primitive again
+   - nothing invalidates a layer behind your back; call invalidate when
+     its content changes and redraw it between layer_begin and layer_end
+     (begin clears it to transparent, end marks it valid)
+   - the layer's context is a normal one: set its mode, threads, clip or
+     alpha as you like
+   - draw_layer follows fossil_cube_composite: in deferred mode the layer
+     is read at the destination's end_frame, so do not redraw or resize
+     it while such a frame is pending
+
+       if (!fossil_cube_layer_valid(panel)) {
+           fossil_cube_ctx* lc = fossil_cube_layer_begin(panel);
+           ... draw into lc ...
+           fossil_cube_layer_end(panel);
+       }
+       fossil_cube_draw_layer(panel, x, y, 255);
+*/
+
+#include "cube.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fossil_cube_layer fossil_cube_layer;
+
+fossil_cube_result fossil_cube_layer_create(fossil_cube_layer** out_layer,
+                                            int width, int height, fossil_cube_format format);
+void fossil_cube_layer_destroy(fossil_cube_layer* layer);
+
+/* Resizing drops the content and invalidates the layer */
+fossil_cube_result fossil_cube_layer_resize(fossil_cube_layer* layer, int width, int height);
+
+fossil_cube_ctx* fossil_cube_layer_ctx(fossil_cube_layer* layer);
+bool fossil_cube_layer_valid(const fossil_cube_layer* layer);
+void fossil_cube_layer_invalidate(fossil_cube_layer* layer);
+uint64_t fossil_cube_layer_redraws(const fossil_cube_layer* layer); /* layer_end calls so far */
+
+fossil_cube_ctx* fossil_cube_layer_begin(fossil_cube_layer* layer);
+void fossil_cube_layer_end(fossil_cube_layer* layer);
+
+/* Composite the whole layer source-over at (x, y), scaled by opacity */
+void fossil_cube_draw_layer(const fossil_cube_layer* layer, int x, int y, uint8_t opacity);
+void fossil_cube_draw_layer_ex(fossil_cube_ctx* ctx, const fossil_cube_layer* layer,
+                               int x, int y, uint8_t opacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FOSSIL_CUBE_LAYER_H */
@@ -0,0 +1,108 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CUBE_SCENE_H
+#define FOSSIL_CUBE_SCENE_H
+
+/* Retained scene
+   - a tree of nodes (group, rect, line, image, text) kept between frames;
+     each node has an integer offset from its parent and an optional clip
+     rect in its own space that also clips its subtree
+   - every change marks the node dirty; render repaints only the old and
+     new screen bounds of dirty nodes (merged into at most
+     FOSSIL_CUBE_MAX_DAMAGE regions) inside begin_frame_retain/end_frame,
+     so the present callback gets just those rects
+   - an unchanged scene renders nothing: render returns 0 without touching
+     the context, so idle screens cost no drawing at all
+   - a region is repainted by filling it with the opaque background and
+     drawing every node that overlaps it, in tree order (children after
+     their parent, siblings in insertion order, raise moves a node last)
+   - the first render, a render to another context or a resized one, and
+     render after invalidate repaint the whole framebuffer
+   - images and fonts are referenced, not copied: they must outlive the
+     nodes. After fossil_cube_image_update, touch the node showing it.
+   - node handles stay valid until the node is removed; handles of removed
+     nodes are ignored (until the slot is reused by a new node)
+*/
+
+#include "cube.h"
+#include "text.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fossil_cube_scene fossil_cube_scene;
+
+typedef uint32_t fossil_cube_node; /* 0: none */
+
+#define FOSSIL_CUBE_SCENE_ROOT ((fossil_cube_node)1) /* group at (0, 0) */
+
+fossil_cube_result fossil_cube_scene_create(fossil_cube_scene** out_scene);
+void fossil_cube_scene_destroy(fossil_cube_scene* scene);
+void fossil_cube_scene_set_background(fossil_cube_scene* scene, uint8_t r, uint8_t g, uint8_t b);
+
+/* Node creation; each returns 0 when out of memory or parent is not a
+   group. Positions are relative to the parent. */
+fossil_cube_node fossil_cube_scene_add_group(fossil_cube_scene* scene, fossil_cube_node parent,
+                                             int x, int y);
+fossil_cube_node fossil_cube_scene_add_rect(fossil_cube_scene* scene, fossil_cube_node parent,
+                                            int x, int y, int w, int h,
+                                            uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+fossil_cube_node fossil_cube_scene_add_line(fossil_cube_scene* scene, fossil_cube_node parent,
+                                            int x0, int y0, int x1, int y1,
+                                            uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+fossil_cube_node fossil_cube_scene_add_image(fossil_cube_scene* scene, fossil_cube_node parent,
+                                             const fossil_cube_image* image, int x, int y);
+fossil_cube_node fossil_cube_scene_add_text(fossil_cube_scene* scene, fossil_cube_node parent,
+                                            fossil_cube_font* font, int x, int baseline,
+                                            const char* utf8, int size,
+                                            uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+/* Remove a node and its subtree (the root only loses its children) */
+void fossil_cube_scene_remove(fossil_cube_scene* scene, fossil_cube_node node);
+
+/* Changes; each marks the node dirty
+   - move: the node's offset (a line moves both ends, text its pen)
+   - set_size: rect size, or the vector from a line's first end to its
+     second
+   - set_clip: w/h <= 0 removes the clip
+*/
+void fossil_cube_scene_move(fossil_cube_scene* scene, fossil_cube_node node, int x, int y);
+void fossil_cube_scene_set_size(fossil_cube_scene* scene, fossil_cube_node node, int w, int h);
+void fossil_cube_scene_set_color(fossil_cube_scene* scene, fossil_cube_node node,
+                                 uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void fossil_cube_scene_set_image(fossil_cube_scene* scene, fossil_cube_node node,
+                                 const fossil_cube_image* image);
+fossil_cube_result fossil_cube_scene_set_text(fossil_cube_scene* scene, fossil_cube_node node,
+                                              const char* utf8);
+void fossil_cube_scene_set_visible(fossil_cube_scene* scene, fossil_cube_node node, bool visible);
+void fossil_cube_scene_set_clip(fossil_cube_scene* scene, fossil_cube_node node,
+                                int x, int y, int w, int h);
+void fossil_cube_scene_raise(fossil_cube_scene* scene, fossil_cube_node node);
+void fossil_cube_scene_touch(fossil_cube_scene* scene, fossil_cube_node node);
+void fossil_cube_scene_invalidate(fossil_cube_scene* scene);
+
+/* Screen bounds the node covered at the last render (empty if none) */
+fossil_cube_rect fossil_cube_scene_bounds(const fossil_cube_scene* scene, fossil_cube_node node);
+
+/* Repaint what changed since the last render and end the frame; returns
+   the number of regions repainted, 0 when nothing changed (no frame is
+   begun or presented then). The context's clip is left as it was. */
+int fossil_cube_scene_render(fossil_cube_scene* scene, fossil_cube_ctx* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FOSSIL_CUBE_SCENE_H */
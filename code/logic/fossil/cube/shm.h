@@ -0,0 +1,110 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CUBE_SHM_H
+#define FOSSIL_CUBE_SHM_H
+
+/* Shared-memory present backend
+   - the framebuffers live in one shared mapping (POSIX shm or memfd, a
+     file mapping on Windows) that a consumer process maps as well
+   - every end_frame publishes the buffer and its damage rects through a
+     single-producer/single-consumer lock-free ring; no pixels are copied
+   - the consumer takes frames in order and releases each one when done,
+     which hands the buffer back to the producer's swapchain
+   - end_frame waits for the consumer to release a buffer when it needs
+     one, for at most FOSSIL_CUBE_RELEASE_TIMEOUT_MS; if none comes the
+     frame is dropped (not published, counted by shm_dropped) and its
+     buffer reused. Until the consumer releases again, later frames drop
+     without waiting; the first frame published after a drop reports the
+     whole surface as damaged
+   - compiled to FOSSIL_CUBE_ERR_UNSUPPORTED stubs with FOSSIL_CUBE_NO_SHM
+     (meson -Dwith_shm=disabled)
+
+   Producer:
+       fossil_cube_shm_create(&shm, "/my-surface", w, h, FOSSIL_CUBE_FORMAT_BGRA8, 3);
+       fossil_cube_config cfg = {0};
+       fossil_cube_shm_config(shm, &cfg);
+       fossil_cube_ctx_create_with(&ctx, &cfg);
+       fossil_cube_shm_bind(shm, ctx);
+       ... begin_frame / draw / end_frame ...
+
+   Consumer:
+       fossil_cube_shm_open(&shm, "/my-surface");
+       while (fossil_cube_shm_acquire(shm, &frame, 16) == FOSSIL_CUBE_OK) {
+           ... read frame.pixels within frame.rects ...
+           fossil_cube_shm_release(shm);
+       }
+*/
+
+#include "cube.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fossil_cube_shm fossil_cube_shm;
+
+/* One published frame as seen by the consumer */
+typedef struct fossil_cube_shm_frame {
+    const uint8_t* pixels;
+    int width, height, pitch;
+    fossil_cube_format format;
+    uint64_t sequence;  /* 0, 1, 2, ... */
+    int buffer;         /* index of the buffer holding this frame */
+    int rect_count;     /* 0: nothing changed since the previous frame */
+    fossil_cube_rect rects[FOSSIL_CUBE_MAX_DAMAGE];
+} fossil_cube_shm_frame;
+
+/* Producer side
+   - name: POSIX shm / Windows mapping name; NULL creates an anonymous
+     memfd (share it with fossil_cube_shm_fd) or an inheritable mapping
+   - buffers: 1..FOSSIL_CUBE_MAX_BUFFERS; with 1 every end_frame waits
+     (up to the timeout) until the consumer released the frame
+*/
+fossil_cube_result fossil_cube_shm_create(fossil_cube_shm** out_shm, const char* name,
+                                          int width, int height,
+                                          fossil_cube_format format, int buffers);
+
+/* Fill size, format, pitch, allocator and present for a context that
+   renders into the shared buffers; other fields are left as they are */
+void fossil_cube_shm_config(fossil_cube_shm* shm, fossil_cube_config* config);
+
+/* Route a context created from fossil_cube_shm_config to the ring: sets
+   its present_rects callback and swapchain length. Resize is not
+   supported on shared surfaces; create a new one instead. */
+fossil_cube_result fossil_cube_shm_bind(fossil_cube_shm* shm, fossil_cube_ctx* ctx);
+
+/* Consumer side */
+fossil_cube_result fossil_cube_shm_open(fossil_cube_shm** out_shm, const char* name);
+fossil_cube_result fossil_cube_shm_open_fd(fossil_cube_shm** out_shm, int fd); /* POSIX */
+
+/* Oldest unconsumed frame; waits up to timeout_ms (0 polls, <0 forever).
+   FOSSIL_CUBE_ERR_NOTINIT when no frame arrived in time. */
+fossil_cube_result fossil_cube_shm_acquire(fossil_cube_shm* shm, fossil_cube_shm_frame* out_frame,
+                                           int timeout_ms);
+void fossil_cube_shm_release(fossil_cube_shm* shm);
+
+/* Producer: frames dropped because the consumer did not release in time */
+uint64_t fossil_cube_shm_dropped(const fossil_cube_shm* shm);
+
+/* Both sides */
+int fossil_cube_shm_fd(const fossil_cube_shm* shm); /* -1 when unavailable */
+/* The creator also unlinks the name; destroy its context first, the
+   framebuffers live in the mapping */
+void fossil_cube_shm_close(fossil_cube_shm* shm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FOSSIL_CUBE_SHM_H */
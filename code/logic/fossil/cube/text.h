@@ -0,0 +1,84 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#ifndef FOSSIL_CUBE_TEXT_H
+#define FOSSIL_CUBE_TEXT_H
+
+/* Text
+   - a font turns (codepoint, pixel size) into an A8 coverage glyph once;
+     glyphs are packed into A8 atlas pages and found again by a hash lookup
+   - draw_text draws a whole UTF-8 string in one call, as one mask run
+     (fossil_cube_blit_masks) through the tinted-coverage kernel
+   - glyphs come from your rasterizer callback or, with a NULL callback,
+     from the built-in 5x9 bitmap font (printable ASCII, anything else
+     draws as '?'; integer-scaled by size / 10, at least 1; per unit of
+     scale: ascent 7, descent 2, advance 6)
+   - atlas pages stay put until font_trim/font_clear/font_destroy, so
+     deferred frames and recorded command buffers may keep drawing a string
+     after the call; trim, clear or destroy the font only when none of
+     those is pending, as they free or reuse the pages those still read
+   - the cache grows as glyphs are drawn; font_trim drops every glyph if
+     more than the cache limit (8 MiB by default, 0: no limit) is in use,
+     so call it between frames, e.g. after end_frame
+*/
+
+#include "cube.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One rasterized glyph, relative to the pen on the baseline */
+typedef struct fossil_cube_glyph {
+    const uint8_t* coverage; /* A8, may be NULL when width or height is 0 */
+    int width, height, pitch;
+    int bearing_x;           /* pen to the left edge of the bitmap */
+    int bearing_y;           /* baseline up to the top row of the bitmap */
+    int advance;             /* pen step after the glyph */
+} fossil_cube_glyph;
+
+/* Fill *out for codepoint at size (pixels, > 0); coverage only has to stay
+   valid until the callback returns to the core, the glyph is copied right
+   away. Return false for a missing glyph (drawn as nothing, no advance). */
+typedef bool (*fossil_cube_glyph_fn)(uint32_t codepoint, int size,
+                                     fossil_cube_glyph* out, void* userdata);
+
+typedef struct fossil_cube_font fossil_cube_font;
+
+fossil_cube_result fossil_cube_font_create(fossil_cube_font** out_font,
+                                           fossil_cube_glyph_fn rasterize, void* userdata);
+void fossil_cube_font_destroy(fossil_cube_font* font);
+void fossil_cube_font_clear(fossil_cube_font* font); /* drop every cached glyph */
+void fossil_cube_font_set_cache_limit(fossil_cube_font* font, size_t bytes); /* 0: no limit */
+void fossil_cube_font_trim(fossil_cube_font* font); /* drop every glyph if over the limit */
+
+/* Pen width of the widest line of a string; invalid UTF-8 reads as U+FFFD */
+int fossil_cube_text_width(fossil_cube_font* font, const char* utf8, int size);
+
+/* Ink box of every glyph drawn, relative to a pen at (0, 0) on the
+   baseline; false (and an empty rect) when nothing draws */
+bool fossil_cube_text_bounds(fossil_cube_font* font, const char* utf8, int size, fossil_cube_rect* out_rect);
+
+/* Draw with the pen starting at (x, baseline); '\n' starts a new line at
+   x, size pixels down. Returns the pen x after the last glyph. */
+int fossil_cube_draw_text(fossil_cube_font* font, int x, int baseline, const char* utf8, int size,
+                          uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+int fossil_cube_draw_text_ex(fossil_cube_ctx* ctx, fossil_cube_font* font,
+                             int x, int baseline, const char* utf8, int size,
+                             uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FOSSIL_CUBE_TEXT_H */
@@ -0,0 +1,104 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include "fossil/cube/layer.h"
+#include <stdlib.h>
+
+/* =========================
+   Layers
+   =========================
+   A thin owner around an offscreen context; the drawing itself is
+   fossil_cube_composite, so a cached layer costs one command per frame.
+*/
+
+struct fossil_cube_layer {
+    fossil_cube_ctx* ctx;
+    bool valid;
+    uint64_t redraws;
+};
+
+fossil_cube_result fossil_cube_layer_create(fossil_cube_layer** out_layer,
+                                            int width, int height, fossil_cube_format format) {
+    if (!out_layer) return FOSSIL_CUBE_ERR_BADARGS;
+    *out_layer = NULL;
+    fossil_cube_layer* layer = (fossil_cube_layer*)calloc(1, sizeof(*layer));
+    if (!layer) return FOSSIL_CUBE_ERR_OOM;
+
+    fossil_cube_config cfg = { 0 };
+    cfg.width = width;
+    cfg.height = height;
+    cfg.format = format;
+    cfg.clear_on_resize = true;
+    const fossil_cube_result r = fossil_cube_ctx_create_with(&layer->ctx, &cfg);
+    if (r != FOSSIL_CUBE_OK) {
+        free(layer);
+        return r;
+    }
+    /* layers start empty, not undefined */
+    fossil_cube_clear_ex(layer->ctx, 0, 0, 0, 0);
+    *out_layer = layer;
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_layer_destroy(fossil_cube_layer* layer) {
+    if (!layer) return;
+    fossil_cube_ctx_destroy(layer->ctx);
+    free(layer);
+}
+
+fossil_cube_result fossil_cube_layer_resize(fossil_cube_layer* layer, int width, int height) {
+    if (!layer) return FOSSIL_CUBE_ERR_BADARGS;
+    layer->valid = false;
+    return fossil_cube_resize_ex(layer->ctx, width, height);
+}
+
+fossil_cube_ctx* fossil_cube_layer_ctx(fossil_cube_layer* layer) {
+    return layer ? layer->ctx : NULL;
+}
+
+bool fossil_cube_layer_valid(const fossil_cube_layer* layer) {
+    return layer && layer->valid;
+}
+
+void fossil_cube_layer_invalidate(fossil_cube_layer* layer) {
+    if (layer) layer->valid = false;
+}
+
+uint64_t fossil_cube_layer_redraws(const fossil_cube_layer* layer) {
+    return layer ? layer->redraws : 0;
+}
+
+fossil_cube_ctx* fossil_cube_layer_begin(fossil_cube_layer* layer) {
+    if (!layer) return NULL;
+    layer->valid = false;
+    fossil_cube_begin_frame_ex(layer->ctx, 0, 0, 0, 0);
+    return layer->ctx;
+}
+
+void fossil_cube_layer_end(fossil_cube_layer* layer) {
+    if (!layer) return;
+    fossil_cube_end_frame_ex(layer->ctx);
+    layer->valid = true;
+    ++layer->redraws;
+}
+
+void fossil_cube_draw_layer(const fossil_cube_layer* layer, int x, int y, uint8_t opacity) {
+    fossil_cube_draw_layer_ex(fossil_cube_default_ctx(), layer, x, y, opacity);
+}
+
+void fossil_cube_draw_layer_ex(fossil_cube_ctx* ctx, const fossil_cube_layer* layer,
+                               int x, int y, uint8_t opacity) {
+    if (!layer) return;
+    fossil_cube_composite_ex(ctx, layer->ctx, 0, 0, fossil_cube_width_ex(layer->ctx),
+                             fossil_cube_height_ex(layer->ctx), x, y, opacity, FOSSIL_CUBE_BLEND_OVER);
+}
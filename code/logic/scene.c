@@ -0,0 +1,640 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include "fossil/cube/scene.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* =========================
+   Scene nodes
+   =========================
+   Nodes live in one array addressed by handle - 1 (the root is slot 0);
+   removed slots are chained into a free list. The tree is linked through
+   parent / first / last / prev / next handles, so walks, removal and
+   raise need no allocation. A layout pass computes each node's screen
+   origin, clip and bounds in tree order; render uses those to pick the
+   regions to repaint and the nodes to redraw in each.
+*/
+
+typedef enum fc_node_kind {
+    FC_NODE_FREE = 0,
+    FC_NODE_GROUP,
+    FC_NODE_RECT,
+    FC_NODE_LINE,
+    FC_NODE_IMAGE,
+    FC_NODE_TEXT
+} fc_node_kind;
+
+/* Half-open screen box, empty when x0 >= x1 or y0 >= y1 */
+typedef struct fc_box {
+    long long x0, y0, x1, y1;
+} fc_box;
+
+typedef struct fc_node {
+    uint8_t kind;
+    bool visible;
+    bool dirty;           /* changed since the last render (the layout pass
+                             extends it to the subtree, then clears it) */
+    bool has_clip;
+    bool text_box_valid;
+    uint8_t rgba[4];
+    int x, y;             /* offset from the parent */
+    int w, h;             /* rect: size; line: second end - first end */
+    fc_box clip;          /* local */
+    fossil_cube_node parent, first, last, prev, next;
+    const fossil_cube_image* image;
+    fossil_cube_font* font;
+    char* text;
+    int size;
+    fc_box text_box;      /* ink box relative to the pen */
+
+    /* layout results */
+    long long wx, wy;     /* screen origin */
+    fc_box wclip;         /* clip in effect */
+    bool shown;           /* visible along the whole path from the root */
+    fc_box drawn;         /* screen bounds at the last render */
+} fc_node;
+
+struct fossil_cube_scene {
+    fc_node* nodes;
+    uint32_t count, cap;
+    fossil_cube_node free_head;
+    uint8_t bg[3];
+
+    bool changed;         /* something may need repainting */
+    bool full;            /* repaint everything at the next render */
+    const fossil_cube_ctx* ctx;
+    int w, h;
+
+    fc_box dirty[FOSSIL_CUBE_MAX_DAMAGE];
+    int dirty_count;
+};
+
+static const fc_box fc_box_empty_value = { 0, 0, 0, 0 };
+
+static inline bool fc_box_empty(const fc_box* b) {
+    return b->x0 >= b->x1 || b->y0 >= b->y1;
+}
+
+static inline fc_box fc_box_and(const fc_box* a, const fc_box* b) {
+    fc_box r;
+    r.x0 = a->x0 > b->x0 ? a->x0 : b->x0;
+    r.y0 = a->y0 > b->y0 ? a->y0 : b->y0;
+    r.x1 = a->x1 < b->x1 ? a->x1 : b->x1;
+    r.y1 = a->y1 < b->y1 ? a->y1 : b->y1;
+    return fc_box_empty(&r) ? fc_box_empty_value : r;
+}
+
+static inline fc_box fc_box_or(const fc_box* a, const fc_box* b) {
+    fc_box r;
+    r.x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+    r.y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+    r.x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+    r.y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+    return r;
+}
+
+static inline bool fc_box_contains(const fc_box* outer, const fc_box* inner) {
+    return inner->x0 >= outer->x0 && inner->y0 >= outer->y0 &&
+           inner->x1 <= outer->x1 && inner->y1 <= outer->y1;
+}
+
+static inline long long fc_box_area(const fc_box* b) {
+    return (b->x1 - b->x0) * (b->y1 - b->y0);
+}
+
+static inline fc_box fc_box_xywh(long long x, long long y, long long w, long long h) {
+    const fc_box b = { x, y, x + w, y + h };
+    return b;
+}
+
+static inline fc_node* fc_node_get(const fossil_cube_scene* s, fossil_cube_node id) {
+    if (!s || id == 0 || id > s->count) return NULL;
+    fc_node* n = &s->nodes[id - 1];
+    return n->kind == FC_NODE_FREE ? NULL : n;
+}
+
+static inline void fc_node_dirty(fossil_cube_scene* s, fc_node* n) {
+    n->dirty = true;
+    s->changed = true;
+}
+
+/* =========================
+   Dirty regions
+   =========================
+   At most FOSSIL_CUBE_MAX_DAMAGE boxes; a box inside another is dropped,
+   and when the list is full the new box joins the one whose union grows
+   least. Before painting, overlapping boxes are merged so no pixel is
+   repainted twice.
+*/
+
+static void fc_region_add(fossil_cube_scene* s, const fc_box* b) {
+    if (fc_box_empty(b)) return;
+    for (int i = 0; i < s->dirty_count; ++i) {
+        if (fc_box_contains(&s->dirty[i], b)) return;
+    }
+    int n = 0;
+    for (int i = 0; i < s->dirty_count; ++i) {
+        if (!fc_box_contains(b, &s->dirty[i])) s->dirty[n++] = s->dirty[i];
+    }
+    s->dirty_count = n;
+    if (n < FOSSIL_CUBE_MAX_DAMAGE) {
+        s->dirty[s->dirty_count++] = *b;
+        return;
+    }
+    int best = 0;
+    long long best_growth = LLONG_MAX;
+    for (int i = 0; i < n; ++i) {
+        const fc_box u = fc_box_or(&s->dirty[i], b);
+        const long long growth = fc_box_area(&u) - fc_box_area(&s->dirty[i]);
+        if (growth < best_growth) { best_growth = growth; best = i; }
+    }
+    s->dirty[best] = fc_box_or(&s->dirty[best], b);
+}
+
+static void fc_region_coalesce(fossil_cube_scene* s) {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (int i = 0; i < s->dirty_count && !merged; ++i) {
+            for (int j = i + 1; j < s->dirty_count; ++j) {
+                const fc_box both = fc_box_and(&s->dirty[i], &s->dirty[j]);
+                if (fc_box_empty(&both)) continue;
+                s->dirty[i] = fc_box_or(&s->dirty[i], &s->dirty[j]);
+                s->dirty[j] = s->dirty[--s->dirty_count];
+                merged = true;
+                break;
+            }
+        }
+    }
+}
+
+/* =========================
+   Tree
+   ========================= */
+
+/* Next node in tree order after id, not entering id's children when
+   skip_children is set; 0 past the end of root's subtree */
+static fossil_cube_node fc_next(const fossil_cube_scene* s, fossil_cube_node id, fossil_cube_node root,
+                                bool skip_children) {
+    const fc_node* n = &s->nodes[id - 1];
+    if (!skip_children && n->first) return n->first;
+    while (id != root) {
+        n = &s->nodes[id - 1];
+        if (n->next) return n->next;
+        id = n->parent;
+    }
+    return 0;
+}
+
+static void fc_unlink(fossil_cube_scene* s, fossil_cube_node id) {
+    fc_node* n = &s->nodes[id - 1];
+    fc_node* p = &s->nodes[n->parent - 1];
+    if (n->prev) s->nodes[n->prev - 1].next = n->next;
+    else p->first = n->next;
+    if (n->next) s->nodes[n->next - 1].prev = n->prev;
+    else p->last = n->prev;
+    n->prev = n->next = 0;
+}
+
+static void fc_append(fossil_cube_scene* s, fossil_cube_node parent, fossil_cube_node id) {
+    fc_node* n = &s->nodes[id - 1];
+    fc_node* p = &s->nodes[parent - 1];
+    n->parent = parent;
+    n->prev = p->last;
+    n->next = 0;
+    if (p->last) s->nodes[p->last - 1].next = id;
+    else p->first = id;
+    p->last = id;
+}
+
+static fossil_cube_node fc_node_new(fossil_cube_scene* s, fossil_cube_node parent, fc_node_kind kind,
+                                    int x, int y) {
+    const fc_node* p = fc_node_get(s, parent);
+    if (!p || p->kind != FC_NODE_GROUP) return 0;
+    fossil_cube_node id = s->free_head;
+    if (id) {
+        s->free_head = s->nodes[id - 1].next;
+    } else {
+        if (s->count == s->cap) {
+            if (s->cap > UINT32_MAX / 2u) return 0;
+            const uint32_t ncap = s->cap ? s->cap * 2u : 64u;
+            fc_node* nn = (fc_node*)realloc(s->nodes, (size_t)ncap * sizeof(fc_node));
+            if (!nn) return 0;
+            s->nodes = nn;
+            s->cap = ncap;
+        }
+        id = ++s->count;
+    }
+    fc_node* n = &s->nodes[id - 1];
+    memset(n, 0, sizeof(*n));
+    n->kind = (uint8_t)kind;
+    n->visible = true;
+    n->x = x;
+    n->y = y;
+    fc_append(s, parent, id);
+    fc_node_dirty(s, n);
+    return id;
+}
+
+static void fc_node_release(fossil_cube_scene* s, fossil_cube_node id) {
+    fc_node* n = &s->nodes[id - 1];
+    free(n->text);
+    memset(n, 0, sizeof(*n));
+    n->next = s->free_head;
+    s->free_head = id;
+}
+
+/* =========================
+   Layout
+   ========================= */
+
+/* Local box the node draws into, before its offset */
+static fc_box fc_node_local_box(fc_node* n) {
+    switch ((fc_node_kind)n->kind) {
+    case FC_NODE_RECT:
+        return (n->w > 0 && n->h > 0) ? fc_box_xywh(0, 0, n->w, n->h) : fc_box_empty_value;
+    case FC_NODE_LINE: {
+        const fc_box b = { n->w < 0 ? n->w : 0, n->h < 0 ? n->h : 0,
+                           (n->w > 0 ? n->w : 0) + 1LL, (n->h > 0 ? n->h : 0) + 1LL };
+        return n->rgba[3] ? b : fc_box_empty_value;
+    }
+    case FC_NODE_IMAGE:
+        return n->image ? fc_box_xywh(0, 0, fossil_cube_image_width(n->image),
+                                      fossil_cube_image_height(n->image))
+                        : fc_box_empty_value;
+    case FC_NODE_TEXT:
+        if (!n->text_box_valid) {
+            fossil_cube_rect r;
+            n->text_box = fossil_cube_text_bounds(n->font, n->text, n->size, &r)
+                ? fc_box_xywh(r.x, r.y, r.w, r.h) : fc_box_empty_value;
+            n->text_box_valid = true;
+        }
+        return n->text_box;
+    default:
+        return fc_box_empty_value;
+    }
+}
+
+/* Recompute origins, clips and bounds for every node; dirty nodes (and
+   everything under them) add their previous and new bounds to the
+   region unless the whole screen is repainted anyway */
+static void fc_scene_layout(fossil_cube_scene* s, int width, int height, bool full) {
+    const fc_box screen = { 0, 0, width, height };
+    for (fossil_cube_node id = FOSSIL_CUBE_SCENE_ROOT; id; ) {
+        fc_node* n = &s->nodes[id - 1];
+        const fc_node* p = n->parent ? &s->nodes[n->parent - 1] : NULL;
+        n->wx = (p ? p->wx : 0) + n->x;
+        n->wy = (p ? p->wy : 0) + n->y;
+        n->wclip = p ? p->wclip : screen;
+        if (n->has_clip) {
+            const fc_box c = { n->wx + n->clip.x0, n->wy + n->clip.y0, n->wx + n->clip.x1, n->wy + n->clip.y1 };
+            n->wclip = fc_box_and(&n->wclip, &c);
+        }
+        n->shown = n->visible && (!p || p->shown);
+        if (p && p->dirty) n->dirty = true;
+
+        fc_box now = fc_box_empty_value;
+        if (n->shown) {
+            const fc_box local = fc_node_local_box(n);
+            if (!fc_box_empty(&local)) {
+                const fc_box b = { local.x0 + n->wx, local.y0 + n->wy, local.x1 + n->wx, local.y1 + n->wy };
+                now = fc_box_and(&b, &n->wclip);
+            }
+        }
+        if (n->dirty && !full) {
+            fc_region_add(s, &n->drawn);
+            fc_region_add(s, &now);
+        }
+        n->drawn = now;
+        id = fc_next(s, id, FOSSIL_CUBE_SCENE_ROOT, false);
+    }
+    for (uint32_t i = 0; i < s->count; ++i) s->nodes[i].dirty = false;
+}
+
+/* =========================
+   Painting
+   ========================= */
+
+static inline bool fc_fits_int(long long v) {
+    return v >= INT_MIN && v <= INT_MAX;
+}
+
+static void fc_node_draw(const fc_node* n, fossil_cube_ctx* ctx) {
+    const uint8_t* k = n->rgba;
+    if (!fc_fits_int(n->wx) || !fc_fits_int(n->wy)) return;
+    const int x = (int)n->wx, y = (int)n->wy;
+    switch ((fc_node_kind)n->kind) {
+    case FC_NODE_RECT:
+        fossil_cube_fill_rect_ex(ctx, x, y, n->w, n->h, k[0], k[1], k[2], k[3]);
+        break;
+    case FC_NODE_LINE:
+        if (!fc_fits_int(n->wx + n->w) || !fc_fits_int(n->wy + n->h)) return;
+        fossil_cube_draw_line_ex(ctx, x, y, x + n->w, y + n->h, k[0], k[1], k[2], k[3]);
+        break;
+    case FC_NODE_IMAGE:
+        fossil_cube_draw_image_ex(ctx, n->image, x, y);
+        break;
+    case FC_NODE_TEXT:
+        fossil_cube_draw_text_ex(ctx, n->font, x, y, n->text, n->size, k[0], k[1], k[2], k[3]);
+        break;
+    default:
+        break;
+    }
+}
+
+static inline void fc_set_clip_box(fossil_cube_ctx* ctx, const fc_box* b) {
+    /* boxes reaching here are non-empty and inside the framebuffer */
+    fossil_cube_set_clip_ex(ctx, (int)b->x0, (int)b->y0, (int)(b->x1 - b->x0), (int)(b->y1 - b->y0));
+}
+
+/* Repaint one region: background, then every node overlapping it */
+static void fc_scene_paint(const fossil_cube_scene* s, fossil_cube_ctx* ctx, const fc_box* region,
+                           bool background) {
+    if (background) {
+        fc_set_clip_box(ctx, region);
+        fossil_cube_fill_rect_ex(ctx, (int)region->x0, (int)region->y0, (int)(region->x1 - region->x0),
+                                 (int)(region->y1 - region->y0), s->bg[0], s->bg[1], s->bg[2], 255);
+    }
+    for (fossil_cube_node id = FOSSIL_CUBE_SCENE_ROOT; id; ) {
+        const fc_node* n = &s->nodes[id - 1];
+        if (!n->shown) {
+            id = fc_next(s, id, FOSSIL_CUBE_SCENE_ROOT, true);
+            continue;
+        }
+        const fc_box hit = fc_box_and(&n->drawn, region);
+        if (!fc_box_empty(&hit)) {
+            const fc_box clip = fc_box_and(&n->wclip, region);
+            fc_set_clip_box(ctx, &clip);
+            fc_node_draw(n, ctx);
+        }
+        id = fc_next(s, id, FOSSIL_CUBE_SCENE_ROOT, false);
+    }
+}
+
+/* =========================
+   Public API
+   ========================= */
+
+fossil_cube_result fossil_cube_scene_create(fossil_cube_scene** out_scene) {
+    if (!out_scene) return FOSSIL_CUBE_ERR_BADARGS;
+    fossil_cube_scene* s = (fossil_cube_scene*)calloc(1, sizeof(*s));
+    if (!s) {
+        *out_scene = NULL;
+        return FOSSIL_CUBE_ERR_OOM;
+    }
+    s->nodes = (fc_node*)calloc(64u, sizeof(fc_node));
+    if (!s->nodes) {
+        free(s);
+        *out_scene = NULL;
+        return FOSSIL_CUBE_ERR_OOM;
+    }
+    s->cap = 64u;
+    s->count = 1u;
+    s->nodes[0].kind = FC_NODE_GROUP;
+    s->nodes[0].visible = true;
+    s->full = true;
+    *out_scene = s;
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_scene_destroy(fossil_cube_scene* s) {
+    if (!s) return;
+    for (uint32_t i = 0; i < s->count; ++i) free(s->nodes[i].text);
+    free(s->nodes);
+    free(s);
+}
+
+void fossil_cube_scene_set_background(fossil_cube_scene* s, uint8_t r, uint8_t g, uint8_t b) {
+    if (!s) return;
+    s->bg[0] = r; s->bg[1] = g; s->bg[2] = b;
+    fossil_cube_scene_invalidate(s);
+}
+
+fossil_cube_node fossil_cube_scene_add_group(fossil_cube_scene* s, fossil_cube_node parent, int x, int y) {
+    return fc_node_new(s, parent, FC_NODE_GROUP, x, y);
+}
+
+fossil_cube_node fossil_cube_scene_add_rect(fossil_cube_scene* s, fossil_cube_node parent,
+                                            int x, int y, int w, int h,
+                                            uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const fossil_cube_node id = fc_node_new(s, parent, FC_NODE_RECT, x, y);
+    if (!id) return 0;
+    fc_node* n = &s->nodes[id - 1];
+    n->w = w; n->h = h;
+    n->rgba[0] = r; n->rgba[1] = g; n->rgba[2] = b; n->rgba[3] = a;
+    return id;
+}
+
+fossil_cube_node fossil_cube_scene_add_line(fossil_cube_scene* s, fossil_cube_node parent,
+                                            int x0, int y0, int x1, int y1,
+                                            uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const long long dx = (long long)x1 - x0, dy = (long long)y1 - y0;
+    if (!fc_fits_int(dx) || !fc_fits_int(dy)) return 0;
+    const fossil_cube_node id = fc_node_new(s, parent, FC_NODE_LINE, x0, y0);
+    if (!id) return 0;
+    fc_node* n = &s->nodes[id - 1];
+    n->w = (int)dx; n->h = (int)dy;
+    n->rgba[0] = r; n->rgba[1] = g; n->rgba[2] = b; n->rgba[3] = a;
+    return id;
+}
+
+fossil_cube_node fossil_cube_scene_add_image(fossil_cube_scene* s, fossil_cube_node parent,
+                                             const fossil_cube_image* image, int x, int y) {
+    const fossil_cube_node id = fc_node_new(s, parent, FC_NODE_IMAGE, x, y);
+    if (id) s->nodes[id - 1].image = image;
+    return id;
+}
+
+fossil_cube_node fossil_cube_scene_add_text(fossil_cube_scene* s, fossil_cube_node parent,
+                                            fossil_cube_font* font, int x, int baseline,
+                                            const char* utf8, int size,
+                                            uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const fossil_cube_node id = fc_node_new(s, parent, FC_NODE_TEXT, x, baseline);
+    if (!id) return 0;
+    fc_node* n = &s->nodes[id - 1];
+    n->font = font;
+    n->size = size;
+    n->rgba[0] = r; n->rgba[1] = g; n->rgba[2] = b; n->rgba[3] = a;
+    if (fossil_cube_scene_set_text(s, id, utf8) != FOSSIL_CUBE_OK) {
+        fossil_cube_scene_remove(s, id);
+        return 0;
+    }
+    return id;
+}
+
+void fossil_cube_scene_remove(fossil_cube_scene* s, fossil_cube_node node) {
+    fc_node* n = fc_node_get(s, node);
+    if (!n) return;
+    /* whatever the subtree covered has to be repainted without it */
+    fossil_cube_node id = n->first;
+    while (id) {
+        const fossil_cube_node next = fc_next(s, id, node, false);
+        fc_region_add(s, &s->nodes[id - 1].drawn);
+        id = next;
+    }
+    id = n->first;
+    while (id) {
+        /* release children before their parent: walk down to a leaf */
+        fc_node* c = &s->nodes[id - 1];
+        if (c->first) { id = c->first; continue; }
+        const fossil_cube_node parent = c->parent;
+        fc_unlink(s, id);
+        fc_node_release(s, id);
+        id = parent == node ? n->first : parent;
+    }
+    if (node != FOSSIL_CUBE_SCENE_ROOT) {
+        fc_region_add(s, &n->drawn);
+        fc_unlink(s, node);
+        fc_node_release(s, node);
+    }
+    s->changed = true;
+}
+
+void fossil_cube_scene_move(fossil_cube_scene* s, fossil_cube_node node, int x, int y) {
+    fc_node* n = fc_node_get(s, node);
+    if (!n || (n->x == x && n->y == y)) return;
+    n->x = x; n->y = y;
+    fc_node_dirty(s, n);
+}
+
+void fossil_cube_scene_set_size(fossil_cube_scene* s, fossil_cube_node node, int w, int h) {
+    fc_node* n = fc_node_get(s, node);
+    if (!n || (n->kind != FC_NODE_RECT && n->kind != FC_NODE_LINE) || (n->w == w && n->h == h)) return;
+    n->w = w; n->h = h;
+    fc_node_dirty(s, n);
+}
+
+void fossil_cube_scene_set_color(fossil_cube_scene* s, fossil_cube_node node,
+                                 uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    fc_node* n = fc_node_get(s, node);
+    const uint8_t k[4] = { r, g, b, a };
+    if (!n || memcmp(n->rgba, k, 4) == 0) return;
+    memcpy(n->rgba, k, 4);
+    fc_node_dirty(s, n);
+}
+
+void fossil_cube_scene_set_image(fossil_cube_scene* s, fossil_cube_node node, const fossil_cube_image* image) {
+    fc_node* n = fc_node_get(s, node);
+    if (!n || n->kind != FC_NODE_IMAGE) return;
+    n->image = image;
+    fc_node_dirty(s, n);
+}
+
+fossil_cube_result fossil_cube_scene_set_text(fossil_cube_scene* s, fossil_cube_node node, const char* utf8) {
+    fc_node* n = fc_node_get(s, node);
+    if (!n || n->kind != FC_NODE_TEXT) return FOSSIL_CUBE_ERR_BADARGS;
+    if (!utf8) utf8 = "";
+    if (n->text && strcmp(n->text, utf8) == 0) return FOSSIL_CUBE_OK;
+    const size_t len = strlen(utf8);
+    char* copy = (char*)malloc(len + 1u);
+    if (!copy) return FOSSIL_CUBE_ERR_OOM;
+    memcpy(copy, utf8, len + 1u);
+    free(n->text);
+    n->text = copy;
+    n->text_box_valid = false;
+    fc_node_dirty(s, n);
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_scene_set_visible(fossil_cube_scene* s, fossil_cube_node node, bool visible) {
+    fc_node* n = fc_node_get(s, node);
+    if (!n || n->visible == visible) return;
+    n->visible = visible;
+    fc_node_dirty(s, n);
+}
+
+void fossil_cube_scene_set_clip(fossil_cube_scene* s, fossil_cube_node node, int x, int y, int w, int h) {
+    fc_node* n = fc_node_get(s, node);
+    if (!n) return;
+    n->has_clip = w > 0 && h > 0;
+    n->clip = n->has_clip ? fc_box_xywh(x, y, w, h) : fc_box_empty_value;
+    fc_node_dirty(s, n);
+}
+
+void fossil_cube_scene_raise(fossil_cube_scene* s, fossil_cube_node node) {
+    fc_node* n = fc_node_get(s, node);
+    if (!n || node == FOSSIL_CUBE_SCENE_ROOT || !n->next) return;
+    const fossil_cube_node parent = n->parent;
+    fc_unlink(s, node);
+    fc_append(s, parent, node);
+    fc_node_dirty(s, n);
+}
+
+void fossil_cube_scene_touch(fossil_cube_scene* s, fossil_cube_node node) {
+    fc_node* n = fc_node_get(s, node);
+    if (!n) return;
+    n->text_box_valid = false;
+    fc_node_dirty(s, n);
+}
+
+void fossil_cube_scene_invalidate(fossil_cube_scene* s) {
+    if (!s) return;
+    s->full = true;
+    s->changed = true;
+}
+
+fossil_cube_rect fossil_cube_scene_bounds(const fossil_cube_scene* s, fossil_cube_node node) {
+    fossil_cube_rect r = { 0, 0, 0, 0 };
+    const fc_node* n = fc_node_get(s, node);
+    if (!n || fc_box_empty(&n->drawn)) return r;
+    /* drawn boxes are clipped to the framebuffer, so they fit an int */
+    r.x = (int)n->drawn.x0;
+    r.y = (int)n->drawn.y0;
+    r.w = (int)(n->drawn.x1 - n->drawn.x0);
+    r.h = (int)(n->drawn.y1 - n->drawn.y0);
+    return r;
+}
+
+int fossil_cube_scene_render(fossil_cube_scene* s, fossil_cube_ctx* ctx) {
+    if (!s || !ctx) return 0;
+    const int w = fossil_cube_width_ex(ctx), h = fossil_cube_height_ex(ctx);
+    if (w <= 0 || h <= 0) return 0;
+    const bool full = s->full || ctx != s->ctx || w != s->w || h != s->h;
+    if (!full && !s->changed) return 0;
+
+    fc_scene_layout(s, w, h, full);
+    s->changed = false;
+    s->full = false;
+    s->ctx = ctx;
+    s->w = w;
+    s->h = h;
+    if (full) {
+        s->dirty[0] = fc_box_xywh(0, 0, w, h);
+        s->dirty_count = 1;
+    } else {
+        /* removed nodes may have left boxes outside a resized screen */
+        const fc_box screen = { 0, 0, w, h };
+        int n = 0;
+        for (int i = 0; i < s->dirty_count; ++i) {
+            const fc_box b = fc_box_and(&s->dirty[i], &screen);
+            if (!fc_box_empty(&b)) s->dirty[n++] = b;
+        }
+        s->dirty_count = n;
+        fc_region_coalesce(s);
+        if (n == 0) return 0;
+    }
+
+    int cx, cy, cw, ch;
+    fossil_cube_get_clip_ex(ctx, &cx, &cy, &cw, &ch);
+    if (full) fossil_cube_begin_frame_ex(ctx, s->bg[0], s->bg[1], s->bg[2], 255);
+    else fossil_cube_begin_frame_retain_ex(ctx);
+    for (int i = 0; i < s->dirty_count; ++i) fc_scene_paint(s, ctx, &s->dirty[i], !full);
+    fossil_cube_set_clip_ex(ctx, cx, cy, cw, ch);
+    fossil_cube_end_frame_ex(ctx);
+
+    const int regions = s->dirty_count;
+    s->dirty_count = 0;
+    return regions;
+}
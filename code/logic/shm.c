@@ -0,0 +1,643 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* shm_open, memfd_create, nanosleep under -std=c17 */
+#endif
+
+#include "fossil/cube/shm.h"
+
+#if defined(FOSSIL_CUBE_NO_SHM)
+
+fossil_cube_result fossil_cube_shm_create(fossil_cube_shm** out_shm, const char* name,
+                                          int width, int height,
+                                          fossil_cube_format format, int buffers) {
+    (void)name; (void)width; (void)height; (void)format; (void)buffers;
+    if (out_shm) *out_shm = NULL;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+void fossil_cube_shm_config(fossil_cube_shm* shm, fossil_cube_config* config) {
+    (void)shm; (void)config;
+}
+
+fossil_cube_result fossil_cube_shm_bind(fossil_cube_shm* shm, fossil_cube_ctx* ctx) {
+    (void)shm; (void)ctx;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+fossil_cube_result fossil_cube_shm_open(fossil_cube_shm** out_shm, const char* name) {
+    (void)name;
+    if (out_shm) *out_shm = NULL;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+fossil_cube_result fossil_cube_shm_open_fd(fossil_cube_shm** out_shm, int fd) {
+    (void)fd;
+    if (out_shm) *out_shm = NULL;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+fossil_cube_result fossil_cube_shm_acquire(fossil_cube_shm* shm, fossil_cube_shm_frame* out_frame,
+                                           int timeout_ms) {
+    (void)shm; (void)out_frame; (void)timeout_ms;
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+}
+
+void fossil_cube_shm_release(fossil_cube_shm* shm) { (void)shm; }
+
+uint64_t fossil_cube_shm_dropped(const fossil_cube_shm* shm) {
+    (void)shm;
+    return 0;
+}
+
+int fossil_cube_shm_fd(const fossil_cube_shm* shm) {
+    (void)shm;
+    return -1;
+}
+
+void fossil_cube_shm_close(fossil_cube_shm* shm) { (void)shm; }
+
+#else
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
+/* =========================
+   Shared layout
+   =========================
+   One mapping: a page-aligned header followed by buffer_count page-aligned
+   framebuffers. Only fixed-width fields and offsets, so producer and
+   consumer may be different builds. head is written by the producer and
+   tail by the consumer, each on its own cache line; a slot is filled
+   before head moves past it (release) and read after head is seen
+   (acquire), so no lock is shared between the processes.
+*/
+
+#define FC_SHM_MAGIC   0x45425543u /* "CUBE" */
+#define FC_SHM_VERSION 1u
+#define FC_SHM_RING    8 /* > FOSSIL_CUBE_MAX_BUFFERS: in-flight frames never wrap */
+#define FC_SHM_PAGE    4096u
+#define FC_SHM_PITCH_ALIGN 64u
+
+typedef struct fc_shm_rect {
+    int32_t x, y, w, h;
+} fc_shm_rect;
+
+typedef struct fc_shm_slot {
+    uint64_t seq;
+    int32_t buffer;
+    int32_t rect_count;
+    fc_shm_rect rects[FOSSIL_CUBE_MAX_DAMAGE];
+} fc_shm_slot;
+
+typedef struct fc_shm_header {
+    uint64_t head; /* frames published */
+    uint8_t pad0[56];
+    uint64_t tail; /* frames released by the consumer */
+    uint8_t pad1[56];
+    uint32_t magic, version; /* magic is stored last on create */
+    int32_t width, height, pitch, format;
+    int32_t buffer_count, ring_size;
+    uint64_t header_size, buffer_size;
+    fc_shm_slot ring[FC_SHM_RING];
+} fc_shm_header;
+
+struct fossil_cube_shm {
+    fc_shm_header* hdr;
+    uint8_t* base;
+    size_t size;
+    bool owner;
+    char* name; /* owner only: unlinked on close */
+#if defined(_WIN32)
+    HANDLE map;
+#else
+    int fd;
+#endif
+    /* producer */
+    fossil_cube_ctx* ctx;
+    fossil_cube_allocator allocator;
+    bool used[FOSSIL_CUBE_MAX_BUFFERS];
+    uint64_t head, released;
+    uint64_t dropped;
+    bool stalled;   /* the last wait timed out and nothing was released since */
+    bool full_next; /* a frame was dropped: the next one reports the whole surface */
+    /* consumer */
+    uint64_t tail;
+};
+
+#if defined(_MSC_VER) && !defined(__clang__)
+static inline uint64_t fc_shm_load(const uint64_t* p) {
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)p, 0, 0);
+}
+static inline void fc_shm_store(uint64_t* p, uint64_t v) {
+    InterlockedExchange64((volatile LONG64*)p, (LONG64)v);
+}
+static inline uint32_t fc_shm_load32(const uint32_t* p) {
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)p, 0, 0);
+}
+static inline void fc_shm_store32(uint32_t* p, uint32_t v) {
+    InterlockedExchange((volatile LONG*)p, (LONG)v);
+}
+#else
+static inline uint64_t fc_shm_load(const uint64_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void fc_shm_store(uint64_t* p, uint64_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static inline uint32_t fc_shm_load32(const uint32_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void fc_shm_store32(uint32_t* p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+#endif
+
+static inline uint64_t fc_shm_round(uint64_t v, uint64_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+/* =========================
+   Platform
+   ========================= */
+
+#if defined(_WIN32)
+
+static uint64_t fc_shm_now_ms(void) { return (uint64_t)GetTickCount64(); }
+static void fc_shm_pause(void) { Sleep(1); }
+
+static bool fc_shm_map_create(fossil_cube_shm* s, const char* name, size_t size) {
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE }; /* anonymous: inherit the handle */
+    const unsigned long long sz = size;
+    s->map = CreateFileMappingA(INVALID_HANDLE_VALUE, name ? NULL : &sa, PAGE_READWRITE,
+                                (DWORD)(sz >> 32), (DWORD)sz, name);
+    if (!s->map) return false;
+    if (name && GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(s->map);
+        s->map = NULL;
+        return false;
+    }
+    s->base = (uint8_t*)MapViewOfFile(s->map, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!s->base) {
+        CloseHandle(s->map);
+        s->map = NULL;
+        return false;
+    }
+    s->size = size;
+    return true;
+}
+
+static bool fc_shm_map_open(fossil_cube_shm* s, const char* name) {
+    s->map = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    if (!s->map) return false;
+    s->base = (uint8_t*)MapViewOfFile(s->map, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (!s->base || !VirtualQuery(s->base, &info, sizeof(info))) {
+        if (s->base) UnmapViewOfFile(s->base);
+        CloseHandle(s->map);
+        s->map = NULL;
+        s->base = NULL;
+        return false;
+    }
+    s->size = info.RegionSize;
+    return true;
+}
+
+static void fc_shm_unmap(fossil_cube_shm* s) {
+    if (s->base) UnmapViewOfFile(s->base);
+    if (s->map) CloseHandle(s->map);
+}
+
+#else
+
+static uint64_t fc_shm_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static void fc_shm_pause(void) {
+    const struct timespec ts = { 0, 50000 }; /* 50us */
+    nanosleep(&ts, NULL);
+}
+
+static bool fc_shm_map_fd(fossil_cube_shm* s, int fd, size_t size) {
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return false;
+    s->fd = fd;
+    s->base = (uint8_t*)p;
+    s->size = size;
+    return true;
+}
+
+static bool fc_shm_map_create(fossil_cube_shm* s, const char* name, size_t size) {
+    int fd;
+    if (name) {
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    } else {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+        fd = memfd_create("fossil-cube", MFD_CLOEXEC);
+#else
+        /* no memfd: a private name that is gone before anyone can open it */
+        static unsigned counter; /* contexts may be created on many threads */
+        char tmp[64];
+        int tries = 0;
+        do {
+            snprintf(tmp, sizeof(tmp), "/fossil-cube-%ld-%u", (long)getpid(),
+                     __atomic_fetch_add(&counter, 1u, __ATOMIC_RELAXED));
+            fd = shm_open(tmp, O_RDWR | O_CREAT | O_EXCL, 0600);
+        } while (fd < 0 && ++tries < 16);
+        if (fd >= 0) shm_unlink(tmp);
+#endif
+    }
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)size) != 0 || !fc_shm_map_fd(s, fd, size)) {
+        close(fd);
+        if (name) shm_unlink(name);
+        return false;
+    }
+    return true;
+}
+
+static bool fc_shm_map_existing(fossil_cube_shm* s, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(fc_shm_header)) return false;
+    return fc_shm_map_fd(s, fd, (size_t)st.st_size);
+}
+
+static bool fc_shm_map_open(fossil_cube_shm* s, const char* name) {
+    const int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) return false;
+    if (!fc_shm_map_existing(s, fd)) {
+        close(fd);
+        return false;
+    }
+    return true;
+}
+
+static void fc_shm_unmap(fossil_cube_shm* s) {
+    if (s->base) munmap(s->base, s->size);
+    if (s->fd >= 0) close(s->fd);
+}
+
+#endif
+
+/* =========================
+   Allocator
+   =========================
+   Hands the context the buffer slots of the mapping; the initial
+   framebuffer takes one and set_buffers the rest.
+*/
+
+static void* fc_shm_alloc(size_t size, size_t align, void* user) {
+    fossil_cube_shm* s = (fossil_cube_shm*)user;
+    if (size > s->hdr->buffer_size || align > FC_SHM_PAGE) return NULL;
+    for (int i = 0; i < s->hdr->buffer_count; ++i) {
+        if (s->used[i]) continue;
+        s->used[i] = true;
+        return s->base + s->hdr->header_size + (size_t)i * s->hdr->buffer_size;
+    }
+    return NULL;
+}
+
+static int fc_shm_index(const fossil_cube_shm* s, const void* p) {
+    const uint8_t* first = s->base + s->hdr->header_size;
+    if ((const uint8_t*)p < first) return -1;
+    const size_t off = (size_t)((const uint8_t*)p - first);
+    if (off % s->hdr->buffer_size) return -1;
+    const size_t i = off / s->hdr->buffer_size;
+    return i < (size_t)s->hdr->buffer_count ? (int)i : -1;
+}
+
+static void fc_shm_free(void* ptr, size_t size, void* user) {
+    fossil_cube_shm* s = (fossil_cube_shm*)user;
+    (void)size;
+    const int i = fc_shm_index(s, ptr);
+    if (i >= 0) s->used[i] = false;
+}
+
+/* =========================
+   Producer
+   ========================= */
+
+/* Hand buffers the consumer released back to the swapchain */
+static void fc_shm_reclaim(fossil_cube_shm* s, uint64_t depth) {
+    const uint64_t tail = fc_shm_load(&s->hdr->tail);
+    if (tail != s->released) s->stalled = false;
+    for (; s->released < tail; ++s->released) {
+        const fc_shm_slot* done = &s->hdr->ring[s->released % FC_SHM_RING];
+        if (s->ctx && depth > 1) {
+            (void)fossil_cube_release_buffer_ex(
+                s->ctx, s->base + s->hdr->header_size + (size_t)done->buffer * s->hdr->buffer_size);
+        }
+    }
+}
+
+/* Wait until fewer than limit frames are queued; gives up after
+   FOSSIL_CUBE_RELEASE_TIMEOUT_MS, or at once while the consumer is known
+   to be stalled */
+static bool fc_shm_wait(fossil_cube_shm* s, uint64_t depth, uint64_t limit) {
+    const uint64_t t0 = fc_shm_now_ms();
+    for (;;) {
+        fc_shm_reclaim(s, depth);
+        if (s->head - s->released < limit) return true;
+        if (s->stalled || fc_shm_now_ms() - t0 >= FOSSIL_CUBE_RELEASE_TIMEOUT_MS) break;
+        fc_shm_pause();
+    }
+    s->stalled = true;
+    return false;
+}
+
+/* Publish the frame so end_frame always finds a free buffer after it:
+   with a swapchain, wait for a queue slot first; with one buffer, wait
+   until the consumer is done with it. A frame that finds the queue still
+   full is dropped and its buffer handed straight back. */
+static void fc_shm_publish(fossil_cube_shm* s, const uint8_t* pixels,
+                           const fossil_cube_rect* rects, int rect_count) {
+    const int idx = fc_shm_index(s, pixels);
+    if (idx < 0) return;
+    const uint64_t depth = s->ctx ? (uint64_t)s->hdr->buffer_count : 1u;
+    if (!fc_shm_wait(s, depth, depth > 1 ? depth - 1 : 1)) {
+        ++s->dropped;
+        s->full_next = true;
+        if (s->ctx && depth > 1) (void)fossil_cube_release_buffer_ex(s->ctx, pixels);
+        return;
+    }
+
+    const fossil_cube_rect all = { 0, 0, s->hdr->width, s->hdr->height };
+    if (s->full_next) {
+        rects = &all;
+        rect_count = 1;
+        s->full_next = false;
+    }
+    fc_shm_slot* slot = &s->hdr->ring[s->head % FC_SHM_RING];
+    slot->seq = s->head;
+    slot->buffer = idx;
+    slot->rect_count = rect_count;
+    for (int i = 0; i < rect_count; ++i) {
+        slot->rects[i].x = rects[i].x;
+        slot->rects[i].y = rects[i].y;
+        slot->rects[i].w = rects[i].w;
+        slot->rects[i].h = rects[i].h;
+    }
+    fc_shm_store(&s->hdr->head, ++s->head);
+    if (depth == 1) (void)fc_shm_wait(s, depth, 1);
+}
+
+static void fc_shm_present(const uint8_t* pixels, int width, int height, int pitch, void* userdata) {
+    (void)pitch;
+    const fossil_cube_rect all = { 0, 0, width, height };
+    fc_shm_publish((fossil_cube_shm*)userdata, pixels, &all, 1);
+}
+
+static void fc_shm_present_rects(const uint8_t* pixels, int width, int height, int pitch,
+                                 const fossil_cube_rect* rects, int rect_count, void* userdata) {
+    (void)width; (void)height; (void)pitch;
+    fc_shm_publish((fossil_cube_shm*)userdata, pixels, rects, rect_count);
+}
+
+fossil_cube_result fossil_cube_shm_create(fossil_cube_shm** out_shm, const char* name,
+                                          int width, int height,
+                                          fossil_cube_format format, int buffers) {
+    if (!out_shm) return FOSSIL_CUBE_ERR_BADARGS;
+    *out_shm = NULL;
+    const int bpp = fossil_cube_format_bpp(format);
+    if (width <= 0 || height <= 0 || bpp == 0 || buffers < 1 || buffers > FOSSIL_CUBE_MAX_BUFFERS) {
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    const uint64_t pitch = fc_shm_round((uint64_t)width * (uint64_t)bpp, FC_SHM_PITCH_ALIGN);
+    if (pitch > INT_MAX) return FOSSIL_CUBE_ERR_BADARGS;
+    const uint64_t header_size = fc_shm_round(sizeof(fc_shm_header), FC_SHM_PAGE);
+    const uint64_t buffer_size = fc_shm_round(pitch * (uint64_t)height, FC_SHM_PAGE);
+    const uint64_t total = header_size + buffer_size * (uint64_t)buffers;
+    if (total > (uint64_t)SIZE_MAX) return FOSSIL_CUBE_ERR_BADARGS;
+
+    fossil_cube_shm* s = (fossil_cube_shm*)calloc(1, sizeof(*s));
+    if (!s) return FOSSIL_CUBE_ERR_OOM;
+#if !defined(_WIN32)
+    s->fd = -1;
+#endif
+    if (name) {
+        const size_t len = strlen(name);
+        s->name = (char*)malloc(len + 1);
+        if (!s->name) {
+            free(s);
+            return FOSSIL_CUBE_ERR_OOM;
+        }
+        memcpy(s->name, name, len + 1);
+    }
+    if (!fc_shm_map_create(s, name, (size_t)total)) {
+        free(s->name);
+        free(s);
+        return FOSSIL_CUBE_ERR_OOM;
+    }
+    s->owner = true;
+    s->hdr = (fc_shm_header*)s->base;
+    s->hdr->version = FC_SHM_VERSION;
+    s->hdr->width = width;
+    s->hdr->height = height;
+    s->hdr->pitch = (int32_t)pitch;
+    s->hdr->format = (int32_t)format;
+    s->hdr->buffer_count = buffers;
+    s->hdr->ring_size = FC_SHM_RING;
+    s->hdr->header_size = header_size;
+    s->hdr->buffer_size = buffer_size;
+    fc_shm_store32(&s->hdr->magic, FC_SHM_MAGIC);
+
+    s->allocator.alloc = fc_shm_alloc;
+    s->allocator.free = fc_shm_free;
+    s->allocator.user = s;
+    *out_shm = s;
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_shm_config(fossil_cube_shm* s, fossil_cube_config* config) {
+    if (!s || !s->owner || !config) return;
+    config->width = s->hdr->width;
+    config->height = s->hdr->height;
+    config->format = (fossil_cube_format)s->hdr->format;
+    config->pitch = s->hdr->pitch;
+    config->pad_rows = false;
+    config->align = FC_SHM_PITCH_ALIGN;
+    config->pixels = NULL;
+    config->allocator = &s->allocator;
+    config->present = fc_shm_present;
+    config->userdata = s;
+}
+
+fossil_cube_result fossil_cube_shm_bind(fossil_cube_shm* s, fossil_cube_ctx* ctx) {
+    if (!s || !s->owner || !ctx) return FOSSIL_CUBE_ERR_BADARGS;
+    int w = 0, h = 0, pitch = 0;
+    const uint8_t* pixels = fossil_cube_framebuffer_ex(ctx, &w, &h, &pitch);
+    if (!pixels) return FOSSIL_CUBE_ERR_NOTINIT;
+    if (fc_shm_index(s, pixels) < 0 || w != s->hdr->width || h != s->hdr->height ||
+        pitch != s->hdr->pitch) {
+        return FOSSIL_CUBE_ERR_BADARGS; /* not created from fossil_cube_shm_config */
+    }
+    const fossil_cube_result res = fossil_cube_set_buffers_ex(ctx, s->hdr->buffer_count);
+    if (res != FOSSIL_CUBE_OK) return res;
+    fossil_cube_set_present_rects_ex(ctx, fc_shm_present_rects);
+    s->ctx = ctx;
+    return FOSSIL_CUBE_OK;
+}
+
+/* =========================
+   Consumer
+   ========================= */
+
+static fossil_cube_result fc_shm_check(fossil_cube_shm* s) {
+    const fc_shm_header* h = (const fc_shm_header*)s->base;
+    if (fc_shm_load32(&h->magic) != FC_SHM_MAGIC || h->version != FC_SHM_VERSION ||
+        h->buffer_count < 1 || h->buffer_count > FOSSIL_CUBE_MAX_BUFFERS ||
+        h->ring_size != FC_SHM_RING || h->buffer_size == 0 ||
+        h->header_size + h->buffer_size * (uint64_t)h->buffer_count > s->size) {
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    /* acquire hands out pitch * height bytes of each buffer */
+    const int bpp = fossil_cube_format_bpp((fossil_cube_format)h->format);
+    if (bpp == 0 || h->width <= 0 || h->height <= 0 ||
+        (int64_t)h->pitch < (int64_t)h->width * bpp ||
+        (uint64_t)h->pitch * (uint64_t)h->height > h->buffer_size) {
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    s->hdr = (fc_shm_header*)s->base;
+    s->tail = fc_shm_load(&s->hdr->tail);
+    return FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_shm_open(fossil_cube_shm** out_shm, const char* name) {
+    if (!out_shm || !name) return FOSSIL_CUBE_ERR_BADARGS;
+    *out_shm = NULL;
+    fossil_cube_shm* s = (fossil_cube_shm*)calloc(1, sizeof(*s));
+    if (!s) return FOSSIL_CUBE_ERR_OOM;
+#if !defined(_WIN32)
+    s->fd = -1;
+#endif
+    if (!fc_shm_map_open(s, name)) {
+        free(s);
+        return FOSSIL_CUBE_ERR_NOTINIT;
+    }
+    if (fc_shm_check(s) != FOSSIL_CUBE_OK) {
+        fc_shm_unmap(s);
+        free(s);
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    *out_shm = s;
+    return FOSSIL_CUBE_OK;
+}
+
+fossil_cube_result fossil_cube_shm_open_fd(fossil_cube_shm** out_shm, int fd) {
+    if (!out_shm || fd < 0) return FOSSIL_CUBE_ERR_BADARGS;
+    *out_shm = NULL;
+#if defined(_WIN32)
+    return FOSSIL_CUBE_ERR_UNSUPPORTED;
+#else
+    const int own = dup(fd); /* the caller keeps its descriptor */
+    if (own < 0) return FOSSIL_CUBE_ERR_BADARGS;
+    fossil_cube_shm* s = (fossil_cube_shm*)calloc(1, sizeof(*s));
+    if (!s) {
+        close(own);
+        return FOSSIL_CUBE_ERR_OOM;
+    }
+    if (!fc_shm_map_existing(s, own)) {
+        close(own);
+        free(s);
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    if (fc_shm_check(s) != FOSSIL_CUBE_OK) {
+        fc_shm_unmap(s);
+        free(s);
+        return FOSSIL_CUBE_ERR_BADARGS;
+    }
+    *out_shm = s;
+    return FOSSIL_CUBE_OK;
+#endif
+}
+
+fossil_cube_result fossil_cube_shm_acquire(fossil_cube_shm* s, fossil_cube_shm_frame* out_frame,
+                                           int timeout_ms) {
+    if (!s || s->owner || !out_frame) return FOSSIL_CUBE_ERR_BADARGS;
+    const uint64_t start = timeout_ms > 0 ? fc_shm_now_ms() : 0;
+    while (fc_shm_load(&s->hdr->head) == s->tail) {
+        if (timeout_ms == 0 || (timeout_ms > 0 && fc_shm_now_ms() - start >= (uint64_t)timeout_ms)) {
+            return FOSSIL_CUBE_ERR_NOTINIT;
+        }
+        fc_shm_pause();
+    }
+    const fc_shm_slot* slot = &s->hdr->ring[s->tail % FC_SHM_RING];
+    const fc_shm_header* h = s->hdr;
+    if (slot->buffer < 0 || slot->buffer >= h->buffer_count) return FOSSIL_CUBE_ERR_BADARGS;
+    out_frame->pixels = s->base + h->header_size + (size_t)slot->buffer * h->buffer_size;
+    out_frame->width = h->width;
+    out_frame->height = h->height;
+    out_frame->pitch = h->pitch;
+    out_frame->format = (fossil_cube_format)h->format;
+    out_frame->sequence = slot->seq;
+    out_frame->buffer = slot->buffer;
+    int n = slot->rect_count;
+    if (n < 0) n = 0;
+    if (n > FOSSIL_CUBE_MAX_DAMAGE) n = FOSSIL_CUBE_MAX_DAMAGE;
+    out_frame->rect_count = n;
+    for (int i = 0; i < n; ++i) {
+        out_frame->rects[i].x = slot->rects[i].x;
+        out_frame->rects[i].y = slot->rects[i].y;
+        out_frame->rects[i].w = slot->rects[i].w;
+        out_frame->rects[i].h = slot->rects[i].h;
+    }
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_shm_release(fossil_cube_shm* s) {
+    if (!s || s->owner || fc_shm_load(&s->hdr->head) == s->tail) return;
+    fc_shm_store(&s->hdr->tail, ++s->tail);
+}
+
+/* =========================
+   Both sides
+   ========================= */
+
+uint64_t fossil_cube_shm_dropped(const fossil_cube_shm* s) {
+    return s ? s->dropped : 0;
+}
+
+int fossil_cube_shm_fd(const fossil_cube_shm* s) {
+#if defined(_WIN32)
+    (void)s;
+    return -1;
+#else
+    return s ? s->fd : -1;
+#endif
+}
+
+void fossil_cube_shm_close(fossil_cube_shm* s) {
+    if (!s) return;
+    fc_shm_unmap(s);
+#if !defined(_WIN32)
+    if (s->owner && s->name) shm_unlink(s->name);
+#endif
+    free(s->name);
+    free(s);
+}
+
+#endif /* FOSSIL_CUBE_NO_SHM */
@@ -0,0 +1,540 @@
+/*
+ * -----------------------------------------------------------------------------
+ * Project: Fossil Logic
+ *
+ * This file is part of the Fossil Logic project, which aims to develop high-
+ * performance, cross-platform applications and libraries. The code contained
+ * herein is subject to the terms and conditions defined in the project license.
+ *
+ * Author: Michael Gene Brockus (Dreamer)
+ *
+ * Copyright (C) 2024 Fossil Logic. All rights reserved.
+ * -----------------------------------------------------------------------------
+ */
+#include "fossil/cube/text.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* =========================
+   Glyph cache
+   =========================
+   Glyphs are keyed by (size << 32 | codepoint) in an open-addressed table
+   and packed on shelves into FC_ATLAS_PAGE square A8 pages. Pages are only
+   appended, so a cached glyph's coverage pointer stays valid for deferred
+   draws; a glyph larger than a page gets a page of its own. Only
+   fossil_cube_font_trim drops a cache over its limit: shelf pages go to a
+   spare list and are packed again, oversized pages are freed.
+*/
+
+enum { FC_ATLAS_PAGE = 256, FC_GLYPHS_MIN = 256, FC_RUN_MIN = 32 };
+#define FC_FONT_CACHE_LIMIT ((size_t)8 << 20)
+
+typedef struct fc_glyph_entry {
+    uint64_t key;        /* 0: empty slot */
+    const uint8_t* px;   /* NULL: nothing to draw */
+    int w, h, pitch;
+    int bx, by, adv;
+} fc_glyph_entry;
+
+typedef struct fc_atlas_page {
+    uint8_t* px;
+    int w, h;
+} fc_atlas_page;
+
+struct fossil_cube_font {
+    fossil_cube_glyph_fn rasterize;
+    void* userdata;
+
+    fc_glyph_entry* table;
+    size_t cap, count;    /* cap: power of two */
+
+    fc_atlas_page* pages;
+    int page_count, page_cap;
+    int shelf_page;       /* page being packed, -1 none */
+    int shelf_x, shelf_y, shelf_h;
+    uint8_t** spare;      /* shelf pages of a dropped cache, packed again first */
+    int spare_count;
+    size_t bytes, limit;  /* pages and table in use; limit 0: none */
+    bool builtin;
+
+    uint8_t* scratch;     /* built-in font: scaled bitmap */
+    size_t scratch_size;
+
+    int* run;             /* draw_text: x, y, w, h, pitch of each glyph, run_cap apart */
+    const uint8_t** run_cov;
+    int run_cap;
+};
+
+static inline uint64_t fc_glyph_key(uint32_t cp, int size) {
+    return ((uint64_t)(uint32_t)size << 32) | cp;
+}
+
+static inline size_t fc_glyph_hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+static fc_glyph_entry* fc_glyph_slot(fc_glyph_entry* table, size_t cap, uint64_t key) {
+    size_t i = fc_glyph_hash(key) & (cap - 1);
+    while (table[i].key != 0 && table[i].key != key) i = (i + 1) & (cap - 1);
+    return &table[i];
+}
+
+static bool fc_glyph_grow(fossil_cube_font* f) {
+    const size_t ncap = f->cap ? f->cap * 2u : FC_GLYPHS_MIN;
+    fc_glyph_entry* n = (fc_glyph_entry*)calloc(ncap, sizeof(*n));
+    if (!n) return false;
+    for (size_t i = 0; i < f->cap; ++i) {
+        if (f->table[i].key != 0) *fc_glyph_slot(n, ncap, f->table[i].key) = f->table[i];
+    }
+    free(f->table);
+    f->bytes += (ncap - f->cap) * sizeof(*n);
+    f->table = n;
+    f->cap = ncap;
+    return true;
+}
+
+static uint8_t* fc_page_add(fossil_cube_font* f, int w, int h) {
+    if (f->page_count == f->page_cap) {
+        const int ncap = f->page_cap ? f->page_cap * 2 : 4;
+        fc_atlas_page* n = (fc_atlas_page*)realloc(f->pages, (size_t)ncap * sizeof(*n));
+        if (!n) return NULL;
+        f->pages = n;
+        f->page_cap = ncap;
+    }
+    uint8_t* px;
+    if (w == FC_ATLAS_PAGE && h == FC_ATLAS_PAGE && f->spare_count > 0) {
+        px = f->spare[--f->spare_count];
+        memset(px, 0, (size_t)w * (size_t)h);
+    } else {
+        px = (uint8_t*)calloc((size_t)w * (size_t)h, 1);
+        if (!px) return NULL;
+    }
+    f->bytes += (size_t)w * (size_t)h;
+    f->pages[f->page_count].px = px;
+    f->pages[f->page_count].w = w;
+    f->pages[f->page_count].h = h;
+    ++f->page_count;
+    return px;
+}
+
+/* Room for a w x h glyph; returns its top-left and the row pitch */
+static uint8_t* fc_atlas_alloc(fossil_cube_font* f, int w, int h, int* out_pitch) {
+    if (w > FC_ATLAS_PAGE || h > FC_ATLAS_PAGE) {
+        *out_pitch = w;
+        return fc_page_add(f, w, h);
+    }
+    if (f->shelf_page >= 0 && f->shelf_x + w > FC_ATLAS_PAGE) {
+        f->shelf_x = 0;
+        f->shelf_y += f->shelf_h;
+        f->shelf_h = 0;
+    }
+    if (f->shelf_page < 0 || f->shelf_y + h > FC_ATLAS_PAGE) {
+        if (!fc_page_add(f, FC_ATLAS_PAGE, FC_ATLAS_PAGE)) return NULL;
+        f->shelf_page = f->page_count - 1;
+        f->shelf_x = f->shelf_y = f->shelf_h = 0;
+    }
+    uint8_t* p = f->pages[f->shelf_page].px + (size_t)f->shelf_y * FC_ATLAS_PAGE + (size_t)f->shelf_x;
+    f->shelf_x += w;
+    if (h > f->shelf_h) f->shelf_h = h;
+    *out_pitch = FC_ATLAS_PAGE;
+    return p;
+}
+
+/* Cached glyph, rasterized and packed on first use; NULL on OOM. The
+   built-in font draws every codepoint it lacks as '?', so those share
+   the '?' entry. */
+static const fc_glyph_entry* fc_font_glyph(fossil_cube_font* f, uint32_t cp, int size) {
+    if (f->builtin && (cp < 0x20 || cp > 0x7E)) cp = '?';
+    const uint64_t key = fc_glyph_key(cp, size);
+    if (f->cap) {
+        const fc_glyph_entry* e = fc_glyph_slot(f->table, f->cap, key);
+        if (e->key == key) return e;
+    }
+    if ((f->count + 1) * 2u > f->cap && !fc_glyph_grow(f)) return NULL;
+
+    fc_glyph_entry e;
+    memset(&e, 0, sizeof(e));
+    e.key = key;
+    fossil_cube_glyph g;
+    memset(&g, 0, sizeof(g));
+    if (f->rasterize(cp, size, &g, f->userdata)) {
+        e.bx = g.bearing_x;
+        e.by = g.bearing_y;
+        e.adv = g.advance;
+        if (g.coverage && g.width > 0 && g.height > 0) {
+            uint8_t* dst = fc_atlas_alloc(f, g.width, g.height, &e.pitch);
+            if (!dst) return NULL;
+            for (int y = 0; y < g.height; ++y) {
+                memcpy(dst + (size_t)y * (size_t)e.pitch,
+                       g.coverage + (size_t)y * (size_t)g.pitch, (size_t)g.width);
+            }
+            e.px = dst;
+            e.w = g.width;
+            e.h = g.height;
+        }
+    }
+    fc_glyph_entry* slot = fc_glyph_slot(f->table, f->cap, key);
+    *slot = e;
+    ++f->count;
+    return slot;
+}
+
+/* =========================
+   Built-in font
+   =========================
+   5x9 cells for U+0020..U+007E, one byte per row with the leftmost pixel
+   in bit 4; rows 0..6 sit above the baseline, 7..8 are descenders.
+*/
+
+enum { FC_FONT_W = 5, FC_FONT_H = 9, FC_FONT_ASCENT = 7, FC_FONT_ADVANCE = 6, FC_FONT_SIZE = 10 };
+
+static const uint8_t fc_font5x9[95][FC_FONT_H] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* ' ' */
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00 }, /* '!' */
+    { 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* '"' */
+    { 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A, 0x00, 0x00 }, /* '#' */
+    { 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04, 0x00, 0x00 }, /* '$' */
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03, 0x00, 0x00 }, /* '%' */
+    { 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D, 0x00, 0x00 }, /* '&' */
+    { 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* ''' */
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02, 0x00, 0x00 }, /* '(' */
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08, 0x00, 0x00 }, /* ')' */
+    { 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00, 0x00, 0x00 }, /* '*' */
+    { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00, 0x00, 0x00 }, /* '+' */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x08, 0x00 }, /* ',' */
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* '-' */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00 }, /* '.' */
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00, 0x00, 0x00 }, /* '/' */
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E, 0x00, 0x00 }, /* '0' */
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E, 0x00, 0x00 }, /* '1' */
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F, 0x00, 0x00 }, /* '2' */
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E, 0x00, 0x00 }, /* '3' */
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02, 0x00, 0x00 }, /* '4' */
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E, 0x00, 0x00 }, /* '5' */
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E, 0x00, 0x00 }, /* '6' */
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08, 0x00, 0x00 }, /* '7' */
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E, 0x00, 0x00 }, /* '8' */
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C, 0x00, 0x00 }, /* '9' */
+    { 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00 }, /* ':' */
+    { 0x00, 0x00, 0x04, 0x00, 0x00, 0x04, 0x04, 0x08, 0x00 }, /* ';' */
+    { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02, 0x00, 0x00 }, /* '<' */
+    { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00, 0x00, 0x00 }, /* '=' */
+    { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08, 0x00, 0x00 }, /* '>' */
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04, 0x00, 0x00 }, /* '?' */
+    { 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E, 0x00, 0x00 }, /* '@' */
+    { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11, 0x00, 0x00 }, /* 'A' */
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E, 0x00, 0x00 }, /* 'B' */
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E, 0x00, 0x00 }, /* 'C' */
+    { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C, 0x00, 0x00 }, /* 'D' */
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F, 0x00, 0x00 }, /* 'E' */
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10, 0x00, 0x00 }, /* 'F' */
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F, 0x00, 0x00 }, /* 'G' */
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11, 0x00, 0x00 }, /* 'H' */
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E, 0x00, 0x00 }, /* 'I' */
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C, 0x00, 0x00 }, /* 'J' */
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11, 0x00, 0x00 }, /* 'K' */
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F, 0x00, 0x00 }, /* 'L' */
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11, 0x00, 0x00 }, /* 'M' */
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11, 0x00, 0x00 }, /* 'N' */
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E, 0x00, 0x00 }, /* 'O' */
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10, 0x00, 0x00 }, /* 'P' */
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D, 0x00, 0x00 }, /* 'Q' */
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11, 0x00, 0x00 }, /* 'R' */
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E, 0x00, 0x00 }, /* 'S' */
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00 }, /* 'T' */
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E, 0x00, 0x00 }, /* 'U' */
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04, 0x00, 0x00 }, /* 'V' */
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A, 0x00, 0x00 }, /* 'W' */
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11, 0x00, 0x00 }, /* 'X' */
+    { 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00 }, /* 'Y' */
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F, 0x00, 0x00 }, /* 'Z' */
+    { 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E, 0x00, 0x00 }, /* '[' */
+    { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00, 0x00, 0x00 }, /* backslash */
+    { 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E, 0x00, 0x00 }, /* ']' */
+    { 0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* '^' */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x00 }, /* '_' */
+    { 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, /* '`' */
+    { 0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F, 0x00, 0x00 }, /* 'a' */
+    { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E, 0x00, 0x00 }, /* 'b' */
+    { 0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E, 0x00, 0x00 }, /* 'c' */
+    { 0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F, 0x00, 0x00 }, /* 'd' */
+    { 0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E, 0x00, 0x00 }, /* 'e' */
+    { 0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08, 0x00, 0x00 }, /* 'f' */
+    { 0x00, 0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x11, 0x0E }, /* 'g' */
+    { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11, 0x00, 0x00 }, /* 'h' */
+    { 0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E, 0x00, 0x00 }, /* 'i' */
+    { 0x02, 0x00, 0x06, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, /* 'j' */
+    { 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12, 0x00, 0x00 }, /* 'k' */
+    { 0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E, 0x00, 0x00 }, /* 'l' */
+    { 0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11, 0x00, 0x00 }, /* 'm' */
+    { 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11, 0x00, 0x00 }, /* 'n' */
+    { 0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E, 0x00, 0x00 }, /* 'o' */
+    { 0x00, 0x00, 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, /* 'p' */
+    { 0x00, 0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x01, 0x01 }, /* 'q' */
+    { 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10, 0x00, 0x00 }, /* 'r' */
+    { 0x00, 0x00, 0x0F, 0x10, 0x0E, 0x01, 0x1E, 0x00, 0x00 }, /* 's' */
+    { 0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06, 0x00, 0x00 }, /* 't' */
+    { 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D, 0x00, 0x00 }, /* 'u' */
+    { 0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04, 0x00, 0x00 }, /* 'v' */
+    { 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A, 0x00, 0x00 }, /* 'w' */
+    { 0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x00, 0x00 }, /* 'x' */
+    { 0x00, 0x00, 0x11, 0x11, 0x11, 0x0F, 0x01, 0x11, 0x0E }, /* 'y' */
+    { 0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F, 0x00, 0x00 }, /* 'z' */
+    { 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02, 0x00, 0x00 }, /* '{' */
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00 }, /* '|' */
+    { 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08, 0x00, 0x00 }, /* '}' */
+    { 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00, 0x00, 0x00 }, /* '~' */
+};
+
+static bool fc_builtin_glyph(uint32_t cp, int size, fossil_cube_glyph* out, void* userdata) {
+    fossil_cube_font* f = (fossil_cube_font*)userdata;
+    const int s = size / FC_FONT_SIZE > 0 ? size / FC_FONT_SIZE : 1;
+    if (s > 64) return false; /* past 640px a 5x9 bitmap is no longer text */
+    const size_t need = (size_t)FC_FONT_W * (size_t)FC_FONT_H * (size_t)s * (size_t)s;
+    if (need > f->scratch_size) {
+        uint8_t* n = (uint8_t*)realloc(f->scratch, need);
+        if (!n) return false;
+        f->scratch = n;
+        f->scratch_size = need;
+    }
+    const uint8_t* rows = fc_font5x9[cp - 0x20];
+    const int w = FC_FONT_W * s;
+    for (int y = 0; y < FC_FONT_H * s; ++y) {
+        uint8_t* d = f->scratch + (size_t)y * (size_t)w;
+        for (int x = 0; x < w; ++x) d[x] = (rows[y / s] >> (FC_FONT_W - 1 - x / s)) & 1u ? 255 : 0;
+    }
+    out->coverage = cp == ' ' ? NULL : f->scratch;
+    out->width = w;
+    out->height = FC_FONT_H * s;
+    out->pitch = w;
+    out->bearing_x = 0;
+    out->bearing_y = FC_FONT_ASCENT * s;
+    out->advance = FC_FONT_ADVANCE * s;
+    return true;
+}
+
+/* =========================
+   Font API
+   ========================= */
+
+fossil_cube_result fossil_cube_font_create(fossil_cube_font** out_font,
+                                           fossil_cube_glyph_fn rasterize, void* userdata) {
+    if (!out_font) return FOSSIL_CUBE_ERR_BADARGS;
+    fossil_cube_font* f = (fossil_cube_font*)calloc(1, sizeof(*f));
+    *out_font = f;
+    if (!f) return FOSSIL_CUBE_ERR_OOM;
+    f->rasterize = rasterize ? rasterize : fc_builtin_glyph;
+    f->userdata = rasterize ? userdata : f;
+    f->builtin = !rasterize;
+    f->shelf_page = -1;
+    f->limit = FC_FONT_CACHE_LIMIT;
+    return FOSSIL_CUBE_OK;
+}
+
+void fossil_cube_font_set_cache_limit(fossil_cube_font* f, size_t bytes) {
+    if (f) f->limit = bytes;
+}
+
+void fossil_cube_font_trim(fossil_cube_font* f) {
+    if (!f || f->limit == 0 || f->bytes <= f->limit) return;
+    int shelves = 0;
+    for (int i = 0; i < f->page_count; ++i) shelves += f->pages[i].w == FC_ATLAS_PAGE && f->pages[i].h == FC_ATLAS_PAGE;
+    uint8_t** n = shelves ? (uint8_t**)realloc(f->spare, (size_t)(f->spare_count + shelves) * sizeof(*n)) : f->spare;
+    if (n) f->spare = n;
+    for (int i = 0; i < f->page_count; ++i) {
+        const bool shelf = f->pages[i].w == FC_ATLAS_PAGE && f->pages[i].h == FC_ATLAS_PAGE;
+        if (shelf && n) f->spare[f->spare_count++] = f->pages[i].px;
+        else free(f->pages[i].px);
+    }
+    f->page_count = 0;
+    f->shelf_page = -1;
+    if (f->cap * sizeof(*f->table) > f->limit / 2) {
+        free(f->table);
+        f->table = NULL;
+        f->cap = 0;
+    } else if (f->cap) {
+        memset(f->table, 0, f->cap * sizeof(*f->table));
+    }
+    f->count = 0;
+    f->bytes = f->cap * sizeof(*f->table);
+}
+
+void fossil_cube_font_clear(fossil_cube_font* f) {
+    if (!f) return;
+    for (int i = 0; i < f->page_count; ++i) free(f->pages[i].px);
+    for (int i = 0; i < f->spare_count; ++i) free(f->spare[i]);
+    free(f->pages);
+    free(f->spare);
+    free(f->table);
+    f->pages = NULL;
+    f->page_count = f->page_cap = 0;
+    f->spare = NULL;
+    f->spare_count = 0;
+    f->table = NULL;
+    f->cap = f->count = 0;
+    f->bytes = 0;
+    f->shelf_page = -1;
+}
+
+void fossil_cube_font_destroy(fossil_cube_font* f) {
+    if (!f) return;
+    fossil_cube_font_clear(f);
+    free(f->scratch);
+    free(f->run);
+    free(f->run_cov);
+    free(f);
+}
+
+/* Next codepoint of a NUL-terminated UTF-8 string; malformed, overlong
+   and surrogate sequences consume one byte and read as U+FFFD */
+static uint32_t fc_utf8_next(const char** s) {
+    const uint8_t* p = (const uint8_t*)*s;
+    const uint32_t c = p[0];
+    int n;
+    uint32_t cp, min;
+    if (c < 0x80) { *s += 1; return c; }
+    if ((c & 0xE0) == 0xC0) { n = 1; cp = c & 0x1F; min = 0x80; }
+    else if ((c & 0xF0) == 0xE0) { n = 2; cp = c & 0x0F; min = 0x800; }
+    else if ((c & 0xF8) == 0xF0) { n = 3; cp = c & 0x07; min = 0x10000; }
+    else { *s += 1; return 0xFFFD; }
+    for (int i = 1; i <= n; ++i) {
+        if ((p[i] & 0xC0) != 0x80) { *s += 1; return 0xFFFD; }
+        cp = (cp << 6) | (p[i] & 0x3Fu);
+    }
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) { *s += 1; return 0xFFFD; }
+    *s += n + 1;
+    return cp;
+}
+
+int fossil_cube_text_width(fossil_cube_font* f, const char* utf8, int size) {
+    if (!f || !utf8 || size <= 0) return 0;
+    int pen = 0, widest = 0;
+    while (*utf8) {
+        const uint32_t cp = fc_utf8_next(&utf8);
+        if (cp == '\n') { pen = 0; continue; }
+        const fc_glyph_entry* e = fc_font_glyph(f, cp, size);
+        if (e) pen += e->adv;
+        if (pen > widest) widest = pen;
+    }
+    return widest;
+}
+
+bool fossil_cube_text_bounds(fossil_cube_font* f, const char* utf8, int size, fossil_cube_rect* out) {
+    if (out) { out->x = out->y = out->w = out->h = 0; }
+    if (!f || !utf8 || size <= 0 || !out) return false;
+    int pen = 0, baseline = 0;
+    long long x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    bool any = false;
+    while (*utf8) {
+        const uint32_t cp = fc_utf8_next(&utf8);
+        if (cp == '\n') { pen = 0; baseline += size; continue; }
+        const fc_glyph_entry* e = fc_font_glyph(f, cp, size);
+        if (!e) continue;
+        if (e->px && e->w > 0 && e->h > 0) {
+            const long long gx = (long long)pen + e->bx, gy = (long long)baseline - e->by;
+            if (!any || gx < x0) x0 = gx;
+            if (!any || gy < y0) y0 = gy;
+            if (!any || gx + e->w > x1) x1 = gx + e->w;
+            if (!any || gy + e->h > y1) y1 = gy + e->h;
+            any = true;
+        }
+        pen += e->adv;
+    }
+    if (!any || x1 - x0 > INT_MAX || y1 - y0 > INT_MAX) return false;
+    out->x = (int)x0; out->y = (int)y0;
+    out->w = (int)(x1 - x0); out->h = (int)(y1 - y0);
+    return true;
+}
+
+/* Room for n glyphs in the draw_text run */
+static bool fc_run_reserve(fossil_cube_font* f, int n) {
+    if (n <= f->run_cap) return true;
+    const int ncap = f->run_cap ? f->run_cap * 2 : FC_RUN_MIN;
+    int* run = (int*)malloc((size_t)ncap * 5u * sizeof(*run));
+    const uint8_t** cov = (const uint8_t**)malloc((size_t)ncap * sizeof(*cov));
+    if (!run || !cov) {
+        free(run);
+        free(cov);
+        return false;
+    }
+    for (int k = 0; k < 5; ++k) {
+        if (f->run_cap) memcpy(run + (size_t)k * ncap, f->run + (size_t)k * f->run_cap, (size_t)f->run_cap * sizeof(*run));
+    }
+    if (f->run_cap) memcpy(cov, f->run_cov, (size_t)f->run_cap * sizeof(*cov));
+    free(f->run);
+    free(f->run_cov);
+    f->run = run;
+    f->run_cov = cov;
+    f->run_cap = ncap;
+    return true;
+}
+
+static void fc_run_flush(fossil_cube_ctx* ctx, fossil_cube_font* f, int n,
+                         uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (n == 0) return;
+    const int* run = f->run;
+    const size_t cap = (size_t)f->run_cap;
+    if (ctx) {
+        fossil_cube_blit_masks_ex(ctx, run, run + cap, f->run_cov, run + 2 * cap, run + 3 * cap,
+                                  run + 4 * cap, n, r, g, b, a);
+    } else {
+        fossil_cube_blit_masks(run, run + cap, f->run_cov, run + 2 * cap, run + 3 * cap,
+                               run + 4 * cap, n, r, g, b, a);
+    }
+}
+
+/* The glyphs of a string go out as one mask run; if the run cannot grow,
+   what it holds is drawn and it starts over */
+static int fc_draw_text(fossil_cube_ctx* ctx, fossil_cube_font* f, int x, int baseline,
+                        const char* utf8, int size, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!f || !utf8 || size <= 0) return x;
+    int pen = x, n = 0;
+    while (*utf8) {
+        const uint32_t cp = fc_utf8_next(&utf8);
+        if (cp == '\n') {
+            pen = x;
+            baseline += size;
+            continue;
+        }
+        const fc_glyph_entry* e = fc_font_glyph(f, cp, size);
+        if (!e) continue;
+        if (e->px && a != 0) {
+            if (!fc_run_reserve(f, n + 1)) {
+                fc_run_flush(ctx, f, n, r, g, b, a);
+                n = 0;
+            }
+            if (n < f->run_cap) {
+                const size_t cap = (size_t)f->run_cap;
+                f->run[n] = pen + e->bx;
+                f->run[cap + (size_t)n] = baseline - e->by;
+                f->run[2 * cap + (size_t)n] = e->w;
+                f->run[3 * cap + (size_t)n] = e->h;
+                f->run[4 * cap + (size_t)n] = e->pitch;
+                f->run_cov[n] = e->px;
+                ++n;
+            } else if (ctx) {
+                fossil_cube_blit_mask_ex(ctx, pen + e->bx, baseline - e->by, e->px, e->w, e->h, e->pitch, r, g, b, a);
+            } else {
+                fossil_cube_blit_mask(pen + e->bx, baseline - e->by, e->px, e->w, e->h, e->pitch, r, g, b, a);
+            }
+        }
+        pen += e->adv;
+    }
+    fc_run_flush(ctx, f, n, r, g, b, a);
+    return pen;
+}
+
+int fossil_cube_draw_text_ex(fossil_cube_ctx* ctx, fossil_cube_font* font, int x, int baseline,
+                             const char* utf8, int size, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (!ctx) return x;
+    return fc_draw_text(ctx, font, x, baseline, utf8, size, r, g, b, a);
+}
+
+int fossil_cube_draw_text(fossil_cube_font* font, int x, int baseline, const char* utf8, int size,
+                          uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    return fc_draw_text(NULL, font, x, baseline, utf8, size, r, g, b, a);
+}
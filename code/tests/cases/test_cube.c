@@ -11,8 +11,18 @@
  * Copyright (C) 2024 Fossil Logic. All rights reserved.
  * -----------------------------------------------------------------------------
  */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* pread/pwrite under -std=c17 */
+#endif
+
 #include <fossil/pizza/framework.h>
 #include "fossil/cube/framework.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
 
 
 // * * * * * * * * * * * * * * * * * * * * * * * *
@@ -30,6 +40,57 @@ FOSSIL_SETUP(c_cube_fixture) {
 
 FOSSIL_TEARDOWN(c_cube_fixture) {
     // Teardown the test fixture
+    fossil_cube_shutdown();
+}
+
+static void test_present(const uint8_t* pixels, int width, int height, int pitch, void* userdata) {
+    (void)pixels; (void)width; (void)height; (void)pitch;
+    if (userdata) ++*(int*)userdata;
+}
+
+static uint32_t test_rng = 1u;
+
+static uint8_t test_rand_u8(void) {
+    test_rng = test_rng * 1664525u + 1013904223u;
+    return (uint8_t)(test_rng >> 24);
+}
+
+/* Source image with opaque, transparent and translucent runs */
+static void test_make_src(uint8_t* src, int w, int h) {
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            uint8_t* p = src + ((size_t)y * (size_t)w + (size_t)x) * 4u;
+            p[0] = test_rand_u8(); p[1] = test_rand_u8(); p[2] = test_rand_u8();
+            if (x < 9)       p[3] = 255;
+            else if (x < 18) p[3] = 0;
+            else             p[3] = test_rand_u8();
+        }
+    }
+}
+
+/* Renders a fixed scene and copies the framebuffer into out */
+static void test_render_scene(uint8_t* out, const uint8_t* src, int sw, int sh) {
+    int w = 0, h = 0, pitch = 0;
+    fossil_cube_begin_frame(10, 20, 30, 255);
+    fossil_cube_fill_rect(-5, 3, 50, 20, 200, 100, 50, 255);
+    fossil_cube_fill_rect(7, -2, 61, 30, 90, 180, 250, 77);
+    fossil_cube_blit_rgba(-3, 5, src, sw, sh, sw * 4);
+    fossil_cube_set_clip(11, 4, 37, 19);
+    fossil_cube_fill_rect(0, 0, 100, 100, 255, 255, 255, 128);
+    fossil_cube_blit_rgba(13, 1, src, sw, sh, sw * 4);
+    fossil_cube_set_clip(0, 0, 0, 0);
+    fossil_cube_blit_rgba_alpha(21, 2, src, sw, sh, sw * 4, FOSSIL_CUBE_ALPHA_PREMULTIPLIED);
+    /* source bytes as coverage: runs of 0, 255 and everything between */
+    fossil_cube_blit_mask(2, 9, src + 3, sw, sh, sw * 4, 240, 40, 20, 200);
+    fossil_cube_blit_mask(30, 0, src + 3, sw, sh, sw * 4, 0, 255, 0, 255);
+    fossil_cube_blit_scaled(-7, 4, 97, 13, src, sw, sh, sw * 4, FOSSIL_CUBE_FILTER_BILINEAR);
+    fossil_cube_blit_scaled(40, -3, 17, 41, src, sw, sh, sw * 4, FOSSIL_CUBE_FILTER_NEAREST);
+    static const float zigzag[] = { -4.0f, 30.0f, 20.5f, 2.25f, 33.0f, 27.0f, 71.0f, 9.5f, 150.0f, 120.0f };
+    fossil_cube_draw_polyline(zigzag, 5, 3.5f, 250, 220, 40, 190);
+    fossil_cube_fill_circle(52.3f, 17.7f, 13.2f, 40, 90, 255, 140);
+    fossil_cube_end_frame();
+    const uint8_t* fb = fossil_cube_framebuffer(&w, &h, &pitch);
+    memcpy(out, fb, (size_t)pitch * (size_t)h);
 }
 
 // * * * * * * * * * * * * * * * * * * * * * * * *
@@ -44,11 +105,2375 @@ FOSSIL_TEST_CASE(c_test_blaink) {
     ASSUME_ITS_TRUE(1);
 }
 
+FOSSIL_TEST_CASE(c_test_simd_matches_scalar) {
+    enum { W = 67, H = 33, SW = 45, SH = 29 };
+    static uint8_t src[SW * SH * 4];
+    static uint8_t ref[W * H * 4];
+    static uint8_t got[W * H * 4];
+    const fossil_cube_simd best = fossil_cube_simd_level();
+
+    test_rng = 1u;
+    test_make_src(src, SW, SH);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_present, NULL));
+
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_set_simd_level(FOSSIL_CUBE_SIMD_SCALAR));
+    test_render_scene(ref, src, SW, SH);
+
+    for (int level = FOSSIL_CUBE_SIMD_SSE2; level <= FOSSIL_CUBE_SIMD_NEON; ++level) {
+        if (fossil_cube_set_simd_level((fossil_cube_simd)level) != FOSSIL_CUBE_OK) continue;
+        test_render_scene(got, src, SW, SH);
+        ASSUME_ITS_TRUE(memcmp(ref, got, sizeof(ref)) == 0);
+    }
+    fossil_cube_set_simd_level(best);
+}
+
+FOSSIL_TEST_CASE(c_test_clear_byte_order) {
+    int w = 0, h = 0, pitch = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(5, 3, test_present, NULL));
+    fossil_cube_clear(1, 2, 3, 4);
+    const uint8_t* fb = fossil_cube_framebuffer(&w, &h, &pitch);
+    for (int i = 0; i < w * h; ++i) {
+        ASSUME_ITS_TRUE(fb[i * 4 + 0] == 1 && fb[i * 4 + 1] == 2 &&
+                        fb[i * 4 + 2] == 3 && fb[i * 4 + 3] == 4);
+    }
+}
+
+FOSSIL_TEST_CASE(c_test_line_clipped_up_front) {
+    int w = 0, h = 0, pitch = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(16, 16, test_present, NULL));
+    const uint8_t* fb = fossil_cube_framebuffer(&w, &h, &pitch);
+
+    /* a diagonal entering from off-screen still covers the visible part */
+    fossil_cube_clear(0, 0, 0, 0);
+    fossil_cube_draw_line(-100, -100, 100, 100, 255, 0, 0, 255);
+    for (int i = 0; i < 16; ++i) {
+        ASSUME_ITS_EQUAL_I32(255, fb[(size_t)i * (size_t)pitch + (size_t)i * 4u]);
+    }
+
+    /* nothing outside the clip rect is touched */
+    fossil_cube_clear(0, 0, 0, 0);
+    fossil_cube_set_clip(4, 4, 8, 8);
+    fossil_cube_draw_line(-50, 7, 60, 9, 255, 0, 0, 255);
+    fossil_cube_draw_line(-50, -3, 60, -2, 255, 0, 0, 255);
+    int inside = 0, outside = 0;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            if (!fb[(size_t)y * (size_t)pitch + (size_t)x * 4u]) continue;
+            if (x >= 4 && x < 12 && y >= 4 && y < 12) ++inside; else ++outside;
+        }
+    }
+    ASSUME_ITS_EQUAL_I32(8, inside);
+    ASSUME_ITS_EQUAL_I32(0, outside);
+}
+
+FOSSIL_TEST_CASE(c_test_contexts_are_independent) {
+    fossil_cube_ctx* a = NULL;
+    fossil_cube_ctx* b = NULL;
+    int frames = 0, w = 0, h = 0, pitch = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&a, 8, 4, test_present, &frames));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&b, 3, 5, NULL, NULL));
+    ASSUME_ITS_CNULL(fossil_cube_default_ctx());
+
+    fossil_cube_begin_frame_ex(a, 255, 0, 0, 255);
+    fossil_cube_begin_frame_ex(b, 0, 0, 255, 255);
+    fossil_cube_set_clip_ex(a, 0, 0, 2, 2);
+    fossil_cube_fill_rect_ex(a, 0, 0, 8, 4, 0, 255, 0, 255);
+    fossil_cube_end_frame_ex(a);
+    fossil_cube_end_frame_ex(b); /* offscreen: no present */
+    ASSUME_ITS_EQUAL_I32(1, frames);
+
+    const uint8_t* pa = fossil_cube_framebuffer_ex(a, &w, &h, &pitch);
+    ASSUME_ITS_EQUAL_I32(8, w);
+    ASSUME_ITS_EQUAL_I32(255, pa[1]);        /* (0,0) inside a's clip */
+    ASSUME_ITS_EQUAL_I32(255, pa[2 * 4]);    /* (2,0) outside a's clip */
+    const uint8_t* pb = fossil_cube_framebuffer_ex(b, &w, &h, &pitch);
+    ASSUME_ITS_EQUAL_I32(3, fossil_cube_width_ex(b));
+    ASSUME_ITS_EQUAL_I32(255, pb[2]);
+    ASSUME_ITS_EQUAL_I32(0, pb[1]);
+
+    /* the classic API is the default context */
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(6, 6, test_present, NULL));
+    ASSUME_NOT_CNULL(fossil_cube_default_ctx());
+    ASSUME_ITS_EQUAL_I32(6, fossil_cube_width_ex(fossil_cube_default_ctx()));
+    ASSUME_ITS_EQUAL_I32(6, fossil_cube_width());
+
+    /* a NULL context is not the default one */
+    fossil_cube_set_clip(1, 1, 2, 2);
+    fossil_cube_get_clip_ex(NULL, NULL, NULL, &w, NULL);
+    ASSUME_ITS_EQUAL_I32(0, w);
+    ASSUME_ITS_CNULL(fossil_cube_framebuffer_ex(NULL, &w, &h, &pitch));
+    ASSUME_ITS_EQUAL_I32(0, h);
+    ASSUME_ITS_EQUAL_I32(0, pitch);
+
+    fossil_cube_ctx_destroy(a);
+    fossil_cube_ctx_destroy(b);
+}
+
+FOSSIL_TEST_CASE(c_test_deferred_matches_immediate) {
+    enum { W = 40, H = 30, SW = 45, SH = 29 };
+    static uint8_t src[SW * SH * 4];
+    static uint8_t ref[W * H * 4];
+    static uint8_t got[W * H * 4];
+    int frames = 0;
+
+    test_rng = 7u;
+    test_make_src(src, SW, SH);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_present, &frames));
+    test_render_scene(ref, src, SW, SH);
+
+    fossil_cube_set_mode(FOSSIL_CUBE_MODE_DEFERRED);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_MODE_DEFERRED, fossil_cube_get_mode());
+    fossil_cube_begin_frame(0, 0, 0, 255);
+    fossil_cube_fill_rect(0, 0, 10, 10, 1, 2, 3, 255);
+    int w = 0, h = 0, pitch = 0;
+    const uint8_t* fb = fossil_cube_framebuffer(&w, &h, &pitch);
+    ASSUME_ITS_EQUAL_I32(10, fb[0]); /* previous frame until end_frame */
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(1, fb[0]);
+    ASSUME_ITS_EQUAL_I32(2, frames);
+
+    test_render_scene(got, src, SW, SH);
+    ASSUME_ITS_TRUE(memcmp(ref, got, sizeof(ref)) == 0);
+}
+
+FOSSIL_TEST_CASE(c_test_cmdbuf_record_replay) {
+    fossil_cube_cmdbuf* buf = NULL;
+    int w = 0, h = 0, pitch = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(8, 8, test_present, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_cmdbuf_create(&buf));
+
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_record_begin(buf));
+    fossil_cube_fill_rect(0, 0, 4, 1, 200, 0, 0, 255);
+    fossil_cube_draw_line(0, 7, 7, 7, 0, 200, 0, 255);
+    fossil_cube_record_end();
+    ASSUME_ITS_EQUAL_I32(2, (int)fossil_cube_cmdbuf_count(buf));
+
+    const uint8_t* fb = fossil_cube_framebuffer(&w, &h, &pitch);
+    for (int frame = 0; frame < 2; ++frame) {
+        fossil_cube_begin_frame(0, 0, 0, 255);
+        ASSUME_ITS_EQUAL_I32(0, fb[0]); /* recording drew nothing */
+        fossil_cube_replay(buf);
+        fossil_cube_end_frame();
+        ASSUME_ITS_EQUAL_I32(200, fb[0]);
+        ASSUME_ITS_EQUAL_I32(200, fb[(size_t)7 * (size_t)pitch + 7 * 4 + 1]);
+    }
+
+    /* a frame begun while recording clears the frame, not the recording */
+    fossil_cube_cmdbuf_reset(buf);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_record_begin(buf));
+    fossil_cube_begin_frame(9, 9, 9, 255);
+    fossil_cube_fill_rect(0, 0, 1, 1, 200, 0, 0, 255);
+    fossil_cube_record_end();
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(1, (int)fossil_cube_cmdbuf_count(buf));
+    ASSUME_ITS_EQUAL_I32(9, fb[0]);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_get_error());
+    fossil_cube_cmdbuf_destroy(buf);
+}
+
+FOSSIL_TEST_CASE(c_test_tiled_threads_match_serial) {
+    enum { W = 200, H = 140, SW = 45, SH = 29 };
+    static uint8_t src[SW * SH * 4];
+    static uint8_t ref[W * H * 4];
+    static uint8_t got[W * H * 4];
+
+    test_rng = 11u;
+    test_make_src(src, SW, SH);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_present, NULL));
+    test_render_scene(ref, src, SW, SH);
+
+    fossil_cube_set_mode(FOSSIL_CUBE_MODE_DEFERRED);
+    const fossil_cube_result res = fossil_cube_set_threads(3);
+    ASSUME_ITS_TRUE(res == FOSSIL_CUBE_OK || res == FOSSIL_CUBE_ERR_UNSUPPORTED);
+    if (res == FOSSIL_CUBE_OK) ASSUME_ITS_EQUAL_I32(3, fossil_cube_get_threads());
+    for (int frame = 0; frame < 3; ++frame) {
+        test_render_scene(got, src, SW, SH);
+        ASSUME_ITS_TRUE(memcmp(ref, got, sizeof(ref)) == 0);
+    }
+}
+
+static fossil_cube_rect test_last_rects[FOSSIL_CUBE_MAX_DAMAGE];
+static int test_last_rect_count;
+
+static void test_present_rects(const uint8_t* pixels, int width, int height, int pitch,
+                               const fossil_cube_rect* rects, int rect_count, void* userdata) {
+    (void)pixels; (void)width; (void)height; (void)pitch; (void)userdata;
+    test_last_rect_count = rect_count;
+    memcpy(test_last_rects, rects, (size_t)rect_count * sizeof(*rects));
+}
+
+FOSSIL_TEST_CASE(c_test_dirty_rects_partial_present) {
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(100, 80, test_present, NULL));
+    fossil_cube_set_present_rects(test_present_rects);
+
+    /* a clearing frame damages the whole surface */
+    fossil_cube_begin_frame(1, 2, 3, 255);
+    fossil_cube_fill_rect(10, 10, 5, 5, 255, 0, 0, 255);
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(1, test_last_rect_count);
+    ASSUME_ITS_EQUAL_I32(100, test_last_rects[0].w);
+    ASSUME_ITS_EQUAL_I32(80, test_last_rects[0].h);
+
+    /* a retained frame only reports what was drawn, clipped to the surface */
+    fossil_cube_begin_frame_retain();
+    fossil_cube_fill_rect(-4, 70, 10, 20, 0, 255, 0, 255);
+    fossil_cube_fill_rect(0, 72, 2, 2, 0, 0, 255, 255);
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(1, test_last_rect_count);
+    ASSUME_ITS_EQUAL_I32(0, test_last_rects[0].x);
+    ASSUME_ITS_EQUAL_I32(70, test_last_rects[0].y);
+    ASSUME_ITS_EQUAL_I32(6, test_last_rects[0].w);
+    ASSUME_ITS_EQUAL_I32(10, test_last_rects[0].h);
+    ASSUME_ITS_EQUAL_I32(1, fossil_cube_framebuffer(NULL, NULL, NULL)[0]);
+
+    /* many scattered draws stay bounded and still cover every pixel */
+    fossil_cube_begin_frame_retain();
+    for (int i = 0; i < 40; ++i) fossil_cube_put_pixel((i * 37) % 100, (i * 23) % 80, 9, 9, 9, 255);
+    fossil_cube_end_frame();
+    ASSUME_ITS_TRUE(test_last_rect_count > 0 && test_last_rect_count <= FOSSIL_CUBE_MAX_DAMAGE);
+    for (int i = 0; i < 40; ++i) {
+        const int x = (i * 37) % 100, y = (i * 23) % 80;
+        bool covered = false;
+        for (int r = 0; r < test_last_rect_count; ++r) {
+            const fossil_cube_rect* q = &test_last_rects[r];
+            if (x >= q->x && x < q->x + q->w && y >= q->y && y < q->y + q->h) covered = true;
+        }
+        ASSUME_ITS_TRUE(covered);
+    }
+
+    /* nothing drawn, nothing reported */
+    fossil_cube_begin_frame_retain();
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(0, test_last_rect_count);
+
+    fossil_cube_add_damage(95, 75, 10, 10);
+    fossil_cube_rect rects[FOSSIL_CUBE_MAX_DAMAGE];
+    ASSUME_ITS_EQUAL_I32(1, fossil_cube_get_damage(rects, FOSSIL_CUBE_MAX_DAMAGE));
+    ASSUME_ITS_EQUAL_I32(5, rects[0].w);
+    ASSUME_ITS_EQUAL_I32(5, rects[0].h);
+}
+
+static const uint8_t* test_held[8];
+static int test_held_count;
+
+static void test_present_hold(const uint8_t* pixels, int width, int height, int pitch, void* userdata) {
+    (void)width; (void)height; (void)pitch; (void)userdata;
+    test_held[test_held_count++] = pixels;
+}
+
+FOSSIL_TEST_CASE(c_test_swapchain_async_present) {
+    enum { W = 40, H = 30 };
+    test_held_count = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_present_hold, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_set_buffers(3));
+    ASSUME_ITS_EQUAL_I32(3, fossil_cube_get_buffers());
+
+    int pitch = 0;
+    fossil_cube_begin_frame(10, 10, 10, 255);
+    fossil_cube_fill_rect(0, 0, 4, 4, 255, 0, 0, 255);
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(1, test_held_count);
+    ASSUME_ITS_TRUE(fossil_cube_framebuffer(NULL, NULL, &pitch) != test_held[0]);
+
+    /* a retained frame on the next buffer still sees the previous one */
+    fossil_cube_begin_frame_retain();
+    fossil_cube_fill_rect(10, 10, 2, 2, 0, 255, 0, 255);
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(2, test_held_count);
+    const uint8_t* b = test_held[1];
+    ASSUME_ITS_EQUAL_I32(255, b[0]);
+    ASSUME_ITS_EQUAL_I32(255, b[(size_t)10 * (size_t)pitch + 10 * 4 + 1]);
+    ASSUME_ITS_EQUAL_I32(10, b[(size_t)20 * (size_t)pitch + 20 * 4]);
+    ASSUME_ITS_EQUAL_I32(255, test_held[0][0]);
+    ASSUME_ITS_EQUAL_I32(10, test_held[0][(size_t)10 * (size_t)pitch + 10 * 4 + 1]);
+
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_release_buffer(test_held[0]));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_release_buffer(test_held[0]));
+    fossil_cube_begin_frame_retain();
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(3, test_held_count);
+    ASSUME_ITS_TRUE(memcmp(test_held[1], test_held[2], (size_t)pitch * H) == 0);
+    ASSUME_ITS_TRUE(fossil_cube_framebuffer(NULL, NULL, NULL) == test_held[0]);
+
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_release_buffer(test_held[1]));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_release_buffer(test_held[2]));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_set_buffers(1));
+    ASSUME_ITS_EQUAL_I32(255, fossil_cube_framebuffer(NULL, NULL, NULL)[(size_t)10 * (size_t)pitch + 10 * 4 + 1]);
+}
+
+/* A consumer that never releases stalls nothing for longer than
+   FOSSIL_CUBE_RELEASE_TIMEOUT_MS */
+FOSSIL_TEST_CASE(c_test_swapchain_release_timeout) {
+    test_held_count = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(8, 8, test_present_hold, NULL));
+    const bool threads = fossil_cube_set_threads(2) == FOSSIL_CUBE_OK;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_set_buffers(2));
+    for (int frame = 0; frame < 2; ++frame) {
+        fossil_cube_begin_frame(0, 0, 0, 255);
+        fossil_cube_end_frame();
+    }
+    ASSUME_ITS_EQUAL_I32(2, test_held_count);
+    /* both were held: the second end_frame took the first one back */
+    ASSUME_ITS_TRUE(fossil_cube_framebuffer(NULL, NULL, NULL) == test_held[0]);
+    ASSUME_ITS_EQUAL_I32(threads ? FOSSIL_CUBE_ERR_TIMEOUT : FOSSIL_CUBE_OK, fossil_cube_get_error());
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_get_error());
+
+    /* the second is still held: nothing changes */
+    ASSUME_ITS_EQUAL_I32(threads ? FOSSIL_CUBE_ERR_TIMEOUT : FOSSIL_CUBE_OK, fossil_cube_set_buffers(1));
+    ASSUME_ITS_EQUAL_I32(threads ? 2 : 1, fossil_cube_get_buffers());
+    if (threads) {
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_TIMEOUT, fossil_cube_resize(9, 9));
+        ASSUME_ITS_EQUAL_I32(8, fossil_cube_width());
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_release_buffer(test_held[1]));
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_set_buffers(1));
+    }
+}
+
+FOSSIL_TEST_CASE(c_test_straight_and_premultiplied_alpha) {
+    int pitch = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(4, 1, test_present, NULL));
+    const uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ALPHA_STRAIGHT, fossil_cube_get_alpha());
+
+    /* straight white at half alpha over black lands at mid grey */
+    uint8_t px[4] = { 255, 255, 255, 128 };
+    fossil_cube_clear(0, 0, 0, 255);
+    fossil_cube_blit_rgba(0, 0, px, 1, 1, 4);
+    ASSUME_ITS_EQUAL_I32(128, fb[0]);
+    ASSUME_ITS_EQUAL_I32(255, fb[3]);
+    fossil_cube_fill_rect(1, 0, 1, 1, 255, 255, 255, 128);
+    ASSUME_ITS_EQUAL_I32(128, fb[4]);
+
+    /* the same coverage already premultiplied gives the same pixel */
+    fossil_cube_premultiply(px, 1, 1, 4);
+    ASSUME_ITS_EQUAL_I32(128, px[0]);
+    fossil_cube_blit_rgba_alpha(2, 0, px, 1, 1, 4, FOSSIL_CUBE_ALPHA_PREMULTIPLIED);
+    ASSUME_ITS_EQUAL_I32(128, fb[8]);
+    fossil_cube_set_alpha(FOSSIL_CUBE_ALPHA_PREMULTIPLIED);
+    fossil_cube_fill_rect(3, 0, 1, 1, 128, 128, 128, 128);
+    ASSUME_ITS_EQUAL_I32(128, fb[12]);
+
+    fossil_cube_unpremultiply(px, 1, 1, 4);
+    ASSUME_ITS_EQUAL_I32(255, px[0]);
+    ASSUME_ITS_EQUAL_I32(128, px[3]);
+}
+
+/* Every (value, alpha) pair through the blend, in all kernel sets, against
+   the reference rounding (v * (255 - a) + 127) / 255 */
+FOSSIL_TEST_CASE(c_test_blend_div255_exhaustive) {
+    const fossil_cube_simd best = fossil_cube_simd_level();
+    static uint8_t src[256 * 4];
+    int pitch = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(256, 256, test_present, NULL));
+    uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+
+    for (int level = FOSSIL_CUBE_SIMD_SCALAR; level <= FOSSIL_CUBE_SIMD_NEON; ++level) {
+        if (fossil_cube_set_simd_level((fossil_cube_simd)level) != FOSSIL_CUBE_OK) continue;
+        for (int pass = 0; pass < 3; ++pass) {
+            for (int y = 0; y < 256; ++y) {
+                for (int x = 0; x < 256; ++x) memset(fb + (size_t)y * (size_t)pitch + (size_t)x * 4, x, 4);
+            }
+            /* row y blends black at alpha y: fill, straight blit, premultiplied blit */
+            for (int y = 0; y < 256; ++y) {
+                if (pass == 0) {
+                    fossil_cube_fill_rect(0, y, 256, 1, 0, 0, 0, (uint8_t)y);
+                    continue;
+                }
+                for (int x = 0; x < 256; ++x) {
+                    src[x * 4 + 0] = src[x * 4 + 1] = src[x * 4 + 2] = 0;
+                    src[x * 4 + 3] = (uint8_t)y;
+                }
+                fossil_cube_blit_rgba_alpha(0, y, src, 256, 1, 256 * 4,
+                                            pass == 1 ? FOSSIL_CUBE_ALPHA_STRAIGHT : FOSSIL_CUBE_ALPHA_PREMULTIPLIED);
+            }
+            int bad = 0;
+            for (int y = 0; y < 256; ++y) {
+                for (int x = 0; x < 256; ++x) {
+                    const uint8_t* p = fb + (size_t)y * (size_t)pitch + (size_t)x * 4;
+                    const int want = (x * (255 - y) + 127) / 255;
+                    if (p[0] != want || p[1] != want || p[2] != want) ++bad;
+                    if (p[3] != y + want) ++bad;
+                }
+            }
+            ASSUME_ITS_EQUAL_I32(0, bad);
+        }
+    }
+    fossil_cube_set_simd_level(best);
+}
+
+FOSSIL_TEST_CASE(c_test_pixel_formats) {
+    enum { W = 80, H = 40, SW = 45, SH = 29 };
+    static uint8_t src[SW * SH * 4];
+    static uint8_t ref[W * H * 4];
+    static uint8_t got[W * H * 4];
+    fossil_cube_config cfg;
+    int pitch = 0;
+
+    test_rng = 5u;
+    test_make_src(src, SW, SH);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_present, NULL));
+    test_render_scene(ref, src, SW, SH);
+
+    /* BGRA8 renders the same scene with R and B swapped, no extra pass */
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.width = W;
+    cfg.height = H;
+    cfg.format = FOSSIL_CUBE_FORMAT_BGRA8;
+    cfg.present = test_present;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init_with(&cfg));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_FORMAT_BGRA8, fossil_cube_get_format());
+    test_render_scene(got, src, SW, SH);
+    int bad = 0;
+    for (int i = 0; i < W * H; ++i) {
+        if (got[i * 4 + 0] != ref[i * 4 + 2] || got[i * 4 + 1] != ref[i * 4 + 1] ||
+            got[i * 4 + 2] != ref[i * 4 + 0] || got[i * 4 + 3] != ref[i * 4 + 3]) ++bad;
+    }
+    ASSUME_ITS_EQUAL_I32(0, bad);
+
+    /* RGB565: two bytes per pixel, rounded to nearest */
+    cfg.format = FOSSIL_CUBE_FORMAT_RGB565;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init_with(&cfg));
+    const uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+    ASSUME_ITS_EQUAL_I32(W * 2, pitch);
+    ASSUME_ITS_EQUAL_I32(2, fossil_cube_format_bpp(FOSSIL_CUBE_FORMAT_RGB565));
+    fossil_cube_clear(255, 0, 0, 255);
+    fossil_cube_fill_rect(1, 0, 1, 1, 255, 255, 255, 128);
+    fossil_cube_draw_line(0, 1, W - 1, 1, 0, 0, 255, 255);
+    uint16_t v = 0;
+    memcpy(&v, fb, 2);
+    ASSUME_ITS_EQUAL_I32(0xF800, v);
+    memcpy(&v, fb + 2, 2);
+    ASSUME_ITS_EQUAL_I32((31 << 11) | (32 << 5) | 16, v); /* (255,128,128) */
+    memcpy(&v, fb + pitch + (W - 1) * 2, 2);
+    ASSUME_ITS_EQUAL_I32(0x001F, v);
+
+    /* A8 keeps coverage only */
+    cfg.format = FOSSIL_CUBE_FORMAT_A8;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init_with(&cfg));
+    fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+    ASSUME_ITS_EQUAL_I32(W, pitch);
+    fossil_cube_fill_rect(0, 0, 2, 1, 9, 9, 9, 128);
+    fossil_cube_fill_rect(1, 0, 1, 1, 9, 9, 9, 128);
+    ASSUME_ITS_EQUAL_I32(128, fb[0]);
+    ASSUME_ITS_EQUAL_I32(192, fb[1]);
+    ASSUME_ITS_EQUAL_I32(0, fb[2]);
+
+    cfg.format = (fossil_cube_format)99;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_init_with(&cfg));
+}
+
+static int test_allocs;
+
+static void* test_alloc(size_t size, size_t align, void* user) {
+    (void)user;
+    ++test_allocs;
+    void* p = malloc(size + align);
+    if (!p) return NULL;
+    /* keep the raw pointer just below the aligned block */
+    uint8_t* a = (uint8_t*)p + sizeof(void*);
+    a += (align - (uintptr_t)a % align) % align;
+    memcpy(a - sizeof(void*), &p, sizeof(p));
+    return a;
+}
+
+static void test_free(void* ptr, size_t size, void* user) {
+    (void)size; (void)user;
+    --test_allocs;
+    void* p;
+    memcpy(&p, (uint8_t*)ptr - sizeof(void*), sizeof(p));
+    free(p);
+}
+
+FOSSIL_TEST_CASE(c_test_framebuffer_memory) {
+    fossil_cube_config cfg;
+    int pitch = 0;
+
+    /* default: aligned base, tight rows */
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(13, 5, test_present, NULL));
+    uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+    ASSUME_ITS_TRUE((uintptr_t)fb % FOSSIL_CUBE_DEFAULT_ALIGN == 0);
+    ASSUME_ITS_EQUAL_I32(13 * 4, pitch);
+
+    /* padded rows through an allocator hook */
+    const fossil_cube_allocator al = { test_alloc, test_free, NULL };
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.width = 13;
+    cfg.height = 5;
+    cfg.present = test_present;
+    cfg.pad_rows = true;
+    cfg.align = 128;
+    cfg.allocator = &al;
+    cfg.clear_on_resize = true;
+    test_allocs = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init_with(&cfg));
+    ASSUME_ITS_EQUAL_I32(1, test_allocs);
+    fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+    ASSUME_ITS_EQUAL_I32(128, pitch);
+    ASSUME_ITS_TRUE((uintptr_t)fb % 128 == 0);
+    fossil_cube_fill_rect(0, 0, 13, 5, 1, 2, 3, 255);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_resize(40, 3));
+    fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+    ASSUME_ITS_EQUAL_I32(256, pitch);
+    ASSUME_ITS_EQUAL_I32(0, fb[0]);
+    ASSUME_ITS_EQUAL_I32(1, test_allocs);
+    fossil_cube_shutdown();
+    ASSUME_ITS_EQUAL_I32(0, test_allocs);
+
+    /* caller memory is drawn into in place and left alone on shutdown */
+    static uint32_t ext_words[8 * 6]; /* whole, aligned pixels */
+    uint8_t* ext = (uint8_t*)ext_words;
+    memset(ext, 0xEE, sizeof(ext_words));
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.width = 5;
+    cfg.height = 8;
+    cfg.pitch = 24;
+    cfg.pixels = ext;
+    cfg.present = test_present;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init_with(&cfg));
+    ASSUME_ITS_TRUE(fossil_cube_framebuffer(NULL, NULL, &pitch) == ext);
+    ASSUME_ITS_EQUAL_I32(24, pitch);
+    fossil_cube_clear(7, 7, 7, 255);
+    ASSUME_ITS_EQUAL_I32(7, ext[4 * 4]);     /* last pixel of row 0 */
+    ASSUME_ITS_EQUAL_I32(0xEE, ext[5 * 4]);  /* row padding untouched */
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_resize(6, 6));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_set_buffers(2));
+
+    static uint32_t ext2_words[4 * 4 + 1];
+    uint8_t* ext2 = (uint8_t*)ext2_words;
+    /* a pixel split across words, or rows that split one, are refused */
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_attach(ext2 + 1, 4, 4, 0));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_attach(ext2, 3, 4, 13));
+    cfg.pitch = 22;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_init_with(&cfg));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_attach(ext2, 4, 4, 0));
+    ASSUME_ITS_EQUAL_I32(4, fossil_cube_width());
+    fossil_cube_put_pixel(3, 3, 9, 9, 9, 255);
+    ASSUME_ITS_EQUAL_I32(9, ext2[4 * 4 * 4 - 4]);
+    fossil_cube_shutdown();
+    ASSUME_ITS_EQUAL_I32(7, ext[0]);
+}
+
+FOSSIL_TEST_CASE(c_test_image_atlas_runs) {
+    enum { SW = 40, SH = 12 };
+    static uint8_t src[SW * SH * 4];
+    static uint8_t pre[SW * SH * 4];
+    test_make_src(src, SW, SH);
+    memcpy(pre, src, sizeof(src));
+    fossil_cube_premultiply(pre, SW, SH, SW * 4);
+
+    fossil_cube_image* atlas = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_image_create(&atlas, src, SW, SH, 0,
+                                                                  FOSSIL_CUBE_ALPHA_STRAIGHT));
+    ASSUME_ITS_EQUAL_I32(SW, fossil_cube_image_width(atlas));
+
+    /* run-skipping draws match a premultiplied blit of the same pixels */
+    const fossil_cube_format formats[] = { FOSSIL_CUBE_FORMAT_RGBA8, FOSSIL_CUBE_FORMAT_BGRA8 };
+    for (int f = 0; f < 2; ++f) {
+        for (int deferred = 0; deferred < 2; ++deferred) {
+            fossil_cube_ctx* a = NULL;
+            fossil_cube_ctx* b = NULL;
+            fossil_cube_config cfg;
+            memset(&cfg, 0, sizeof(cfg));
+            cfg.width = 48;
+            cfg.height = 20;
+            cfg.format = formats[f];
+            ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&a, &cfg));
+            ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&b, &cfg));
+            fossil_cube_ctx* both[2] = { a, b };
+            for (int k = 0; k < 2; ++k) {
+                if (deferred) fossil_cube_set_mode_ex(both[k], FOSSIL_CUBE_MODE_DEFERRED);
+                fossil_cube_begin_frame_ex(both[k], 30, 60, 90, 255);
+            }
+            fossil_cube_draw_image_ex(a, atlas, -3, 2);
+            fossil_cube_blit_rgba_alpha_ex(b, -3, 2, pre, SW, SH, SW * 4, FOSSIL_CUBE_ALPHA_PREMULTIPLIED);
+            /* atlas cell spanning the opaque/transparent/translucent edges */
+            fossil_cube_draw_image_rect_ex(a, atlas, 6, 3, 20, 7, 25, 11);
+            fossil_cube_blit_rgba_alpha_ex(b, 25, 11, pre + (3 * SW + 6) * 4, 20, 7, SW * 4,
+                                           FOSSIL_CUBE_ALPHA_PREMULTIPLIED);
+            /* source rect clamped to the image */
+            fossil_cube_draw_image_rect_ex(a, atlas, -2, 10, 5, 9, 1, 1);
+            fossil_cube_blit_rgba_alpha_ex(b, 3, 1, pre + (10 * SW) * 4, 3, 2, SW * 4,
+                                           FOSSIL_CUBE_ALPHA_PREMULTIPLIED);
+            fossil_cube_end_frame_ex(a);
+            fossil_cube_end_frame_ex(b);
+            int pitch = 0;
+            const uint8_t* pa = fossil_cube_framebuffer_ex(a, NULL, NULL, &pitch);
+            const uint8_t* pb = fossil_cube_framebuffer_ex(b, NULL, NULL, NULL);
+            ASSUME_ITS_TRUE(memcmp(pa, pb, (size_t)pitch * 20u) == 0);
+            fossil_cube_ctx_destroy(a);
+            fossil_cube_ctx_destroy(b);
+        }
+    }
+
+    /* update reclassifies: an opaque patch now covers the transparent run */
+    static uint8_t patch[4 * 2 * 4];
+    memset(patch, 0xFF, sizeof(patch));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_image_update(atlas, 10, 0, patch, 4, 2, 0,
+                                                                  FOSSIL_CUBE_ALPHA_STRAIGHT));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_image_update(atlas, SW - 2, 0, patch, 4, 2, 0,
+                                                                           FOSSIL_CUBE_ALPHA_STRAIGHT));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(SW, SH, test_present, NULL));
+    fossil_cube_begin_frame(0, 0, 0, 255);
+    fossil_cube_draw_image(atlas, 0, 0);
+    fossil_cube_end_frame();
+    const uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, NULL);
+    ASSUME_ITS_EQUAL_I32(255, fb[(1 * SW + 12) * 4 + 1]);
+    ASSUME_ITS_EQUAL_I32(0, fb[(2 * SW + 12) * 4 + 1]);
+    fossil_cube_image_destroy(atlas);
+}
+
+static int test_glyph_calls;
+
+/* 3x4 box per glyph, coverage rising with the codepoint */
+static bool test_glyph(uint32_t cp, int size, fossil_cube_glyph* out, void* userdata) {
+    static uint8_t cov[3 * 4];
+    (void)userdata;
+    ++test_glyph_calls;
+    if (cp == 'x') return false;
+    memset(cov, (int)(cp & 0xFFu), sizeof(cov));
+    out->coverage = cov;
+    out->width = 3;
+    out->height = 4;
+    out->pitch = 3;
+    out->bearing_x = 1;
+    out->bearing_y = 4;
+    out->advance = size / 2;
+    return true;
+}
+
+FOSSIL_TEST_CASE(c_test_text_glyph_cache) {
+    fossil_cube_font* font = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_font_create(&font, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(18, fossil_cube_text_width(font, "Hi\nabc", 10));
+    ASSUME_ITS_EQUAL_I32(24, fossil_cube_text_width(font, "ab", 20));
+
+    /* built-in font: 'H' is #...# on its top row, 7 rows above the baseline */
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(40, 24, test_present, NULL));
+    fossil_cube_begin_frame(0, 0, 0, 255);
+    ASSUME_ITS_EQUAL_I32(14, fossil_cube_draw_text(font, 2, 10, "H\xff", 10, 255, 255, 255, 255));
+    fossil_cube_end_frame();
+    int pitch = 0;
+    const uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+    ASSUME_ITS_EQUAL_I32(255, fb[3 * pitch + 2 * 4]);
+    ASSUME_ITS_EQUAL_I32(0, fb[3 * pitch + 3 * 4]);
+    ASSUME_ITS_EQUAL_I32(255, fb[6 * pitch + 4 * 4]); /* crossbar */
+    ASSUME_ITS_EQUAL_I32(255, fb[3 * pitch + 9 * 4]); /* invalid byte drew '?' */
+    fossil_cube_shutdown();
+    fossil_cube_font_destroy(font);
+
+    /* callback glyphs are rasterized once per (codepoint, size) */
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_font_create(&font, test_glyph, NULL));
+    test_glyph_calls = 0;
+    fossil_cube_ctx* a = NULL;
+    fossil_cube_ctx* b = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&a, 32, 16, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&b, 32, 16, NULL, NULL));
+    fossil_cube_set_mode_ex(b, FOSSIL_CUBE_MODE_DEFERRED);
+    fossil_cube_begin_frame_ex(a, 10, 10, 10, 255);
+    fossil_cube_begin_frame_ex(b, 10, 10, 10, 255);
+    ASSUME_ITS_EQUAL_I32(12, fossil_cube_draw_text_ex(a, font, 0, 6, "\x80\xc0x\xe0", 8, 255, 0, 0, 255));
+    fossil_cube_draw_text_ex(b, font, 0, 6, "\x80\xc0x\xe0", 8, 255, 0, 0, 255);
+    ASSUME_ITS_EQUAL_I32(2, test_glyph_calls); /* U+FFFD and the missing 'x' */
+    fossil_cube_draw_text_ex(a, font, 3, 14, "AB\nBA", 8, 0, 0, 255, 160);
+    fossil_cube_draw_text_ex(b, font, 3, 14, "AB\nBA", 8, 0, 0, 255, 160);
+    ASSUME_ITS_EQUAL_I32(4, test_glyph_calls);
+    fossil_cube_end_frame_ex(a);
+    fossil_cube_end_frame_ex(b);
+    const uint8_t* pa = fossil_cube_framebuffer_ex(a, NULL, NULL, &pitch);
+    ASSUME_ITS_TRUE(memcmp(pa, fossil_cube_framebuffer_ex(b, NULL, NULL, NULL), (size_t)pitch * 16u) == 0);
+    ASSUME_ITS_EQUAL_I32(10 + (255 - 10) * 0xFD / 255, pa[(3 * 32 + 1) * 4]);
+
+    /* over its limit the cache is only dropped by font_trim, never under a
+       deferred frame still drawing from it */
+    uint8_t ref[32 * 16 * 4];
+    memcpy(ref, pa, sizeof(ref));
+    fossil_cube_font_set_cache_limit(font, 1);
+    test_glyph_calls = 0;
+    fossil_cube_begin_frame_ex(b, 10, 10, 10, 255);
+    fossil_cube_draw_text_ex(b, font, 0, 6, "\x80\xc0x\xe0", 8, 255, 0, 0, 255);
+    fossil_cube_draw_text_ex(b, font, 3, 14, "AB\nBA", 8, 0, 0, 255, 160);
+    fossil_cube_end_frame_ex(b);
+    ASSUME_ITS_EQUAL_I32(0, test_glyph_calls);
+    ASSUME_ITS_TRUE(memcmp(ref, fossil_cube_framebuffer_ex(b, NULL, NULL, NULL), sizeof(ref)) == 0);
+    fossil_cube_font_trim(font);
+    fossil_cube_draw_text_ex(a, font, 3, 14, "AB", 8, 0, 0, 255, 160);
+    ASSUME_ITS_EQUAL_I32(2, test_glyph_calls);
+    fossil_cube_font_set_cache_limit(font, 0);
+    fossil_cube_font_trim(font);
+    fossil_cube_draw_text_ex(a, font, 3, 14, "BA", 8, 0, 0, 255, 160);
+    ASSUME_ITS_EQUAL_I32(2, test_glyph_calls);
+    fossil_cube_ctx_destroy(a);
+    fossil_cube_ctx_destroy(b);
+    fossil_cube_font_destroy(font);
+}
+
+FOSSIL_TEST_CASE(c_test_blit_scaled) {
+    enum { SW = 45, SH = 29, W = 600, H = 40 };
+    static uint8_t src[SW * SH * 4];
+    static uint8_t ref[W * H * 4];
+    test_rng = 5u;
+    test_make_src(src, SW, SH);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_present, NULL));
+    int pitch = 0;
+    const uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+
+    /* 1:1 nearest is a plain blit */
+    fossil_cube_begin_frame(30, 60, 90, 255);
+    fossil_cube_blit_rgba(-4, 3, src, SW, SH, SW * 4);
+    fossil_cube_end_frame();
+    memcpy(ref, fb, sizeof(ref));
+    fossil_cube_begin_frame(30, 60, 90, 255);
+    fossil_cube_blit_scaled(-4, 3, SW, SH, src, SW, SH, SW * 4, FOSSIL_CUBE_FILTER_NEAREST);
+    fossil_cube_end_frame();
+    ASSUME_ITS_TRUE(memcmp(ref, fb, sizeof(ref)) == 0);
+
+    /* ... and so is 1:1 bilinear once the source is premultiplied */
+    fossil_cube_set_alpha(FOSSIL_CUBE_ALPHA_PREMULTIPLIED);
+    static uint8_t pre[SW * SH * 4];
+    memcpy(pre, src, sizeof(pre));
+    fossil_cube_premultiply(pre, SW, SH, SW * 4);
+    fossil_cube_begin_frame(30, 60, 90, 255);
+    fossil_cube_blit_rgba(5, -2, pre, SW, SH, SW * 4);
+    fossil_cube_end_frame();
+    memcpy(ref, fb, sizeof(ref));
+    fossil_cube_begin_frame(30, 60, 90, 255);
+    fossil_cube_blit_scaled(5, -2, SW, SH, pre, SW, SH, SW * 4, FOSSIL_CUBE_FILTER_BILINEAR);
+    fossil_cube_end_frame();
+    ASSUME_ITS_TRUE(memcmp(ref, fb, sizeof(ref)) == 0);
+    fossil_cube_set_alpha(FOSSIL_CUBE_ALPHA_STRAIGHT);
+
+    /* 2x nearest replicates every source pixel into a 2x2 block */
+    fossil_cube_begin_frame(0, 0, 0, 255);
+    fossil_cube_blit_scaled(0, 0, 18, 20, src, 9, 10, SW * 4, FOSSIL_CUBE_FILTER_NEAREST);
+    fossil_cube_end_frame();
+    bool same = true;
+    for (int y = 0; y < 20; ++y)
+        for (int x = 0; x < 18; ++x)
+            same = same && memcmp(fb + y * pitch + x * 4, src + ((y / 2) * SW + x / 2) * 4, 4) == 0;
+    ASSUME_ITS_TRUE(same);
+
+    /* bilinear across a flat opaque color stays exactly that color */
+    static uint8_t flat[4 * 3 * 4];
+    for (int i = 0; i < 12; ++i) {
+        flat[i * 4 + 0] = 17; flat[i * 4 + 1] = 201; flat[i * 4 + 2] = 99; flat[i * 4 + 3] = 255;
+    }
+    fossil_cube_begin_frame(0, 0, 0, 255);
+    fossil_cube_blit_scaled(3, 2, 37, 11, flat, 4, 3, 16, FOSSIL_CUBE_FILTER_BILINEAR);
+    fossil_cube_end_frame();
+    same = true;
+    for (int y = 2; y < 13; ++y)
+        for (int x = 3; x < 40; ++x) same = same && memcmp(fb + y * pitch + x * 4, flat, 4) == 0;
+    ASSUME_ITS_TRUE(same);
+    ASSUME_ITS_EQUAL_I32(0, fb[2 * pitch + 40 * 4 + 1]);
+
+    /* strips wider than the stack buffer, clipped, deferred over tiles */
+    fossil_cube_begin_frame(10, 10, 10, 255);
+    fossil_cube_set_clip(3, 1, 590, 37);
+    fossil_cube_blit_scaled(-20, -5, 640, 50, src, SW, SH, SW * 4, FOSSIL_CUBE_FILTER_BILINEAR);
+    fossil_cube_blit_scaled(100, 4, 300, 9, src, SW, SH, SW * 4, FOSSIL_CUBE_FILTER_NEAREST);
+    fossil_cube_end_frame();
+    memcpy(ref, fb, sizeof(ref));
+    fossil_cube_set_mode(FOSSIL_CUBE_MODE_DEFERRED);
+    (void)fossil_cube_set_threads(3);
+    fossil_cube_begin_frame(10, 10, 10, 255);
+    fossil_cube_set_clip(3, 1, 590, 37);
+    fossil_cube_blit_scaled(-20, -5, 640, 50, src, SW, SH, SW * 4, FOSSIL_CUBE_FILTER_BILINEAR);
+    fossil_cube_blit_scaled(100, 4, 300, 9, src, SW, SH, SW * 4, FOSSIL_CUBE_FILTER_NEAREST);
+    fossil_cube_end_frame();
+    ASSUME_ITS_TRUE(memcmp(ref, fb, sizeof(ref)) == 0);
+}
+
+FOSSIL_TEST_CASE(c_test_aa_shapes) {
+    enum { W = 300, H = 200 };
+    static uint8_t ref[W * H * 4];
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_present, NULL));
+    int pitch = 0;
+    const uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+
+    /* a pixel-aligned polygon covers its pixels fully: same as fill_rect */
+    fossil_cube_begin_frame(20, 40, 60, 255);
+    fossil_cube_fill_rect(3, 4, 70, 9, 200, 100, 50, 128);
+    fossil_cube_end_frame();
+    memcpy(ref, fb, sizeof(ref));
+    const float quad[] = { 3.0f, 4.0f, 73.0f, 4.0f, 73.0f, 13.0f, 3.0f, 13.0f };
+    fossil_cube_begin_frame(20, 40, 60, 255);
+    fossil_cube_fill_polygon(quad, 4, 200, 100, 50, 128);
+    fossil_cube_end_frame();
+    ASSUME_ITS_TRUE(memcmp(ref, fb, sizeof(ref)) == 0);
+
+    /* half a pixel column, and a 1-wide line on a pixel center row */
+    fossil_cube_begin_frame(0, 0, 0, 255);
+    fossil_cube_fill_rounded_rect(2.0f, 2.0f, 4.5f, 3.0f, 0.0f, 255, 255, 255, 255);
+    fossil_cube_draw_line_aa(10.0f, 20.5f, 30.0f, 20.5f, 1.0f, 255, 255, 255, 255);
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(255, fb[3 * pitch + 5 * 4]);
+    ASSUME_ITS_EQUAL_I32(128, fb[3 * pitch + 6 * 4]);
+    ASSUME_ITS_EQUAL_I32(0, fb[3 * pitch + 7 * 4]);
+    ASSUME_ITS_EQUAL_I32(255, fb[20 * pitch + 15 * 4]);
+    ASSUME_ITS_EQUAL_I32(0, fb[19 * pitch + 15 * 4]);
+    ASSUME_ITS_EQUAL_I32(0, fb[21 * pitch + 15 * 4]);
+
+    /* total coverage of a circle is its area */
+    fossil_cube_begin_frame(0, 0, 0, 255);
+    fossil_cube_fill_circle(100.3f, 80.6f, 40.0f, 255, 255, 255, 255);
+    fossil_cube_end_frame();
+    long long sum = 0;
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x) sum += fb[y * pitch + x * 4];
+    const double area = (double)sum / 255.0;
+    ASSUME_ITS_TRUE(area > 5026.5 * 0.998 && area < 5026.5 * 1.002);
+    ASSUME_ITS_EQUAL_I32(255, fb[80 * pitch + 100 * 4]);
+
+    /* overlapping parts of one shape blend once */
+    const float cross[] = { 10.0f, 10.0f, 60.0f, 60.0f, 60.0f, 10.0f, 10.0f, 60.0f };
+    fossil_cube_begin_frame(0, 0, 0, 255);
+    fossil_cube_draw_polyline(cross, 4, 6.0f, 255, 0, 0, 128);
+    fossil_cube_end_frame();
+    ASSUME_ITS_EQUAL_I32(128, fb[35 * pitch + 35 * 4]); /* crossing */
+    ASSUME_ITS_EQUAL_I32(128, fb[60 * pitch + 60 * 4]); /* round join */
+    ASSUME_ITS_EQUAL_I32(128, fb[20 * pitch + 20 * 4]);
+
+    /* a long chart polyline, deferred over tiles, matches immediate */
+    static float chart[2 * 2000];
+    for (int i = 0; i < 2000; ++i) {
+        chart[2 * i] = -10.0f + (float)i * 0.16f;
+        chart[2 * i + 1] = 100.0f + 90.0f * (float)((i * 7919) % 101 - 50) / 50.0f;
+    }
+    for (int deferred = 0; deferred < 2; ++deferred) {
+        if (deferred) {
+            fossil_cube_set_mode(FOSSIL_CUBE_MODE_DEFERRED);
+            (void)fossil_cube_set_threads(3);
+        }
+        fossil_cube_begin_frame(8, 8, 8, 255);
+        fossil_cube_set_clip(5, 3, 280, 190);
+        fossil_cube_draw_polyline(chart, 2000, 1.25f, 90, 250, 120, 220);
+        fossil_cube_fill_rounded_rect(150.5f, 40.25f, 120.0f, 70.0f, 18.0f, 255, 255, 255, 100);
+        fossil_cube_end_frame();
+        if (!deferred) memcpy(ref, fb, sizeof(ref));
+    }
+    ASSUME_ITS_TRUE(memcmp(ref, fb, sizeof(ref)) == 0);
+}
+
+FOSSIL_TEST_CASE(c_test_axis_lines_fast_paths) {
+    /* axis lines, hline/vline and outlines hit the same pixels as per-pixel
+       drawing, every pixel blended exactly once */
+    const fossil_cube_format formats[] = {
+        FOSSIL_CUBE_FORMAT_RGBA8, FOSSIL_CUBE_FORMAT_BGRA8, FOSSIL_CUBE_FORMAT_RGB565
+    };
+    for (int f = 0; f < 3; ++f) {
+        for (int deferred = 0; deferred < 2; ++deferred) {
+            fossil_cube_ctx* a = NULL;
+            fossil_cube_ctx* b = NULL;
+            fossil_cube_config cfg;
+            memset(&cfg, 0, sizeof(cfg));
+            cfg.width = 90;
+            cfg.height = 70;
+            cfg.format = formats[f];
+            ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&a, &cfg));
+            ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&b, &cfg));
+            fossil_cube_ctx* both[2] = { a, b };
+            for (int k = 0; k < 2; ++k) {
+                if (deferred) fossil_cube_set_mode_ex(both[k], FOSSIL_CUBE_MODE_DEFERRED);
+                fossil_cube_begin_frame_ex(both[k], 30, 60, 90, 255);
+                fossil_cube_set_clip_ex(both[k], 2, 1, 80, 66);
+            }
+            /* reversed, clipped on both ends */
+            fossil_cube_draw_line_ex(b, 85, 5, -10, 5, 200, 10, 40, 128);
+            for (int x = -10; x <= 85; ++x) fossil_cube_put_pixel_ex(a, x, 5, 200, 10, 40, 128);
+            fossil_cube_draw_line_ex(b, 7, 80, 7, -3, 10, 220, 40, 255);
+            for (int y = -3; y <= 80; ++y) fossil_cube_put_pixel_ex(a, 7, y, 10, 220, 40, 255);
+            fossil_cube_draw_line_ex(b, 9, 9, 9, 9, 255, 255, 255, 90);
+            fossil_cube_put_pixel_ex(a, 9, 9, 255, 255, 255, 90);
+            fossil_cube_draw_hline_ex(b, 20, 30, 40, 5, 5, 250, 77);
+            for (int x = 20; x < 60; ++x) fossil_cube_put_pixel_ex(a, x, 30, 5, 5, 250, 77);
+            fossil_cube_draw_vline_ex(b, 40, 10, 50, 90, 90, 0, 211);
+            for (int y = 10; y < 60; ++y) fossil_cube_put_pixel_ex(a, 40, y, 90, 90, 0, 211);
+            /* translucent outline over the lines above, and degenerate ones */
+            const int rects[][4] = { { 12, 12, 30, 20 }, { 50, 40, 1, 9 }, { 60, 20, 8, 1 },
+                                     { 70, 50, 2, 2 }, { 30, 50, 5, 3 } };
+            for (int r = 0; r < 5; ++r) {
+                const int x = rects[r][0], y = rects[r][1], w = rects[r][2], h = rects[r][3];
+                fossil_cube_draw_rect_ex(b, x, y, w, h, 240, 120, 0, 128);
+                for (int yy = y; yy < y + h; ++yy)
+                    for (int xx = x; xx < x + w; ++xx)
+                        if (yy == y || yy == y + h - 1 || xx == x || xx == x + w - 1)
+                            fossil_cube_put_pixel_ex(a, xx, yy, 240, 120, 0, 128);
+            }
+            fossil_cube_end_frame_ex(a);
+            fossil_cube_end_frame_ex(b);
+            int pitch = 0;
+            const uint8_t* pa = fossil_cube_framebuffer_ex(a, NULL, NULL, &pitch);
+            const uint8_t* pb = fossil_cube_framebuffer_ex(b, NULL, NULL, NULL);
+            ASSUME_ITS_TRUE(memcmp(pa, pb, (size_t)pitch * 70u) == 0);
+            fossil_cube_ctx_destroy(a);
+            fossil_cube_ctx_destroy(b);
+        }
+    }
+}
+
+FOSSIL_TEST_CASE(c_test_frame_arena) {
+    enum { W = 160, H = 120 };
+    static uint8_t ref[W * H * 4];
+    static float chart[600 * 2];
+    for (int i = 0; i < 600; ++i) {
+        chart[i * 2 + 0] = (float)i * 0.25f;
+        chart[i * 2 + 1] = 60.0f + (float)((i * 37) % 50) - 25.0f;
+    }
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_present, NULL));
+    int pitch = 0;
+    const uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+    fossil_cube_cmdbuf* buf = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_cmdbuf_create(&buf));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_record_begin(buf));
+    fossil_cube_fill_circle(120.0f, 30.0f, 17.0f, 0, 200, 90, 180);
+    fossil_cube_record_end();
+
+    /* immediate shapes hand their record back right away */
+    fossil_cube_arena_stats st;
+    fossil_cube_begin_frame(5, 5, 5, 255);
+    fossil_cube_draw_polyline(chart, 600, 1.5f, 250, 200, 20, 255);
+    fossil_cube_get_arena_stats(&st);
+    ASSUME_ITS_TRUE(st.used == 0 && st.peak > 0);
+    fossil_cube_replay(buf);
+    fossil_cube_end_frame();
+    memcpy(ref, fb, sizeof(ref));
+
+    /* deferred: after the first frames settle, no more blocks are taken */
+    fossil_cube_set_mode(FOSSIL_CUBE_MODE_DEFERRED);
+    uint64_t allocs = 0;
+    for (int frame = 0; frame < 6; ++frame) {
+        fossil_cube_begin_frame(5, 5, 5, 255);
+        for (int k = 0; k < 1 + (frame < 3 ? frame * 20 : 40); ++k)
+            fossil_cube_fill_circle(-100.0f, 60.0f, 3.0f + (float)k, 1, 2, 3, 255);
+        fossil_cube_draw_polyline(chart, 600, 1.5f, 250, 200, 20, 255);
+        fossil_cube_replay(buf);
+        fossil_cube_get_arena_stats(&st);
+        ASSUME_ITS_TRUE(st.used > 0 && st.used <= st.reserved);
+        fossil_cube_end_frame();
+        ASSUME_ITS_TRUE(memcmp(ref, fb, sizeof(ref)) == 0);
+        if (frame == 3) allocs = st.block_allocs;
+    }
+    fossil_cube_get_arena_stats(&st);
+    ASSUME_ITS_TRUE(allocs > 0 && st.block_allocs == allocs);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_DEFAULT_ARENA_LIMIT, st.limit);
+
+    /* above the limit a frame still draws, then gives its memory back */
+    fossil_cube_set_arena_limit(1024);
+    fossil_cube_begin_frame(5, 5, 5, 255);
+    fossil_cube_draw_polyline(chart, 600, 1.5f, 250, 200, 20, 255);
+    fossil_cube_replay(buf);
+    fossil_cube_end_frame();
+    ASSUME_ITS_TRUE(memcmp(ref, fb, sizeof(ref)) == 0);
+    fossil_cube_get_arena_stats(&st);
+    ASSUME_ITS_TRUE(st.reserved == 0 && st.limit == 1024);
+    fossil_cube_cmdbuf_destroy(buf);
+}
+
+static int test_stats_presents = 0;
+
+static void test_stats_present(const uint8_t* pixels, int width, int height, int pitch, void* userdata) {
+    (void)pixels; (void)width; (void)height; (void)pitch; (void)userdata;
+    ++test_stats_presents;
+}
+
+FOSSIL_TEST_CASE(c_test_frame_stats) {
+    enum { W = 100, H = 80 };
+    static uint8_t src[4 * 3 * 4];
+    for (int i = 0; i < 12; ++i) {
+        src[i * 4 + 0] = 200; src[i * 4 + 1] = 10; src[i * 4 + 2] = 10;
+        src[i * 4 + 3] = i < 6 ? 255 : 0;
+    }
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_stats_present, NULL));
+    fossil_cube_stats st;
+    const fossil_cube_result res = fossil_cube_get_stats(&st);
+    if (res == FOSSIL_CUBE_ERR_UNSUPPORTED) { /* built without with_stats */
+        ASSUME_ITS_TRUE(st.frames == 0);
+        return;
+    }
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, res);
+    fossil_cube_font* font = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_font_create(&font, NULL, NULL));
+
+    /* the same frame counts the same pixels serially and on tiles */
+    for (int threads = 1; threads <= 4; threads += 3) {
+        fossil_cube_reset_stats();
+        test_stats_presents = 0;
+        fossil_cube_set_mode(threads > 1 ? FOSSIL_CUBE_MODE_DEFERRED : FOSSIL_CUBE_MODE_IMMEDIATE);
+        (void)fossil_cube_set_threads(threads);
+        fossil_cube_begin_frame(0, 0, 0, 255);
+        fossil_cube_fill_rect(-5, 10, 30, 4, 255, 255, 255, 255); /* 25 x 4 visible */
+        fossil_cube_fill_rect(70, 70, 20, 20, 255, 255, 255, 128); /* 20 x 10 */
+        fossil_cube_draw_line(0, 0, 9, 3, 255, 0, 0, 255);
+        fossil_cube_blit_rgba(50, 2, src, 4, 3, 16);
+        fossil_cube_set_clip(0, 0, 1, 1);
+        fossil_cube_fill_rect(0, 0, 50, 50, 9, 9, 9, 255); /* 1 pixel */
+        fossil_cube_set_clip(0, 0, 0, 0);
+        fossil_cube_draw_text(font, 2, 40, "Hi!", 10, 255, 255, 255, 255); /* one run of 3 5x9 glyphs */
+        fossil_cube_end_frame();
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_get_stats(&st));
+        ASSUME_ITS_TRUE(st.frames == 1 && test_stats_presents == 1);
+        const fossil_cube_prim_stats* clr = &st.prim[FOSSIL_CUBE_PRIM_CLEAR];
+        const fossil_cube_prim_stats* fill = &st.prim[FOSSIL_CUBE_PRIM_FILL];
+        const fossil_cube_prim_stats* line = &st.prim[FOSSIL_CUBE_PRIM_LINE];
+        const fossil_cube_prim_stats* blit = &st.prim[FOSSIL_CUBE_PRIM_BLIT];
+        ASSUME_ITS_TRUE(clr->calls == 1 && clr->copied == W * H && clr->blended == 0);
+        ASSUME_ITS_TRUE(fill->calls == 3 && fill->copied == 101 && fill->blended == 200);
+        ASSUME_ITS_TRUE(fill->pixels == fill->copied + fill->blended);
+        ASSUME_ITS_TRUE(line->calls == 1 && line->copied == 10);
+        ASSUME_ITS_TRUE(blit->calls == 1 && blit->blended == 12);
+        ASSUME_ITS_TRUE(st.prim[FOSSIL_CUBE_PRIM_MASK].calls == 1 && st.prim[FOSSIL_CUBE_PRIM_MASK].blended == 3 * 45);
+        ASSUME_ITS_TRUE(st.frame.count == 1 && st.present.count == 1);
+        ASSUME_ITS_TRUE(st.frame.max_ns >= st.present.max_ns && st.frame.total_ns == st.frame.last_ns);
+        ASSUME_ITS_TRUE(st.render.count == (threads > 1 ? 1u : 0u));
+    }
+    fossil_cube_reset_stats();
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_get_stats(&st));
+    ASSUME_ITS_TRUE(st.frames == 0 && st.prim[FOSSIL_CUBE_PRIM_FILL].calls == 0);
+    fossil_cube_font_destroy(font);
+}
+
+FOSSIL_TEST_CASE(c_test_shm_present_zero_copy) {
+    fossil_cube_shm* prod = NULL;
+    fossil_cube_shm* cons = NULL;
+    fossil_cube_ctx* ctx = NULL;
+    fossil_cube_shm_frame frame;
+    fossil_cube_config cfg;
+
+    const fossil_cube_result res = fossil_cube_shm_create(&prod, NULL, 9, 6, FOSSIL_CUBE_FORMAT_BGRA8, 2);
+    if (res == FOSSIL_CUBE_ERR_UNSUPPORTED) return; /* -Dwith_shm=disabled */
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, res);
+    memset(&cfg, 0, sizeof(cfg));
+    fossil_cube_shm_config(prod, &cfg);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&ctx, &cfg));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_shm_bind(prod, ctx));
+    ASSUME_ITS_EQUAL_I32(2, fossil_cube_get_buffers_ex(ctx));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_shm_open_fd(&cons, fossil_cube_shm_fd(prod)));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_NOTINIT, fossil_cube_shm_acquire(cons, &frame, 0));
+
+#if !defined(_WIN32)
+    /* a header whose pitch is narrower than a row is refused */
+    const int fd = fossil_cube_shm_fd(prod);
+    int32_t hdr[64];
+    if (fd >= 0 && pread(fd, hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr)) {
+        int at = 0;
+        while (at + 2 < 64 && !(hdr[at] == 9 && hdr[at + 1] == 6)) ++at; /* width, height, pitch */
+        ASSUME_ITS_TRUE(at + 2 < 64);
+        const int32_t pitch = hdr[at + 2], bad = 4;
+        fossil_cube_shm* broken = NULL;
+        ASSUME_ITS_TRUE(pwrite(fd, &bad, sizeof(bad), (off_t)(at + 2) * 4) == (ssize_t)sizeof(bad));
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_shm_open_fd(&broken, fd));
+        ASSUME_ITS_CNULL(broken);
+        ASSUME_ITS_TRUE(pwrite(fd, &pitch, sizeof(pitch), (off_t)(at + 2) * 4) == (ssize_t)sizeof(pitch));
+    }
+#endif
+
+    /* frame 0: full clear, read straight out of the mapping */
+    fossil_cube_begin_frame_ex(ctx, 200, 0, 0, 255);
+    fossil_cube_end_frame_ex(ctx);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_shm_acquire(cons, &frame, 100));
+    ASSUME_ITS_TRUE(frame.sequence == 0);
+    ASSUME_ITS_EQUAL_I32(9, frame.width);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_FORMAT_BGRA8, frame.format);
+    ASSUME_ITS_EQUAL_I32(1, frame.rect_count);
+    ASSUME_ITS_EQUAL_I32(6, frame.rects[0].h);
+    ASSUME_ITS_EQUAL_I32(200, frame.pixels[5 * frame.pitch + 8 * 4 + 2]);
+    const int first = frame.buffer;
+    fossil_cube_shm_release(cons);
+
+    /* frame 1: retained, lands in the other buffer with only its damage */
+    fossil_cube_begin_frame_retain_ex(ctx);
+    fossil_cube_fill_rect_ex(ctx, 2, 1, 3, 2, 0, 0, 90, 255);
+    fossil_cube_end_frame_ex(ctx);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_shm_acquire(cons, &frame, 100));
+    ASSUME_ITS_TRUE(frame.sequence == 1);
+    ASSUME_ITS_TRUE(frame.buffer != first);
+    ASSUME_ITS_EQUAL_I32(1, frame.rect_count);
+    ASSUME_ITS_EQUAL_I32(2, frame.rects[0].x);
+    ASSUME_ITS_EQUAL_I32(3, frame.rects[0].w);
+    ASSUME_ITS_EQUAL_I32(90, frame.pixels[1 * frame.pitch + 2 * 4 + 0]);
+    ASSUME_ITS_EQUAL_I32(200, frame.pixels[5 * frame.pitch + 8 * 4 + 2]);
+    fossil_cube_shm_release(cons);
+
+    /* frame 2 reuses the first buffer, which the consumer gave back */
+    fossil_cube_begin_frame_retain_ex(ctx);
+    fossil_cube_end_frame_ex(ctx);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_shm_acquire(cons, &frame, 100));
+    ASSUME_ITS_EQUAL_I32(first, frame.buffer);
+    ASSUME_ITS_EQUAL_I32(0, frame.rect_count);
+    ASSUME_ITS_EQUAL_I32(90, frame.pixels[1 * frame.pitch + 2 * 4 + 0]);
+    fossil_cube_shm_release(cons);
+
+    /* a consumer that stops releasing costs one timeout, then frames drop */
+    fossil_cube_begin_frame_retain_ex(ctx);
+    fossil_cube_end_frame_ex(ctx);
+    for (int i = 0; i < 2; ++i) {
+        fossil_cube_begin_frame_retain_ex(ctx);
+        fossil_cube_fill_rect_ex(ctx, 0, 0, 1, 1, 0, 0, 0, 255);
+        fossil_cube_end_frame_ex(ctx);
+    }
+    ASSUME_ITS_TRUE(fossil_cube_shm_dropped(prod) == 2);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_shm_acquire(cons, &frame, 100));
+    ASSUME_ITS_TRUE(frame.sequence == 3);
+    fossil_cube_shm_release(cons);
+    /* the next frame makes up for the dropped damage */
+    fossil_cube_begin_frame_retain_ex(ctx);
+    fossil_cube_fill_rect_ex(ctx, 4, 4, 1, 1, 0, 0, 0, 255);
+    fossil_cube_end_frame_ex(ctx);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_shm_acquire(cons, &frame, 100));
+    ASSUME_ITS_TRUE(frame.sequence == 4);
+    ASSUME_ITS_EQUAL_I32(1, frame.rect_count);
+    ASSUME_ITS_EQUAL_I32(9, frame.rects[0].w);
+    ASSUME_ITS_EQUAL_I32(6, frame.rects[0].h);
+    ASSUME_ITS_EQUAL_I32(0, frame.pixels[0]);
+    fossil_cube_shm_release(cons);
+
+    fossil_cube_shm_close(cons);
+    fossil_cube_ctx_destroy(ctx);
+    fossil_cube_shm_close(prod);
+}
+
+static uint8_t test_div255(unsigned x) { return (uint8_t)((x + 127u) / 255u); }
+
+/* Reference for one composited byte: s and d premultiplied, sa/da their alpha */
+static uint8_t test_composite_ref(fossil_cube_blend mode, unsigned d, unsigned da, unsigned s, unsigned sa) {
+    switch (mode) {
+    case FOSSIL_CUBE_BLEND_COPY: return (uint8_t)s;
+    case FOSSIL_CUBE_BLEND_ADD: return (uint8_t)(s + d > 255u ? 255u : s + d);
+    case FOSSIL_CUBE_BLEND_MULTIPLY: return test_div255(s * d + s * (255u - da) + d * (255u - sa));
+    default: return (uint8_t)(s + test_div255(d * (255u - sa)));
+    }
+}
+
+FOSSIL_TEST_CASE(c_test_composite_layers) {
+    enum { W = 9, H = 5 };
+    fossil_cube_ctx* src = NULL;
+    fossil_cube_ctx* dst = NULL;
+    fossil_cube_ctx* dst2 = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&src, W, H, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&dst, W, H, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&dst2, W, H, NULL, NULL));
+    int sp = 0, dp = 0, dp2 = 0;
+    uint8_t* sfb = fossil_cube_framebuffer_ex(src, NULL, NULL, &sp);
+    uint8_t* dfb = fossil_cube_framebuffer_ex(dst, NULL, NULL, &dp);
+    uint8_t* dfb2 = fossil_cube_framebuffer_ex(dst2, NULL, NULL, &dp2);
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            uint8_t* p = sfb + y * sp + x * 4;
+            const unsigned a = (unsigned)((x * 61 + y * 17) % 4 == 0 ? 0 : (x * 61 + y * 17) % 256);
+            p[0] = (uint8_t)(a * (unsigned)x / 8u); p[1] = (uint8_t)(a / 2u); p[2] = (uint8_t)a; p[3] = (uint8_t)a;
+        }
+    }
+    static const uint8_t opacities[2] = { 255, 97 };
+    for (int mode = FOSSIL_CUBE_BLEND_OVER; mode <= FOSSIL_CUBE_BLEND_MULTIPLY; ++mode) {
+        for (int o = 0; o < 2; ++o) {
+            const uint8_t op = opacities[o];
+            fossil_cube_clear_ex(dst, 40, 30, 20, 200);
+            fossil_cube_composite_ex(dst, src, 1, 0, W, H, 0, 1, op, (fossil_cube_blend)mode);
+            for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                    const uint8_t* d = dfb + y * dp + x * 4;
+                    static const uint8_t bg[4] = { 40, 30, 20, 200 };
+                    if (y == 0 || x == W - 1) {
+                        ASSUME_ITS_TRUE(memcmp(d, bg, 4) == 0);
+                        continue;
+                    }
+                    const uint8_t* sp8 = sfb + (y - 1) * sp + (x + 1) * 4;
+                    uint8_t s[4];
+                    for (int ch = 0; ch < 4; ++ch) s[ch] = op == 255 ? sp8[ch] : test_div255((unsigned)sp8[ch] * op);
+                    for (int ch = 0; ch < 4; ++ch) {
+                        ASSUME_ITS_EQUAL_I32(test_composite_ref((fossil_cube_blend)mode, bg[ch], bg[3], s[ch], s[3]), d[ch]);
+                    }
+                }
+            }
+        }
+    }
+
+    /* deferred and clipped gives the same as immediate; RGB565 reads opaque */
+    fossil_cube_ctx* src565 = NULL;
+    fossil_cube_config cfg = { 0 };
+    cfg.width = 4; cfg.height = 4; cfg.format = FOSSIL_CUBE_FORMAT_RGB565;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&src565, &cfg));
+    fossil_cube_clear_ex(src565, 255, 0, 0, 255);
+    fossil_cube_set_clip_ex(dst, 1, 1, 6, 3);
+    fossil_cube_set_clip_ex(dst2, 1, 1, 6, 3);
+    fossil_cube_clear_ex(dst, 0, 0, 0, 0);
+    fossil_cube_composite_ex(dst, src, 0, 0, W, H, -2, 0, 200, FOSSIL_CUBE_BLEND_OVER);
+    fossil_cube_composite_ex(dst, src565, 0, 0, 4, 4, 3, 2, 255, FOSSIL_CUBE_BLEND_MULTIPLY);
+    fossil_cube_set_mode_ex(dst2, FOSSIL_CUBE_MODE_DEFERRED);
+    fossil_cube_begin_frame_ex(dst2, 0, 0, 0, 0);
+    fossil_cube_composite_ex(dst2, src, 0, 0, W, H, -2, 0, 200, FOSSIL_CUBE_BLEND_OVER);
+    fossil_cube_composite_ex(dst2, src565, 0, 0, 4, 4, 3, 2, 255, FOSSIL_CUBE_BLEND_MULTIPLY);
+    fossil_cube_end_frame_ex(dst2);
+    ASSUME_ITS_TRUE(memcmp(dfb, dfb2, (size_t)dp * H) == 0);
+    ASSUME_ITS_EQUAL_I32(0, dfb[3 * dp + 5 * 4 + 1]); /* multiplied by opaque red */
+    fossil_cube_ctx_destroy(src565);
+
+    /* a layer draws once, then each frame is a single composite */
+    int presents = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init(W, H, test_present, &presents));
+    fossil_cube_layer* layer = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_layer_create(&layer, 4, 3, FOSSIL_CUBE_FORMAT_RGBA8));
+    ASSUME_ITS_TRUE(!fossil_cube_layer_valid(layer));
+    const uint8_t* fb = fossil_cube_framebuffer(NULL, NULL, &dp);
+    for (int frame = 0; frame < 3; ++frame) {
+        if (!fossil_cube_layer_valid(layer)) {
+            fossil_cube_ctx* lc = fossil_cube_layer_begin(layer);
+            fossil_cube_fill_rect_ex(lc, 1, 0, 2, 3, 10, 200, 30, 255);
+            fossil_cube_layer_end(layer);
+        }
+        fossil_cube_begin_frame(0, 0, 255, 255);
+        fossil_cube_draw_layer(layer, 3, 1, 255);
+        fossil_cube_end_frame();
+        ASSUME_ITS_EQUAL_I32(200, fb[2 * dp + 4 * 4 + 1]);
+        ASSUME_ITS_EQUAL_I32(255, fb[2 * dp + 3 * 4 + 2]); /* transparent layer pixel */
+    }
+    ASSUME_ITS_TRUE(fossil_cube_layer_redraws(layer) == 1);
+    fossil_cube_layer_invalidate(layer);
+    ASSUME_ITS_TRUE(!fossil_cube_layer_valid(layer));
+    fossil_cube_layer_destroy(layer);
+
+    fossil_cube_ctx_destroy(dst2);
+    fossil_cube_ctx_destroy(dst);
+    fossil_cube_ctx_destroy(src);
+}
+
+typedef struct test_scene_state {
+    int rx, ry;
+    bool group_visible, text, raised;
+} test_scene_state;
+
+/* What the retained scene below must look like, drawn from scratch */
+static void test_scene_reference(fossil_cube_ctx* ctx, fossil_cube_font* font, const test_scene_state* st) {
+    fossil_cube_begin_frame_ex(ctx, 10, 10, 10, 255);
+    if (st->group_visible) {
+        fossil_cube_set_clip_ex(ctx, 8, 8, 30, 20);
+        fossil_cube_fill_rect_ex(ctx, 8 + st->rx, 8 + st->ry, 40, 10, 200, 30, 30, 255);
+        fossil_cube_draw_line_ex(ctx, 8, 27, 37, 8, 30, 200, 30, 255);
+        fossil_cube_set_clip_ex(ctx, 0, 0, 0, 0);
+    }
+    if (!st->raised) fossil_cube_fill_rect_ex(ctx, 20, 20, 20, 20, 30, 30, 200, 160);
+    fossil_cube_fill_rect_ex(ctx, 30, 25, 10, 10, 250, 250, 0, 255);
+    if (st->raised) fossil_cube_fill_rect_ex(ctx, 20, 20, 20, 20, 30, 30, 200, 160);
+    if (st->text) fossil_cube_draw_text_ex(ctx, font, 2, 44, "Hi", 10, 255, 255, 255, 255);
+    fossil_cube_end_frame_ex(ctx);
+}
+
+FOSSIL_TEST_CASE(c_test_retained_scene) {
+    enum { W = 64, H = 48 };
+    fossil_cube_ctx* ctx = NULL;
+    fossil_cube_ctx* ref = NULL;
+    fossil_cube_font* font = NULL;
+    fossil_cube_scene* scene = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&ctx, W, H, test_present, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&ref, W, H, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_font_create(&font, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_scene_create(&scene));
+    fossil_cube_set_present_rects_ex(ctx, test_present_rects);
+    int pitch = 0;
+    const uint8_t* fb = fossil_cube_framebuffer_ex(ctx, NULL, NULL, &pitch);
+    const uint8_t* rfb = fossil_cube_framebuffer_ex(ref, NULL, NULL, NULL);
+
+    fossil_cube_scene_set_background(scene, 10, 10, 10);
+    const fossil_cube_node group = fossil_cube_scene_add_group(scene, FOSSIL_CUBE_SCENE_ROOT, 8, 8);
+    fossil_cube_scene_set_clip(scene, group, 0, 0, 30, 20);
+    const fossil_cube_node a = fossil_cube_scene_add_rect(scene, group, 0, 0, 40, 10, 200, 30, 30, 255);
+    ASSUME_ITS_TRUE(fossil_cube_scene_add_line(scene, group, 0, 19, 29, 0, 30, 200, 30, 255) != 0);
+    const fossil_cube_node b = fossil_cube_scene_add_rect(scene, FOSSIL_CUBE_SCENE_ROOT, 20, 20, 20, 20,
+                                                          30, 30, 200, 160);
+    ASSUME_ITS_TRUE(fossil_cube_scene_add_rect(scene, FOSSIL_CUBE_SCENE_ROOT, 30, 25, 10, 10, 250, 250, 0, 255) != 0);
+    const fossil_cube_node text = fossil_cube_scene_add_text(scene, FOSSIL_CUBE_SCENE_ROOT, font, 2, 44, "Hi", 10,
+                                                             255, 255, 255, 255);
+    ASSUME_ITS_TRUE(group && a && b && text);
+    ASSUME_ITS_TRUE(fossil_cube_scene_add_rect(scene, a, 0, 0, 1, 1, 0, 0, 0, 255) == 0); /* not a group */
+
+    test_scene_state st = { 0, 0, true, true, false };
+    ASSUME_ITS_EQUAL_I32(1, fossil_cube_scene_render(scene, ctx));
+    test_scene_reference(ref, font, &st);
+    ASSUME_ITS_TRUE(memcmp(fb, rfb, (size_t)pitch * H) == 0);
+    fossil_cube_rect bounds = fossil_cube_scene_bounds(scene, a);
+    ASSUME_ITS_TRUE(bounds.x == 8 && bounds.y == 8 && bounds.w == 30 && bounds.h == 10); /* clipped */
+
+    /* nothing changed: no frame at all */
+    test_last_rect_count = -1;
+    ASSUME_ITS_EQUAL_I32(0, fossil_cube_scene_render(scene, ctx));
+    ASSUME_ITS_EQUAL_I32(-1, test_last_rect_count);
+
+    /* each change repaints only around the node */
+    for (int step = 0; step < 4; ++step) {
+        switch (step) {
+        case 0: fossil_cube_scene_move(scene, a, 3, 6); st.rx = 3; st.ry = 6; break;
+        case 1: fossil_cube_scene_raise(scene, b); st.raised = true; break;
+        case 2: fossil_cube_scene_remove(scene, text); st.text = false; break;
+        default: fossil_cube_scene_set_visible(scene, group, false); st.group_visible = false; break;
+        }
+        test_last_rect_count = -1;
+        ASSUME_ITS_TRUE(fossil_cube_scene_render(scene, ctx) > 0);
+        ASSUME_ITS_TRUE(test_last_rect_count > 0);
+        long long area = 0;
+        for (int i = 0; i < test_last_rect_count; ++i) area += (long long)test_last_rects[i].w * test_last_rects[i].h;
+        ASSUME_ITS_TRUE(area < (long long)W * H / 2);
+        test_scene_reference(ref, font, &st);
+        ASSUME_ITS_TRUE(memcmp(fb, rfb, (size_t)pitch * H) == 0);
+    }
+    ASSUME_ITS_TRUE(fossil_cube_scene_bounds(scene, a).w == 0);
+    fossil_cube_scene_set_text(scene, text, "stale"); /* removed handle: ignored */
+    ASSUME_ITS_EQUAL_I32(0, fossil_cube_scene_render(scene, ctx));
+
+    /* a resized context gets a full repaint */
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_resize_ex(ctx, W, H - 8));
+    ASSUME_ITS_EQUAL_I32(1, fossil_cube_scene_render(scene, ctx));
+
+    fossil_cube_scene_destroy(scene);
+    fossil_cube_font_destroy(font);
+    fossil_cube_ctx_destroy(ref);
+    fossil_cube_ctx_destroy(ctx);
+}
+
+typedef struct test_stream {
+    uint8_t pixels[100 * 70 * 4];
+    int pitch;
+    fossil_cube_format format;
+    fossil_cube_packet_info info;
+    size_t size;
+    fossil_cube_result res;
+    uint8_t last[100 * 70 * 5 + 1024]; /* copy of the last packet */
+} test_stream;
+
+static void test_packet(const uint8_t* data, size_t size, void* userdata) {
+    test_stream* s = (test_stream*)userdata;
+    s->size = size;
+    if (size <= sizeof(s->last)) memcpy(s->last, data, size);
+    s->res = fossil_cube_decode_info(data, size, &s->info);
+    if (s->res == FOSSIL_CUBE_OK) {
+        s->res = fossil_cube_decode(data, size, s->pixels, s->info.width, s->info.height, s->pitch, s->format);
+    }
+}
+
+/* the client copy equals the framebuffer row by row */
+static bool test_stream_synced(fossil_cube_ctx* ctx, const test_stream* s) {
+    int w = 0, h = 0, pitch = 0;
+    const uint8_t* fb = fossil_cube_framebuffer_ex(ctx, &w, &h, &pitch);
+    const size_t row = (size_t)w * (size_t)fossil_cube_format_bpp(s->format);
+    for (int y = 0; y < h; ++y) {
+        if (memcmp(fb + (size_t)y * (size_t)pitch, s->pixels + (size_t)y * (size_t)s->pitch, row) != 0) return false;
+    }
+    return true;
+}
+
+FOSSIL_TEST_CASE(c_test_frame_encoder) {
+    static test_stream s;
+    const fossil_cube_format formats[2] = { FOSSIL_CUBE_FORMAT_RGBA8, FOSSIL_CUBE_FORMAT_RGB565 };
+    for (int pass = 0; pass < 4; ++pass) {
+        fossil_cube_config cfg = { 0 };
+        cfg.width = 100;
+        cfg.height = 70;
+        cfg.format = formats[pass & 1];
+        cfg.pad_rows = true;
+        fossil_cube_ctx* ctx = NULL;
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&ctx, &cfg));
+        if (pass >= 2) {
+            /* deferred with workers: tiles are encoded by the rasterizer */
+            fossil_cube_set_mode_ex(ctx, FOSSIL_CUBE_MODE_DEFERRED);
+            const fossil_cube_result res = fossil_cube_set_threads_ex(ctx, 3);
+            ASSUME_ITS_TRUE(res == FOSSIL_CUBE_OK || res == FOSSIL_CUBE_ERR_UNSUPPORTED);
+        }
+        memset(s.pixels, 0xAB, sizeof(s.pixels));
+        s.format = cfg.format;
+        s.pitch = 100 * fossil_cube_format_bpp(cfg.format);
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_set_encoder_ex(ctx, test_packet, &s));
+
+        /* first packet: key frame over every tile */
+        fossil_cube_begin_frame_ex(ctx, 10, 20, 30, 255);
+        fossil_cube_fill_rect_ex(ctx, 5, 5, 60, 40, 200, 100, 50, 255);
+        fossil_cube_draw_line_ex(ctx, 0, 69, 99, 0, 255, 255, 255, 255);
+        fossil_cube_end_frame_ex(ctx);
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, s.res);
+        ASSUME_ITS_TRUE(s.info.key);
+        ASSUME_ITS_EQUAL_I32(0, (int)s.info.sequence);
+        ASSUME_ITS_EQUAL_I32(4, s.info.tile_count);
+        ASSUME_ITS_TRUE(test_stream_synced(ctx, &s));
+
+        /* a small retained change codes one tile, far below a raw frame */
+        fossil_cube_begin_frame_retain_ex(ctx);
+        fossil_cube_fill_rect_ex(ctx, 70, 10, 8, 8, 0, 255, 0, 128);
+        fossil_cube_end_frame_ex(ctx);
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, s.res);
+        ASSUME_ITS_TRUE(!s.info.key);
+        ASSUME_ITS_EQUAL_I32(1, s.info.tile_count);
+        ASSUME_ITS_TRUE(s.size < 8 * 8 * 4);
+        ASSUME_ITS_TRUE(test_stream_synced(ctx, &s));
+
+        /* unchanged frame: empty packet; redrawing the same pixels codes skips */
+        fossil_cube_begin_frame_retain_ex(ctx);
+        fossil_cube_end_frame_ex(ctx);
+        ASSUME_ITS_EQUAL_I32(0, s.info.tile_count);
+        ASSUME_ITS_EQUAL_I32(2, (int)s.info.sequence);
+        fossil_cube_begin_frame_ex(ctx, 10, 20, 30, 255);
+        fossil_cube_fill_rect_ex(ctx, 5, 5, 60, 40, 200, 100, 50, 255);
+        fossil_cube_draw_line_ex(ctx, 0, 69, 99, 0, 255, 255, 255, 255);
+        fossil_cube_end_frame_ex(ctx);
+        ASSUME_ITS_EQUAL_I32(4, s.info.tile_count);
+        ASSUME_ITS_TRUE(s.size < 400);
+        ASSUME_ITS_TRUE(test_stream_synced(ctx, &s));
+
+        /* corrupt packets are refused */
+        const size_t size = s.size;
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS,
+                             fossil_cube_decode(s.last, size - 1, s.pixels, 100, 70, 0, cfg.format));
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS,
+                             fossil_cube_decode(s.last, size, s.pixels, 99, 70, 0, cfg.format));
+
+        /* a request or a resize starts over from a key frame */
+        fossil_cube_request_key_frame_ex(ctx);
+        fossil_cube_begin_frame_retain_ex(ctx);
+        fossil_cube_end_frame_ex(ctx);
+        ASSUME_ITS_TRUE(s.info.key && s.info.tile_count == 4);
+        ASSUME_ITS_TRUE(test_stream_synced(ctx, &s));
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_resize_ex(ctx, 90, 65));
+        s.pitch = 90 * fossil_cube_format_bpp(cfg.format);
+        fossil_cube_begin_frame_ex(ctx, 1, 2, 3, 255);
+        fossil_cube_fill_rect_ex(ctx, 60, 50, 30, 20, 9, 8, 7, 255);
+        fossil_cube_end_frame_ex(ctx);
+        ASSUME_ITS_TRUE(s.info.key && s.info.width == 90 && s.info.height == 65);
+        ASSUME_ITS_TRUE(test_stream_synced(ctx, &s));
+
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_set_encoder_ex(ctx, NULL, NULL));
+        fossil_cube_ctx_destroy(ctx);
+    }
+}
+
+static void test_capture_present(const uint8_t* pixels, int width, int height, int pitch,
+                                 const fossil_cube_rect* rects, int rect_count, void* userdata) {
+    fossil_cube_capture* cap = (fossil_cube_capture*)userdata;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_write(cap, pixels, width, height, pitch,
+                                                                   FOSSIL_CUBE_FORMAT_RGBA8, rects, rect_count));
+}
+
+FOSSIL_TEST_CASE(c_test_frame_capture) {
+    enum { W = 40, H = 30, FRAMES = 8 };
+    static const char path[] = "fossil_cube_capture_test.fcap";
+    static uint8_t expect[FRAMES][W * H * 4];
+    static uint8_t got[W * H * 4];
+    fossil_cube_capture* cap = NULL;
+    fossil_cube_ctx* ctx = NULL;
+
+    const fossil_cube_result res = fossil_cube_capture_create(&cap, path, FOSSIL_CUBE_CAPTURE_DAMAGE, 3);
+    if (res == FOSSIL_CUBE_ERR_UNSUPPORTED) return; /* -Dwith_capture=disabled */
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, res);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&ctx, W, H, NULL, cap));
+    fossil_cube_set_present_rects_ex(ctx, test_capture_present);
+    int pitch = 0;
+    const uint8_t* fb = fossil_cube_framebuffer_ex(ctx, NULL, NULL, &pitch);
+
+    fossil_cube_begin_frame_ex(ctx, 5, 6, 7, 255);
+    fossil_cube_end_frame_ex(ctx);
+    for (int y = 0; y < H; ++y) memcpy(expect[0] + y * W * 4, fb + (size_t)y * (size_t)pitch, W * 4);
+    for (int f = 1; f < FRAMES; ++f) {
+        fossil_cube_begin_frame_retain_ex(ctx);
+        if (f != 4) fossil_cube_fill_rect_ex(ctx, f * 4, f * 3, 6, 5, (uint8_t)(f * 30), 200, 0, 160);
+        fossil_cube_end_frame_ex(ctx);
+        for (int y = 0; y < H; ++y) memcpy(expect[f] + y * W * 4, fb + (size_t)y * (size_t)pitch, W * 4);
+    }
+    fossil_cube_capture_close(cap);
+    cap = NULL;
+
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_open(&cap, path));
+    ASSUME_ITS_EQUAL_I32(FRAMES, fossil_cube_capture_count(cap));
+    fossil_cube_capture_frame frame;
+    uint64_t t = 0;
+    for (int f = 0; f < FRAMES; ++f) {
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_get(cap, f, &frame));
+        ASSUME_ITS_TRUE(frame.width == W && frame.height == H && frame.format == FOSSIL_CUBE_FORMAT_RGBA8);
+        ASSUME_ITS_TRUE(frame.key == (f % 3 == 0)); /* first frame, then every third */
+        ASSUME_ITS_TRUE(frame.time_ns >= t);
+        t = frame.time_ns;
+        if (f == 4) ASSUME_ITS_EQUAL_I32(0, frame.rect_count); /* nothing drawn */
+        if (f == 5) {
+            /* damage only: the one rect, tightly packed */
+            ASSUME_ITS_EQUAL_I32(1, frame.rect_count);
+            ASSUME_ITS_TRUE(frame.rects[0].x == 20 && frame.rects[0].y == 15);
+            ASSUME_ITS_EQUAL_I32(6 * 5 * 4, (int)frame.size);
+            ASSUME_ITS_TRUE(memcmp(frame.data, expect[5] + (15 * W + 20) * 4, 6 * 4) == 0);
+        }
+    }
+    /* random access recreates every frame from its key frame */
+    const int order[FRAMES] = { 5, 0, 7, 2, 4, 1, 6, 3 };
+    for (int i = 0; i < FRAMES; ++i) {
+        memset(got, 0, sizeof(got));
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_read(cap, order[i], got, 0));
+        ASSUME_ITS_TRUE(memcmp(got, expect[order[i]], sizeof(got)) == 0);
+    }
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_capture_read(cap, FRAMES, got, 0));
+    fossil_cube_capture_close(cap);
+
+    /* a file cut mid-record reads back up to its last whole frame */
+    FILE* fp = fopen(path, "rb");
+    ASSUME_ITS_TRUE(fp != NULL);
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t* bytes = (uint8_t*)malloc((size_t)size);
+    ASSUME_ITS_TRUE(bytes && fread(bytes, 1, (size_t)size, fp) == (size_t)size);
+    fclose(fp);
+    fp = fopen(path, "wb");
+    ASSUME_ITS_TRUE(fp && fwrite(bytes, 1, (size_t)size - 100, fp) == (size_t)size - 100);
+    fclose(fp);
+    free(bytes);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_open(&cap, path));
+    ASSUME_ITS_EQUAL_I32(FRAMES - 1, fossil_cube_capture_count(cap));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_read(cap, FRAMES - 2, got, 0));
+    ASSUME_ITS_TRUE(memcmp(got, expect[FRAMES - 2], sizeof(got)) == 0);
+    fossil_cube_capture_close(cap);
+
+    /* more rects than a record holds store the frame whole, not a part of it */
+    fossil_cube_rect spots[FOSSIL_CUBE_MAX_DAMAGE + 1];
+    memcpy(got, expect[0], sizeof(got));
+    for (int i = 0; i <= FOSSIL_CUBE_MAX_DAMAGE; ++i) {
+        spots[i].x = (i * 3) % W;
+        spots[i].y = (i * 3) / W * 2;
+        spots[i].w = spots[i].h = 1;
+        got[(spots[i].y * W + spots[i].x) * 4] ^= 0xFF;
+    }
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_create(&cap, path, FOSSIL_CUBE_CAPTURE_DAMAGE, 0));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_write(cap, expect[0], W, H, 0, FOSSIL_CUBE_FORMAT_RGBA8, NULL, 1));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_write(cap, got, W, H, 0, FOSSIL_CUBE_FORMAT_RGBA8,
+                                                                   spots, FOSSIL_CUBE_MAX_DAMAGE + 1));
+    fossil_cube_capture_close(cap);
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_open(&cap, path));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_get(cap, 1, &frame));
+    ASSUME_ITS_TRUE(frame.key);
+    ASSUME_ITS_EQUAL_I32(1, frame.rect_count);
+    ASSUME_ITS_TRUE(frame.rects[0].w == W && frame.rects[0].h == H);
+    memcpy(expect[1], got, sizeof(got));
+    memset(got, 0, sizeof(got));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_capture_read(cap, 1, got, 0));
+    ASSUME_ITS_TRUE(memcmp(got, expect[1], sizeof(got)) == 0);
+    fossil_cube_capture_close(cap);
+
+    fossil_cube_ctx_destroy(ctx);
+    remove(path);
+}
+
+static void test_clear_scene(fossil_cube_ctx* ctx, int scene, int w, int h) {
+    fossil_cube_begin_frame_ex(ctx, 30, 60, 90, 255);
+    fossil_cube_fill_rect_ex(ctx, 5, 5, 40, 30, 200, 0, 0, 255);
+    switch (scene) {
+    case 0: /* a second clear under a full-screen cover */
+        fossil_cube_clear_ex(ctx, 1, 2, 3, 255);
+        fossil_cube_fill_rect_ex(ctx, -2, -2, w + 4, h + 4, 9, 90, 9, 255);
+        break;
+    case 1: /* bands off the top and bottom, then the left column */
+        fossil_cube_clear_ex(ctx, 1, 2, 3, 255);
+        fossil_cube_fill_rect_ex(ctx, 0, 0, w, 20, 9, 90, 9, 255);
+        fossil_cube_fill_rect_ex(ctx, 0, h - 25, w, 25, 90, 9, 9, 255);
+        fossil_cube_fill_rect_ex(ctx, 0, 10, 30, h - 20, 9, 9, 90, 255);
+        fossil_cube_fill_rect_ex(ctx, 20, 15, w / 2, h / 2, 255, 255, 255, 100);
+        break;
+    case 2: /* a clipped clear, covered only in part */
+        fossil_cube_set_clip_ex(ctx, 10, 8, w / 2, h / 2);
+        fossil_cube_clear_ex(ctx, 1, 2, 3, 255);
+        fossil_cube_set_clip_ex(ctx, 0, 0, 0, 0);
+        fossil_cube_fill_rect_ex(ctx, 0, 0, 40, h, 9, 90, 9, 255);
+        fossil_cube_fill_rect_ex(ctx, 0, 0, w, 12, 90, 9, 9, 128);
+        break;
+    default: /* pieces that only cover it together */
+        fossil_cube_clear_ex(ctx, 1, 2, 3, 255);
+        fossil_cube_fill_rect_ex(ctx, 0, 0, w / 2, h, 9, 90, 9, 255);
+        fossil_cube_fill_rect_ex(ctx, w / 2, 0, w - w / 2, h, 90, 9, 9, 255);
+        break;
+    }
+    fossil_cube_end_frame_ex(ctx);
+}
+
+FOSSIL_TEST_CASE(c_test_fast_clear) {
+    /* deferred frames trim or drop clears that later covers hide; the
+       output matches immediate mode */
+    enum { W = 150, H = 90 };
+    fossil_cube_ctx* a = NULL;
+    fossil_cube_ctx* b = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&a, W, H, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&b, W, H, NULL, NULL));
+    fossil_cube_set_mode_ex(b, FOSSIL_CUBE_MODE_DEFERRED);
+    (void)fossil_cube_set_threads_ex(b, 3);
+    int pitch = 0;
+    for (int scene = 0; scene < 4; ++scene) {
+        test_clear_scene(a, scene, W, H);
+        test_clear_scene(b, scene, W, H);
+        const uint8_t* pa = fossil_cube_framebuffer_ex(a, NULL, NULL, &pitch);
+        ASSUME_ITS_TRUE(memcmp(pa, fossil_cube_framebuffer_ex(b, NULL, NULL, NULL), (size_t)pitch * H) == 0);
+    }
+
+    /* a full-screen opaque cover of each kind right after begin_frame
+       leaves the clear nothing to draw; a blit with one translucent pixel
+       keeps it */
+    fossil_cube_stats st;
+    if (fossil_cube_get_stats_ex(b, &st) == FOSSIL_CUBE_OK) {
+        uint8_t* src = (uint8_t*)malloc((size_t)W * H * 4u);
+        ASSUME_ITS_TRUE(src != NULL);
+        for (int i = 0; i < W * H; ++i) {
+            src[i * 4 + 0] = (uint8_t)i; src[i * 4 + 1] = (uint8_t)(i >> 8);
+            src[i * 4 + 2] = 77; src[i * 4 + 3] = 255;
+        }
+        fossil_cube_image* img = NULL;
+        fossil_cube_paint* paint = NULL;
+        const fossil_cube_color_stop stops[2] = { { 0.0f, 250, 10, 10, 255 }, { 1.0f, 10, 10, 250, 255 } };
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_image_create(&img, src, W, H, 0, FOSSIL_CUBE_ALPHA_STRAIGHT));
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_paint_linear(&paint, 0, 0, W, H, stops, 2,
+                                                                      FOSSIL_CUBE_EXTEND_PAD));
+        for (int kind = 0; kind < 5; ++kind) {
+            if (kind == 4) src[((H / 2) * W + W / 2) * 4 + 3] = 254;
+            fossil_cube_reset_stats_ex(b);
+            fossil_cube_ctx* both[2] = { a, b };
+            for (int k = 0; k < 2; ++k) {
+                fossil_cube_begin_frame_ex(both[k], 30, 60, 90, 255);
+                switch (kind) {
+                case 0: fossil_cube_fill_rect_ex(both[k], 0, 0, W, H, 9, 90, 9, 255); break;
+                case 1: fossil_cube_draw_image_ex(both[k], img, 0, 0); break;
+                case 2: fossil_cube_fill_rect_paint_ex(both[k], -3, -3, W + 6, H + 6, paint); break;
+                default: fossil_cube_blit_rgba_ex(both[k], 0, 0, src, W, H, W * 4); break;
+                }
+                fossil_cube_end_frame_ex(both[k]);
+            }
+            const uint8_t* pa = fossil_cube_framebuffer_ex(a, NULL, NULL, &pitch);
+            ASSUME_ITS_TRUE(memcmp(pa, fossil_cube_framebuffer_ex(b, NULL, NULL, NULL), (size_t)pitch * H) == 0);
+            ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_get_stats_ex(b, &st));
+            ASSUME_ITS_TRUE(st.prim[FOSSIL_CUBE_PRIM_CLEAR].copied == (kind == 4 ? (uint64_t)W * H : 0u));
+        }
+        fossil_cube_paint_destroy(paint);
+        fossil_cube_image_destroy(img);
+        free(src);
+    }
+    fossil_cube_ctx_destroy(a);
+    fossil_cube_ctx_destroy(b);
+
+    /* large clears (streaming stores, split over the pool) match a serial
+       scalar clear, including unaligned row heads and tails */
+    enum { BW = 1283, BH = 1700 };
+    const fossil_cube_simd best = fossil_cube_simd_level();
+    const fossil_cube_format formats[] = { FOSSIL_CUBE_FORMAT_RGBA8, FOSSIL_CUBE_FORMAT_RGB565,
+                                           FOSSIL_CUBE_FORMAT_A8 };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+        fossil_cube_config cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.width = BW;
+        cfg.height = BH;
+        cfg.format = formats[f];
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&a, &cfg));
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&b, &cfg));
+        (void)fossil_cube_set_threads_ex(b, 4);
+        fossil_cube_ctx* both[2] = { a, b };
+        for (int k = 0; k < 2; ++k) {
+            fossil_cube_set_simd_level(k == 0 ? FOSSIL_CUBE_SIMD_SCALAR : best);
+            fossil_cube_begin_frame_ex(both[k], 10, 10, 10, 255);
+            fossil_cube_set_clip_ex(both[k], 3, 1, BW - 10, BH - 3);
+            fossil_cube_clear_ex(both[k], 200, 100, 50, 255);
+            fossil_cube_set_clip_ex(both[k], 0, 0, 0, 0);
+            fossil_cube_end_frame_ex(both[k]);
+        }
+        const uint8_t* pa = fossil_cube_framebuffer_ex(a, NULL, NULL, &pitch);
+        ASSUME_ITS_TRUE(memcmp(pa, fossil_cube_framebuffer_ex(b, NULL, NULL, NULL), (size_t)pitch * BH) == 0);
+        fossil_cube_ctx_destroy(a);
+        fossil_cube_ctx_destroy(b);
+    }
+    fossil_cube_set_simd_level(best);
+}
+
+static void test_paint_scene(fossil_cube_ctx* ctx, const fossil_cube_paint* const* paints, int count) {
+    static const float tri[6] = { 10.3f, 100.0f, 150.0f, 60.7f, 290.0f, 118.2f };
+    fossil_cube_begin_frame_ex(ctx, 30, 60, 90, 255);
+    for (int i = 0; i < count; ++i) {
+        fossil_cube_fill_rect_paint_ex(ctx, -7 + 37 * i, 3 + 11 * i, 180, 40, paints[i]);
+        fossil_cube_fill_circle_paint_ex(ctx, 40.0f + 45.0f * (float)i, 70.5f, 25.3f, paints[i]);
+        fossil_cube_fill_rounded_rect_paint_ex(ctx, 200.5f - 20.0f * (float)i, 10.0f, 90.0f, 50.0f, 12.0f,
+                                               paints[i]);
+    }
+    fossil_cube_fill_polygon_paint_ex(ctx, tri, 3, paints[0]);
+    fossil_cube_end_frame_ex(ctx);
+}
+
+FOSSIL_TEST_CASE(c_test_paint_fills) {
+    enum { W = 300, H = 120 };
+    fossil_cube_ctx* a = NULL;
+    fossil_cube_ctx* b = NULL;
+    int pitch = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&a, W, H, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&b, W, H, NULL, NULL));
+
+    /* a one-color paint draws exactly what the solid calls draw */
+    static const float tri[6] = { 10.3f, 100.0f, 150.0f, 60.7f, 290.0f, 118.2f };
+    for (int alpha = 160; alpha <= 255; alpha += 95) {
+        const fossil_cube_color_stop solid = { 0.3f, 200, 40, 90, (uint8_t)alpha };
+        fossil_cube_paint* flat = NULL;
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_paint_linear(&flat, 0, 0, 10, 3, &solid, 1,
+                                                                      FOSSIL_CUBE_EXTEND_PAD));
+        fossil_cube_begin_frame_ex(a, 30, 60, 90, 255);
+        fossil_cube_fill_rect_ex(a, -5, 7, 120, 30, 200, 40, 90, (uint8_t)alpha);
+        fossil_cube_fill_polygon_ex(a, tri, 3, 200, 40, 90, (uint8_t)alpha);
+        fossil_cube_fill_circle_ex(a, 230.0f, 40.5f, 30.2f, 200, 40, 90, (uint8_t)alpha);
+        fossil_cube_fill_rounded_rect_ex(a, 100.5f, 50.0f, 80.0f, 40.0f, 9.0f, 200, 40, 90, (uint8_t)alpha);
+        fossil_cube_end_frame_ex(a);
+        fossil_cube_begin_frame_ex(b, 30, 60, 90, 255);
+        fossil_cube_fill_rect_paint_ex(b, -5, 7, 120, 30, flat);
+        fossil_cube_fill_polygon_paint_ex(b, tri, 3, flat);
+        fossil_cube_fill_circle_paint_ex(b, 230.0f, 40.5f, 30.2f, flat);
+        fossil_cube_fill_rounded_rect_paint_ex(b, 100.5f, 50.0f, 80.0f, 40.0f, 9.0f, flat);
+        fossil_cube_end_frame_ex(b);
+        const uint8_t* pa = fossil_cube_framebuffer_ex(a, NULL, NULL, &pitch);
+        ASSUME_ITS_TRUE(memcmp(pa, fossil_cube_framebuffer_ex(b, NULL, NULL, NULL), (size_t)pitch * H) == 0);
+        fossil_cube_paint_destroy(flat);
+    }
+
+    /* a black to white ramp over 256 pixels: entry x at column x, then
+       mirrored with REFLECT */
+    const fossil_cube_color_stop bw[2] = { { 0.0f, 0, 0, 0, 255 }, { 1.0f, 255, 255, 255, 255 } };
+    fossil_cube_paint* ramp = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_paint_linear(&ramp, 0, 0, 256, 0, bw, 2,
+                                                                  FOSSIL_CUBE_EXTEND_REFLECT));
+    fossil_cube_begin_frame_ex(a, 0, 0, 0, 255);
+    fossil_cube_fill_rect_paint_ex(a, 0, 0, W, 2, ramp);
+    fossil_cube_end_frame_ex(a);
+    const uint8_t* fb = fossil_cube_framebuffer_ex(a, NULL, NULL, &pitch);
+    for (int x = 0; x < W; ++x) {
+        const int e = x < 256 ? x : 511 - x;
+        ASSUME_ITS_EQUAL_I32((255 * (2 * e + 1) + 256) / 512, fb[pitch + x * 4]);
+    }
+    fossil_cube_paint_destroy(ramp);
+
+    /* a pattern repeats its image from the origin in both directions */
+    enum { PW = 7, PH = 5 };
+    static uint8_t tile[PW * PH * 4];
+    test_rng = 9u;
+    for (int i = 0; i < PW * PH * 4; ++i) tile[i] = (i & 3) == 3 ? 255 : test_rand_u8();
+    fossil_cube_image* img = NULL;
+    fossil_cube_paint* pat = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_image_create(&img, tile, PW, PH, 0, FOSSIL_CUBE_ALPHA_STRAIGHT));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_paint_pattern(&pat, img, -3, 4));
+    fossil_cube_begin_frame_ex(a, 0, 0, 0, 255);
+    fossil_cube_fill_rect_paint_ex(a, 0, 0, W, H, pat);
+    fossil_cube_end_frame_ex(a);
+    bool tiled = true;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const int u = (x + 3) % PW, v = ((y - 4) % PH + PH) % PH;
+            tiled = tiled && memcmp(fb + (size_t)y * (size_t)pitch + (size_t)x * 4u, tile + (v * PW + u) * 4, 4) == 0;
+        }
+    }
+    ASSUME_ITS_TRUE(tiled);
+
+    /* every paint and extend mode: deferred on tiles with the best SIMD
+       level matches immediate scalar */
+    const fossil_cube_color_stop stops[4] = {
+        { -0.2f, 255, 0, 0, 255 }, { 0.4f, 0, 255, 0, 128 }, { 0.4f, 0, 0, 255, 200 }, { 0.9f, 250, 250, 0, 0 }
+    };
+    fossil_cube_paint* paints[7] = { pat };
+    int count = 1;
+    for (int e = FOSSIL_CUBE_EXTEND_PAD; e <= FOSSIL_CUBE_EXTEND_REFLECT; ++e) {
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_paint_linear(&paints[count++], 20.5f, 10.0f, 57.0f, 41.0f,
+                                                                      stops, 4, (fossil_cube_extend)e));
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_paint_radial(&paints[count++], 150.0f, 60.0f, 33.3f,
+                                                                      stops, 4, (fossil_cube_extend)e));
+    }
+    const fossil_cube_simd best = fossil_cube_simd_level();
+    fossil_cube_set_simd_level(FOSSIL_CUBE_SIMD_SCALAR);
+    test_paint_scene(a, (const fossil_cube_paint* const*)paints, count);
+    fossil_cube_set_simd_level(best);
+    fossil_cube_set_mode_ex(b, FOSSIL_CUBE_MODE_DEFERRED);
+    (void)fossil_cube_set_threads_ex(b, 3);
+    test_paint_scene(b, (const fossil_cube_paint* const*)paints, count);
+    ASSUME_ITS_TRUE(memcmp(fb, fossil_cube_framebuffer_ex(b, NULL, NULL, NULL), (size_t)pitch * H) == 0);
+
+    fossil_cube_paint* bad = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_paint_linear(&bad, 0, 0, 1, 1, stops, 0,
+                                                                           FOSSIL_CUBE_EXTEND_PAD));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_paint_radial(&bad, 0, 0, 0.0f, stops, 4,
+                                                                           FOSSIL_CUBE_EXTEND_PAD));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_paint_pattern(&bad, NULL, 0, 0));
+    ASSUME_ITS_TRUE(bad == NULL);
+
+    for (int i = 0; i < count; ++i) fossil_cube_paint_destroy(paints[i]);
+    fossil_cube_image_destroy(img);
+    fossil_cube_ctx_destroy(a);
+    fossil_cube_ctx_destroy(b);
+}
+
+enum { TEST_BATCH = 1500 };
+
+typedef struct test_batch {
+    int a[4][TEST_BATCH];            /* rects: x, y, w, h; lines: x0, y0, x1, y1 */
+    uint8_t rgba[TEST_BATCH * 4];
+    const uint8_t* src[TEST_BATCH];
+    int sw[TEST_BATCH], sh[TEST_BATCH], pitch[TEST_BATCH];
+} test_batch;
+
+static int test_rand_range(int lo, int hi) {
+    const int v = (test_rand_u8() << 8) | test_rand_u8();
+    return lo + v % (hi - lo);
+}
+
+/* Draws the batch with the array entry points or one call per element */
+static void test_draw_batch(fossil_cube_ctx* ctx, const test_batch* t, bool batched) {
+    const int(*a)[TEST_BATCH] = t->a;
+    fossil_cube_begin_frame_ex(ctx, 20, 30, 40, 255);
+    fossil_cube_set_clip_ex(ctx, 13, 9, 170, 120);
+    if (batched) {
+        fossil_cube_fill_rects_ex(ctx, a[0], a[1], a[2], a[3], TEST_BATCH, t->rgba, 4, FOSSIL_CUBE_BATCH_IN_ORDER);
+        fossil_cube_draw_lines_ex(ctx, a[2], a[3], a[0], a[1], TEST_BATCH, t->rgba + 4, 0, FOSSIL_CUBE_BATCH_IN_ORDER);
+        fossil_cube_blit_many_ex(ctx, a[1], a[0], t->src, t->sw, t->sh, t->pitch, TEST_BATCH,
+                                 FOSSIL_CUBE_BATCH_IN_ORDER);
+    } else {
+        for (int i = 0; i < TEST_BATCH; ++i) {
+            const uint8_t* k = t->rgba + i * 4;
+            fossil_cube_fill_rect_ex(ctx, a[0][i], a[1][i], a[2][i], a[3][i], k[0], k[1], k[2], k[3]);
+        }
+        for (int i = 0; i < TEST_BATCH; ++i) {
+            const uint8_t* k = t->rgba + 4;
+            fossil_cube_draw_line_ex(ctx, a[2][i], a[3][i], a[0][i], a[1][i], k[0], k[1], k[2], k[3]);
+        }
+        for (int i = 0; i < TEST_BATCH; ++i) {
+            fossil_cube_blit_rgba_ex(ctx, a[1][i], a[0][i], t->src[i], t->sw[i], t->sh[i], t->pitch[i]);
+        }
+    }
+    fossil_cube_set_clip_ex(ctx, 0, 0, 0, 0);
+    fossil_cube_end_frame_ex(ctx);
+}
+
+FOSSIL_TEST_CASE(c_test_batches) {
+    enum { W = 200, H = 150, S = 24 };
+    static test_batch t;
+    static uint8_t src[S * S * 4];
+    test_rng = 28u;
+    test_make_src(src, S, S);
+    for (int i = 0; i < TEST_BATCH; ++i) {
+        /* many elements miss the clip, some are empty or transparent */
+        t.a[0][i] = test_rand_range(-100, 300);
+        t.a[1][i] = test_rand_range(-100, 300);
+        t.a[2][i] = test_rand_range(-3, 40);
+        t.a[3][i] = test_rand_range(-3, 40);
+        for (int j = 0; j < 4; ++j) t.rgba[i * 4 + j] = test_rand_u8();
+        if (i % 7 == 0) t.rgba[i * 4 + 3] = 0;
+        const int sx = test_rand_range(0, S), sy = test_rand_range(0, S);
+        t.src[i] = i % 11 == 0 ? NULL : src + (sy * S + sx) * 4;
+        t.sw[i] = test_rand_range(-2, S - sx + 1);
+        t.sh[i] = test_rand_range(-2, S - sy + 1);
+        t.pitch[i] = S * 4;
+    }
+    t.rgba[4 + 3] = 180; /* the lines' shared color */
+
+    fossil_cube_ctx* one = NULL;
+    fossil_cube_ctx* many = NULL;
+    int pitch = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&one, W, H, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&many, W, H, NULL, NULL));
+    const uint8_t* ref = fossil_cube_framebuffer_ex(one, NULL, NULL, &pitch);
+    const uint8_t* got = fossil_cube_framebuffer_ex(many, NULL, NULL, NULL);
+
+    /* batches draw what the single calls draw, in every mode */
+    test_draw_batch(one, &t, false);
+    test_draw_batch(many, &t, true);
+    ASSUME_ITS_TRUE(memcmp(ref, got, (size_t)pitch * H) == 0);
+    fossil_cube_set_mode_ex(many, FOSSIL_CUBE_MODE_DEFERRED);
+    (void)fossil_cube_set_threads_ex(many, 3);
+    test_draw_batch(many, &t, true);
+    ASSUME_ITS_TRUE(memcmp(ref, got, (size_t)pitch * H) == 0);
+
+    /* BY_ROW only reorders: disjoint cells given bottom-up land the same */
+    enum { CELLS = 15 * 13 };
+    int cx[CELLS], cy[CELLS], cw[CELLS], ch[CELLS];
+    for (int i = 0; i < CELLS; ++i) {
+        const int cell = CELLS - 1 - i;
+        cx[i] = (cell % 15) * 13 + 1;
+        cy[i] = (cell / 15) * 11 + 2;
+        cw[i] = 12;
+        ch[i] = 10;
+    }
+    fossil_cube_set_mode_ex(many, FOSSIL_CUBE_MODE_IMMEDIATE);
+    fossil_cube_begin_frame_ex(one, 0, 0, 0, 255);
+    fossil_cube_fill_rects_ex(one, cx, cy, cw, ch, CELLS, t.rgba, 4, FOSSIL_CUBE_BATCH_IN_ORDER);
+    fossil_cube_end_frame_ex(one);
+    fossil_cube_begin_frame_ex(many, 0, 0, 0, 255);
+    fossil_cube_fill_rects_ex(many, cx, cy, cw, ch, CELLS, t.rgba, 4, FOSSIL_CUBE_BATCH_BY_ROW);
+    fossil_cube_end_frame_ex(many);
+    ASSUME_ITS_TRUE(memcmp(ref, got, (size_t)pitch * H) == 0);
+
+    /* overlapping elements are drawn top row first, ties in array order */
+    const int ox[3] = { 0, 0, 0 }, oy[3] = { 5, 2, 2 }, ow[3] = { 4, 4, 4 }, oh[3] = { 4, 4, 4 };
+    const uint8_t oc[12] = { 255, 0, 0, 255, 0, 255, 0, 255, 0, 0, 255, 255 };
+    fossil_cube_begin_frame_ex(many, 0, 0, 0, 255);
+    fossil_cube_fill_rects_ex(many, ox, oy, ow, oh, 3, oc, 4, FOSSIL_CUBE_BATCH_BY_ROW);
+    fossil_cube_end_frame_ex(many);
+    ASSUME_ITS_EQUAL_I32(255, got[(size_t)pitch * 5 + 0]);
+    ASSUME_ITS_EQUAL_I32(255, got[(size_t)pitch * 4 + 2]);
+
+    fossil_cube_ctx_destroy(one);
+    fossil_cube_ctx_destroy(many);
+}
+
+/* Draws every kind of primitive; with a region set it must land exactly
+   where the region lets it */
+static void test_region_scene(fossil_cube_ctx* ctx, const uint8_t* src, const fossil_cube_image* img,
+                              const fossil_cube_paint* paint) {
+    static const float tri[6] = { 5.0f, 100.0f, 80.5f, 3.2f, 150.0f, 110.0f };
+    static const int bx[3] = { 3, 70, 120 }, by[3] = { 60, 8, 30 }, bw[3] = { 50, 9, 30 }, bh[3] = { 9, 50, 70 };
+    static const uint8_t bc[4] = { 10, 200, 90, 230 };
+    fossil_cube_fill_rect_ex(ctx, -4, 5, 120, 40, 200, 40, 60, 140);
+    fossil_cube_fill_rect_ex(ctx, 50, 30, 90, 60, 20, 90, 250, 255);
+    fossil_cube_draw_line_ex(ctx, 0, 119, 159, 2, 255, 255, 0, 200);
+    fossil_cube_draw_rect_ex(ctx, 12, 14, 120, 80, 0, 255, 255, 255);
+    fossil_cube_blit_rgba_ex(ctx, 40, 20, src, 24, 24, 24 * 4);
+    fossil_cube_blit_scaled_ex(ctx, 90, 50, 60, 45, src, 24, 24, 24 * 4, FOSSIL_CUBE_FILTER_BILINEAR);
+    fossil_cube_draw_image_ex(ctx, img, 8, 70);
+    fossil_cube_fill_polygon_ex(ctx, tri, 3, 250, 120, 10, 160);
+    fossil_cube_fill_circle_ex(ctx, 70.3f, 50.6f, 33.0f, 90, 20, 140, 200);
+    fossil_cube_fill_rect_paint_ex(ctx, 100, 5, 55, 50, paint);
+    fossil_cube_fill_rects_ex(ctx, bx, by, bw, bh, 3, bc, 0, FOSSIL_CUBE_BATCH_IN_ORDER);
+}
+
+FOSSIL_TEST_CASE(c_test_clip_region) {
+    enum { W = 160, H = 120, S = 24 };
+    /* two overlapping windows minus two on top of them, with holes */
+    const fossil_cube_rect wins[2] = { { 10, 10, 100, 70 }, { 60, 40, 90, 70 } };
+    const fossil_cube_rect over[3] = { { 30, 20, 40, 30 }, { 0, 90, 160, 5 }, { 95, 60, 10, 10 } };
+    fossil_cube_region* rg = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_region_create_diff(&rg, wins, 2, over, 3));
+    const fossil_cube_rect bounds = fossil_cube_region_bounds(rg);
+    ASSUME_ITS_TRUE(bounds.x == 10 && bounds.y == 10 && bounds.w == 140 && bounds.h == 100);
+
+    /* the rects are disjoint and cover exactly the difference */
+    static uint8_t inside[W * H];
+    fossil_cube_rect parts[64];
+    const int count = fossil_cube_region_rects(rg, NULL, 0);
+    ASSUME_ITS_TRUE(count > 0 && count <= 64);
+    ASSUME_ITS_EQUAL_I32(count, fossil_cube_region_rects(rg, parts, 64));
+    memset(inside, 0, sizeof(inside));
+    bool disjoint = true, exact = true;
+    for (int i = 0; i < count; ++i) {
+        for (int y = parts[i].y; y < parts[i].y + parts[i].h; ++y) {
+            for (int x = parts[i].x; x < parts[i].x + parts[i].w; ++x) {
+                disjoint = disjoint && !inside[y * W + x];
+                inside[y * W + x] = 1;
+            }
+        }
+    }
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            bool in = false, out = false;
+            for (int i = 0; i < 2; ++i) {
+                in = in || (x >= wins[i].x && x < wins[i].x + wins[i].w && y >= wins[i].y && y < wins[i].y + wins[i].h);
+            }
+            for (int i = 0; i < 3; ++i) {
+                out = out || (x >= over[i].x && x < over[i].x + over[i].w && y >= over[i].y && y < over[i].y + over[i].h);
+            }
+            exact = exact && inside[y * W + x] == (in && !out);
+        }
+    }
+    ASSUME_ITS_TRUE(disjoint);
+    ASSUME_ITS_TRUE(exact);
+
+    static uint8_t src[S * S * 4];
+    test_rng = 29u;
+    test_make_src(src, S, S);
+    fossil_cube_image* img = NULL;
+    fossil_cube_paint* paint = NULL;
+    const fossil_cube_color_stop stops[2] = { { 0.0f, 255, 0, 0, 255 }, { 1.0f, 0, 0, 255, 120 } };
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_image_create(&img, src, S, S, 0, FOSSIL_CUBE_ALPHA_STRAIGHT));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_paint_linear(&paint, 100, 5, 155, 55, stops, 2,
+                                                                  FOSSIL_CUBE_EXTEND_PAD));
+
+    /* expected: the unclipped scene inside the region, the background
+       outside it */
+    fossil_cube_ctx* ref = NULL;
+    fossil_cube_ctx* got = NULL;
+    int pitch = 0;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&ref, W, H, NULL, NULL));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create(&got, W, H, NULL, NULL));
+    fossil_cube_begin_frame_ex(ref, 30, 30, 30, 255);
+    test_region_scene(ref, src, img, paint);
+    fossil_cube_end_frame_ex(ref);
+    static uint8_t want[W * H * 4];
+    const uint8_t* rp = fossil_cube_framebuffer_ex(ref, NULL, NULL, &pitch);
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            static const uint8_t bg[4] = { 30, 30, 30, 255 };
+            memcpy(want + (y * W + x) * 4, inside[y * W + x] ? rp + y * pitch + x * 4 : bg, 4);
+        }
+    }
+
+    fossil_cube_cmdbuf* buf = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_cmdbuf_create(&buf));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_record_begin_ex(ref, buf));
+    test_region_scene(ref, src, img, paint);
+    fossil_cube_record_end_ex(ref);
+
+    const uint8_t* gp = fossil_cube_framebuffer_ex(got, NULL, NULL, NULL);
+    for (int pass = 0; pass < 3; ++pass) {
+        fossil_cube_set_mode_ex(got, pass == 0 ? FOSSIL_CUBE_MODE_IMMEDIATE : FOSSIL_CUBE_MODE_DEFERRED);
+        (void)fossil_cube_set_threads_ex(got, pass == 0 ? 1 : 3);
+        fossil_cube_begin_frame_ex(got, 30, 30, 30, 255);
+        fossil_cube_set_clip_region_ex(got, rg);
+        ASSUME_ITS_TRUE(fossil_cube_get_clip_region_ex(got) == rg);
+        if (pass < 2) test_region_scene(got, src, img, paint);
+        else fossil_cube_replay_ex(got, buf); /* takes the region set now */
+        fossil_cube_set_clip_region_ex(got, NULL);
+        fossil_cube_end_frame_ex(got);
+        bool same = true;
+        for (int y = 0; y < H; ++y) same = same && memcmp(gp + y * pitch, want + y * W * 4, W * 4) == 0;
+        ASSUME_ITS_TRUE(same);
+    }
+
+    /* an opaque fill under a region hides nothing outside it */
+    fossil_cube_begin_frame_ex(got, 0, 0, 0, 255);
+    fossil_cube_fill_rect_ex(got, 0, 0, W, H, 255, 0, 0, 255);
+    fossil_cube_set_clip_region_ex(got, rg);
+    fossil_cube_fill_rect_ex(got, 0, 0, W, H, 0, 0, 255, 255);
+    fossil_cube_set_clip_region_ex(got, NULL);
+    fossil_cube_end_frame_ex(got);
+    ASSUME_ITS_EQUAL_I32(255, gp[0]);
+    ASSUME_ITS_EQUAL_I32(255, gp[(size_t)parts[0].y * (size_t)pitch + (size_t)parts[0].x * 4u + 2u]);
+
+    fossil_cube_region* empty = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_region_create(&empty, NULL, 0));
+    ASSUME_ITS_EQUAL_I32(0, fossil_cube_region_rects(empty, NULL, 0));
+    ASSUME_ITS_EQUAL_I32(0, fossil_cube_region_bounds(empty).w);
+    fossil_cube_region* bad = NULL;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_region_create(&bad, NULL, 2));
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_ERR_BADARGS, fossil_cube_region_create_diff(&bad, wins, 2, over, -1));
+    ASSUME_ITS_TRUE(bad == NULL);
+
+    fossil_cube_cmdbuf_destroy(buf);
+    fossil_cube_region_destroy(empty);
+    fossil_cube_region_destroy(rg);
+    fossil_cube_paint_destroy(paint);
+    fossil_cube_image_destroy(img);
+    fossil_cube_ctx_destroy(ref);
+    fossil_cube_ctx_destroy(got);
+}
+
+/* Every span kernel set against a per-byte reference computed in memory
+   order, over odd widths and unaligned starts: the packed 32-bit blends
+   must agree with it on either byte order, not only with each other */
+static void test_kernel_ref(int op, uint8_t* d, const uint8_t* s, const uint8_t* k, int n) {
+    for (int i = 0; i < n; ++i, d += 4) {
+        unsigned p[4], a;
+        switch (op) {
+        case 0: /* fill: straight color k, premultiplied on submit */
+        case 3: /* mask: the same color scaled by coverage s[i] */
+            for (int c = 0; c < 3; ++c) p[c] = k[3] == 255 ? k[c] : test_div255((unsigned)k[c] * k[3]);
+            p[3] = k[3];
+            if (op == 3) {
+                for (int c = 0; c < 4; ++c) p[c] = test_div255(p[c] * s[i]);
+            }
+            break;
+        case 1: /* premultiplied source */
+            for (int c = 0; c < 4; ++c) p[c] = s[i * 4 + c];
+            break;
+        default: /* straight source: lerp, with the alpha lane lerping from 255 */
+            a = s[i * 4 + 3];
+            for (int c = 0; c < 4; ++c) {
+                d[c] = test_div255((c < 3 ? s[i * 4 + c] : 255u) * a + d[c] * (255u - a));
+            }
+            continue;
+        }
+        for (int c = 0; c < 4; ++c) d[c] = (uint8_t)(p[c] + test_div255(d[c] * (255u - p[3])));
+    }
+}
+
+/* One framebuffer pixel of format f to RGBA8 and back, as cube.h
+   describes the formats: RGB565 expands by bit replication, reads as
+   opaque and rounds to nearest; A8 is the alpha byte alone */
+static void test_px_load(fossil_cube_format f, const uint8_t* p, uint8_t* q) {
+    uint16_t v;
+    switch (f) {
+    case FOSSIL_CUBE_FORMAT_BGRA8: q[0] = p[2]; q[1] = p[1]; q[2] = p[0]; q[3] = p[3]; break;
+    case FOSSIL_CUBE_FORMAT_RGB565:
+        memcpy(&v, p, sizeof(v));
+        q[0] = (uint8_t)((v >> 11) << 3 | (v >> 13));
+        q[1] = (uint8_t)(((v >> 5) & 63u) << 2 | ((v >> 9) & 3u));
+        q[2] = (uint8_t)((v & 31u) << 3 | ((v >> 2) & 7u));
+        q[3] = 255;
+        break;
+    case FOSSIL_CUBE_FORMAT_A8: q[0] = q[1] = q[2] = 0; q[3] = p[0]; break;
+    default: memcpy(q, p, 4); break;
+    }
+}
+
+static void test_px_store(fossil_cube_format f, uint8_t* p, const uint8_t* q) {
+    uint16_t v;
+    switch (f) {
+    case FOSSIL_CUBE_FORMAT_BGRA8: p[0] = q[2]; p[1] = q[1]; p[2] = q[0]; p[3] = q[3]; break;
+    case FOSSIL_CUBE_FORMAT_RGB565:
+        v = (uint16_t)((q[0] * 31u + 127u) / 255u << 11 | (q[1] * 63u + 127u) / 255u << 5 |
+                       (q[2] * 31u + 127u) / 255u);
+        memcpy(p, &v, sizeof(v));
+        break;
+    case FOSSIL_CUBE_FORMAT_A8: p[0] = q[3]; break;
+    default: memcpy(p, q, 4); break;
+    }
+}
+
+/* The ramp entry step v of a gradient lands on under extend */
+static int test_ramp_index(int v, int extend) {
+    if (extend == FOSSIL_CUBE_EXTEND_PAD) return v < 0 ? 0 : v > 255 ? 255 : v;
+    if (extend == FOSSIL_CUBE_EXTEND_REPEAT) return (v % 256 + 256) % 256;
+    v = (v % 512 + 512) % 512;
+    return v < 256 ? v : 511 - v;
+}
+
+/* Bilinear taps of output pixel i of n over s source pixels: the source
+   coordinate (i + 0.5) * s / n - 0.5 is num / den, its fraction in 1/256,
+   both taps clamped to [0, s) */
+static void test_scale_tap(int i, int n, int s, int* t0, int* t1, unsigned* f) {
+    const int num = (2 * i + 1) * s - n, den = 2 * n;
+    *t0 = *t1 = num <= 0 ? 0 : num / den < s - 1 ? num / den : s - 1;
+    *f = 0;
+    if (num > 0 && *t0 < s - 1) {
+        *t1 = *t0 + 1;
+        *f = (unsigned)(num % den * 256 / den);
+    }
+}
+
+static unsigned test_lerp256(unsigned a, unsigned b, unsigned f) { return (a * (256u - f) + b * f + 128u) >> 8; }
+
+/* want gets a bilinear blit of the straight src (sw x sh) over the dst
+   rect (x, y, w, h): premultiplied taps, lerped, then blended */
+static void test_bilinear_ref(uint8_t* want, int pitch, const uint8_t* src, int sw, int sh,
+                              int x, int y, int w, int h) {
+    for (int j = 0; j < h; ++j) {
+        int v0, v1;
+        unsigned fy;
+        test_scale_tap(j, h, sh, &v0, &v1, &fy);
+        for (int i = 0; i < w; ++i) {
+            int u0, u1;
+            unsigned fx;
+            test_scale_tap(i, w, sw, &u0, &u1, &fx);
+            const uint8_t* tap[4] = { src + (v0 * sw + u0) * 4, src + (v0 * sw + u1) * 4,
+                                      src + (v1 * sw + u0) * 4, src + (v1 * sw + u1) * 4 };
+            uint8_t px[4];
+            for (int c = 0; c < 4; ++c) {
+                unsigned t[4];
+                for (int k = 0; k < 4; ++k) t[k] = c < 3 ? test_div255((unsigned)tap[k][c] * tap[k][3]) : tap[k][3];
+                px[c] = (uint8_t)test_lerp256(test_lerp256(t[0], t[1], fx), test_lerp256(t[2], t[3], fx), fy);
+            }
+            test_kernel_ref(1, want + (y + j) * pitch + (x + i) * 4, px, NULL, 1);
+        }
+    }
+}
+
+FOSSIL_TEST_CASE(c_test_kernels_match_reference) {
+    enum { W = 48, H = 64 };
+    static uint8_t want[H][W * 4];
+    static uint8_t src[H][W * 4];
+    static uint8_t cov[H][W];
+    uint8_t color[H][4];
+    const fossil_cube_simd best = fossil_cube_simd_level();
+    const fossil_cube_format formats[] = { FOSSIL_CUBE_FORMAT_RGBA8, FOSSIL_CUBE_FORMAT_BGRA8,
+                                           FOSSIL_CUBE_FORMAT_RGB565, FOSSIL_CUBE_FORMAT_A8 };
+    const int nformats = (int)(sizeof(formats) / sizeof(formats[0]));
+    fossil_cube_config cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.width = W;
+    cfg.height = H;
+    cfg.present = test_present;
+    int pitch = 0;
+    uint8_t* fb = NULL;
+
+    /* every format through its load and store: the RGBA8 reference on
+       the pixel as the format reads it, written back as it stores it */
+    for (int f = 0; f < nformats; ++f) {
+        cfg.format = formats[f];
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init_with(&cfg));
+        const int bpp = fossil_cube_format_bpp(cfg.format);
+        fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+        for (int op = 0; op < 4; ++op) {
+            for (int level = FOSSIL_CUBE_SIMD_SCALAR; level <= FOSSIL_CUBE_SIMD_NEON; ++level) {
+                if (fossil_cube_set_simd_level((fossil_cube_simd)level) != FOSSIL_CUBE_OK) continue;
+                test_rng = 31u + (uint32_t)op;
+                for (int y = 0; y < H; ++y) {
+                    /* row y: y & 3 pixels in, 1 to 44 wide */
+                    const int x0 = y & 3, n = 1 + (y * 7) % (W - 4);
+                    uint8_t* row = fb + (size_t)y * (size_t)pitch;
+                    for (int i = 0; i < W * bpp; ++i) row[i] = test_rand_u8();
+                    for (int i = 0; i < n; ++i) {
+                        uint8_t* px = src[y] + i * 4;
+                        px[3] = (i & 7) == 0 ? 255 : (i & 7) == 1 ? 0 : test_rand_u8();
+                        for (int c = 0; c < 3; ++c) {
+                            px[c] = test_rand_u8();
+                            if (op == 1) px[c] = (uint8_t)(px[c] % (px[3] + 1u));
+                        }
+                        cov[y][i] = (i & 7) == 2 ? 255 : (i & 7) == 3 ? 0 : test_rand_u8();
+                    }
+                    for (int c = 0; c < 4; ++c) color[y][c] = test_rand_u8();
+                    if (op == 0 && (color[y][3] == 0 || color[y][3] == 255)) color[y][3] = 77;
+                    if (op == 3 && (y & 1)) color[y][3] = 255;
+                    if (op == 3 && color[y][3] == 0) color[y][3] = 1;
+                    memcpy(want[y], row, (size_t)(W * bpp));
+                    for (int i = 0; i < n; ++i) {
+                        uint8_t* d = want[y] + (x0 + i) * bpp;
+                        uint8_t q[4];
+                        test_px_load(cfg.format, d, q);
+                        test_kernel_ref(op, q, op == 3 ? cov[y] + i : src[y] + i * 4, color[y], 1);
+                        test_px_store(cfg.format, d, q);
+                    }
+
+                    const uint8_t* k = color[y];
+                    switch (op) {
+                    case 0: fossil_cube_fill_rect(x0, y, n, 1, k[0], k[1], k[2], k[3]); break;
+                    case 1:
+                        fossil_cube_blit_rgba_alpha(x0, y, src[y], n, 1, W * 4, FOSSIL_CUBE_ALPHA_PREMULTIPLIED);
+                        break;
+                    case 2:
+                        fossil_cube_blit_rgba_alpha(x0, y, src[y], n, 1, W * 4, FOSSIL_CUBE_ALPHA_STRAIGHT);
+                        break;
+                    default: fossil_cube_blit_mask(x0, y, cov[y], n, 1, W, k[0], k[1], k[2], k[3]); break;
+                    }
+                }
+                int bad = 0;
+                for (int y = 0; y < H; ++y) bad += memcmp(fb + (size_t)y * (size_t)pitch, want[y], (size_t)(W * bpp)) != 0;
+                ASSUME_ITS_EQUAL_I32(0, bad);
+            }
+        }
+    }
+
+    /* known bytes: blue at half coverage over opaque black keeps its own
+       alpha lane, which a top-byte-is-alpha shortcut misreads on
+       big-endian hosts as the red byte */
+    cfg.format = FOSSIL_CUBE_FORMAT_RGBA8;
+    ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_init_with(&cfg));
+    fb = fossil_cube_framebuffer(NULL, NULL, &pitch);
+    static const uint8_t half = 128;
+    fossil_cube_clear(0, 0, 0, 255);
+    fossil_cube_blit_mask(0, 0, &half, 1, 1, 1, 0, 0, 255, 255);
+    ASSUME_ITS_TRUE(fb[0] == 0 && fb[1] == 0 && fb[2] == 128 && fb[3] == 255);
+
+    /* linear ramps through the ramp lookups: a 256-pixel two-stop ramp
+       puts entry v at step v; forwards, backwards, diagonally and off
+       either end, in every extend mode */
+    static const struct { float x0, y0, x1, y1; int dx, dy, v0; } geo[4] = {
+        { -230.0f, 0.0f, 26.0f, 0.0f, 1, 0, 230 },  { 300.0f, 0.0f, 556.0f, 0.0f, 1, 0, -300 },
+        { 20.0f, 0.0f, -236.0f, 0.0f, -1, 0, 19 },  { 40.0f, 0.0f, 168.0f, 128.0f, 1, 1, -39 }
+    };
+    const fossil_cube_color_stop ud[2] = { { 0.0f, 0, 255, 60, 255 }, { 1.0f, 255, 0, 60, 255 } };
+    fossil_cube_paint* ramps[3][4];
+    for (int e = 0; e < 3; ++e) {
+        for (int g = 0; g < 4; ++g) {
+            ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_paint_linear(&ramps[e][g], geo[g].x0, geo[g].y0,
+                                                                          geo[g].x1, geo[g].y1, ud, 2,
+                                                                          (fossil_cube_extend)e));
+        }
+    }
+    for (int level = FOSSIL_CUBE_SIMD_SCALAR; level <= FOSSIL_CUBE_SIMD_NEON; ++level) {
+        if (fossil_cube_set_simd_level((fossil_cube_simd)level) != FOSSIL_CUBE_OK) continue;
+        test_rng = 41u;
+        for (int y = 0; y < H; ++y) {
+            const int x0 = y & 3, n = 1 + (y * 7) % (W - 4), e = y % 3, g = y / 3 % 4;
+            uint8_t* row = fb + (size_t)y * (size_t)pitch;
+            for (int i = 0; i < W * 4; ++i) row[i] = test_rand_u8();
+            memcpy(want[y], row, sizeof(want[y]));
+            for (int i = 0; i < n; ++i) {
+                const int v = test_ramp_index(geo[g].dx * (x0 + i) + geo[g].dy * y + geo[g].v0, e);
+                uint8_t* px = want[y] + (x0 + i) * 4;
+                px[0] = (uint8_t)((255 * (2 * v + 1) + 256) / 512);
+                px[1] = (uint8_t)((255 * 512 + 256 - 255 * (2 * v + 1)) / 512);
+                px[2] = 60;
+                px[3] = 255;
+            }
+            fossil_cube_fill_rect_paint(x0, y, n, 1, ramps[e][g]);
+        }
+        int bad = 0;
+        for (int y = 0; y < H; ++y) bad += memcmp(fb + (size_t)y * (size_t)pitch, want[y], W * 4) != 0;
+        ASSUME_ITS_EQUAL_I32(0, bad);
+    }
+    for (int e = 0; e < 3; ++e) {
+        for (int g = 0; g < 4; ++g) fossil_cube_paint_destroy(ramps[e][g]);
+    }
+
+    /* bilinear stretches, up and down, of a straight source with
+       opaque, clear and translucent pixels */
+    enum { SW = 9, SH = 6 };
+    static uint8_t img[SW * SH * 4];
+    test_rng = 43u;
+    for (int i = 0; i < SW * SH; ++i) {
+        img[i * 4 + 3] = (i & 3) == 0 ? 255 : (i & 3) == 1 ? 0 : test_rand_u8();
+        for (int c = 0; c < 3; ++c) img[i * 4 + c] = test_rand_u8();
+    }
+    for (int level = FOSSIL_CUBE_SIMD_SCALAR; level <= FOSSIL_CUBE_SIMD_NEON; ++level) {
+        if (fossil_cube_set_simd_level((fossil_cube_simd)level) != FOSSIL_CUBE_OK) continue;
+        for (int y = 0; y < H; ++y) {
+            uint8_t* row = fb + (size_t)y * (size_t)pitch;
+            for (int i = 0; i < W * 4; ++i) row[i] = test_rand_u8();
+            memcpy(want[y], row, sizeof(want[y]));
+        }
+        test_bilinear_ref(want[0], W * 4, img, SW, SH, 2, 3, 44, 29);
+        test_bilinear_ref(want[0], W * 4, img, SW, SH, 41, 40, 5, 3);
+        fossil_cube_blit_scaled(2, 3, 44, 29, img, SW, SH, SW * 4, FOSSIL_CUBE_FILTER_BILINEAR);
+        fossil_cube_blit_scaled(41, 40, 5, 3, img, SW, SH, SW * 4, FOSSIL_CUBE_FILTER_BILINEAR);
+        int bad = 0;
+        for (int y = 0; y < H; ++y) bad += memcmp(fb + (size_t)y * (size_t)pitch, want[y], W * 4) != 0;
+        ASSUME_ITS_EQUAL_I32(0, bad);
+    }
+
+    /* clears big enough for the streaming stores, in every format; the
+       odd width leaves every row but the first off alignment */
+    enum { BW = 1283, BH = 1700 };
+    static const uint8_t fill[4] = { 200, 100, 50, 255 };
+    static uint8_t line[BW * 4];
+    cfg.width = BW;
+    cfg.height = BH;
+    for (int f = 0; f < nformats; ++f) {
+        cfg.format = formats[f];
+        fossil_cube_ctx* ctx = NULL;
+        ASSUME_ITS_EQUAL_I32(FOSSIL_CUBE_OK, fossil_cube_ctx_create_with(&ctx, &cfg));
+        const int bpp = fossil_cube_format_bpp(cfg.format);
+        for (int x = 0; x < BW; ++x) test_px_store(cfg.format, line + x * bpp, fill);
+        for (int level = FOSSIL_CUBE_SIMD_SCALAR; level <= FOSSIL_CUBE_SIMD_NEON; ++level) {
+            if (fossil_cube_set_simd_level((fossil_cube_simd)level) != FOSSIL_CUBE_OK) continue;
+            uint8_t* p = fossil_cube_framebuffer_ex(ctx, NULL, NULL, &pitch);
+            memset(p, 0x5A, (size_t)pitch * BH);
+            fossil_cube_clear_ex(ctx, fill[0], fill[1], fill[2], fill[3]);
+            int bad = 0;
+            for (int y = 0; y < BH; ++y) bad += memcmp(p + (size_t)y * (size_t)pitch, line, (size_t)(BW * bpp)) != 0;
+            ASSUME_ITS_EQUAL_I32(0, bad);
+        }
+        fossil_cube_ctx_destroy(ctx);
+    }
+    fossil_cube_set_simd_level(best);
+}
+
 // * * * * * * * * * * * * * * * * * * * * * * * *
 // * Fossil Logic Test Pool
 // * * * * * * * * * * * * * * * * * * * * * * * *
 FOSSIL_TEST_GROUP(c_cube_tests) {    
     FOSSIL_TEST_ADD(c_cube_fixture, c_test_blaink);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_simd_matches_scalar);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_clear_byte_order);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_line_clipped_up_front);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_contexts_are_independent);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_deferred_matches_immediate);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_cmdbuf_record_replay);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_tiled_threads_match_serial);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_dirty_rects_partial_present);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_swapchain_async_present);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_swapchain_release_timeout);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_straight_and_premultiplied_alpha);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_blend_div255_exhaustive);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_pixel_formats);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_framebuffer_memory);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_shm_present_zero_copy);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_image_atlas_runs);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_text_glyph_cache);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_blit_scaled);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_aa_shapes);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_axis_lines_fast_paths);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_frame_arena);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_frame_stats);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_composite_layers);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_retained_scene);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_frame_encoder);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_frame_capture);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_fast_clear);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_paint_fills);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_batches);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_clip_region);
+    FOSSIL_TEST_ADD(c_cube_fixture, c_test_kernels_match_reference);
 
     FOSSIL_TEST_REGISTER(c_cube_fixture);
 } // end of tests
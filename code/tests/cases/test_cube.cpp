@@ -13,6 +13,7 @@
  */
 #include <fossil/pizza/framework.h>
 #include "fossil/cube/framework.h"
+#include <type_traits>
 
 
 // * * * * * * * * * * * * * * * * * * * * * * * *
@@ -44,12 +45,107 @@ FOSSIL_TEST_CASE(cpp_test_blaink) {
     ASSUME_ITS_TRUE(1);
 }
 
+FOSSIL_TEST_CASE(cpp_test_raii_context) {
+    using namespace fossil::cube;
+    static_assert(!std::is_copy_constructible_v<Context>);
+    static_assert(std::is_nothrow_move_constructible_v<Context>);
+    static_assert(std::is_nothrow_move_assignable_v<Surface<Format::BGRA8>>);
+    static_assert(bytes_per_pixel(Format::RGB565) == 2);
+    static_assert(Color::hex(0x80402010u) == Color{ 0x80, 0x40, 0x20, 0x10 });
+    static_assert(Color{ 255, 255, 255, 128 }.premultiplied() == Color{ 128, 128, 128, 128 });
+
+    Context ctx(16, 8);
+    ASSUME_ITS_TRUE(ctx && ctx.width() == 16 && ctx.height() == 8);
+    ctx.clear(Color{ 1, 2, 3, 255 });
+
+    Context moved(std::move(ctx));
+    ASSUME_ITS_TRUE(!ctx && moved);
+    ASSUME_ITS_TRUE(moved.view<Format::BGRA8>().empty());
+    const SurfaceView<Format::RGBA8> v = moved.view<Format::RGBA8>();
+    ASSUME_ITS_TRUE(!v.empty() && v.load(15, 7) == (Color{ 1, 2, 3, 255 }));
+
+    bool threw = false;
+    try {
+        Context bad(0, 0);
+    } catch (const Error& e) {
+        threw = e.result() == FOSSIL_CUBE_ERR_BADARGS;
+    }
+    ASSUME_ITS_TRUE(threw);
+
+    const uint8_t px[8] = { 10, 20, 30, 255, 0, 0, 0, 0 };
+    Image img(ImageView(px, 2, 1));
+    Image other(std::move(img));
+    ASSUME_ITS_TRUE(img.get() == nullptr && other.width() == 2);
+    moved.draw_image(other, 0, 0);
+    ASSUME_ITS_TRUE(v.load(0, 0) == (Color{ 10, 20, 30, 255 }) && v.load(1, 0) == (Color{ 1, 2, 3, 255 }));
+}
+
+/* The fill/blit templates must match the context's own kernels bit for bit */
+template <fossil::cube::Format F>
+static bool cpp_templates_match_core() {
+    using namespace fossil::cube;
+    constexpr int W = 23, H = 11;
+    Surface<F> ref(W, H), typed(W, H);
+    const SurfaceView<F> rv = ref.view(), tv = typed.view();
+    if (rv.empty() || tv.empty()) return false;
+
+    uint8_t src[7 * 5 * 4];
+    for (int i = 0; i < 7 * 5; ++i) {
+        src[i * 4 + 0] = (uint8_t)(i * 37);
+        src[i * 4 + 1] = (uint8_t)(i * 91 + 5);
+        src[i * 4 + 2] = (uint8_t)(i * 13 + 200);
+        src[i * 4 + 3] = (uint8_t)(i % 3 == 0 ? 255 : i % 3 == 1 ? 0 : i * 29);
+    }
+    const ImageView image(src, 7, 5);
+    uint8_t premul[sizeof(src)];
+    std::memcpy(premul, src, sizeof(src));
+    fossil_cube_premultiply(premul, 7, 5, 28);
+    const ImageView pimage(premul, 7, 5);
+
+    const Color bg{ 40, 90, 160, 255 }, tint{ 250, 20, 130, 100 };
+    ref.clear(bg);
+    fill<Blend::Copy>(tv, Rect{ 0, 0, W, H }, bg);
+    ref.fill_rect(Rect{ -3, 2, 12, 20 }, tint);
+    fill(tv, Rect{ -3, 2, 12, 20 }, tint);
+    ref.fill_rect(Rect{ 15, -1, 4, 4 }, Color{ 9, 8, 7, 255 });
+    fill(tv, Rect{ 15, -1, 4, 4 }, Color{ 9, 8, 7, 255 });
+    ref.blit(4, 3, image);
+    blit(tv, 4, 3, image);
+    ref.blit(19, 8, pimage, Alpha::Premultiplied);
+    blit<Blend::Over, Alpha::Premultiplied>(tv, 19, 8, pimage);
+    Surface<Format::RGBA8> layer(7, 5);
+    const SurfaceView<Format::RGBA8> lv = layer.view();
+    for (int y = 0; y < 5; ++y) std::memcpy(lv.row(y).data(), premul + y * 28, 28);
+    ref.composite(layer, Rect{ 0, 0, 7, 5 }, 1, 5, 255, Blend::Multiply);
+    blit<Blend::Multiply, Alpha::Premultiplied>(tv, 1, 5, pimage);
+    ref.composite(layer, Rect{ 0, 0, 7, 5 }, 12, 1, 255, Blend::Add);
+    blit<Blend::Add, Alpha::Premultiplied>(tv, 12, 1, pimage);
+    ref.set_alpha(Alpha::Premultiplied);
+    ref.fill_rect(Rect{ 2, 0, 9, 3 }, tint.premultiplied());
+    fill<Blend::Over, Alpha::Premultiplied>(tv, Rect{ 2, 0, 9, 3 }, tint.premultiplied());
+
+    for (int y = 0; y < H; ++y) {
+        if (std::memcmp(rv.row(y).data(), tv.row(y).data(), rv.row(y).size()) != 0) return false;
+    }
+    return true;
+}
+
+FOSSIL_TEST_CASE(cpp_test_typed_fill_blit) {
+    using fossil::cube::Format;
+    ASSUME_ITS_TRUE(cpp_templates_match_core<Format::RGBA8>());
+    ASSUME_ITS_TRUE(cpp_templates_match_core<Format::BGRA8>());
+    ASSUME_ITS_TRUE(cpp_templates_match_core<Format::RGB565>());
+    ASSUME_ITS_TRUE(cpp_templates_match_core<Format::A8>());
+}
+
 // * * * * * * * * * * * * * * * * * * * * * * * *
 // * Fossil Logic Test Pool
 // * * * * * * * * * * * * * * * * * * * * * * * *
 FOSSIL_TEST_GROUP(cpp_cube_tests) {    
     // C++ Wrapper Tests
     FOSSIL_TEST_ADD(cpp_cube_fixture, cpp_test_blaink);
+    FOSSIL_TEST_ADD(cpp_cube_fixture, cpp_test_raii_context);
+    FOSSIL_TEST_ADD(cpp_cube_fixture, cpp_test_typed_fill_blit);
 
     FOSSIL_TEST_REGISTER(cpp_cube_fixture);
 } // end of tests